@@ -0,0 +1,135 @@
+#pragma once
+
+/**
+ * @file bench.h
+ * @brief On-device benchmark suite and loopback keyload harness
+ *
+ * Times the building blocks of a fill on the target itself - CRC, frame
+ * build and parse, key derivation and bulk ciphers, LVGL frames, TWI
+ * transmit rate - and, with a second TWI port wired back to the front-panel
+ * port, the line itself: TX and RX bit timing measured with LineCapture,
+ * receive throughput, and full keyload round trips against the MR emulator
+ * running on the loopback port. No radio is needed.
+ *
+ * Loopback wiring: front-panel DATA to BENCH_LOOP_DATA_PIN, SENSE to
+ * BENCH_LOOP_SENSE_PIN. Both ports share the board's ground.
+ *
+ * Every result is a named metric. "bench baseline" stores the last results
+ * in LittleFS; later runs flag any metric that got worse than the baseline
+ * by more than BENCH_REGRESSION_PCT, and metrics with a fixed limit (bit
+ * timing error, byte errors, failed loads) fail on their own.
+ */
+
+#include <Arduino.h>
+#include "twi_hal.h"
+#include "kfd_protocol.h"
+
+// 1 = bench build: run the whole suite once at boot
+#ifndef KFD_BENCH
+#define KFD_BENCH 0
+#endif
+
+// Loopback radio port (defaults are fleet port 2 - not with FLEET_PORTS > 2)
+#ifndef BENCH_LOOP_DATA_PIN
+#define BENCH_LOOP_DATA_PIN 14
+#endif
+#ifndef BENCH_LOOP_SENSE_PIN
+#define BENCH_LOOP_SENSE_PIN 21
+#endif
+#ifndef BENCH_LOOP_RMT_CHANNEL
+#define BENCH_LOOP_RMT_CHANNEL 2
+#endif
+
+// Keyload round trips: rounds of BENCH_LOOP_KEYS AES-256 keys each
+#ifndef BENCH_LOOP_ROUNDS
+#define BENCH_LOOP_ROUNDS 5
+#endif
+#ifndef BENCH_LOOP_KEYS
+#define BENCH_LOOP_KEYS 4
+#endif
+
+// Allowed slowdown against the stored baseline
+#ifndef BENCH_REGRESSION_PCT
+#define BENCH_REGRESSION_PCT 15
+#endif
+
+namespace Bench {
+
+// Test groups (bit mask for run())
+enum Test : uint32_t {
+    T_CRC    = 1u << 0,     // KMM CRC, table and ROM paths
+    T_FRAME  = 1u << 1,     // Keyload plan build, rekey ack parse
+    T_CRYPTO = 1u << 2,     // PBKDF2, SHA-256, AES-GCM
+    T_LVGL   = 1u << 3,     // Full-screen render + flush
+    T_TX     = 1u << 4,     // sendBytesFast() / sendEncoded() rate
+    T_LOOP   = 1u << 5,     // Loopback: bit timing, RX path, keyload round trips
+    T_ALL    = 0x3F,
+};
+
+enum Metric : uint8_t {
+    M_CRC_TABLE = 0,
+    M_CRC_ROM,
+    M_PLAN_1KEY,
+    M_PLAN_8KEYS,
+    M_ACK_PARSE,
+    M_PBKDF2,
+    M_SHA256,
+    M_AES_GCM,
+    M_LVGL_FRAME,
+    M_LVGL_FRAME_MAX,
+    M_TX_RATE,
+    M_TX_ENCODED_RATE,
+    M_TX_OVERHEAD,
+    M_TX_BIT_ERROR,
+    M_TX_JITTER,
+    M_TX_BYTE_ERRORS,
+    M_RX_RATE,
+    M_RX_BIT_ERROR,
+    M_RX_BYTE_ERRORS,
+    M_LOOP_CONNECT,
+    M_LOOP_KEYLOAD,
+    M_LOOP_KEYLOAD_MAX,
+    M_LOOP_FAILURES,
+    METRIC_COUNT
+};
+
+/**
+ * @brief Attach the front-panel port (called once from setup)
+ */
+void init(TWI_HAL* hal, KFDProtocol* kfd);
+
+/**
+ * @brief Map a test name ("crc", "frame", "crypto", "lvgl", "tx", "loop",
+ *        "all") to its mask
+ * @return 0 for an unknown name
+ */
+uint32_t parseTests(const String& name);
+
+/**
+ * @brief Run the selected tests, then compare against the baseline
+ * Blocks the caller for the duration (seconds with T_LOOP / T_CRYPTO).
+ * @param tests Test mask
+ * @param out Progress and result table
+ * @return true if no metric exceeded its limit or regressed
+ */
+bool run(uint32_t tests, Print& out);
+
+/**
+ * @brief Result table of the last run, with the baseline beside it
+ */
+void print(Print& out);
+
+/**
+ * @brief Last results as CSV: name,unit,value,baseline,verdict
+ */
+size_t exportCsv(Print& out);
+
+/**
+ * @brief Store the last results as the regression baseline (LittleFS)
+ * Metrics the last run did not measure keep their stored value.
+ */
+bool saveBaseline();
+
+const char* metricName(Metric metric);
+
+} // namespace Bench
@@ -0,0 +1,35 @@
+#pragma once
+
+/**
+ * @file console.h
+ * @brief Text console sink shared by every module
+ *
+ * All diagnostic and console text goes through Console instead of Serial.
+ * The USB CDC port also carries the host bridge's binary frames, where any
+ * stray byte ('a' and 'c' are the frame delimiters) would start or break a
+ * frame, so the bridge mutes Console for as long as it owns the port and
+ * writes its frames to Serial directly.
+ *
+ * Console input (commands) is still read from Serial.
+ */
+
+#include <Arduino.h>
+
+class ConsoleSink : public Print {
+public:
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    void flush() override;
+
+    /**
+     * @brief Drop all output (and ESP-IDF log output) until unmuted
+     * Muted writes report success so callers don't retry.
+     */
+    void setMuted(bool muted);
+    bool isMuted() const { return _muted; }
+
+private:
+    volatile bool _muted = false;
+};
+
+extern ConsoleSink Console;
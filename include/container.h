@@ -15,6 +15,10 @@
 #include <stdint.h>
 #include <string>
 #include <vector>
+#include <utility>
+#include <functional>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include "p25_defs.h"
 
 // =============================================================================
@@ -26,10 +30,16 @@ struct KeySlot {
     uint8_t     algorithmId;    // P25::AlgorithmId
     uint16_t    keyId;          // Key ID
     uint16_t    sln;            // Storage Location Number (CKR)
-    std::string keyHex;         // Key material as hex string
+    uint8_t     key[P25::MAX_KEY_LEN]; // Key material (raw bytes)
+    uint8_t     keyLen;         // Bytes used in key
     bool        selected;       // Selected for keyload
     
-    KeySlot() : algorithmId(P25::ALGO_AES_256), keyId(1), sln(1), selected(true) {}
+    KeySlot() : algorithmId(P25::ALGO_AES_256), keyId(1), sln(1), key{}, keyLen(0), selected(true) {}
+    KeySlot(const KeySlot&) = default;
+    KeySlot(KeySlot&&) = default;
+    KeySlot& operator=(const KeySlot&) = default;
+    KeySlot& operator=(KeySlot&&) = default;
+    ~KeySlot();                 // Wipes the key material
     
     // Convert to P25::KeyItem for protocol operations
     P25::KeyItem toKeyItem(uint16_t keysetId = 1) const;
@@ -38,7 +48,28 @@ struct KeySlot {
     bool isValid() const;
     
     // Get key length in bytes
-    size_t getKeyLength() const;
+    size_t getKeyLength() const { return keyLen; }
+    
+    // Key material as hex (UI and JSON only)
+    std::string keyHex() const;
+    
+    // Set key material; false (key unchanged) if malformed or too long
+    bool setKeyHex(const std::string& hex);
+    bool setKey(const uint8_t* data, size_t len);
+    void clearKey();
+};
+
+// Position of a key inside a container (valid until the container changes)
+struct KeyRef {
+    uint16_t group;
+    uint16_t key;
+};
+
+// Key index entry: (keyset, SLN) -> position
+struct KeyIndexEntry {
+    uint16_t keysetId;
+    uint16_t sln;
+    KeyRef   ref;
 };
 
 // =============================================================================
@@ -54,8 +85,8 @@ struct KeyGroup {
     
     KeyGroup() : keysetId(1), useActiveKeyset(true), expanded(true) {}
     
-    // Get all selected keys
-    std::vector<KeySlot> getSelectedKeys() const;
+    // Indices of the selected keys
+    std::vector<uint16_t> getSelectedKeys() const;
     
     // Count selected keys
     size_t selectedCount() const;
@@ -76,24 +107,60 @@ struct Container {
     // Groups and keys
     std::vector<KeyGroup> groups;
     
+    // Key index sorted by (keysetId, SLN) and cached counts. Rebuilt by
+    // reindex(); ContainerManager's group and key operations keep it in sync.
+    std::vector<KeyIndexEntry> keyIndex;
+    uint16_t    keyCount;       // Also valid while not resident (from the storage index)
+    uint16_t    selectedCount;
+    uint16_t    duplicateSlns;  // Keys sharing (keysetId, SLN) with an earlier key
+    
     // Security settings
     bool        isLocked;       // Container is locked (no edits)
     bool        isEncrypted;    // Container is encrypted
     std::string passwordHash;   // SHA-256 hash of password (for verification)
     
-    Container() : isLocked(false), isEncrypted(false) {}
+    // Storage bookkeeping (maintained by ContainerManager)
+    uint32_t    storeId;        // Record file ID (0 = not stored yet)
+    bool        storeDirty;     // Changed since the record was written
+    bool        resident;       // Groups and keys in RAM (false = index summary only)
+    uint32_t    lastUsed;       // LRU stamp
+    
+    Container() : keyCount(0), selectedCount(0), duplicateSlns(0), isLocked(false), isEncrypted(false),
+                  storeId(0), storeDirty(true), resident(true), lastUsed(0) {}
+    
+    // All keys (flattened)
+    std::vector<KeyRef> getAllKeys() const;
+    
+    // Selected keys
+    std::vector<KeyRef> getSelectedKeys() const;
     
-    // Get all keys (flattened)
-    std::vector<KeySlot> getAllKeys() const;
+    // Key at a reference
+    const KeySlot& keyAt(const KeyRef& ref) const { return groups[ref.group].keys[ref.key]; }
     
-    // Get all selected keys
-    std::vector<KeySlot> getSelectedKeys() const;
+    // Selected keys as protocol items, each tagged with its group's keyset ID
+    std::vector<P25::KeyItem> getSelectedKeyItems() const;
     
     // Count total keys
-    size_t totalKeyCount() const;
+    size_t totalKeyCount() const { return keyCount; }
     
     // Count selected keys
-    size_t selectedKeyCount() const;
+    size_t selectedKeyCount() const { return selectedCount; }
+    
+    // Lookup by keyset and SLN (O(log n)); first match if duplicated
+    const KeySlot* findKey(uint16_t keysetId, uint16_t sln, KeyRef* ref = nullptr) const;
+    
+    // Keys stored under a keyset and SLN (> 1 = duplicate)
+    size_t countKeys(uint16_t keysetId, uint16_t sln) const;
+    
+    // Lowest SLN not used in a keyset
+    uint16_t nextFreeSln(uint16_t keysetId) const;
+    
+    // Rebuild the key index and counts from groups
+    void reindex();
+    
+    // Incremental index updates (ContainerManager)
+    void indexInsert(const KeyRef& ref);
+    void indexErase(const KeyRef& ref);
     
     // Update modified timestamp
     void touch();
@@ -110,9 +177,19 @@ public:
     bool init();
     
     // Container CRUD
+    // Containers are paged in from storage on access; the list screens only
+    // need the index summary (name, modified date, key counts)
     size_t getContainerCount() const { return _containers.size(); }
-    const Container& getContainer(size_t index) const;
+    
+    // Bumped by every change to container contents, membership, selection or
+    // lock state. Containers move in memory (vector growth, restore, paging),
+    // so anything derived from them is keyed on (generation, index), never
+    // on a Container pointer.
+    uint32_t getGeneration() const { return _generation; }
+    const Container& getSummary(size_t index) const;      // Never pages in
+    const Container& getContainer(size_t index);
     Container& getMutableContainer(size_t index);
+    size_t residentKeyCount() const;
     int addContainer(const Container& c);
     bool updateContainer(size_t index, const Container& c);
     bool deleteContainer(size_t index);
@@ -120,7 +197,7 @@ public:
     // Active container
     int getActiveIndex() const { return _activeIndex; }
     bool setActiveIndex(int index);
-    const Container* getActiveContainer() const;
+    const Container* getActiveContainer();
     Container* getActiveContainerMutable();
     
     // Group operations
@@ -128,15 +205,25 @@ public:
     bool updateGroup(size_t containerIdx, size_t groupIdx, const KeyGroup& group);
     bool deleteGroup(size_t containerIdx, size_t groupIdx);
     
-    // Key operations
+    // Key operations (keep the container's key index and counts current)
     bool addKey(size_t containerIdx, size_t groupIdx, const KeySlot& key);
     bool updateKey(size_t containerIdx, size_t groupIdx, size_t keyIdx, const KeySlot& key);
     bool deleteKey(size_t containerIdx, size_t groupIdx, size_t keyIdx);
+    bool setKeySelected(size_t containerIdx, size_t groupIdx, size_t keyIdx, bool selected);
     
-    // Persistence (encrypted storage)
+    // Persistence: one AES-256-GCM binary record per container plus an index,
+    // key from DeviceManager's session. Only changed containers are rewritten,
+    // each to a temp file renamed over the old one, so a brown-out leaves
+    // either the previous or the new record. Autosave runs on a writer task.
     bool load();                              // Load from internal storage
-    bool save();                              // Save to internal storage
-    bool saveNow();                           // Immediate save
+    bool save();                              // Mark the active container (or all) changed
+    bool saveNow();                           // Immediate save (waits for the writer)
+    bool isSaving() const { return _jobQueued; }
+    
+    // Contents are only held while a user is logged in
+    bool unlock();                            // Load with the session key (defaults if none stored)
+    void lock();                              // Flush pending changes, wipe contents from RAM
+    bool isUnlocked() const { return _unlocked; }
     
     // Password protection
     bool setPassword(const std::string& password);
@@ -144,12 +231,17 @@ public:
     bool isPasswordSet() const { return !_password.empty(); }
     void clearPassword() { _password.clear(); }
     
-    // SD Card backup/restore
+    // SD Card backup/restore (/kfdtool/<name>.kbk unless a path is given).
+    // Sealed with the storage key, so a backup restores on this device only.
+    // Restore replaces all containers, and only once the whole file has
+    // authenticated. Both stream one container at a time.
     bool backupToSd(const char* filename);
     bool restoreFromSd(const char* filename);
     bool listSdBackups(std::vector<std::string>& files);
     
-    // Export/Import (unencrypted JSON for compatibility)
+    // Export/Import (unencrypted JSON for compatibility, /kfdtool/<name>.json).
+    // Import adds the file's containers to the existing ones; it parses one
+    // key object at a time, so only the largest container has to fit in RAM.
     bool exportToJson(const char* filename);
     bool importFromJson(const char* filename);
     
@@ -157,9 +249,25 @@ public:
     bool factoryReset();
     void loadDefaults();
     
-    // Autosave service (call from loop)
+    // Autosave service (call from loop) - snapshots changes for the writer task
     void service();
     
+    // Whole-store changes: everything derived from the old contents (selection,
+    // open screens, compiled keyload plans) is stale. Called on the loop task.
+    enum StoreEvent : uint8_t {
+        STORE_REPLACED = 0,     // restoreFromSd(): all containers replaced
+        STORE_IMPORTED,         // importFromJson(): containers added
+        STORE_LOCKED,           // lock(): logout or session timeout, contents wiped
+    };
+    using StoreCallback = std::function<void(StoreEvent event)>;
+    void setStoreCallback(StoreCallback cb) { _storeCallback = cb; }
+    
+    // True while a TWI exchange may be running. Flash writes stall both cores
+    // and hold off the (non-IRAM) edge ISR, so autosave waits until it's false.
+    // Polled from the loop and the writer task.
+    using LinkBusyCheck = std::function<bool()>;
+    void setLinkBusyCheck(LinkBusyCheck cb) { _linkBusy = cb; }
+    
 private:
     ContainerManager();
     ContainerManager(const ContainerManager&) = delete;
@@ -167,22 +275,58 @@ private:
     
     std::vector<Container> _containers;
     int _activeIndex;
+    uint32_t _generation;
+    StoreCallback _storeCallback;
+    LinkBusyCheck _linkBusy;
     std::string _password;  // Current session password (not persisted)
     
     // Persistence state
     bool _storageReady;
+    bool _unlocked;
     bool _dirty;
+    bool _indexDirty;                     // Order or membership changed
+    uint32_t _nextStoreId;
+    std::vector<uint32_t> _removedIds;    // Records to delete after the next index write
     uint32_t _lastChangeMs;
     uint32_t _lastSaveMs;
     
+    // Snapshot of the changed state, sealed and written off the loop task
+    struct SaveJob {
+        std::vector<std::pair<uint32_t, std::string>> records;  // Record ID, encoded container
+        std::string index;                                      // Encoded index (empty = unchanged)
+        std::vector<uint32_t> removed;                          // Records to delete after the index
+    };
+    SaveJob _job;
+    bool _jobQueued;                      // Handed to the writer, not yet finished (loop task only)
+    volatile bool _jobPending;            // Writer is working on _job
+    volatile bool _jobOk;
+    TaskHandle_t _writerTask;
+    
+    uint32_t _useTick;
+    
     // Internal methods
-    bool ensureStorage();
-    bool loadFromStorage();
-    bool saveToStorage();
+    bool pageIn(size_t index);
+    void evictIfNeeded();
+    bool startWriter(BaseType_t core = 0);
+    static void writerTask(void* arg);
+    void writerLoop();
+    void buildSaveJob(SaveJob& job);
+    bool writeSaveJob(SaveJob& job);
+    void finishSaveJob(bool ok);
+    bool linkBusy() const { return _linkBusy && _linkBusy(); }
+    void waitForWriter();
+    void removeOrphans(const std::vector<uint32_t>& ids);
+    void markChanged(size_t index);
+    bool loadRecords();
+    bool migrateLegacy();
+    bool recordOf(size_t index, std::string& record);
+    bool stageContainer(Container& c, std::vector<Container>& staged);
+    void discardStaged(std::vector<Container>& staged);
+    bool commitStaged(std::vector<Container>& staged, bool replace);
     std::string serializeContainers();
     bool deserializeContainers(const std::string& json);
-    bool encryptAndSave(const std::string& plaintext);
-    bool loadAndDecrypt(std::string& plaintext);
+    bool encryptAndSave(const char* path, const std::string& plaintext);
+    bool loadAndDecrypt(const char* path, std::string& plaintext);
 };
 
 // =============================================================================
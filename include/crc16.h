@@ -0,0 +1,99 @@
+#pragma once
+
+/**
+ * @file crc16.h
+ * @brief CRC-16 engines used by the KMM framing and the storage layer
+ *
+ * Two variants, both polynomial 0x1021 with init 0xFFFF:
+ * - Kmm:   reflected (0x8408), no final XOR - TIA 102.AACD-A as implemented by KFDtool
+ * - Ccitt: MSB-first (CCITT-FALSE) - used for container/storage integrity
+ *
+ * Each engine is incremental: bytes can be fed as they arrive off the wire
+ * instead of buffering the frame and checksumming it afterwards. Block updates
+ * use a 256-entry table in internal RAM, or the ESP32 ROM routines for longer
+ * blocks when enabled (verified against the table by selfTest()).
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Crc16 {
+
+// Check values for the ASCII string "123456789"
+constexpr uint16_t KMM_CHECK   = 0x6F91;
+constexpr uint16_t CCITT_CHECK = 0x29B1;
+constexpr uint16_t INIT        = 0xFFFF;
+
+class Kmm {
+public:
+    Kmm() : _crc(INIT) {}
+
+    void reset() { _crc = INIT; }
+
+    /**
+     * @brief Feed one byte (safe from ISR context)
+     */
+    void update(uint8_t b);
+
+    /**
+     * @brief Feed a block (ROM path for long blocks when enabled)
+     */
+    void update(const uint8_t* data, size_t len);
+
+    /**
+     * @brief Feed a block through the table only
+     */
+    void updateTable(const uint8_t* data, size_t len);
+
+    /**
+     * @brief Feed a block through the ROM routine only
+     */
+    void updateRom(const uint8_t* data, size_t len);
+
+    uint16_t value() const { return _crc; }
+
+private:
+    uint16_t _crc;
+};
+
+class Ccitt {
+public:
+    Ccitt() : _crc(INIT) {}
+
+    void reset() { _crc = INIT; }
+    void update(uint8_t b);
+    void update(const uint8_t* data, size_t len);
+    void updateTable(const uint8_t* data, size_t len);
+    void updateRom(const uint8_t* data, size_t len);
+
+    uint16_t value() const { return _crc; }
+
+private:
+    uint16_t _crc;
+};
+
+/**
+ * @brief One-shot KMM CRC of a buffer
+ */
+uint16_t kmm(const uint8_t* data, size_t len);
+
+/**
+ * @brief One-shot CCITT CRC of a buffer
+ */
+uint16_t ccitt(const uint8_t* data, size_t len);
+
+/**
+ * @brief Enable/disable the ROM path for block updates
+ */
+void setUseRom(bool enable);
+bool getUseRom();
+
+/**
+ * @brief Check both engines against the standard test vector
+ * @param verbose Print results to the Console
+ * @return true if the table path is correct. The ROM path is disabled
+ *         automatically if it disagrees with the table.
+ */
+bool selfTest(bool verbose = true);
+
+} // namespace Crc16
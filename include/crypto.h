@@ -9,12 +9,18 @@
  * - Key derivation from PIN
  * - Secure random number generation
  * - Key validation
+ * 
+ * All primitives go through mbedTLS, which the ESP32-S3 build routes to the
+ * SHA and AES peripherals. Bulk ciphers stream in fixed chunks - nothing
+ * allocates a copy of the full plaintext.
  */
 
 #include <stdint.h>
 #include <stddef.h>
 #include <string>
 #include <vector>
+#include <mbedtls/aes.h>
+#include <mbedtls/gcm.h>
 
 // AES-256 key size (32 bytes = 256 bits)
 #define AES256_KEY_SIZE 32
@@ -22,19 +28,33 @@
 #define AES_BLOCK_SIZE 16
 // PBKDF2 iteration count (FIPS 140-2 recommends minimum 1000)
 #define PBKDF2_ITERATIONS 10000
+// Unlock budget the iteration count is tuned against (cryptobench)
+#define PBKDF2_TARGET_MS 300
 // Salt size for key derivation
 #define SALT_SIZE 16
 // HMAC-SHA256 size
 #define HMAC_SIZE 32
+// AES-GCM nonce and tag sizes
+#define GCM_IV_SIZE 12
+#define GCM_TAG_SIZE 16
+// Bulk cipher chunk (multiple of AES_BLOCK_SIZE)
+#define CRYPTO_CHUNK_SIZE 4096
 
 namespace Crypto {
 
 /**
- * @brief Initialize the crypto module
+ * @brief Initialize the crypto module (runs selfTest())
  * @return true if initialization successful
  */
 bool init();
 
+/**
+ * @brief Check PBKDF2, CBC and GCM against known vectors / round trips
+ * @param verbose Print results
+ * @return true if all passed
+ */
+bool selfTest(bool verbose = true);
+
 /**
  * @brief Generate cryptographically secure random bytes
  * @param buffer Output buffer
@@ -57,16 +77,36 @@ bool generateKey256(uint8_t* key);
  */
 bool generateKeyDES(uint8_t* key);
 
+/**
+ * @brief PBKDF2-HMAC-SHA256 (RFC 8018)
+ * 
+ * The HMAC inner/outer pad states are hashed once, so each iteration costs
+ * two SHA-256 compressions instead of four.
+ * 
+ * @param password Password bytes
+ * @param passwordLen Length of password
+ * @param salt Salt value
+ * @param saltLen Length of salt
+ * @param iterations Iteration count (>= 1)
+ * @param out Output buffer
+ * @param outLen Bytes to derive
+ * @return true if successful
+ */
+bool pbkdf2Sha256(const uint8_t* password, size_t passwordLen,
+                  const uint8_t* salt, size_t saltLen,
+                  uint32_t iterations, uint8_t* out, size_t outLen);
+
 /**
  * @brief Derive an encryption key from a password using PBKDF2-SHA256
  * @param password User password/PIN
  * @param salt Salt value (should be random, stored with ciphertext)
  * @param saltLen Length of salt
  * @param derivedKey Output buffer (must be AES256_KEY_SIZE bytes)
+ * @param iterations Iteration count
  * @return true if successful
  */
 bool deriveKey(const char* password, const uint8_t* salt, size_t saltLen, 
-               uint8_t* derivedKey);
+               uint8_t* derivedKey, uint32_t iterations = PBKDF2_ITERATIONS);
 
 /**
  * @brief Encrypt data using AES-256-CBC with PKCS7 padding
@@ -96,6 +136,122 @@ bool decrypt(const uint8_t* ciphertext, size_t ciphertextLen,
              const uint8_t* key, const uint8_t* iv,
              uint8_t* plaintext, size_t* plaintextLen);
 
+// =============================================================================
+// Streaming ciphers
+// =============================================================================
+
+/**
+ * @brief AES-256-CBC with PKCS7 padding, fed in pieces of any size
+ * 
+ * Whole blocks go straight from input to output; at most one block is
+ * buffered (decryption holds back the last block to strip the padding).
+ * Output must not overlap input.
+ */
+class CbcStream {
+public:
+    CbcStream();
+    ~CbcStream();
+
+    /**
+     * @brief Start a message
+     * @param key 256-bit key
+     * @param iv 128-bit IV
+     * @param encrypt true to encrypt, false to decrypt
+     */
+    bool begin(const uint8_t* key, const uint8_t* iv, bool encrypt);
+
+    /**
+     * @brief Process input
+     * @param out Output, room for len + AES_BLOCK_SIZE bytes
+     * @return Bytes written, or -1 on error
+     */
+    int update(const uint8_t* in, size_t len, uint8_t* out);
+
+    /**
+     * @brief End the message
+     * @param out Encrypt: padded final block (AES_BLOCK_SIZE bytes).
+     *            Decrypt: last plaintext bytes (< AES_BLOCK_SIZE)
+     * @return Bytes written, or -1 (bad length or padding)
+     */
+    int finish(uint8_t* out);
+
+private:
+    mbedtls_aes_context _ctx;
+    uint8_t _iv[AES_BLOCK_SIZE];
+    uint8_t _buf[AES_BLOCK_SIZE];
+    size_t _bufLen;
+    bool _encrypt;
+    bool _active;
+};
+
+/**
+ * @brief AES-256-GCM, fed in pieces of any size
+ * 
+ * Decrypted output is released before the tag is checked - discard it if
+ * finish() fails.
+ */
+class GcmStream {
+public:
+    GcmStream();
+    ~GcmStream();
+
+    /**
+     * @brief Start a message
+     * @param key 256-bit key
+     * @param iv Nonce (GCM_IV_SIZE bytes recommended, never reused per key)
+     * @param ivLen Nonce length
+     * @param encrypt true to encrypt, false to decrypt
+     * @param aad Additional authenticated data (optional)
+     * @param aadLen Length of aad
+     */
+    bool begin(const uint8_t* key, const uint8_t* iv, size_t ivLen, bool encrypt,
+               const uint8_t* aad = nullptr, size_t aadLen = 0);
+
+    /**
+     * @brief Process input
+     * @param out Output, room for len + AES_BLOCK_SIZE bytes
+     * @return Bytes written, or -1 on error
+     */
+    int update(const uint8_t* in, size_t len, uint8_t* out);
+
+    /**
+     * @brief End the message
+     * @param out Remaining output (< AES_BLOCK_SIZE bytes)
+     * @param tag Encrypt: receives the tag. Decrypt: the received tag
+     * @return Bytes written, or -1 (decrypt: authentication failed)
+     */
+    int finish(uint8_t* out, uint8_t* tag);
+
+private:
+    mbedtls_gcm_context _ctx;
+    uint8_t _buf[AES_BLOCK_SIZE];
+    size_t _bufLen;
+    bool _encrypt;
+    bool _active;
+};
+
+// =============================================================================
+// Benchmark
+// =============================================================================
+
+struct BenchResult {
+    uint32_t iterations;            // PBKDF2 iterations measured
+    uint32_t pbkdf2Ms;              // One derivation
+    uint32_t suggestedIterations;   // Fits PBKDF2_TARGET_MS
+    float sha256MBps;
+    float cbcEncryptMBps;
+    float cbcDecryptMBps;
+    float gcmMBps;
+};
+
+/**
+ * @brief Time key derivation and bulk ciphers
+ * @param iterations PBKDF2 iteration count to time
+ * @param result Output
+ * @return false if the work buffer could not be allocated
+ */
+bool benchmark(uint32_t iterations, BenchResult& result);
+
 /**
  * @brief Calculate HMAC-SHA256 for data integrity
  * @param data Input data
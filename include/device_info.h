@@ -13,6 +13,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <functional>
 
 // =============================================================================
 // User Roles
@@ -50,6 +51,22 @@ struct DeviceInfo {
     std::string getInfoString() const;
 };
 
+// =============================================================================
+// Radio Profiles (persisted connect tuning per radio model)
+// =============================================================================
+#define MAX_RADIO_PROFILES 8
+
+struct RadioProfile {
+    char model[16];             // Radio model name
+    uint32_t postReadyDelayUs;  // Post-0xD0 delay that last worked
+    
+    // Line timing from the last link probe (txKilobaud 0 = standard)
+    uint8_t txKilobaud;
+    uint8_t rxKilobaud;
+    uint8_t stopBits;
+    uint8_t gapBits;
+};
+
 // =============================================================================
 // Device Settings (persisted)
 // =============================================================================
@@ -75,9 +92,10 @@ struct DeviceSettings {
     uint8_t maxPinAttempts; // Max failed PIN attempts before lockout
     uint16_t lockoutTime;   // Lockout duration in seconds
     
-    // User PINs (hashed)
-    char operatorPinHash[65]; // SHA-256 hash of operator PIN
-    char adminPinHash[65];    // SHA-256 hash of admin PIN
+    // User PINs: "p2:<iterations>:<salt hex>:<PBKDF2-SHA256 hex>" (see hashPIN),
+    // or a bare SHA-256 hex from older firmware, upgraded at the next login
+    char operatorPinHash[112];
+    char adminPinHash[112];
     
     // Container Settings
     bool autoSave;          // Auto-save containers
@@ -85,6 +103,11 @@ struct DeviceSettings {
     bool confirmDelete;     // Require confirmation for deletes
     bool backupOnSave;      // Backup to SD on save
     
+    // Radio Settings
+    char radioModel[16];    // Model used for the next session
+    RadioProfile radioProfiles[MAX_RADIO_PROFILES];
+    uint8_t radioProfileCount;
+    
     // Initialize with defaults
     void setDefaults();
     
@@ -162,12 +185,45 @@ public:
     void recordActivity();
     void recordKeyload();
     
+    // Radio profiles
+    uint32_t getPostReadyDelay(const char* model) const;
+    bool setPostReadyDelay(const char* model, uint32_t delayUs);
+    const RadioProfile* getRadioProfile(const char* model) const;
+    bool setLinkTiming(const char* model, uint8_t txKilobaud, uint8_t rxKilobaud,
+                       uint8_t stopBits, uint8_t gapBits);
+    bool setRadioModel(const char* model);
+    
+    // Tuning learned by the KFD worker mid-session (post-0xD0 delay, line
+    // timing). Only recorded here (any task); service() applies and saves it once the link is idle, so the
+    // settings write never lands inside an exchange.
+    void queuePostReadyDelay(const char* model, uint32_t delayUs);
+    void queueLinkTiming(const char* model, uint8_t txKilobaud, uint8_t rxKilobaud,
+                         uint8_t stopBits, uint8_t gapBits);
+    using LinkBusyCheck = std::function<bool()>;
+    void setLinkBusyCheck(LinkBusyCheck cb) { _linkBusy = cb; }
+    
     // Factory reset
     bool factoryReset();
     
     // Get serial number for display
     const char* getSerialNumber() const { return _info.serialNumber; }
     
+    /**
+     * @brief Container storage key (AES-256), valid while logged in
+     * 
+     * A random key wrapped per role under PBKDF2(PIN). It is unwrapped once
+     * at login and wiped at logout or session timeout.
+     * 
+     * @return Key, or nullptr while locked
+     */
+    const uint8_t* getStorageKey() const { return _storageKeyValid ? _storageKey : nullptr; }
+    
+    /**
+     * @brief Why the container store stayed locked at the last login
+     * @return Message for the user, or nullptr if the store unlocked
+     */
+    const char* getStorageError() const { return _storageError; }
+    
 private:
     DeviceManager();
     DeviceManager(const DeviceManager&) = delete;
@@ -180,8 +236,35 @@ private:
     bool _initialized;
     bool _settingsDirty;
     
+    // Container storage key (see getStorageKey)
+    uint8_t _storageKey[32];
+    bool _storageKeyValid;
+    const char* _storageError;    // Static string, see getStorageError
+    bool unlockStorage(UserRole role, const std::string& pin);
+    bool wrapStorageKey(UserRole role, const std::string& pin);
+    void wipeStorageKey();
+    
+    RadioProfile* findOrAddProfile(const char* model);
+    
+    // Queued radio profile updates (see queuePostReadyDelay)
+    struct PendingDelay {
+        char model[16];
+        uint32_t delayUs;
+        bool valid;
+    };
+    struct PendingLink {
+        char model[16];
+        uint8_t txKilobaud, rxKilobaud, stopBits, gapBits;
+        bool valid;
+    };
+    PendingDelay _pendingDelay;
+    PendingLink _pendingLink;
+    LinkBusyCheck _linkBusy;
+    void applyPendingProfiles();
+    
     // PIN hashing
     std::string hashPIN(const std::string& pin);
+    bool matchPIN(const std::string& pin, const char* stored, bool& legacy);
     
     // Persistence
     bool saveInfoToStorage();
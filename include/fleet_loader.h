@@ -0,0 +1,128 @@
+#pragma once
+
+/**
+ * @file fleet_loader.h
+ * @brief Gang-fill keyload - one compiled plan replayed to several radios at once
+ *
+ * Each port is a TWI_HAL/KFDProtocol pair with its own DATA/SENSE pins, edge
+ * ISR and RMT TX channel, driven by its own task. Port 0 is the front-panel
+ * port (the main g_twiHal/g_kfd pair); ports 1..3 are the fixture ports on
+ * the expansion header. All ports read the same KeyloadPlan, so the key
+ * frames are built and encrypted once per fill no matter how many radios
+ * are attached.
+ *
+ * Extra ports always transmit through RMT: the bit-bang backend masks
+ * interrupts for a whole byte, which would stretch the bits of every other
+ * port's edge capture.
+ *
+ * Fixture wiring (FLEET_PORTS > 1):
+ *   Port 1: DATA GPIO12, SENSE GPIO13, RMT channel 1
+ *   Port 2: DATA GPIO14, SENSE GPIO21, RMT channel 2
+ *   Port 3: DATA GPIO2,  SENSE GPIO1,  RMT channel 3
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "twi_hal.h"
+#include "kfd_protocol.h"
+
+// Number of ports fitted (1 = front panel only)
+#ifndef FLEET_PORTS
+#define FLEET_PORTS 1
+#endif
+
+class FleetLoader {
+public:
+    static const uint8_t MAX_PORTS = 4;
+
+    enum PortState : uint8_t {
+        PORT_IDLE = 0,
+        PORT_RUNNING,
+        PORT_DONE,      // Every key acknowledged
+        PORT_FAILED     // No session, aborted, or some keys failed
+    };
+
+    struct PortStatus {
+        PortState state;
+        uint16_t current;       // Keys handled so far
+        uint16_t total;
+        uint16_t keysOk;
+        uint16_t keysFailed;
+        uint32_t elapsedMs;     // Session time (running or final)
+        char status[64];        // Last progress or result message
+    };
+
+    static FleetLoader& instance();
+
+    /**
+     * @brief Bring up the fixture ports and start one task per port
+     * @param mainHal Front-panel HAL (port 0)
+     * @param mainKfd Front-panel protocol (port 0)
+     * @param txKilobaud TX speed for the fixture ports
+     * @param rxKilobaud RX speed for the fixture ports
+     * @return true if every configured port is ready
+     */
+    bool init(TWI_HAL* mainHal, KFDProtocol* mainKfd, uint8_t txKilobaud, uint8_t rxKilobaud);
+
+    /**
+     * @brief Load a plan to the selected ports concurrently
+     * The plan is copied once and shared read-only by all port tasks; the
+     * copy is wiped when the last port finishes.
+     * @param plan Compiled keyload
+     * @param portMask Ports to load (bit n = port n); ports with no radio
+     *                 attached still run and report "Failed to connect"
+     * @return false if a fill is already running, port 0's worker is busy,
+     *         or the plan is empty
+     */
+    bool start(const KFDProtocol::KeyloadPlan& plan, uint32_t portMask = 0xFFFFFFFF);
+
+    /**
+     * @brief Abort every running port at its next frame boundary
+     */
+    void abort();
+
+    bool isRunning() const { return _running; }
+    uint8_t portCount() const { return _portCount; }
+
+    /**
+     * @brief Snapshot of one port's progress
+     */
+    PortStatus status(uint8_t port) const;
+
+    /**
+     * @brief Change counter - bumps on every progress update of any port
+     * The UI polls this and redraws only when it moved.
+     */
+    uint32_t generation() const { return _generation; }
+
+    /**
+     * @brief True when the radio on a port asserts SENSE
+     */
+    bool isRadioConnected(uint8_t port);
+
+private:
+    FleetLoader();
+    FleetLoader(const FleetLoader&) = delete;
+    FleetLoader& operator=(const FleetLoader&) = delete;
+
+    struct Port {
+        TWI_HAL* hal;
+        KFDProtocol* kfd;
+        TaskHandle_t task;
+        uint32_t startMs;
+        PortStatus st;
+    };
+
+    static void portTask(void* arg);
+    void portLoop(uint8_t idx);
+    void setStatus(uint8_t idx, PortState state, int current, int total, const char* msg);
+
+    Port _ports[MAX_PORTS];
+    uint8_t _portCount;
+    KFDProtocol::KeyloadPlan _plan;     // Shared by all ports during a fill
+    volatile uint8_t _activePorts;      // Ports still loading
+    volatile bool _running;
+    volatile uint32_t _generation;
+    mutable portMUX_TYPE _mux;
+};
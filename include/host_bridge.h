@@ -0,0 +1,114 @@
+#pragma once
+
+/**
+ * @file host_bridge.h
+ * @brief Binary host bridge on USB CDC - drive this device as a KFDtool adapter
+ *
+ * Framing follows the KFDtool adapter serial protocol: each frame is
+ * SOM (0x61) ... EOM (0x63), with SOM/EOM/ESC (0x62) inside a frame sent as
+ * ESC followed by 0x91/0x93/0x92.
+ *
+ * Two command sets share the link:
+ * - KFDtool adapter commands (read info, self test, key signature, send
+ *   byte; received bytes are pushed as BCST_RECEIVE_BYTE) so the KFDtool
+ *   desktop can run its own TWI state machine byte by byte
+ * - Bridge extensions (0x4x): the host sends a whole KMM and this device
+ *   runs the timing-critical exchange locally through KFDProtocol - one USB
+ *   round trip per KMM instead of one per byte
+ *
+ * While the bridge is active the USB serial port carries only frames: the
+ * text console is off, Console (all log and trace output) is muted and
+ * KFD/TWI debug output is disabled.
+ *
+ * Extension commands (all big-endian):
+ *   0x40 KMM_EXCHANGE   [timeout ms:2][KMM from message ID, no CRC]
+ *        -> 0x50 [KMM reply]                 (session opened if none is held)
+ *   0x41 SESSION_OPEN   -> 0x51 [0xD0 MR / 0xD1 KVL]
+ *   0x42 SESSION_CLOSE  -> 0x52
+ *   0x43 READ_STATS     -> 0x53 [frames rx:4][frames tx:4][bad frames:4][overruns:4]
+ *   0x4F EXIT           -> 0x5F, back to the text console
+ *   Errors              -> 0x20 [error code][0x4x: message text]
+ */
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/ringbuf.h>
+#include "twi_hal.h"
+#include "kfd_protocol.h"
+
+// 1 = start in bridge mode (KFDtool desktop attached), 0 = text console
+#ifndef HOST_BRIDGE_ON_BOOT
+#define HOST_BRIDGE_ON_BOOT 0
+#endif
+
+class HostBridge {
+public:
+    // Largest decoded frame: opcode + timeout + a full TWI frame
+    static const size_t MAX_FRAME = 3 + P25::TWI_MAX_FRAME_LEN;
+
+    struct Stats {
+        uint32_t framesRx;
+        uint32_t framesTx;
+        uint32_t badFrames;     // Too long, or ESC followed by a bad placeholder
+        uint32_t overruns;      // Frame queue full - frame dropped
+    };
+
+    static HostBridge& instance();
+
+    /**
+     * @brief Switch the USB serial port to bridge mode
+     * Starts the RX and command tasks on first use.
+     * @param hal TWI port the host drives
+     * @param kfd Protocol layer on the same port
+     * @return true if the bridge is running
+     */
+    bool start(TWI_HAL* hal, KFDProtocol* kfd);
+
+    /**
+     * @brief Return the port to the text console (closes a held session)
+     */
+    void stop();
+
+    bool isActive() const { return _active; }
+    Stats getStats() const { return _stats; }
+
+private:
+    HostBridge();
+    HostBridge(const HostBridge&) = delete;
+    HostBridge& operator=(const HostBridge&) = delete;
+
+    static void rxTask(void* arg);
+    static void cmdTask(void* arg);
+    void rxLoop();
+    void cmdLoop();
+
+    // Commands
+    void handleFrame(const uint8_t* frame, size_t len);
+    void handleRead(const uint8_t* args, size_t len);
+    void handleKmmExchange(const uint8_t* args, size_t len);
+    void setByteMode(bool on);
+    void forwardRadioBytes();
+
+    // Responses
+    bool send(const uint8_t* payload, size_t len);   // false: too long for _txBuf, not sent
+    void sendByteRsp(uint8_t rsp);
+    void sendError(uint8_t code, const char* message = nullptr);
+    void closeSession();
+
+    TWI_HAL* _hal;
+    KFDProtocol* _kfd;
+    TaskHandle_t _rxTask;
+    TaskHandle_t _cmdTask;
+    RingbufHandle_t _frames;            // Decoded frames, RX task -> command task
+    volatile bool _active;
+    volatile bool _stopRequested;
+    bool _byteMode;                     // Host runs TWI itself - forward radio bytes (port held)
+    KFDProtocol::Session* _session;     // Held by SESSION_OPEN
+    bool _kfdDebug;                     // Debug flags restored at stop()
+    bool _halDebug;
+    Stats _stats;
+
+    uint8_t _rxFrame[MAX_FRAME];        // RX task deframing buffer
+    uint8_t _txBuf[2 + 2 * (MAX_FRAME + 16)];  // Worst case: every byte escaped
+};
@@ -10,14 +10,20 @@
  * - Key management operations (load, erase, view)
  * - RSI, MNP, and keyset operations
  * - MR (Mobile Radio) Emulator mode
+ * - Asynchronous operation queue serviced by a dedicated worker task
  */
 
 #include <stdint.h>
 #include <vector>
 #include <functional>
 #include <string>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 #include "p25_defs.h"
 #include "twi_hal.h"
+#include "kmm_frame.h"
 
 class KFDProtocol {
 public:
@@ -33,6 +39,7 @@ public:
         bool success;
         std::string message;
         P25::OperationStatus status;
+        std::vector<P25::KeyStatus> keyStatus;  // Per-key outcome (multi-key operations)
         
         Result() : success(false), status(P25::STATUS_INTERNAL_ERROR) {}
         Result(bool ok, const std::string& msg = "") 
@@ -40,21 +47,137 @@ public:
               status(ok ? P25::STATUS_COMMAND_PERFORMED : P25::STATUS_INTERNAL_ERROR) {}
     };
 
+    // Pre-built keyload: frames are built, CRC'd and wire-encoded once and
+    // replayed to any number of radios by keyloadPlan()
+    struct KeyloadPlan {
+        struct Frame {
+            std::vector<uint16_t> wire;    // Encoded TWI frame (TWI_HAL::encodeBytes)
+            std::vector<size_t> keyIndex;  // Keys carried by this frame (index into keys)
+        };
+        std::vector<P25::KeyStatus> keys;  // Key ID / algorithm per key, in load order
+        std::vector<Frame> frames;
+        
+        KeyloadPlan() = default;
+        KeyloadPlan(const KeyloadPlan&) = default;
+        KeyloadPlan& operator=(const KeyloadPlan&) = default;
+        ~KeyloadPlan() { clear(); }
+        
+        bool empty() const { return frames.empty(); }
+        size_t keyCount() const { return keys.size(); }
+        
+        /** @brief Wipe key material and drop all frames */
+        void clear();
+    };
+
+    // Outcome of the last syncKeys()
+    struct SyncStats {
+        uint16_t radioKeys;   // Keys listed by the radio's inventory
+        uint16_t selected;    // Keys asked for
+        uint16_t unchanged;   // Already held - not sent
+        uint16_t toLoad;      // Modify Key items sent
+        uint16_t toErase;     // Erase items sent
+        
+        SyncStats() : radioKeys(0), selected(0), unchanged(0), toLoad(0), toErase(0) {}
+    };
+
+    // Session establishment tuning - each attempt listens for the radio's
+    // start bit for a window that doubles per attempt, with a short
+    // doubling back-off between attempts. An unanswered attempt is first
+    // retried with READY_REQ alone; the 105 ms key signature is only sent
+    // again after readyRetries of those went unanswered too.
+    struct ConnectConfig {
+        uint8_t maxAttempts;
+        uint8_t readyRetries;     // READY_REQ-only retries per key signature
+        uint32_t firstWindowMs;   // Listen window on the first attempt (at least;
+                                  // widened to the model's observed response time)
+        uint32_t maxWindowMs;
+        uint32_t firstBackoffMs;  // Pause before the second attempt
+        uint32_t maxBackoffMs;
+        
+        ConnectConfig() : maxAttempts(6), readyRetries(1), firstWindowMs(50), maxWindowMs(2000),
+                          firstBackoffMs(10), maxBackoffMs(200) {}
+    };
+
+    // Session establishment statistics
+    struct ConnectStats {
+        uint32_t sessions;        // Sessions established
+        uint32_t failures;        // beginSession() gave up
+        uint32_t attempts;        // Key signature or READY_REQ-only sends
+        uint32_t lastConnectUs;   // beginSession() call to 0xD0/0xD1
+        uint32_t minConnectUs;
+        uint32_t maxConnectUs;
+        uint64_t totalConnectUs;
+        uint32_t lastResponseUs;  // End of READY_REQ to the radio's start bit
+        uint8_t lastAttempts;     // Attempts used by the last session
+        uint32_t reused;          // Operations that joined an open session
+        
+        ConnectStats() { reset(); }
+        void reset() {
+            sessions = failures = attempts = reused = 0;
+            lastConnectUs = maxConnectUs = lastResponseUs = 0;
+            minConnectUs = UINT32_MAX;
+            totalConnectUs = 0;
+            lastAttempts = 0;
+        }
+        uint32_t avgConnectUs() const { return sessions ? (uint32_t)(totalConnectUs / sessions) : 0; }
+    };
+
+    // Called when the post-0xD0 delay for the active radio model changes.
+    // Runs on the operation's task inside an open session - record, don't save
+    using TuningCallback = std::function<void(const char* model, uint32_t postReadyDelayUs)>;
+
+    // Called when the line timing for the active radio model changes
+    // (probeLink() result, or a fall back to the standard timing). Also runs
+    // on the operation's task mid-session - record, don't save
+    using LinkCallback = std::function<void(const char* model, const TWI_HAL::LineTiming& timing)>;
+
+    // Inventory callback - called once per response frame with the items it
+    // carried (already appended to the output vector)
+    using KeyInfoCallback = std::function<void(const P25::KeyStatus* items, size_t count)>;
+
     // Progress callback for multi-key operations
     using ProgressCallback = std::function<void(int current, int total, const char* status)>;
 
     // MR Emulator callback - called when keys are received
     using MrKeyCallback = std::function<void(const P25::KeyItem& key)>;
 
+    // Operations that can be queued to the worker task
+    enum AsyncOp : uint8_t {
+        ASYNC_NONE = 0,
+        ASYNC_KEYLOAD,          // Single key (submitKeyload)
+        ASYNC_KEYLOAD_PLAN,     // Compiled plan (submitKeyloadPlan)
+        ASYNC_TEST_INVENTORY,
+        ASYNC_TEST_DES_KEY,
+        ASYNC_ERASE_ALL,
+        ASYNC_VIEW_KEYS,        // Key inventory - items via getAsyncKeys()
+        ASYNC_SYNC,             // Differential keyload (submitSync)
+    };
+
+    // Event posted by the worker task (plain data - safe to pass through a queue)
+    struct AsyncEvent {
+        enum Kind : uint8_t {
+            PROGRESS,   // current/total/status updated
+            DONE,       // Operation finished - success/status hold the result message
+        };
+        Kind kind;
+        AsyncOp op;
+        bool success;
+        int current;
+        int total;
+        char status[64];
+    };
+
     KFDProtocol();
     ~KFDProtocol();
 
     /**
      * @brief Initialize the protocol layer
      * @param hal TWI hardware abstraction layer
+     * @param async Start the worker task; instances driven from their own
+     *              task (FleetLoader ports) only use the blocking calls
      * @return true if successful
      */
-    bool init(TWI_HAL* hal);
+    bool init(TWI_HAL* hal, bool async = true);
 
     /**
      * @brief Check if connected to radio (SENSE line)
@@ -99,11 +222,120 @@ public:
     uint32_t getPostReadyDelay() const { return _postReadyDelayUs; }
 
     /**
-     * @brief Load multiple keys (2.3.1)
+     * @brief Select the radio model for the following sessions
+     * If the first KMM of a session goes unanswered the post-0xD0 delay is
+     * stepped up and reported through the tuning callback, so the value that
+     * works is remembered per model.
+     * @param model Model name (as stored in settings)
+     * @param postReadyDelayUs Delay that worked last time for this model
+     */
+    void setRadioModel(const char* model, uint32_t postReadyDelayUs);
+    const char* getRadioModel() const { return _radioModel.c_str(); }
+    void setTuningCallback(TuningCallback cb) { _tuningCallback = cb; }
+
+    /**
+     * @brief Use a cached line timing for the selected radio model
+     * Sessions run at this timing until a CRC, parity or framing error, or a
+     * radio that stops answering the key signature, drops back to the
+     * standard timing (reported through the link callback).
+     */
+    void setLinkTiming(const TWI_HAL::LineTiming& timing);
+    TWI_HAL::LineTiming getLinkTiming() const { return _linkTiming; }
+    const TWI_HAL::LineTiming& getStandardLinkTiming() const { return _linkBase; }
+    void setLinkCallback(LinkCallback cb) { _linkCallback = cb; }
+
+    /**
+     * @brief Find the fastest line timing the connected radio handles
+     * Within one session at the standard timing, steps the bit rate up
+     * (first with the radio answering at our rate, then with only our TX
+     * faster), then trims stop bits and the inter-byte gap. Every step must
+     * pass a run of inventory commands with no CRC, parity or framing
+     * error; a failing step is undone and probing of that parameter stops.
+     * The result becomes the link timing and is reported through the link
+     * callback.
+     */
+    Result probeLink(ProgressCallback progress = nullptr);
+
+    void setConnectConfig(const ConnectConfig& cfg) { _connectConfig = cfg; }
+    const ConnectConfig& getConnectConfig() const { return _connectConfig; }
+    const ConnectStats& getConnectStats() const { return _connectStats; }
+    void resetConnectStats() { _connectStats.reset(); }
+
+    /**
+     * @brief Load multiple keys in one session (2.3.1)
+     * Keys sharing keyset, algorithm and key length are packed into as few
+     * Modify Key KMMs as fit in a TWI frame. A NAK or failed item only fails
+     * the affected keys - see Result::keyStatus (same order as keys).
      */
     Result keyloadMultiple(const std::vector<P25::KeyItem>& keys,
                            ProgressCallback progress = nullptr);
 
+    /**
+     * @brief Build a reusable keyload plan
+     * Uses the same batching as keyloadMultiple(). The plan holds key
+     * material - clear() it when the selection changes.
+     * @param keys Keys to load
+     * @param plan Output plan (previous contents are wiped)
+     * @return true if the plan has at least one frame
+     */
+    bool compilePlan(const std::vector<P25::KeyItem>& keys, KeyloadPlan& plan);
+
+    /**
+     * @brief Replay a compiled plan to the connected radio
+     * Only the session handshake and acks happen per radio; no frame is
+     * rebuilt. Result::keyStatus follows plan.keys.
+     */
+    Result keyloadPlan(const KeyloadPlan& plan, ProgressCallback progress = nullptr);
+
+    /**
+     * @brief Send a KMM built by the host and return the radio's reply
+     * Adds the TWI header and CRC, so the host only deals in KMMs. Joins a
+     * held Session, otherwise runs its own.
+     * @param kmm KMM from the message ID onward (no TWI header, no CRC)
+     * @param len KMM length
+     * @param response Reply KMM in the same layout
+     * @param timeoutMs Time allowed for the radio to start answering
+     */
+    Result exchangeKmm(const uint8_t* kmm, size_t len, std::vector<uint8_t>& response,
+                       uint32_t timeoutMs = 5000);
+
+    /**
+     * @brief Load only the keys the radio does not already hold
+     * Reads the key inventory, drops every key the radio reports at the same
+     * keyset/SLN with the same key ID and algorithm, and loads the rest as
+     * batched Modify Key KMMs - all in one session. The inventory carries no
+     * key material, so a changed key value under an unchanged key ID is not
+     * detected; use keyloadMultiple() to force a full load.
+     * @param keys Keys the radio should hold
+     * @param eraseExtras Also erase radio keys in the same keysets that are
+     *                    not in keys
+     * @param progress Optional progress callback
+     * @return Result::keyStatus covers the keys actually sent (loads, then erases)
+     */
+    Result syncKeys(const std::vector<P25::KeyItem>& keys, bool eraseExtras = false,
+                    ProgressCallback progress = nullptr);
+
+    /**
+     * @brief Work out which keys have to be sent to a radio
+     * @param wanted Keys the radio should hold
+     * @param radio Radio inventory (viewKeyInfo)
+     * @param eraseExtras Add erase items for radio keys in the wanted keysets
+     *                    that are not wanted
+     * @param out Output: keys to load, followed by erase items
+     * @return Number of wanted keys the radio already holds
+     */
+    static size_t diffKeys(const std::vector<P25::KeyItem>& wanted,
+                           const std::vector<P25::KeyStatus>& radio,
+                           bool eraseExtras, std::vector<P25::KeyItem>& out);
+
+    const SyncStats& getSyncStats() const { return _syncStats; }
+
+    /**
+     * @brief Pack several keys per Modify Key KMM (default) or send one each
+     */
+    void setBatchKeyload(bool batch) { _batchKeyload = batch; }
+    bool getBatchKeyload() const { return _batchKeyload; }
+
     /**
      * @brief Erase a specific key (2.3.2)
      */
@@ -116,8 +348,13 @@ public:
 
     /**
      * @brief View key info (2.3.4)
+     * Requests the active key list in pages of INV_MAX_KEYS_PER_FRAME,
+     * following the inventory marker until the radio returns 0. Items are
+     * parsed straight out of each received frame.
+     * @param keys Output: keyset, SLN, algorithm and key ID per key
+     * @param onItems Optional: called per page as items arrive
      */
-    Result viewKeyInfo(std::vector<P25::KeyStatus>& keys);
+    Result viewKeyInfo(std::vector<P25::KeyStatus>& keys, KeyInfoCallback onItems = nullptr);
 
     /**
      * @brief View individual RSI (2.3.5)
@@ -151,6 +388,7 @@ public:
 
     /**
      * @brief View keyset info (2.3.11)
+     * Lists active then inactive keyset IDs (names are not reported)
      */
     Result viewKeysetInfo(std::vector<P25::KeysetInfo>& keysets);
 
@@ -165,12 +403,19 @@ public:
 
     /**
      * @brief Start MR emulator mode
-     * Listens for key loads from another KFD
+     * Acts as a radio for another KFD (KVL, KFDtool): answers the key
+     * signature / READY_REQ with 0xD0, acks Modify Key, Zeroize and key /
+     * keyset inventory KMMs from an in-memory key table, and re-arms after
+     * each disconnect so back-to-back sessions need no restart. SENSE is
+     * released for the duration. KFD operations are refused while running.
+     * @param callback Called per received key (and erase) from a separate
+     *                 low-priority task, never from the receive path.
+     *                 Key material is wiped after the callback returns.
      */
     Result startMrEmulator(MrKeyCallback callback);
 
     /**
-     * @brief Stop MR emulator mode
+     * @brief Stop MR emulator mode (waits for the emulator tasks to exit)
      */
     void stopMrEmulator();
 
@@ -179,19 +424,92 @@ public:
      */
     bool isMrEmulatorRunning() const { return _mrEmulatorRunning; }
 
+    // MR emulator counters since startMrEmulator()
+    struct MrEmulatorStats {
+        uint32_t sessions;      // READY_REQs answered
+        uint32_t kmms;          // KMMs received with a good CRC
+        uint32_t keysLoaded;    // Modify Key items accepted (loads)
+        uint32_t keysErased;    // Modify Key erase items and zeroize
+        uint32_t crcErrors;
+        uint32_t naks;          // KMMs answered with a Negative Ack
+        uint32_t dropped;       // Keys not delivered (callback queue full)
+        uint16_t storedKeys;    // Keys currently held by the emulator
+    };
+    const MrEmulatorStats& getMrEmulatorStats() const { return _mrStats; }
+
     // =========================================================================
     // Session Management
     // =========================================================================
 
     /**
-     * @brief Abort current operation
+     * RAII handle that keeps one radio session open across operations.
+     * While a handle is alive, keyload(), eraseAllKeys(), testInventory()
+     * etc. join its session instead of sending their own key signature and
+     * TRANSFER_DONE/DISCONNECT. The session ends when the last handle goes
+     * away. A handle holds the radio session, not one handshake: after SENSE
+     * loss, idle timeout, an unanswered KMM or abort() the next operation
+     * (or reopen()) reconnects, and the handle keeps holding the new session.
+     * Use it on the task that runs the operations (the worker for async ops).
+     */
+    class Session {
+    public:
+        explicit Session(KFDProtocol& kfd);
+        ~Session() { close(); }
+        Session(Session&& other);
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+
+        /**
+         * @brief Check a session is up and usable
+         */
+        bool ok() const;
+        explicit operator bool() const { return ok(); }
+        DeviceType deviceType() const;
+
+        /**
+         * @brief Reconnect now if the session dropped since the last use
+         * @return true if a session is up
+         */
+        bool reopen();
+
+        /**
+         * @brief Release the handle early (ends the session if last)
+         */
+        void close();
+
+    private:
+        KFDProtocol* _kfd;
+    };
+
+    /**
+     * @brief Idle time after which a held session is considered dropped
+     * by the radio and re-established on next use (0 = never)
+     */
+    void setSessionIdleTimeout(uint32_t ms) { _sessionIdleTimeoutMs = ms; }
+    uint32_t getSessionIdleTimeout() const { return _sessionIdleTimeoutMs; }
+    bool isSessionOpen() const { return _sessionOpen; }
+
+    /**
+     * @brief Abort current operation (also tears down a held session)
      */
     void abort();
 
     /**
-     * @brief Check if operation is in progress
+     * @brief Check if operation is in progress (or queued for the worker)
+     */
+    bool isOperationInProgress() const { return _opOwner.load() != nullptr; }
+
+    /**
+     * @brief Take the port for one operation - one task at a time
+     * Every entry point that drives the line claims it: the sync API from
+     * any task, submit*() on behalf of the worker, the MR emulator, and
+     * callers using the TWI HAL directly. Claims nest on the owning task
+     * (syncKeys() runs an inventory and a load); only the outermost one
+     * clears a previous abort.
+     * @return false if another task holds the port
      */
-    bool isOperationInProgress() const { return _operationInProgress; }
+    bool beginOperation();
+    void endOperation();
 
     /**
      * @brief Get last error message
@@ -202,33 +520,214 @@ public:
      * @brief Set debug mode
      */
     void setDebug(bool enable) { _debug = enable; }
+    bool isDebugEnabled() const { return _debug; }
+
+    // =========================================================================
+    // Asynchronous Operations
+    // =========================================================================
+    // Operations run on a worker task so the caller (the LVGL loop) never
+    // blocks. Progress and completion arrive as AsyncEvents; abort() stops
+    // the running operation at the next frame or retry boundary.
+
+    /**
+     * @brief Start the worker task (called by init())
+     * @param core Core to pin the worker to - keep it off the LVGL core
+     * @return true if the worker is running
+     */
+    bool startWorker(BaseType_t core = 0);
+
+    /**
+     * @brief Queue a single-key load (key material is copied and wiped after)
+     * @return false if an operation is already queued or running
+     */
+    bool submitKeyload(const P25::KeyItem& key);
+
+    /**
+     * @brief Queue a compiled keyload (the plan is copied - the caller may
+     *        invalidate its own copy while the load runs)
+     * @return false if an operation is already queued or running
+     */
+    bool submitKeyloadPlan(const KeyloadPlan& plan);
+
+    /**
+     * @brief Queue a differential keyload (keys are copied and wiped after)
+     * @return false if an operation is already queued or running
+     */
+    bool submitSync(const std::vector<P25::KeyItem>& keys, bool eraseExtras = false);
+
+    /**
+     * @brief Queue an operation that takes no arguments
+     * @param op ASYNC_TEST_INVENTORY, ASYNC_TEST_DES_KEY, ASYNC_ERASE_ALL
+     *           or ASYNC_VIEW_KEYS
+     * @return false if busy or op needs arguments
+     */
+    bool submit(AsyncOp op);
+
+    /**
+     * @brief Fetch the next worker event without blocking
+     * @return true if ev was filled
+     */
+    bool pollEvent(AsyncEvent& ev);
+
+    /**
+     * @brief Check if an asynchronous operation is queued or running
+     */
+    bool isBusy() const { return _asyncBusy; }
+
+    /**
+     * @brief Full result of the last asynchronous operation (after DONE)
+     */
+    const Result& getAsyncResult() const { return _asyncResult; }
+
+    /**
+     * @brief Copy key inventory items received so far by ASYNC_VIEW_KEYS
+     * Safe to call while the inventory is still arriving.
+     * @param out Items from index `from` onward are appended
+     * @param from Number of items the caller already has
+     * @return Total number of items received so far
+     */
+    size_t getAsyncKeys(std::vector<P25::KeyStatus>& out, size_t from = 0);
 
 private:
     TWI_HAL* _hal;
     bool _initialized;
     bool _debug;
-    bool _operationInProgress;
+    std::atomic<TaskHandle_t> _opOwner;  // Holder of the port (beginOperation())
+    uint8_t _opDepth;                    // Nested claims by the holder
     bool _mrEmulatorRunning;
-    bool _abortRequested;
+    volatile bool _abortRequested;  // Set from the UI core, polled by the worker
     bool _useFastSend;  // true = sendBytesFast(), false = sendByte() loop
+    bool _batchKeyload; // true = many keys per Modify Key KMM
     uint32_t _postReadyDelayUs;  // Delay after 0xD0/0xD1 before sending KMM
+    std::string _radioModel;
+    uint32_t _modelDelayUs;      // Delay last reported for _radioModel
+    uint32_t _modelResponseUs;   // Slow end of _radioModel's READY_REQ answers (0 = none yet)
+    TuningCallback _tuningCallback;
+    TWI_HAL::LineTiming _linkBase;    // Standard timing (the HAL's at init)
+    TWI_HAL::LineTiming _linkTiming;  // Timing sessions run at
+    LinkCallback _linkCallback;
+    bool _linkProbing;                // Errors are expected - no fall back
+    uint32_t _crcErrors;              // KMM CRC mismatches (all sessions)
+    uint32_t _linkErrMark;            // Line errors at session start
+    TWI_HAL::RxStats _rxMark;         // RX counters at session start (metrics)
+    uint64_t _txEndUs;                // End of our last frame
+    bool _replyPending;               // Next received frame answers it
+    ConnectConfig _connectConfig;
+    ConnectStats _connectStats;
+    SyncStats _syncStats;
+    bool _firstKmmPending;       // Session up, no KMM answered yet
+    
+    // Open session shared by nested beginSession()/endSession() pairs
+    bool _sessionOpen;
+    bool _sessionBroken;         // Exchange failed - radio may have left the session
+    uint8_t _sessionDepth;       // Operations inside the session
+    volatile uint8_t _sessionHandles;  // Live Session handles - keep it open between operations
+    uint64_t _sessionLastUs;     // Last exchange
+    uint32_t _sessionIdleTimeoutMs;
+    DeviceType _sessionType;
     std::string _lastError;
     MrKeyCallback _mrCallback;
+    
+    // MR emulator - the engine task answers the KFD, received keys are
+    // handed to the delivery task through _mrKeyQueue (plain data)
+    struct MrKeyMsg {
+        uint16_t keysetId;
+        uint16_t sln;
+        uint16_t keyId;
+        uint8_t algorithmId;
+        uint8_t keyLen;
+        bool erase;
+        uint8_t key[32];
+    };
+    struct MrStoredKey {
+        uint8_t keysetId;
+        uint16_t sln;
+        uint16_t keyId;
+        uint8_t algorithmId;
+    };
+    TaskHandle_t _mrTask;
+    TaskHandle_t _mrDeliverTask;
+    QueueHandle_t _mrKeyQueue;    // MrKeyMsg
+    MrEmulatorStats _mrStats;
+    std::vector<MrStoredKey> _mrKeys;
+    bool _mrHalDebug;             // HAL debug state to restore on stop
+    volatile bool _mrSelfStop;    // stopMrEmulator() called from the key callback
+    
+    // Per-session frame buffers - frames are serialized and received in
+    // place, so nothing is allocated between 0xD0 and the first KMM byte
+    uint8_t _txFrame[P25::TWI_MAX_FRAME_BYTES];
+    uint8_t _rxFrame[P25::TWI_MAX_FRAME_LEN];
+
+    // Worker task - one operation at a time, arguments held here while queued
+    TaskHandle_t _workerTask;
+    QueueHandle_t _opQueue;       // AsyncOp
+    QueueHandle_t _eventQueue;    // AsyncEvent
+    volatile bool _asyncBusy;
+    P25::KeyItem _asyncKey;
+    KeyloadPlan _asyncPlan;
+    std::vector<P25::KeyItem> _asyncSyncKeys;
+    bool _asyncSyncErase;
+    Result _asyncResult;
+    std::vector<P25::KeyStatus> _asyncKeys;  // Guarded by _asyncKeysMux
+    portMUX_TYPE _asyncKeysMux;
+
+    static void workerTask(void* arg);
+    void workerLoop();
+    Result runAsync(AsyncOp op);
+    void recordOpMetrics(AsyncOp op, uint32_t us, bool success);
+    bool claimPort(TaskHandle_t owner);
+    bool claimForWorker();
+    bool queueOp(AsyncOp op);       // Port claimed for the worker first
+    void postEvent(AsyncEvent::Kind kind, AsyncOp op, bool success,
+                   int current, int total, const char* status);
 
     // Session management
+    // beginSession()/endSession() nest: the outermost pair does the
+    // handshake and disconnect, inner pairs join the open session
     bool beginSession(DeviceType* deviceType = nullptr);
     void endSession();
+    bool holdSession();
+    bool handshake(DeviceType* deviceType);
+    void disconnect();
+    void teardownSession(bool graceful);
+    const char* sessionStale();
+    void noteFirstKmm(bool answered);
+    
+    // Line timing
+    enum LinkTrial : uint8_t { LINK_OK, LINK_REJECTED, LINK_LOST };
+    uint32_t lineErrors() const;
+    void fallBackLink(const char* reason);
+    bool linkCanary(uint8_t count);
+    LinkTrial tryLinkTiming(const TWI_HAL::LineTiming& trial, const TWI_HAL::LineTiming& good);
     bool sendKmm(const std::vector<uint8_t>& kmm);
+    bool sendFrame(const uint8_t* frame, size_t len);
     bool receiveKmm(std::vector<uint8_t>& kmm, uint32_t timeoutMs = 5000);
+    
+    /**
+     * @brief Receive a KMM into the session rx buffer
+     * @param kmm Output: points into the rx buffer (valid until the next receive)
+     * @param len Output: KMM length, message ID onward, CRC stripped
+     */
+    bool receiveKmm(const uint8_t*& kmm, size_t& len, uint32_t timeoutMs = 5000);
 
     // KMM Frame construction
     std::vector<uint8_t> buildKmmFrame(const std::vector<uint8_t>& kmmBody);
     std::vector<uint8_t> buildKmmFrame(const std::vector<uint8_t>& kmmBody, uint8_t messageId, uint8_t responseKind);
     bool parseKmmFrame(const std::vector<uint8_t>& frame, std::vector<uint8_t>& kmmBody);
 
+    // Inventory exchange - sends InventoryCommand(type, args) and receives the reply
+    bool inventoryExchange(P25::InventoryType type, const uint8_t* args, size_t argLen,
+                           const uint8_t*& kmm, size_t& len, uint32_t timeoutMs = 10000);
+    Result inventoryOperation(const std::function<Result()>& exchange);
+    Result runSync(const std::vector<P25::KeyItem>& keys, bool eraseExtras, ProgressCallback progress);
+
     // KMM Message builders
     std::vector<uint8_t> buildModifyKeyCommand(const P25::KeyItem& key);
     std::vector<uint8_t> buildModifyKeyCommand(const std::vector<P25::KeyItem>& keys);
+    std::vector<std::vector<size_t>> planKeyloadBatches(const std::vector<P25::KeyItem>& keys,
+                                                        size_t maxPerKmm);
+    void writeModifyKeyHeader(P25::KmmWriter& w, const P25::KeyItem& first, size_t count);
+    void writeModifyKeyItem(P25::KmmWriter& w, const P25::KeyItem& key);
     std::vector<uint8_t> buildZeroizeCommand();
     std::vector<uint8_t> buildInventoryCommand(P25::InventoryType type);
     std::vector<uint8_t> buildLoadConfigCommand(P25::InventoryType type, 
@@ -237,15 +736,37 @@ private:
     std::vector<uint8_t> buildChangeoverCommand(uint8_t keysetId);
 
     // KMM Response parsers
-    bool parseRekeyAck(const std::vector<uint8_t>& kmm, 
+    bool parseRekeyAck(const uint8_t* kmm, size_t len,
                        std::vector<P25::KeyStatus>& status);
-    bool parseInventoryResponse(const std::vector<uint8_t>& kmm,
-                                P25::InventoryType expectedType,
-                                std::vector<uint8_t>& data);
-    bool parseNegativeAck(const std::vector<uint8_t>& kmm, 
+    bool parseInventoryResponse(P25::KmmReader& r, P25::InventoryType expectedType);
+    bool parseNegativeAck(const uint8_t* kmm, size_t len,
                           P25::OperationStatus& status);
     bool parseZeroizeResponse(const std::vector<uint8_t>& kmm);
 
+    // MR emulator engine
+    static void mrTask(void* arg);
+    static void mrDeliverTask(void* arg);
+    void mrLoop();
+    void mrDeliverLoop();
+    void mrFinish();
+    bool mrReceiveKmm(uint32_t timeoutMs);
+    void mrHandleKmm(const uint8_t* kmm, size_t len);
+    void mrModifyKey(P25::KmmReader& r, P25::KmmWriter& w);
+    void mrInventory(P25::KmmReader& r, P25::KmmWriter& w);
+    void mrNak(P25::KmmWriter& w, uint8_t messageId, P25::OperationStatus status);
+    void mrSend(const uint8_t* data, size_t len);
+    void mrSendByte(uint8_t b);
+    
+    /**
+     * @brief Read a TWI frame body (control onward) into the rx buffer and check its CRC
+     * @param len TWI length field (body + CRC)
+     */
+    bool readFrameBody(size_t len, uint32_t timeoutMs);
+    
+    // A frame just left - times it and arms the turnaround measurement
+    void noteFrameSent(uint64_t startUs);
+    void noteTxFailed();
+
     // Error handling
     void setError(const char* fmt, ...);
 };
@@ -0,0 +1,97 @@
+#pragma once
+
+/**
+ * @file kmm_frame.h
+ * @brief In-place KMM frame writer and reader
+ *
+ * Serializes a complete TWI KMM frame (opcode, length, control, dest RSI,
+ * KMM header, body, CRC) directly into a caller-owned buffer, and walks a
+ * received KMM without copying. Neither class allocates.
+ *
+ * Frame layout written by KmmWriter:
+ *   [0]      0xC2 opcode
+ *   [1..2]   TWI length (body + CRC)
+ *   [3]      control
+ *   [4..6]   dest RSI
+ *   [7..16]  KMM header (message ID, length, format, dest/src RSI)
+ *   [17..]   KMM body
+ *   [n-2..]  CRC low, CRC high
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "p25_defs.h"
+
+namespace P25 {
+
+// Largest buffer a frame can need: opcode + length + TWI length field
+constexpr size_t TWI_MAX_FRAME_BYTES = 3 + TWI_MAX_FRAME_LEN;
+
+class KmmWriter {
+public:
+    KmmWriter(uint8_t* buf, size_t capacity);
+
+    /**
+     * @brief Start a new frame (discards anything written before)
+     * @param messageId KMM message ID
+     * @param responseKind Message format byte (0xC0 = immediate)
+     */
+    void begin(uint8_t messageId, uint8_t responseKind = 0xC0);
+
+    // Body serialization (big-endian multi-byte fields)
+    void put(uint8_t b);
+    void put16(uint16_t v);
+    void put24(uint32_t v);
+    void put(const uint8_t* data, size_t len);
+    void fill(uint8_t b, size_t len);
+
+    /**
+     * @brief Patch lengths and append the CRC
+     * @return Total frame length, or 0 if the buffer overflowed
+     */
+    size_t end();
+
+    const uint8_t* data() const { return _buf; }
+    size_t size() const { return _pos; }
+    size_t bodySize() const { return _pos - BODY_OFFSET; }
+    bool overflow() const { return _overflow; }
+
+    static constexpr size_t BODY_OFFSET = 17;
+
+private:
+    uint8_t* _buf;
+    size_t _cap;
+    size_t _pos;
+    bool _overflow;
+};
+
+class KmmReader {
+public:
+    /**
+     * @param kmm KMM starting at the message ID (as returned by receiveKmm)
+     * @param len Length in bytes
+     */
+    KmmReader(const uint8_t* kmm, size_t len);
+
+    bool valid() const { return _len >= KMM_HEADER_LEN; }
+    uint8_t messageId() const { return _len > 0 ? _kmm[0] : 0xFF; }
+    uint8_t messageFormat() const { return _len > 3 ? _kmm[3] : 0; }
+
+    // Body cursor - reads past the end return 0 and clear ok()
+    uint8_t get();
+    uint16_t get16();
+    uint32_t get24();
+    const uint8_t* take(size_t n);
+    void skip(size_t n) { take(n); }
+
+    size_t remaining() const { return _pos < _len ? _len - _pos : 0; }
+    bool ok() const { return _ok; }
+
+private:
+    const uint8_t* _kmm;
+    size_t _len;
+    size_t _pos;
+    bool _ok;
+};
+
+} // namespace P25
@@ -0,0 +1,177 @@
+#pragma once
+
+/**
+ * @file line_capture.h
+ * @brief Logic-analyzer capture of the TWI DATA and SENSE lines
+ *
+ * Both lines are sampled by RMT receive channels (1 µs resolution, glitch
+ * filter) - the peripheral timestamps every transition, so nothing is lost
+ * while the CPU prints or services Serial. A collector task moves finished
+ * RMT blocks into an edge buffer in PSRAM for the configured window.
+ *
+ * Once stopped, the capture is decoded offline into bit periods, TWI bytes,
+ * breaks (key signatures) and KMM frames with CRC check, and can be
+ * exported as VCD (GTKWave, PulseView) or CSV to the SD card.
+ *
+ * Timing inside an RMT block (a burst of edges without a 30 ms gap) is
+ * exact; blocks are placed on the common time line from their arrival
+ * time, so gaps between bursts and DATA/SENSE alignment are accurate to
+ * the collector task's latency.
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <driver/rmt.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+class LineCapture {
+public:
+    enum Line : uint8_t {
+        LINE_DATA = 0,
+        LINE_SENSE = 1,
+    };
+
+    struct Config {
+        int dataPin = 11;
+        int sensePin = 10;
+        uint32_t windowMs = 5000;       // Capture length (0 = until stop())
+        uint32_t maxEdges = 131072;     // Edge buffer (4 bytes each, PSRAM)
+        uint32_t bitUs = 250;           // Decoder bit period (0 = estimate from capture)
+        rmt_channel_t dataChannel = RMT_CHANNEL_4;   // ESP32-S3 RX channels: 4-7
+        rmt_channel_t senseChannel = RMT_CHANNEL_6;  // DATA uses two memory blocks (4, 5)
+    };
+
+    struct Edge {
+        uint32_t timeUs;    // From capture start
+        uint8_t line;       // Line
+        bool level;         // Level after the edge (true = HIGH/IDLE)
+    };
+
+    struct DecodedByte {
+        uint32_t timeUs;    // Start bit
+        uint8_t value;
+        bool parityError;
+    };
+
+    struct Frame {
+        uint32_t timeUs;    // Opcode byte
+        uint8_t opcode;     // TWI opcode (0xC2 = KMM)
+        size_t firstByte;   // Index into the decoded bytes
+        size_t byteCount;   // Including opcode
+        uint16_t length;    // TWI length field (KMM frames)
+        uint8_t messageId;  // KMM message ID (KMM frames)
+        bool crcOk;
+    };
+
+    struct Summary {
+        uint32_t durationUs;
+        uint32_t edges;
+        uint32_t dataEdges;
+        uint32_t senseEdges;
+        uint32_t bitUs;             // Bit period used to decode
+        uint32_t measuredBitUs;     // Estimated from the shortest pulses (0 = none)
+        uint32_t bytes;
+        uint32_t parityErrors;
+        uint32_t framingErrors;     // Start bit glitches
+        uint32_t breaks;            // BUSY longer than 20 bit times
+        uint32_t longestBreakUs;
+        uint32_t frames;            // KMM frames
+        uint32_t crcErrors;
+        bool overflow;              // Edge buffer filled before the window ended
+    };
+
+    static LineCapture& instance();
+
+    /**
+     * @brief Start capturing (returns immediately)
+     * @param config Pins, window and buffer size
+     * @return true if both RMT channels are receiving
+     */
+    bool start(const Config& config);
+
+    /**
+     * @brief Stop capturing, sort the edge buffer and release the RMT channels
+     */
+    void stop();
+
+    /**
+     * @brief Wait for the capture window to end
+     * @param timeoutMs Maximum wait
+     * @return true if the capture has finished
+     */
+    bool wait(uint32_t timeoutMs);
+
+    bool isRunning() const { return _running; }
+    bool hasCapture() const { return !_running && _count > 0; }
+    const char* getLastError() const { return _lastError; }
+
+    size_t edgeCount() const { return _running ? 0 : _count; }
+    Edge edge(size_t index) const;
+
+    /**
+     * @brief Decode the capture into bytes and frames
+     * @param bytes Decoded bytes (optional)
+     * @param frames TWI opcode groups and KMM frames (optional)
+     * @return Statistics for the capture
+     */
+    Summary decode(std::vector<DecodedByte>* bytes = nullptr, std::vector<Frame>* frames = nullptr);
+
+    /**
+     * @brief Print summary, bytes and frames
+     */
+    void printDecoded(Print& out);
+
+    /**
+     * @brief Write the capture as VCD (1 µs timescale, decoded bytes as an 8-bit signal)
+     */
+    size_t exportVcd(Print& out);
+
+    /**
+     * @brief Write the capture as CSV: time_us,data,sense per edge
+     */
+    size_t exportCsv(Print& out);
+
+    /**
+     * @brief Export VCD and CSV to the SD card as /<baseName>.vcd and .csv
+     */
+    bool saveToSd(const char* baseName);
+
+private:
+    LineCapture();
+    LineCapture(const LineCapture&) = delete;
+    LineCapture& operator=(const LineCapture&) = delete;
+
+    // Edge buffer entry: bit 31 = line, bit 30 = level, bits 0-29 = time (µs)
+    static const uint32_t EDGE_LINE = 0x80000000u;
+    static const uint32_t EDGE_LEVEL = 0x40000000u;
+    static const uint32_t EDGE_TIME = 0x3FFFFFFFu;
+
+    bool installChannel(rmt_channel_t ch, int pin, uint8_t memBlocks, size_t ringBytes);
+    void releaseChannels();
+    void append(uint8_t line, bool level, uint32_t timeUs);
+    void drainBlock(uint8_t line, const rmt_item32_t* items, size_t n, uint32_t endUs);
+    void collectLoop();
+    static void collectTask(void* arg);
+    uint32_t estimateBitUs() const;
+    void setError(const char* msg);
+
+    Config _config;
+    uint32_t* _edges;
+    size_t _capacity;
+    size_t _count;
+    bool _overflow;
+    volatile bool _running;
+    volatile bool _stopRequested;
+    uint64_t _startUs;
+    uint32_t _durationUs;
+    uint32_t _lineTimeUs[2];    // Last edge per line (keeps each line monotonic)
+    bool _lineLevel[2];
+    bool _dataInstalled;
+    bool _senseInstalled;
+    TaskHandle_t _task;
+    TaskHandle_t _waiter;
+    const char* _lastError;
+};
@@ -13,7 +13,7 @@
    COLOR SETTINGS
  *====================*/
 #define LV_COLOR_DEPTH 16
-#define LV_COLOR_16_SWAP 0
+#define LV_COLOR_16_SWAP 1  // Panel byte order: flush pushes LVGL buffers by DMA unconverted
 #define LV_COLOR_MIX_ROUND_OFS 128
 #define LV_COLOR_CHROMA_KEY lv_color_hex(0x00ff00)
 
@@ -62,7 +62,9 @@
 #define LV_ATTRIBUTE_FAST_MEM
 #define LV_ATTRIBUTE_DMA
 #define LV_EXPORT_CONST_INT(int_value) struct _silence_gcc_warning
-#define LV_USE_LARGE_COORD 0
+// 32-bit coordinates: virtual lists are row count x pitch tall (200 keys at
+// 58 px is past the 8191 px limit of 16-bit coordinates)
+#define LV_USE_LARGE_COORD 1
 
 /*====================
    FONT USAGE
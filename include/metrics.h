@@ -0,0 +1,127 @@
+#pragma once
+
+/**
+ * @file metrics.h
+ * @brief Protocol latency histograms and error counters
+ *
+ * KFDProtocol times every phase of a session (key signature, ready wait,
+ * TX frame, radio turnaround, RX frame, teardown) and the worker, fleet
+ * ports and host bridge time whole operations. Each sample lands in a
+ * fixed log2 histogram - recording is a bucket index and a short spinlock,
+ * nothing is allocated or printed on the protocol path, and several TWI
+ * ports may record at once.
+ *
+ * Buckets are powers of two in microseconds: bucket 0 holds samples below
+ * 64 us, bucket k (1..BUCKETS-2) holds [2^(5+k), 2^(6+k)) us, and the last
+ * bucket everything from 2^(4+BUCKETS) us (~16.8 s) up. Exact count, sum,
+ * min and max are kept beside the buckets.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Arduino.h>
+
+namespace Metrics {
+
+static const size_t BUCKETS = 20;
+
+enum Phase : uint8_t {
+    PH_KEY_SIGNATURE = 0,   // Key signature + READY_REQ on the wire
+    PH_READY_WAIT,          // End of READY_REQ to the radio's start bit
+    PH_CONNECT,             // beginSession() handshake, all attempts
+    PH_TX_FRAME,            // One frame on the wire
+    PH_TURNAROUND,          // End of our frame to the radio's first byte
+    PH_RX_FRAME,            // Radio's first byte to the frame's CRC
+    PH_TEARDOWN,            // TRANSFER_DONE / DISCONNECT exchange
+    PHASE_COUNT
+};
+
+enum Op : uint8_t {
+    OP_KEYLOAD = 0,         // Single key (or erase)
+    OP_KEYLOAD_MULTI,       // Keyload plan / gang fill, per port
+    OP_SYNC,
+    OP_INVENTORY,
+    OP_ERASE_ALL,
+    OP_TEST,                // Test inventory / DES key
+    OP_KMM_EXCHANGE,        // Host bridge, one KMM
+    OP_COUNT
+};
+
+enum Counter : uint8_t {
+    CNT_SESSIONS = 0,       // Handshakes that succeeded
+    CNT_HANDSHAKE_RETRIES,  // Attempts beyond the first per handshake
+    CNT_HANDSHAKE_FAILS,    // Handshakes that gave up
+    CNT_RX_TIMEOUTS,        // No answer to a frame
+    CNT_CRC_ERRORS,
+    CNT_PARITY_ERRORS,      // Counted per session, at teardown
+    CNT_FRAMING_ERRORS,
+    CNT_LINK_FALLBACKS,     // Cached line timing abandoned
+    CNT_TX_TIMEOUTS,        // RMT transmission that never finished
+    COUNTER_COUNT
+};
+
+struct Histogram {
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint64_t sumUs;
+    uint32_t buckets[BUCKETS];
+
+    uint32_t meanUs() const { return count ? (uint32_t)(sumUs / count) : 0; }
+
+    /**
+     * @brief Estimated percentile - upper edge of the bucket holding it,
+     *        clamped to the observed maximum
+     * @param pct 0..100
+     */
+    uint32_t percentileUs(uint8_t pct) const;
+};
+
+struct OpStats {
+    Histogram time;
+    uint32_t failures;
+};
+
+// Bucket edges
+uint32_t bucketLowUs(size_t bucket);
+
+/**
+ * @brief Record one phase sample (task context)
+ */
+void recordPhase(Phase phase, uint32_t us);
+
+/**
+ * @brief Record one finished operation (task context)
+ */
+void recordOp(Op op, uint32_t us, bool success);
+
+void count(Counter counter, uint32_t n = 1);
+
+// Consistent snapshots
+Histogram getPhase(Phase phase);
+OpStats getOp(Op op);
+uint32_t getCounter(Counter counter);
+
+void reset();
+
+const char* phaseName(Phase phase);
+const char* opName(Op op);
+const char* counterName(Counter counter);
+
+/**
+ * @brief Human-readable summary (serial "metrics" command)
+ */
+void print(Print& out);
+
+/**
+ * @brief Everything as CSV: one row per phase/operation with its buckets,
+ *        then one row per counter
+ */
+size_t exportCsv(Print& out);
+
+/**
+ * @brief Write exportCsv() to /<name>.csv on the SD card
+ */
+bool saveToSd(const char* baseName);
+
+} // namespace Metrics
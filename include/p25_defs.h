@@ -107,6 +107,7 @@ enum InventoryType : uint8_t {
     INV_LIST_ALL_KSET_TAGGING     = 0x06,
     INV_LIST_ALL_UNIQUE_KEY_INFO  = 0x07,
     INV_LIST_KSET_TAGGING         = 0xF9,
+    INV_LIST_RSI_ITEMS            = 0xFC,
     INV_LIST_ACTIVE_KEYS          = 0xFD,  // This returns full key info
     INV_LIST_MNP                  = 0xFE,
     INV_LIST_KMF_RSI              = 0xFF,
@@ -149,6 +150,16 @@ enum TwiOpcode : uint8_t {
     TWI_DISCONNECT_ACK      = 0x90,  // MR -> KFD: Disconnect Acknowledge
 };
 
+// Frame size limits
+constexpr uint16_t TWI_MAX_FRAME_LEN        = 512;  // Max TWI length field (body + CRC)
+constexpr size_t   TWI_FRAME_OVERHEAD       = 6;    // Control + dest RSI + CRC
+constexpr size_t   KMM_HEADER_LEN           = 10;   // Message ID, length, format, dest/src RSI
+constexpr size_t   MODIFY_KEY_HEADER_LEN    = 9;    // Decryption info, KEK, keyset, algo, length, count
+constexpr size_t   MODIFY_KEY_ITEM_OVERHEAD = 5;    // Key format, SLN, key ID
+constexpr uint16_t INV_MAX_KEYS_PER_FRAME   = 78;   // ListActiveKeys items requested per response (KFDtool)
+constexpr size_t   INV_KEY_ITEM_LEN         = 6;    // Keyset, SLN, algorithm, key ID
+constexpr size_t   MAX_KEY_LEN              = 32;   // Longest key material (AES-256)
+
 // =============================================================================
 // Key Types
 // =============================================================================
@@ -179,11 +190,16 @@ struct KeyItem {
                 isKek(false), erase(false) {}
 };
 
-// Key status response
+// Key status response (rekey acks, keyload results and key inventory)
 struct KeyStatus {
+    uint8_t  keysetId;
+    uint16_t sln;         // Storage Location Number (inventory / keyload)
     uint16_t keyId;
     uint8_t  algorithmId;
     uint8_t  status;      // OperationStatus
+    
+    KeyStatus() : keysetId(0), sln(0), keyId(0), algorithmId(0), 
+                  status(STATUS_COMMAND_PERFORMED) {}
 };
 
 // RSI (Radio System Identity) item
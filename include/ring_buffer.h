@@ -0,0 +1,80 @@
+#pragma once
+
+/**
+ * @file ring_buffer.h
+ * @brief Lock-free single-producer / single-consumer ring buffer
+ *
+ * Used to hand data from interrupt context to a task without locks:
+ * - Exactly one producer (e.g. an ISR) calls push()
+ * - Exactly one consumer (e.g. a task) calls pop()/read()
+ * - Capacity must be a power of two; one slot is never used
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+    SpscRing() : _head(0), _tail(0) {}
+
+    /**
+     * @brief Append one element (producer side)
+     * @return false if the buffer is full (element dropped)
+     */
+    inline bool push(const T& value) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t next = (head + 1) & (N - 1);
+        if (next == _tail.load(std::memory_order_acquire)) return false;
+        _buf[head] = value;
+        _head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove one element (consumer side)
+     * @return false if the buffer is empty
+     */
+    inline bool pop(T& value) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) return false;
+        value = _buf[tail];
+        _tail.store((tail + 1) & (N - 1), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove up to maxCount elements (consumer side)
+     * @return Number of elements copied to out
+     */
+    size_t read(T* out, size_t maxCount) {
+        size_t count = 0;
+        while (count < maxCount && pop(out[count])) count++;
+        return count;
+    }
+
+    /**
+     * @brief Number of elements waiting (approximate from the producer side)
+     */
+    size_t size() const {
+        size_t head = _head.load(std::memory_order_acquire);
+        size_t tail = _tail.load(std::memory_order_acquire);
+        return (head - tail) & (N - 1);
+    }
+
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return N - 1; }
+
+    /**
+     * @brief Drop everything (consumer side)
+     */
+    void clear() { _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release); }
+
+private:
+    T _buf[N];
+    std::atomic<size_t> _head;  // Written by producer
+    std::atomic<size_t> _tail;  // Written by consumer
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+/**
+ * @file sd_card.h
+ * @brief microSD slot of the WT32-SC01-Plus (SPI)
+ *
+ * Pins: CS 41, MOSI 40, SCLK 39, MISO 38. The card is mounted on first
+ * use and stays mounted until unmount() or a failed access.
+ */
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SPI.h>
+
+class SdCard {
+public:
+    static const int PIN_CS = 41;
+    static const int PIN_MOSI = 40;
+    static const int PIN_SCLK = 39;
+    static const int PIN_MISO = 38;
+    static const uint32_t SPI_HZ = 20000000;
+
+    static SdCard& instance();
+
+    /**
+     * @brief Mount the card (no-op if already mounted)
+     * @return true if a card is mounted
+     */
+    bool mount();
+
+    void unmount();
+    bool isMounted() const { return _mounted; }
+
+    /**
+     * @brief Filesystem of the mounted card
+     */
+    fs::FS& fs();
+
+private:
+    SdCard();
+    SdCard(const SdCard&) = delete;
+    SdCard& operator=(const SdCard&) = delete;
+
+    SPIClass _spi;
+    bool _mounted;
+};
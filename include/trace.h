@@ -0,0 +1,122 @@
+#pragma once
+
+/**
+ * @file trace.h
+ * @brief Binary protocol trace ring
+ *
+ * Timestamped 8-byte records of TX/RX bytes, DATA line edges and session
+ * events, written from tasks and from the receive ISR. Recording is one
+ * mask test plus a short spinlock - nothing is formatted or printed on the
+ * protocol path. Records are formatted later, either by a low-priority
+ * task streaming to the Console or on demand (serial "trace" command).
+ *
+ * The ring keeps the newest TRACE_RING_SIZE records; older ones are
+ * overwritten and counted as dropped.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <Arduino.h>
+
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 2048  // Records (power of two), 8 bytes each
+#endif
+
+namespace Trace {
+
+enum Event : uint8_t {
+    EV_NONE = 0,
+    EV_TX_BYTE,        // a = byte (timestamp = start of its frame)
+    EV_TX_DONE,        // b = bytes sent, line released
+    EV_RX_BYTE,        // a = byte, b = 1 on parity error
+    EV_RX_TIMEOUT,     // b = timeout (ms)
+    EV_EDGE,           // a = level after the edge (1 = IDLE), b = 1 if gated (own TX)
+    EV_BREAK,          // b = BUSY duration (ms) - key signature from the far end
+    EV_KEYSIG,         // Key signature sent
+    EV_SESSION_BEGIN,  // b = attempt
+    EV_READY,          // a = ready response (0xD0/0xD1), b = attempt
+    EV_SESSION_END,    // a = 1 graceful, 0 torn down
+    EV_KMM_TX,         // a = message ID, b = frame length
+    EV_KMM_RX,         // a = message ID, b = KMM length
+    EV_CRC_ERROR,      // b = received CRC
+    EV_MARK,           // a/b = caller defined
+    EV_LINK_FALLBACK,  // a = TX kbaud, b = RX kbaud given up for the standard timing
+};
+
+// Record categories (setMask)
+enum Mask : uint8_t {
+    MASK_BYTES  = 0x01,   // EV_TX_BYTE, EV_RX_BYTE - off by default, includes key material
+    MASK_EDGES  = 0x02,   // EV_EDGE - one record per line transition
+    MASK_EVENTS = 0x04,   // Everything else
+    MASK_ALL    = 0x07,
+};
+
+struct Record {
+    uint32_t timeUs;      // esp_timer, low 32 bits
+    uint8_t event;
+    uint8_t a;
+    uint16_t b;
+};
+
+struct Stats {
+    uint32_t recorded;
+    uint32_t dropped;     // Overwritten before being read
+    uint32_t pending;     // Waiting to be read
+};
+
+// Categories being recorded (0 = off)
+extern volatile uint8_t g_mask;
+
+/**
+ * @brief Append a record (task or ISR context, IRAM)
+ */
+void push(uint8_t event, uint8_t a, uint16_t b);
+
+/**
+ * @brief Record an event if its category is enabled (inlined - ISR safe)
+ */
+__attribute__((always_inline)) inline void record(Event ev, uint8_t a = 0, uint16_t b = 0) {
+    uint8_t category = (ev == EV_EDGE) ? MASK_EDGES
+                     : (ev == EV_TX_BYTE || ev == EV_RX_BYTE) ? MASK_BYTES : MASK_EVENTS;
+    if (g_mask & category) push(ev, a, b);
+}
+
+void setMask(uint8_t mask);
+uint8_t getMask();
+
+/**
+ * @brief Drop all buffered records
+ */
+void clear();
+
+/**
+ * @brief Remove up to maxCount records, oldest first
+ * @return Number of records copied
+ */
+size_t read(Record* out, size_t maxCount);
+
+/**
+ * @brief Format and remove buffered records
+ * @param out Destination (Console)
+ * @param maxCount Stop after this many records
+ * @return Number of records printed
+ */
+size_t dump(Print& out, size_t maxCount = SIZE_MAX);
+
+/**
+ * @brief Stream records to the Console from the drain task as they arrive
+ */
+void setStreaming(bool enable);
+bool isStreaming();
+
+/**
+ * @brief Start the low-priority drain task (idempotent)
+ * @param core Core to run on - keep it off the protocol worker's core
+ */
+bool startTask(BaseType_t core = 1);
+
+Stats getStats();
+
+const char* eventName(uint8_t event);
+
+} // namespace Trace
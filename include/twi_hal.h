@@ -6,6 +6,7 @@
  * 
  * Implements the physical layer for P25 TWI/3WI communication:
  * - Bit-level transmit/receive
+ * - Edge-timestamped interrupt receiver feeding a byte ring buffer
  * - Key signature generation
  * - Timing control
  * - Self-test functionality
@@ -19,9 +20,49 @@
 #include <Arduino.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <vector>
+#include <driver/rmt.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "ring_buffer.h"
 
 class TWI_HAL {
 public:
+    // Transmit backend
+    enum TxBackend : uint8_t {
+        TX_BITBANG = 0,  // CPU-timed bit banging (interrupts disabled per byte)
+        TX_RMT,          // RMT peripheral streams pre-encoded symbols
+    };
+
+    // Receive backend
+    enum RxBackend : uint8_t {
+        RX_EDGE_CAPTURE = 0,  // GPIO edge ISR decodes frames into a ring buffer
+        RX_POLLED,            // Legacy: spin for start bit, sample with interrupts disabled
+    };
+
+    // Receiver statistics (edge capture backend)
+    struct RxStats {
+        uint32_t bytes;          // Bytes decoded
+        uint32_t parityErrors;   // Parity bit did not match
+        uint32_t framingErrors;  // Start bit too short (glitch)
+        uint32_t overruns;       // Ring buffer full, byte dropped
+        uint32_t breaks;         // Long BUSY periods (key signature)
+    };
+
+    // Line timing - bit rates plus the per-byte framing overhead
+    struct LineTiming {
+        uint8_t txKilobaud;
+        uint8_t rxKilobaud;
+        uint8_t stopBits;        // Stop bits after each frame (standard: 4)
+        uint8_t gapBits;         // Idle bit times between bytes (standard: 2)
+        
+        bool operator==(const LineTiming& o) const {
+            return txKilobaud == o.txKilobaud && rxKilobaud == o.rxKilobaud &&
+                   stopBits == o.stopBits && gapBits == o.gapBits;
+        }
+        bool operator!=(const LineTiming& o) const { return !(*this == o); }
+    };
+
     // Configuration structure
     struct Config {
         int dataPin = 11;      // DATA pin (bidirectional, open-drain)
@@ -36,6 +77,13 @@ public:
         // Transfer speeds
         uint8_t txKilobaud = 4;  // TX speed in kbaud (standard)
         uint8_t rxKilobaud = 4;  // RX speed in kbaud (standard)
+        
+        // Transmit backend
+        TxBackend txBackend = TX_BITBANG;
+        int rmtTxChannel = 0;    // RMT TX channel (ESP32-S3: 0-3)
+        
+        // Receive backend
+        RxBackend rxBackend = RX_EDGE_CAPTURE;
     };
 
     TWI_HAL();
@@ -107,8 +155,57 @@ public:
      * @brief Send multiple bytes with minimal overhead (for KMM frames)
      * @param data Data buffer
      * @param len Number of bytes
+     * @return false if the transmission did not complete (RMT timeout) -
+     *         the radio saw a partial frame at best
      */
-    void sendBytesFast(const uint8_t* data, size_t len);
+    bool sendBytesFast(const uint8_t* data, size_t len);
+
+    /**
+     * @brief Encode bytes into 10-bit wire frames
+     * Each frame is start bit + 8 data bits (reversed) + parity, LSB first.
+     * Stop bits and gaps are added at send time.
+     * @param data Data buffer
+     * @param len Number of bytes
+     * @param frames Output, len entries
+     */
+    void encodeBytes(const uint8_t* data, size_t len, uint16_t* frames);
+
+    /**
+     * @brief Send frames produced by encodeBytes() (same timing as sendBytesFast)
+     * @param frames Encoded frames
+     * @param len Number of frames
+     * @return false if the transmission did not complete (RMT timeout)
+     */
+    bool sendEncoded(const uint16_t* frames, size_t len);
+
+    /**
+     * @brief Start sending bytes in the background (RMT backend only)
+     * Falls back to a blocking sendBytesFast() with the bit-bang backend.
+     * The caller must not start another transmission before waitTxDone().
+     * @param data Data buffer
+     * @param len Number of bytes
+     * @return true if the transmission was started
+     */
+    bool sendBytesAsync(const uint8_t* data, size_t len);
+
+    /**
+     * @brief Wait for a background transmission to finish
+     * @param timeoutMs Timeout in milliseconds
+     * @return true if the line has been released
+     */
+    bool waitTxDone(uint32_t timeoutMs = 1000);
+
+    /**
+     * @brief Check if a background transmission is in progress
+     */
+    bool isTxBusy() const { return _rmtTxActive; }
+
+    /**
+     * @brief Select transmit backend at runtime
+     * @return true if the backend is available
+     */
+    bool setTxBackend(TxBackend backend);
+    TxBackend getTxBackend() const { return _config.txBackend; }
 
     /**
      * @brief Receive a byte with timeout
@@ -119,7 +216,10 @@ public:
     bool receiveByte(uint8_t* byte, uint32_t timeoutMs = 5000);
 
     /**
-     * @brief Receive bytes with timeout
+     * @brief Drain received bytes
+     * With the edge capture backend this waits up to timeoutMs for the first
+     * byte only, then returns everything already buffered without blocking.
+     * Pass timeoutMs = 0 for a pure non-blocking drain.
      * @param buffer Output buffer
      * @param maxLen Maximum bytes to receive
      * @param received Output: actual bytes received
@@ -129,6 +229,51 @@ public:
     bool receiveBytes(uint8_t* buffer, size_t maxLen, size_t* received, 
                       uint32_t timeoutMs = 5000);
 
+    /**
+     * @brief Wait for the far end to start transmitting
+     * Returns on the start bit edge (or a buffered byte), without waiting
+     * for the byte to complete - used to tell a silent radio from a slow one.
+     * @param timeoutUs Listen window in microseconds
+     * @param latencyUs Output: end of our last transmission to the start edge
+     * @return true if activity was seen within the window
+     */
+    bool waitForRxStart(uint32_t timeoutUs, uint32_t* latencyUs = nullptr);
+
+    /**
+     * @brief Number of received bytes waiting in the ring buffer
+     */
+    size_t available();
+
+    /**
+     * @brief Discard buffered bytes and any partially decoded frame
+     */
+    void flushRx();
+
+    /**
+     * @brief Check and clear the break (long BUSY) flag
+     * @return true if a break was seen since the last call
+     */
+    bool takeBreak();
+
+    /**
+     * @brief Wait for the far end to send a key signature (MR emulator)
+     * @param timeoutMs Timeout in milliseconds
+     * @return true if a break ended within the timeout (flag cleared)
+     */
+    bool waitForBreak(uint32_t timeoutMs);
+
+    /**
+     * @brief Receiver statistics since init (edge capture backend)
+     */
+    RxStats getRxStats() const { return _rxStats; }
+    void resetRxStats();
+
+    /**
+     * @brief Select receive backend at runtime
+     */
+    void setRxBackend(RxBackend backend);
+    RxBackend getRxBackend() const { return _config.rxBackend; }
+
     /**
      * @brief Set DATA line state (for diagnostics)
      * @param busy true = pull low (busy), false = release (idle/high)
@@ -153,6 +298,13 @@ public:
      */
     void setSenseLine(bool active);
 
+    /**
+     * @brief Stop driving SENSE and read it as an input (MR emulator -
+     *        the KFD on the other end drives it). Any later
+     *        setSenseLine()/enableInterface() takes the pin back.
+     */
+    void releaseSenseLine();
+
     /**
      * @brief Enable the KFD interface (pull SENSE low to wake radio)
      */
@@ -170,7 +322,7 @@ public:
     void sendKeySignatureAndReadyReq();
 
     /**
-     * @brief Enable debug output to Serial
+     * @brief Enable debug output to the Console
      */
     void enableDebug(bool enable) { _debug = enable; }
     bool isDebugEnabled() const { return _debug; }
@@ -183,6 +335,21 @@ public:
     void setStopBitMode(bool useBusy) { _useBusyStopBits = useBusy; }
     bool getStopBitMode() const { return _useBusyStopBits; }
 
+    /**
+     * @brief Set the per-byte framing overhead of transmitted bytes
+     * @param stopBits Stop bits after each frame (1-4, standard 4)
+     * @param gapBits Idle bit times before the next byte (0-2, standard 2)
+     */
+    void setFrameTiming(uint8_t stopBits, uint8_t gapBits);
+    uint8_t getStopBits() const { return _stopBits; }
+    uint8_t getGapBits() const { return _gapBits; }
+
+    /**
+     * @brief Apply speeds and framing in one call
+     */
+    void setLineTiming(const LineTiming& timing);
+    LineTiming getLineTiming() const;
+
     /**
      * @brief Reset to idle state
      */
@@ -193,22 +360,72 @@ private:
     bool _initialized;
     bool _debug;
     bool _useBusyStopBits;  // true = BUSY (KFDtool), false = IDLE (standard)
+    uint8_t _stopBits;      // Stop bits per transmitted byte
+    uint8_t _gapBits;       // Idle bit times after each transmitted byte
+    bool _senseReleased;    // SENSE is an input (releaseSenseLine)
+    
+    // Edge capture receiver - decoder state is shared with the ISR under _rxMux
+    enum RxState : uint8_t { RXS_HUNT = 0, RXS_FRAME, RXS_WAIT_IDLE };
     
-    volatile bool _receiving;
-    volatile uint8_t _rxByte;
-    volatile bool _rxComplete;
+    portMUX_TYPE _rxMux;
+    bool _rxIsrAttached;
+    volatile RxState _rxState;
+    volatile bool _rxLevel;          // Line level after the last edge (true = IDLE)
+    volatile uint64_t _rxFrameStart; // Start bit falling edge (µs)
+    volatile uint64_t _rxLastEdge;   // Last edge (µs)
+    volatile uint64_t _rxGateUntil;  // Ignore edges before this time (our own TX)
+    volatile uint16_t _rxShift;      // Bits decoded so far, LSB = start bit
+    volatile uint8_t _rxBitCount;
+    volatile bool _rxBreak;
+    volatile TaskHandle_t _rxWaiter;
+    RxStats _rxStats;
+    SpscRing<uint8_t, 1024> _rxRing;
     
     // Timing
     uint32_t _bitPeriodTx;
     uint32_t _bitPeriodRx;
     
+    // RMT transmit backend
+    bool _rmtReady;
+    uint32_t _rmtTotalTicks;              // Stream length so far
+    uint32_t _rmtDrivenTicks;             // End of the last BUSY run in the stream
+    volatile bool _rmtTxActive;
+    uint32_t _rmtBitTicks;                // RMT ticks per TX bit
+    std::vector<rmt_item32_t> _rmtItems;  // Encoded symbols (reused between frames)
+    bool _rmtPendingIdle;                 // Level of the run being accumulated
+    uint32_t _rmtPendingTicks;            // Length of the run being accumulated
+    bool _rmtHalfOpen;                    // Last item has only its first half used
+    
     // Internal methods
     void sendBit(bool bit);
     bool receiveBit();
     uint8_t reverseBits(uint8_t byte);
     bool isEvenParity(uint8_t byte);
+    uint16_t encodeFrame(uint8_t byte);
+    void bitbangFrame(uint16_t frame, bool last);
     void delayMicroseconds_accurate(uint32_t us);
     
+    // RMT symbol encoding
+    bool rmtInit();
+    void rmtBegin();
+    void rmtLevel(bool idle, uint32_t ticks);
+    void rmtEncodeFrame(uint16_t frame);
+    bool rmtStart();
+    bool rmtFinish(uint32_t timeoutMs);
+    void rmtFlushRun();
+    void rmtPushHalf(bool idle, uint32_t ticks);
+    void rmtAttach();
+    void rmtDetach();
+    
+    // Edge capture receiver
+    void rxAttach();
+    void rxDetach();
+    void rxGate(uint64_t untilUs);
+    void serviceRx();
+    bool receiveBytePolled(uint8_t* byte, uint32_t timeoutMs);
+    void rxFillBits(uint64_t t, bool level);
+    void rxFinishFrame();
+    
     // Low-level line control (matching KFDtool naming conventions)
     void kfdTxBusy();      // Drive DATA LOW (busy)
     void kfdTxIdle();      // Drive DATA HIGH (idle)
@@ -219,8 +436,13 @@ private:
     bool senRxIsConn();    // Check if SENSE is LOW
     bool senRxIsDisc();    // Check if SENSE is HIGH
     
-    // Interrupt handling
-    static TWI_HAL* _instance;
-    static void IRAM_ATTR dataFallingISR();
-    void handleDataFalling();
+    // RMT TX channels claimed by live HAL instances (bit per channel)
+    static uint32_t _rmtClaimed;
+    static bool rmtClaim(int channel);
+    static void rmtRelease(int channel);
+    
+    // Interrupt handling - the ISR argument is the owning instance, so any
+    // number of ports can run side by side
+    static void IRAM_ATTR dataEdgeISR(void* arg);
+    void handleDataEdge();
 };
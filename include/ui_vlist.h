@@ -0,0 +1,64 @@
+#pragma once
+
+/**
+ * @file ui_vlist.h
+ * @brief Virtualized list widget - a fixed pool of recycled rows
+ *
+ * Only the rows that fit the viewport (plus two) are ever created. A spacer
+ * child gives the list its full scroll height; on scroll each pooled row is
+ * moved to the index it now represents and rebound, so a 200-key container
+ * costs the same LVGL memory as a 5-key one.
+ *
+ * The spacer is count x pitch tall, so long lists need 32-bit coordinates
+ * (LV_USE_LARGE_COORD). Rows have a fixed height. The create callback builds a row's children
+ * once; the bind callback fills them for an item index and must not add or
+ * delete objects. Row event handlers find their item with ui_vlist_row_index().
+ */
+
+#include <lvgl.h>
+#include <stdint.h>
+
+typedef void (*ui_vlist_create_cb_t)(lv_obj_t* row);
+typedef void (*ui_vlist_bind_cb_t)(lv_obj_t* row, uint32_t index);
+
+/**
+ * @brief Create an empty list
+ * @param parent Screen or container
+ * @param w List width
+ * @param h List height (fixes the row pool size)
+ * @param row_h Row height (rows are spaced 4 px apart)
+ * @param create_cb Builds the children of a pooled row
+ * @param bind_cb Shows item @p index in a row
+ */
+lv_obj_t* ui_vlist_create(lv_obj_t* parent, lv_coord_t w, lv_coord_t h, lv_coord_t row_h,
+                          ui_vlist_create_cb_t create_cb, ui_vlist_bind_cb_t bind_cb);
+
+/**
+ * @brief Set the item count and rebind every visible row
+ */
+void ui_vlist_set_count(lv_obj_t* list, uint32_t count);
+
+uint32_t ui_vlist_get_count(lv_obj_t* list);
+
+/**
+ * @brief Rebind visible rows after the items changed in place
+ */
+void ui_vlist_rebind(lv_obj_t* list);
+
+/**
+ * @brief Scroll so that an item is the first visible row (clamped to the end)
+ */
+void ui_vlist_scroll_to(lv_obj_t* list, uint32_t index);
+
+/**
+ * @brief Text shown while the list is empty (nullptr = none)
+ */
+void ui_vlist_set_empty_text(lv_obj_t* list, const char* text);
+
+/**
+ * @brief Item shown by the row containing an object
+ * @param list List
+ * @param obj A row or any descendant of one (e.g. an event target)
+ * @return Item index, or -1 if @p obj is not in a bound row
+ */
+int32_t ui_vlist_row_index(lv_obj_t* list, lv_obj_t* obj);
@@ -0,0 +1,755 @@
+/**
+ * @file bench.cpp
+ * @brief On-device benchmark suite and loopback keyload harness implementation
+ */
+
+#include "bench.h"
+#include "console.h"
+#include "crc16.h"
+#include "crypto.h"
+#include "kmm_frame.h"
+#include "line_capture.h"
+#include "fleet_loader.h"
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include <lvgl.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+namespace Bench {
+
+namespace {
+    const char* const BASELINE_FILE = "/bench.json";
+
+    // HIGHER/LOWER metrics are compared with the baseline; LIMIT metrics
+    // fail when |value| exceeds their limit
+    enum Kind : uint8_t { HIGHER, LOWER, LIMIT };
+
+    struct MetricDef {
+        const char* name;
+        const char* unit;
+        Kind kind;
+        float slack;        // LOWER: absolute slack on top of the percentage, LIMIT: the limit
+    };
+
+    const MetricDef METRICS[METRIC_COUNT] = {
+        { "crc_table",        "MB/s", HIGHER, 0 },
+        { "crc_rom",          "MB/s", HIGHER, 0 },
+        { "plan_1key",        "us",   LOWER,  20 },
+        { "plan_8keys",       "us",   LOWER,  50 },
+        { "ack_parse",        "us",   LOWER,  2 },
+        { "pbkdf2",           "ms",   LOWER,  5 },
+        { "sha256",           "MB/s", HIGHER, 0 },
+        { "aes_gcm",          "MB/s", HIGHER, 0 },
+        { "lvgl_frame",       "ms",   LOWER,  2 },
+        { "lvgl_frame_max",   "ms",   LOWER,  5 },
+        { "tx_rate",          "B/s",  HIGHER, 0 },
+        { "tx_encoded_rate",  "B/s",  HIGHER, 0 },
+        { "tx_overhead",      "%",    LIMIT,  10 },
+        { "tx_bit_error",     "%",    LIMIT,  2 },
+        { "tx_jitter",        "us",   LOWER,  5 },
+        { "tx_byte_errors",   "",     LIMIT,  0 },
+        { "rx_rate",          "B/s",  HIGHER, 0 },
+        { "rx_bit_error",     "%",    LIMIT,  2 },
+        { "rx_byte_errors",   "",     LIMIT,  0 },
+        { "loop_connect",     "ms",   LOWER,  5 },
+        { "loop_keyload",     "ms",   LOWER,  20 },
+        { "loop_keyload_max", "ms",   LOWER,  50 },
+        { "loop_failures",    "",     LIMIT,  0 },
+    };
+
+    enum Verdict : uint8_t { V_NONE, V_OK, V_REGRESSED, V_OVER_LIMIT };
+
+    struct Slot {
+        float value;
+        bool valid;
+    };
+
+    Slot s_result[METRIC_COUNT];
+    Slot s_baseline[METRIC_COUNT];
+    bool s_baselineLoaded = false;
+
+    TWI_HAL* s_hal = nullptr;
+    KFDProtocol* s_kfd = nullptr;
+
+    // Loopback radio port, set up on first use
+    TWI_HAL s_loopHal;
+    KFDProtocol s_loopKfd;
+    bool s_loopTried = false;
+    bool s_loopReady = false;
+
+    // Bytes pushed through the line per timing test
+    const size_t LINE_TEST_BYTES = 64;
+
+    // Keeps the compiler from dropping timed loops
+    volatile uint32_t s_sink;
+
+    uint64_t now() { return esp_timer_get_time(); }
+
+    void set(Metric m, float value) {
+        s_result[m].value = value;
+        s_result[m].valid = true;
+    }
+
+    float mbps(size_t bytes, uint64_t us) {
+        return us ? (float)bytes / (float)us : 0.0f;
+    }
+
+    void loadBaseline() {
+        if (s_baselineLoaded) return;
+        s_baselineLoaded = true;
+        memset(s_baseline, 0, sizeof(s_baseline));
+
+        File f = LittleFS.open(BASELINE_FILE, "r");
+        if (!f) return;
+        JsonDocument doc;
+        if (deserializeJson(doc, f)) { f.close(); return; }
+        f.close();
+
+        for (uint8_t m = 0; m < METRIC_COUNT; m++) {
+            JsonVariant v = doc[METRICS[m].name];
+            if (v.isNull()) continue;
+            s_baseline[m].value = v.as<float>();
+            s_baseline[m].valid = true;
+        }
+    }
+
+    Verdict verdict(uint8_t m) {
+        if (!s_result[m].valid) return V_NONE;
+        const MetricDef& d = METRICS[m];
+        float v = s_result[m].value;
+        if (d.kind == LIMIT) return fabsf(v) <= d.slack ? V_OK : V_OVER_LIMIT;
+        if (!s_baseline[m].valid) return V_OK;
+
+        float base = s_baseline[m].value;
+        float tol = fabsf(base) * BENCH_REGRESSION_PCT / 100.0f;
+        if (d.kind == LOWER) return (v > base + tol && v > base + d.slack) ? V_REGRESSED : V_OK;
+        return v < base - tol ? V_REGRESSED : V_OK;
+    }
+
+    const char* verdictName(Verdict v) {
+        switch (v) {
+            case V_OK:         return "ok";
+            case V_REGRESSED:  return "REGRESSED";
+            case V_OVER_LIMIT: return "OVER LIMIT";
+            default:           return "-";
+        }
+    }
+
+    std::vector<P25::KeyItem> makeKeys(size_t count) {
+        std::vector<P25::KeyItem> keys(count);
+        for (size_t i = 0; i < count; i++) {
+            keys[i].sln = (uint16_t)(i + 1);
+            keys[i].keyId = (uint16_t)(i + 1);
+            keys[i].key.resize(AES256_KEY_SIZE);
+            Crypto::generateKey256(keys[i].key.data());
+        }
+        return keys;
+    }
+
+    void wipeKeys(std::vector<P25::KeyItem>& keys) {
+        for (auto& k : keys) {
+            if (!k.key.empty()) Crypto::secureZero(k.key.data(), k.key.size());
+        }
+        keys.clear();
+    }
+
+    // Alternating bits give plenty of single-bit pulses, the counter
+    // makes a dropped or shifted byte visible
+    void linePattern(uint8_t* data, size_t len) {
+        for (size_t i = 0; i < len; i++) data[i] = (i & 1) ? 0x55 : (uint8_t)i;
+    }
+
+    uint32_t byteErrors(const std::vector<LineCapture::DecodedByte>& got, const uint8_t* want, size_t len) {
+        uint32_t errors = got.size() > len ? got.size() - len : len - got.size();
+        for (size_t i = 0; i < got.size() && i < len; i++) {
+            if (got[i].value != want[i] || got[i].parityError) errors++;
+        }
+        return errors;
+    }
+
+    struct BitTiming {
+        uint32_t pulses;
+        float errorPct;     // Mean bit length against nominal
+        uint32_t jitterUs;  // Largest distance of an edge from a whole bit count
+    };
+
+    // Every DATA pulse up to a frame long is a whole number of bit times -
+    // idle gaps before and after the burst are longer and drop out
+    BitTiming analyseCapture(LineCapture& cap, float bitUs) {
+        BitTiming bt = {};
+        double sumUs = 0;
+        uint32_t sumBits = 0;
+        bool havePrev = false;
+        uint32_t prev = 0;
+
+        for (size_t i = 0; i < cap.edgeCount(); i++) {
+            LineCapture::Edge e = cap.edge(i);
+            if (e.line != LineCapture::LINE_DATA) continue;
+            if (havePrev) {
+                uint32_t w = e.timeUs - prev;
+                uint32_t bits = (uint32_t)(w / bitUs + 0.5f);
+                if (bits >= 1 && bits <= 10) {
+                    sumUs += w;
+                    sumBits += bits;
+                    bt.pulses++;
+                    uint32_t dev = (uint32_t)(fabsf((float)w - bits * bitUs) + 0.5f);
+                    if (dev > bt.jitterUs) bt.jitterUs = dev;
+                }
+            }
+            prev = e.timeUs;
+            havePrev = true;
+        }
+        if (sumBits) bt.errorPct = (float)((sumUs / sumBits - bitUs) * 100.0 / bitUs);
+        return bt;
+    }
+
+    bool startCapture(int dataPin, int sensePin, float bitUs, Print& out) {
+        LineCapture::Config cc;
+        cc.dataPin = dataPin;
+        cc.sensePin = sensePin;
+        cc.windowMs = 0;
+        cc.maxEdges = 8192;
+        cc.bitUs = (uint32_t)(bitUs + 0.5f);
+        if (!LineCapture::instance().start(cc)) {
+            out.printf("[BENCH] loop: capture failed: %s\n", LineCapture::instance().getLastError());
+            return false;
+        }
+        // Twenty idle bit times separate the burst from the capture anchor
+        delay((uint32_t)(bitUs * 20 / 1000) + 1);
+        return true;
+    }
+}
+
+// =============================================================================
+// Tests
+// =============================================================================
+
+static void benchCrc(Print& out) {
+    const size_t len = 4096;
+    const int passes = 16;
+    std::vector<uint8_t> buf(len);
+    Crypto::generateRandom(buf.data(), len);
+
+    Crc16::Kmm crc;
+    uint64_t t0 = now();
+    for (int i = 0; i < passes; i++) crc.updateTable(buf.data(), len);
+    uint64_t tableUs = now() - t0;
+    s_sink = crc.value();
+    set(M_CRC_TABLE, mbps(len * passes, tableUs));
+
+    if (Crc16::getUseRom()) {
+        crc.reset();
+        t0 = now();
+        for (int i = 0; i < passes; i++) crc.updateRom(buf.data(), len);
+        uint64_t romUs = now() - t0;
+        s_sink = crc.value();
+        set(M_CRC_ROM, mbps(len * passes, romUs));
+        out.printf("[BENCH] crc: table %.2f MB/s, ROM %.2f MB/s\n",
+                   s_result[M_CRC_TABLE].value, s_result[M_CRC_ROM].value);
+    } else {
+        out.printf("[BENCH] crc: table %.2f MB/s, ROM path disabled (self-test)\n", s_result[M_CRC_TABLE].value);
+    }
+}
+
+static void benchFrame(Print& out) {
+    if (!s_kfd || s_kfd->isBusy()) {
+        out.println("[BENCH] frame: protocol busy - skipped");
+        return;
+    }
+
+    // Plan build = Modify Key frame, CRC and wire encoding, as a fill does it
+    const int iterations = 50;
+    auto keys = makeKeys(8);
+    std::vector<P25::KeyItem> one(keys.begin(), keys.begin() + 1);
+    KFDProtocol::KeyloadPlan plan;
+
+    uint64_t t0 = now();
+    for (int i = 0; i < iterations; i++) s_kfd->compilePlan(one, plan);
+    set(M_PLAN_1KEY, (float)(now() - t0) / iterations);
+
+    t0 = now();
+    for (int i = 0; i < iterations; i++) s_kfd->compilePlan(keys, plan);
+    set(M_PLAN_8KEYS, (float)(now() - t0) / iterations);
+    plan.clear();
+    wipeKeys(one);
+    wipeKeys(keys);
+
+    // Parse = CRC check and item walk of an 8-key Rekey Ack, as received
+    uint8_t frame[P25::TWI_MAX_FRAME_BYTES];
+    P25::KmmWriter w(frame, sizeof(frame));
+    w.begin(P25::MSG_REKEY_ACK);
+    w.put(P25::MSG_MODIFY_KEY_CMD);
+    w.put16(8);
+    for (uint16_t i = 0; i < 8; i++) {
+        w.put(P25::ALGO_AES_256);
+        w.put16(i + 1);
+        w.put(P25::STATUS_COMMAND_PERFORMED);
+    }
+    size_t len = w.end();
+
+    const int parses = 1000;
+    uint32_t items = 0;
+    t0 = now();
+    for (int i = 0; i < parses; i++) {
+        uint16_t crc = P25::calculateCrc16(frame + 3, len - 5);
+        if (crc != (uint16_t)(frame[len - 2] | (frame[len - 1] << 8))) continue;
+        P25::KmmReader r(frame + 7, len - 9);
+        if (!r.valid() || r.messageId() != P25::MSG_REKEY_ACK) continue;
+        r.get();
+        uint16_t count = r.get16();
+        for (uint16_t k = 0; k < count && r.remaining() >= 4; k++) {
+            r.get();
+            r.get16();
+            if (r.get() == P25::STATUS_COMMAND_PERFORMED) items++;
+        }
+    }
+    set(M_ACK_PARSE, (float)(now() - t0) / parses);
+    s_sink = items;
+
+    out.printf("[BENCH] frame: plan 1 key %.1f us, 8 keys %.1f us, ack parse %.2f us%s\n",
+               s_result[M_PLAN_1KEY].value, s_result[M_PLAN_8KEYS].value, s_result[M_ACK_PARSE].value,
+               items == (uint32_t)parses * 8 ? "" : " (PARSE MISMATCH)");
+}
+
+static void benchCrypto(Print& out) {
+    Crypto::BenchResult br;
+    if (!Crypto::benchmark(PBKDF2_ITERATIONS, br)) {
+        out.println("[BENCH] crypto: out of memory");
+        return;
+    }
+    set(M_PBKDF2, (float)br.pbkdf2Ms);
+    set(M_SHA256, br.sha256MBps);
+    set(M_AES_GCM, br.gcmMBps);
+    out.printf("[BENCH] crypto: PBKDF2 x%u %u ms, SHA-256 %.2f MB/s, AES-GCM %.2f MB/s\n",
+               br.iterations, br.pbkdf2Ms, br.sha256MBps, br.gcmMBps);
+}
+
+static void benchLvgl(Print& out) {
+    lv_disp_t* disp = lv_disp_get_default();
+    if (!disp) {
+        out.println("[BENCH] lvgl: no display - skipped");
+        return;
+    }
+
+    // Whole screen invalidated per frame: worst case render + flush
+    const int frames = 20;
+    uint64_t total = 0;
+    uint32_t worst = 0;
+    for (int i = 0; i < frames; i++) {
+        lv_obj_invalidate(lv_scr_act());
+        uint64_t t0 = now();
+        lv_refr_now(disp);
+        uint32_t us = (uint32_t)(now() - t0);
+        total += us;
+        if (us > worst) worst = us;
+    }
+    set(M_LVGL_FRAME, total / frames / 1000.0f);
+    set(M_LVGL_FRAME_MAX, worst / 1000.0f);
+    out.printf("[BENCH] lvgl: full frame avg %.1f ms, max %.1f ms\n",
+               s_result[M_LVGL_FRAME].value, s_result[M_LVGL_FRAME_MAX].value);
+}
+
+static void benchTx(Print& out) {
+    // Drives the HAL directly - hold the port like an operation would
+    if (!s_hal || !s_kfd || !s_kfd->beginOperation()) {
+        out.println("[BENCH] tx: port busy - skipped");
+        return;
+    }
+
+    uint8_t data[LINE_TEST_BYTES];
+    uint16_t wire[LINE_TEST_BYTES];
+    linePattern(data, sizeof(data));
+    s_hal->encodeBytes(data, sizeof(data), wire);
+
+    TWI_HAL::LineTiming lt = s_hal->getLineTiming();
+    float nominalUs = sizeof(data) * (10 + lt.stopBits + lt.gapBits) * (1000.0f / lt.txKilobaud);
+
+    uint64_t t0 = now();
+    bool sent = s_hal->sendBytesFast(data, sizeof(data));
+    uint32_t fastUs = (uint32_t)(now() - t0);
+
+    t0 = now();
+    sent = s_hal->sendEncoded(wire, sizeof(data)) && sent;
+    uint32_t encodedUs = (uint32_t)(now() - t0);
+    s_hal->flushRx();
+    s_kfd->endOperation();
+    if (!sent) {
+        out.println("[BENCH] tx: transmission did not complete - skipped");
+        return;
+    }
+
+    set(M_TX_RATE, sizeof(data) * 1e6f / fastUs);
+    set(M_TX_ENCODED_RATE, sizeof(data) * 1e6f / encodedUs);
+    set(M_TX_OVERHEAD, (fastUs - nominalUs) * 100.0f / nominalUs);
+    out.printf("[BENCH] tx: %s, %u kbaud: %.0f B/s (%.0f B/s pre-encoded), %+.1f%% against nominal\n",
+               s_hal->getTxBackend() == TWI_HAL::TX_RMT ? "RMT" : "bit-bang", lt.txKilobaud,
+               s_result[M_TX_RATE].value, s_result[M_TX_ENCODED_RATE].value, s_result[M_TX_OVERHEAD].value);
+}
+
+// =============================================================================
+// Loopback
+// =============================================================================
+
+static bool loopAttach(Print& out) {
+    if (s_loopTried) {
+        if (!s_loopReady) out.println("[BENCH] loop: loopback port unavailable");
+        return s_loopReady;
+    }
+    s_loopTried = true;
+
+    TWI_HAL::Config hc = s_hal->getConfig();
+    if (hc.dataPin == BENCH_LOOP_DATA_PIN || hc.sensePin == BENCH_LOOP_SENSE_PIN ||
+        hc.dataPin == BENCH_LOOP_SENSE_PIN || hc.sensePin == BENCH_LOOP_DATA_PIN) {
+        out.println("[BENCH] loop: loopback pins are the front-panel port - set BENCH_LOOP_*_PIN");
+        return false;
+    }
+    if (FleetLoader::instance().portCount() > 1) {
+        out.println("[BENCH] loop: fixture ports in use (FLEET_PORTS > 1) - loopback disabled");
+        return false;
+    }
+
+    TWI_HAL::Config cfg = hc;
+    cfg.dataPin = BENCH_LOOP_DATA_PIN;
+    cfg.sensePin = BENCH_LOOP_SENSE_PIN;
+    cfg.txBackend = TWI_HAL::TX_RMT;
+    cfg.rmtTxChannel = BENCH_LOOP_RMT_CHANNEL;
+    cfg.rxBackend = TWI_HAL::RX_EDGE_CAPTURE;
+
+    s_loopHal.enableDebug(false);
+    s_loopKfd.setDebug(false);
+    // Bit-bang TX would mask the front-panel port's receive interrupt
+    if (!s_loopHal.init(cfg) || s_loopHal.getTxBackend() != TWI_HAL::TX_RMT ||
+        !s_loopKfd.init(&s_loopHal, false)) {
+        out.printf("[BENCH] loop: loopback port (DATA=%d SENSE=%d, RMT %d) unavailable\n",
+                   BENCH_LOOP_DATA_PIN, BENCH_LOOP_SENSE_PIN, BENCH_LOOP_RMT_CHANNEL);
+        return false;
+    }
+    // The radio side listens on SENSE
+    s_loopHal.releaseSenseLine();
+    s_loopReady = true;
+    return true;
+}
+
+// Drive each front-panel line and watch it arrive on the loopback port
+static bool loopWired() {
+    bool ok = true;
+    s_hal->setDataLine(true);
+    delayMicroseconds(100);
+    ok = ok && !s_loopHal.readDataLine();
+    s_hal->setDataLine(false);
+    delayMicroseconds(100);
+    ok = ok && s_loopHal.readDataLine();
+
+    s_hal->setSenseLine(false);
+    delayMicroseconds(100);
+    ok = ok && !s_loopHal.readSenseLine();
+    s_hal->setSenseLine(true);
+    delayMicroseconds(100);
+    ok = ok && s_loopHal.readSenseLine();
+
+    s_hal->flushRx();
+    s_loopHal.flushRx();
+    return ok;
+}
+
+// Front panel transmits with its configured backend, the capture on the
+// loopback pins times every edge
+static void loopTxTiming(Print& out) {
+    LineCapture& cap = LineCapture::instance();
+    TWI_HAL::LineTiming lt = s_hal->getLineTiming();
+    float bitUs = 1000.0f / lt.txKilobaud;
+
+    uint8_t data[LINE_TEST_BYTES];
+    linePattern(data, sizeof(data));
+    if (!startCapture(BENCH_LOOP_DATA_PIN, BENCH_LOOP_SENSE_PIN, bitUs, out)) return;
+    bool sent = s_hal->sendBytesFast(data, sizeof(data));
+    delay((uint32_t)(bitUs * 20 / 1000) + 1);
+    cap.stop();
+    s_hal->flushRx();
+    s_loopHal.flushRx();
+    if (!sent) {
+        out.println("[BENCH] loop: TX did not complete - timing skipped");
+        return;
+    }
+
+    BitTiming bt = analyseCapture(cap, bitUs);
+    std::vector<LineCapture::DecodedByte> bytes;
+    cap.decode(&bytes);
+    set(M_TX_BYTE_ERRORS, (float)byteErrors(bytes, data, sizeof(data)));
+    if (bt.pulses < 8) {
+        out.println("[BENCH] loop: TX not seen on the loopback DATA pin");
+        return;
+    }
+    set(M_TX_BIT_ERROR, bt.errorPct);
+    set(M_TX_JITTER, (float)bt.jitterUs);
+    out.printf("[BENCH] loop: TX bit %+.2f%% of %.1f us, jitter %u us, %u byte errors (%u pulses)\n",
+               bt.errorPct, bitUs, bt.jitterUs, (unsigned)s_result[M_TX_BYTE_ERRORS].value, bt.pulses);
+}
+
+// Loopback port (RMT) transmits, the front panel decodes; the capture on
+// the front-panel pins shows the timing our decoder was given
+static void loopRx(Print& out) {
+    LineCapture& cap = LineCapture::instance();
+    TWI_HAL::LineTiming lt = s_hal->getLineTiming();
+    float bitUs = 1000.0f / lt.rxKilobaud;
+    TWI_HAL::Config hc = s_hal->getConfig();
+
+    uint8_t data[LINE_TEST_BYTES];
+    uint8_t got[LINE_TEST_BYTES + 16];
+    linePattern(data, sizeof(data));
+
+    if (!startCapture(hc.dataPin, hc.sensePin, bitUs, out)) return;
+    s_hal->flushRx();
+    TWI_HAL::RxStats before = s_hal->getRxStats();
+
+    uint64_t t0 = now();
+    if (!s_loopHal.sendBytesFast(data, sizeof(data))) {
+        cap.stop();
+        out.println("[BENCH] loop: loopback TX did not complete - RX skipped");
+        return;
+    }
+    // Last byte is decoded once its parity bit has passed
+    uint64_t deadline = now() + (uint64_t)(bitUs * 20);
+    while (s_hal->available() < sizeof(data) && now() < deadline) delayMicroseconds(50);
+    uint32_t rxUs = (uint32_t)(now() - t0);
+    size_t received = 0;
+    s_hal->receiveBytes(got, sizeof(got), &received, 0);
+    cap.stop();
+
+    TWI_HAL::RxStats after = s_hal->getRxStats();
+    uint32_t errors = received > sizeof(data) ? received - sizeof(data) : sizeof(data) - received;
+    for (size_t i = 0; i < received && i < sizeof(data); i++) {
+        if (got[i] != data[i]) errors++;
+    }
+    errors += (after.parityErrors - before.parityErrors) + (after.framingErrors - before.framingErrors) +
+              (after.overruns - before.overruns);
+    set(M_RX_BYTE_ERRORS, (float)errors);
+    set(M_RX_RATE, received * 1e6f / rxUs);
+
+    BitTiming bt = analyseCapture(cap, bitUs);
+    if (bt.pulses < 8) {
+        out.println("[BENCH] loop: loopback TX not seen on the front-panel DATA pin");
+        return;
+    }
+    set(M_RX_BIT_ERROR, bt.errorPct);
+    out.printf("[BENCH] loop: RX %u/%u bytes, %u errors, %.0f B/s, incoming bit %+.2f%% of %.1f us\n",
+               (unsigned)received, (unsigned)sizeof(data), errors, s_result[M_RX_RATE].value, bt.errorPct, bitUs);
+}
+
+// Full keyloads against the MR emulator on the loopback port
+static void loopKeyload(Print& out) {
+    auto keys = makeKeys(BENCH_LOOP_KEYS);
+    KFDProtocol::KeyloadPlan plan;
+    bool built = s_kfd->compilePlan(keys, plan);
+    wipeKeys(keys);
+    if (!built) {
+        out.println("[BENCH] loop: keyload plan build failed");
+        return;
+    }
+
+    auto started = s_loopKfd.startMrEmulator(nullptr);
+    if (!started.success) {
+        out.printf("[BENCH] loop: emulator: %s\n", started.message.c_str());
+        return;
+    }
+
+    const KFDProtocol::ConnectStats before = s_kfd->getConnectStats();
+    uint32_t failures = 0;
+    uint64_t total = 0;
+    uint32_t worst = 0;
+    for (int round = 0; round < BENCH_LOOP_ROUNDS; round++) {
+        uint64_t t0 = now();
+        auto result = s_kfd->keyloadPlan(plan);
+        uint32_t us = (uint32_t)(now() - t0);
+        total += us;
+        if (us > worst) worst = us;
+
+        bool ok = result.success && result.keyStatus.size() == plan.keyCount();
+        for (const auto& ks : result.keyStatus) {
+            if (ks.status != P25::STATUS_COMMAND_PERFORMED) ok = false;
+        }
+        if (!ok) {
+            failures++;
+            out.printf("[BENCH] loop: round %d failed: %s\n", round + 1, result.message.c_str());
+        }
+    }
+    plan.clear();
+
+    // The emulator counts a key once the frame has been acked
+    const uint32_t expected = (uint32_t)BENCH_LOOP_ROUNDS * BENCH_LOOP_KEYS;
+    uint32_t start = millis();
+    while (s_loopKfd.getMrEmulatorStats().keysLoaded < expected && millis() - start < 500) delay(10);
+    s_loopKfd.stopMrEmulator();
+    s_loopHal.releaseSenseLine();
+
+    const KFDProtocol::MrEmulatorStats st = s_loopKfd.getMrEmulatorStats();
+    if (st.keysLoaded < expected) failures += expected - st.keysLoaded;
+    failures += st.crcErrors;
+
+    const KFDProtocol::ConnectStats& after = s_kfd->getConnectStats();
+    uint32_t sessions = after.sessions - before.sessions;
+    if (sessions) set(M_LOOP_CONNECT, (after.totalConnectUs - before.totalConnectUs) / sessions / 1000.0f);
+    set(M_LOOP_KEYLOAD, total / BENCH_LOOP_ROUNDS / 1000.0f);
+    set(M_LOOP_KEYLOAD_MAX, worst / 1000.0f);
+    set(M_LOOP_FAILURES, (float)failures);
+
+    out.printf("[BENCH] loop: %d x %d keys: avg %.1f ms, max %.1f ms, connect %.1f ms, "
+               "radio got %u keys, %u CRC errors, %u failures\n",
+               BENCH_LOOP_ROUNDS, BENCH_LOOP_KEYS, s_result[M_LOOP_KEYLOAD].value,
+               s_result[M_LOOP_KEYLOAD_MAX].value, s_result[M_LOOP_CONNECT].value,
+               st.keysLoaded, st.crcErrors, failures);
+}
+
+static void loopRun(Print& out) {
+    if (!loopAttach(out)) return;
+    if (!loopWired()) {
+        out.printf("[BENCH] loop: no loopback - wire DATA to GPIO%d and SENSE to GPIO%d\n",
+                   BENCH_LOOP_DATA_PIN, BENCH_LOOP_SENSE_PIN);
+        return;
+    }
+
+    // The radio side mirrors our speeds
+    TWI_HAL::LineTiming lt = s_hal->getLineTiming();
+    TWI_HAL::LineTiming mirror = lt;
+    mirror.txKilobaud = lt.rxKilobaud;
+    mirror.rxKilobaud = lt.txKilobaud;
+    s_loopHal.setLineTiming(mirror);
+
+    loopTxTiming(out);
+    loopRx(out);
+
+    // The loopback port decodes in a GPIO interrupt on this core and
+    // bit-bang TX masks interrupts per byte - round trips run on RMT, as
+    // the fleet loader does with fixture ports on the line
+    TWI_HAL::TxBackend txWas = s_hal->getTxBackend();
+    if (txWas != TWI_HAL::TX_RMT && !s_hal->setTxBackend(TWI_HAL::TX_RMT)) {
+        out.println("[BENCH] loop: RMT TX unavailable - keyload round trips skipped");
+        return;
+    }
+    loopKeyload(out);
+    if (txWas != TWI_HAL::TX_RMT) s_hal->setTxBackend(txWas);
+}
+
+static void benchLoop(Print& out) {
+    // The keyloads nest inside this claim; line tests use the HAL directly
+    if (!s_hal || !s_kfd || !s_kfd->beginOperation()) {
+        out.println("[BENCH] loop: port busy - skipped");
+        return;
+    }
+    loopRun(out);
+    s_kfd->endOperation();
+}
+
+// =============================================================================
+// Suite
+// =============================================================================
+
+void init(TWI_HAL* hal, KFDProtocol* kfd) {
+    s_hal = hal;
+    s_kfd = kfd;
+}
+
+uint32_t parseTests(const String& name) {
+    if (name.length() == 0 || name == "all") return T_ALL;
+    if (name == "crc") return T_CRC;
+    if (name == "frame") return T_FRAME;
+    if (name == "crypto") return T_CRYPTO;
+    if (name == "lvgl") return T_LVGL;
+    if (name == "tx") return T_TX;
+    if (name == "loop") return T_LOOP;
+    return 0;
+}
+
+bool run(uint32_t tests, Print& out) {
+    loadBaseline();
+    memset(s_result, 0, sizeof(s_result));
+
+    out.println("\n[BENCH] === Benchmark suite ===");
+    uint32_t t0 = millis();
+    if (tests & T_CRC) benchCrc(out);
+    if (tests & T_FRAME) benchFrame(out);
+    if (tests & T_CRYPTO) benchCrypto(out);
+    if (tests & T_LVGL) benchLvgl(out);
+    if (tests & T_TX) benchTx(out);
+    if (tests & T_LOOP) benchLoop(out);
+
+    print(out);
+
+    uint32_t regressed = 0, overLimit = 0;
+    for (uint8_t m = 0; m < METRIC_COUNT; m++) {
+        Verdict v = verdict(m);
+        if (v == V_REGRESSED) regressed++;
+        else if (v == V_OVER_LIMIT) overLimit++;
+    }
+    bool pass = !regressed && !overLimit;
+    out.printf("[BENCH] RESULT: %s - %u over limit, %u regressed (%u ms)\n",
+               pass ? "PASS" : "FAIL", overLimit, regressed, (unsigned)(millis() - t0));
+    return pass;
+}
+
+void print(Print& out) {
+    loadBaseline();
+    out.printf("\n[BENCH] Metric                 value       baseline  verdict (tolerance %u%%)\n",
+               (unsigned)BENCH_REGRESSION_PCT);
+    for (uint8_t m = 0; m < METRIC_COUNT; m++) {
+        if (!s_result[m].valid) continue;
+        const MetricDef& d = METRICS[m];
+        out.printf("  %-17s %10.2f %-4s", d.name, s_result[m].value, d.unit);
+        if (d.kind == LIMIT) out.printf("  limit %6.2f", d.slack);
+        else if (s_baseline[m].valid) out.printf("  %12.2f", s_baseline[m].value);
+        else out.print("             -");
+        out.printf("  %s\n", verdictName(verdict(m)));
+    }
+}
+
+size_t exportCsv(Print& out) {
+    loadBaseline();
+    size_t rows = 0;
+    out.println("name,unit,value,baseline,verdict");
+    for (uint8_t m = 0; m < METRIC_COUNT; m++) {
+        if (!s_result[m].valid) continue;
+        out.printf("%s,%s,%.3f,", METRICS[m].name, METRICS[m].unit, s_result[m].value);
+        if (s_baseline[m].valid) out.printf("%.3f", s_baseline[m].value);
+        out.printf(",%s\n", verdictName(verdict(m)));
+        rows++;
+    }
+    return rows;
+}
+
+bool saveBaseline() {
+    loadBaseline();
+    size_t saved = 0;
+    for (uint8_t m = 0; m < METRIC_COUNT; m++) {
+        if (s_result[m].valid) {
+            s_baseline[m] = s_result[m];
+            saved++;
+        }
+    }
+    if (!saved) {
+        Console.println("[BENCH] Nothing measured yet - run 'bench' first");
+        return false;
+    }
+
+    JsonDocument doc;
+    for (uint8_t m = 0; m < METRIC_COUNT; m++) {
+        if (s_baseline[m].valid) doc[METRICS[m].name] = s_baseline[m].value;
+    }
+    File f = LittleFS.open(BASELINE_FILE, "w");
+    if (!f) {
+        Console.printf("[BENCH] Cannot write %s\n", BASELINE_FILE);
+        return false;
+    }
+    serializeJson(doc, f);
+    f.close();
+    Console.printf("[BENCH] Baseline updated: %u metrics\n", (unsigned)saved);
+    return true;
+}
+
+const char* metricName(Metric metric) {
+    return metric < METRIC_COUNT ? METRICS[metric].name : "?";
+}
+
+} // namespace Bench
@@ -0,0 +1,31 @@
+/**
+ * @file console.cpp
+ * @brief Text console sink implementation
+ */
+
+#include "console.h"
+#include <esp_log.h>
+
+ConsoleSink Console;
+
+size_t ConsoleSink::write(uint8_t c) {
+    if (_muted) return 1;
+    return Serial.write(c);
+}
+
+size_t ConsoleSink::write(const uint8_t* buffer, size_t size) {
+    if (_muted) return size;
+    return Serial.write(buffer, size);
+}
+
+void ConsoleSink::flush() {
+    if (!_muted) Serial.flush();
+}
+
+void ConsoleSink::setMuted(bool muted) {
+    if (muted == _muted) return;
+    if (muted) Serial.flush();   // Let text already queued leave before the first frame
+    _muted = muted;
+    // IDF components log straight to the same port
+    esp_log_level_set("*", muted ? ESP_LOG_NONE : (esp_log_level_t)CONFIG_LOG_DEFAULT_LEVEL);
+}
@@ -4,10 +4,14 @@
  */
 
 #include "container.h"
+#include "console.h"
 #include "crypto.h"
+#include "device_info.h"
+#include "sd_card.h"
 #include <Arduino.h>
 #include <LittleFS.h>
 #include <ArduinoJson.h>
+#include <algorithm>
 
 P25::KeyItem KeySlot::toKeyItem(uint16_t keysetId) const {
     P25::KeyItem item;
@@ -17,21 +21,40 @@ P25::KeyItem KeySlot::toKeyItem(uint16_t keysetId) const {
     item.algorithmId = algorithmId;
     item.isKek = P25::getKeyType(sln) == P25::KEY_TYPE_KEK;
     item.erase = false;
-    int len = Crypto::hexToBytes(keyHex, nullptr, 0);
-    if (len > 0) { item.key.resize(len); Crypto::hexToBytes(keyHex, item.key.data(), len); }
+    item.key.assign(key, key + keyLen);
     return item;
 }
 
+KeySlot::~KeySlot() { Crypto::secureZero(key, sizeof(key)); }
+
 bool KeySlot::isValid() const {
     size_t expected = P25::getKeyLength(algorithmId);
-    return expected == 0 || keyHex.length() == expected * 2;
+    return expected == 0 || keyLen == expected;
 }
 
-size_t KeySlot::getKeyLength() const { return keyHex.length() / 2; }
+std::string KeySlot::keyHex() const { return Crypto::bytesToHex(key, keyLen); }
 
-std::vector<KeySlot> KeyGroup::getSelectedKeys() const {
-    std::vector<KeySlot> sel;
-    for (const auto& k : keys) if (k.selected) sel.push_back(k);
+bool KeySlot::setKeyHex(const std::string& hex) {
+    if (hex.length() % 2 || hex.length() / 2 > sizeof(key)) return false;
+    for (char ch : hex) if (!isxdigit((unsigned char)ch)) return false;
+    clearKey();
+    keyLen = Crypto::hexToBytes(hex, key, sizeof(key));
+    return true;
+}
+
+bool KeySlot::setKey(const uint8_t* data, size_t len) {
+    if (len > sizeof(key)) return false;
+    clearKey();
+    memcpy(key, data, len);
+    keyLen = len;
+    return true;
+}
+
+void KeySlot::clearKey() { Crypto::secureZero(key, sizeof(key)); keyLen = 0; }
+
+std::vector<uint16_t> KeyGroup::getSelectedKeys() const {
+    std::vector<uint16_t> sel;
+    for (size_t i = 0; i < keys.size(); i++) if (keys[i].selected) sel.push_back(i);
     return sel;
 }
 
@@ -40,118 +63,826 @@ size_t KeyGroup::selectedCount() const {
     return c;
 }
 
-std::vector<KeySlot> Container::getAllKeys() const {
-    std::vector<KeySlot> all;
-    for (const auto& g : groups) for (const auto& k : g.keys) all.push_back(k);
+std::vector<KeyRef> Container::getAllKeys() const {
+    std::vector<KeyRef> all;
+    for (size_t g = 0; g < groups.size(); g++)
+        for (size_t k = 0; k < groups[g].keys.size(); k++) all.push_back({(uint16_t)g, (uint16_t)k});
     return all;
 }
 
-std::vector<KeySlot> Container::getSelectedKeys() const {
-    std::vector<KeySlot> sel;
-    for (const auto& g : groups) for (const auto& k : g.keys) if (k.selected) sel.push_back(k);
+std::vector<KeyRef> Container::getSelectedKeys() const {
+    std::vector<KeyRef> sel;
+    for (size_t g = 0; g < groups.size(); g++)
+        for (size_t k = 0; k < groups[g].keys.size(); k++)
+            if (groups[g].keys[k].selected) sel.push_back({(uint16_t)g, (uint16_t)k});
     return sel;
 }
 
-size_t Container::totalKeyCount() const {
-    size_t c = 0; for (const auto& g : groups) c += g.keys.size();
-    return c;
+std::vector<P25::KeyItem> Container::getSelectedKeyItems() const {
+    std::vector<P25::KeyItem> items;
+    for (const auto& g : groups) for (const auto& k : g.keys) if (k.selected) items.push_back(k.toKeyItem(g.keysetId));
+    return items;
 }
 
-size_t Container::selectedKeyCount() const {
-    size_t c = 0; for (const auto& g : groups) c += g.selectedCount();
-    return c;
+static bool indexBefore(const KeyIndexEntry& e, uint32_t key) {
+    return (((uint32_t)e.keysetId << 16) | e.sln) < key;
+}
+
+static bool indexAfter(uint32_t key, const KeyIndexEntry& e) {
+    return key < (((uint32_t)e.keysetId << 16) | e.sln);
+}
+
+static uint32_t indexKey(uint16_t keysetId, uint16_t sln) {
+    return ((uint32_t)keysetId << 16) | sln;
+}
+
+void Container::reindex() {
+    keyIndex.clear();
+    keyCount = 0; selectedCount = 0; duplicateSlns = 0;
+    for (size_t g = 0; g < groups.size(); g++) {
+        for (size_t k = 0; k < groups[g].keys.size(); k++) {
+            const KeySlot& ks = groups[g].keys[k];
+            keyIndex.push_back({groups[g].keysetId, ks.sln, {(uint16_t)g, (uint16_t)k}});
+            if (ks.selected) selectedCount++;
+        }
+    }
+    keyCount = keyIndex.size();
+    std::stable_sort(keyIndex.begin(), keyIndex.end(), [](const KeyIndexEntry& a, const KeyIndexEntry& b) {
+        return indexKey(a.keysetId, a.sln) < indexKey(b.keysetId, b.sln);
+    });
+    for (size_t i = 1; i < keyIndex.size(); i++) {
+        if (keyIndex[i].keysetId == keyIndex[i - 1].keysetId && keyIndex[i].sln == keyIndex[i - 1].sln) duplicateSlns++;
+    }
+}
+
+void Container::indexInsert(const KeyRef& ref) {
+    const KeySlot& ks = groups[ref.group].keys[ref.key];
+    uint32_t key = indexKey(groups[ref.group].keysetId, ks.sln);
+    auto at = std::upper_bound(keyIndex.begin(), keyIndex.end(), key, indexAfter);
+    if (at != keyIndex.begin() && indexKey((at - 1)->keysetId, (at - 1)->sln) == key) duplicateSlns++;
+    keyIndex.insert(at, {groups[ref.group].keysetId, ks.sln, ref});
+    keyCount++;
+    if (ks.selected) selectedCount++;
+}
+
+void Container::indexErase(const KeyRef& ref) {
+    for (auto it = keyIndex.begin(); it != keyIndex.end(); ++it) {
+        if (it->ref.group != ref.group || it->ref.key != ref.key) continue;
+        uint32_t key = indexKey(it->keysetId, it->sln);
+        keyIndex.erase(it);
+        if (countKeys(key >> 16, key & 0xFFFF) > 0 && duplicateSlns) duplicateSlns--;
+        keyCount--;
+        if (groups[ref.group].keys[ref.key].selected && selectedCount) selectedCount--;
+        return;
+    }
+}
+
+const KeySlot* Container::findKey(uint16_t keysetId, uint16_t sln, KeyRef* ref) const {
+    uint32_t key = indexKey(keysetId, sln);
+    auto it = std::lower_bound(keyIndex.begin(), keyIndex.end(), key, indexBefore);
+    if (it == keyIndex.end() || indexKey(it->keysetId, it->sln) != key) return nullptr;
+    if (ref) *ref = it->ref;
+    return &groups[it->ref.group].keys[it->ref.key];
+}
+
+size_t Container::countKeys(uint16_t keysetId, uint16_t sln) const {
+    uint32_t key = indexKey(keysetId, sln);
+    auto lo = std::lower_bound(keyIndex.begin(), keyIndex.end(), key, indexBefore);
+    auto hi = std::upper_bound(lo, keyIndex.end(), key, indexAfter);
+    return hi - lo;
+}
+
+uint16_t Container::nextFreeSln(uint16_t keysetId) const {
+    // SLN 0 is reserved; entries of one keyset are contiguous and ascending
+    uint32_t first = indexKey(keysetId, 1);
+    uint16_t sln = 1;
+    for (auto it = std::lower_bound(keyIndex.begin(), keyIndex.end(), first, indexBefore);
+         it != keyIndex.end() && it->keysetId == keysetId && it->sln <= sln; ++it) {
+        if (it->sln == sln) { if (sln == 0xFFFF) break; sln++; }
+    }
+    return sln;
 }
 
 void Container::touch() { char buf[32]; snprintf(buf, sizeof(buf), "%lu", millis()/1000); modifiedDate = buf; }
 
+// Sealed file: magic (4), version, 3 reserved | IV (12) | AES-256-GCM ciphertext | tag (16)
+// The header and the file's path are authenticated as AAD, so records cannot
+// be swapped between files.
+static const char* STORE_DIR = "/cont";
+static const char* INDEX_FILE = "/cont/index.bin";
+static const char* LEGACY_ENC_FILE = "/containers.enc";       // Single JSON store, previous firmware
+static const char* LEGACY_CONTAINER_FILE = "/containers.json"; // Plaintext, older firmware
+static const uint8_t STORE_MAGIC[4] = {'K', 'F', 'D', 'E'};
+static const uint8_t STORE_VERSION = 1;
+static const uint8_t RECORD_VERSION = 1;
+static const uint8_t INDEX_VERSION = 2;      // 1: IDs only, 2: with summaries
+static const size_t STORE_HEADER_SIZE = 8;
+static const size_t STORE_CHUNK = 1024;
+static const size_t STORE_MAX_PATH = 32;
+
+// Resident key budget (a KeySlot is ~100 bytes; vectors above 4 KB are
+// placed in PSRAM by the allocator), and the internal heap floor below
+// which the least recently used container is dropped regardless
+static const size_t RESIDENT_KEYS_PSRAM = 20000;
+static const size_t RESIDENT_KEYS_INTERNAL = 1000;
+static const size_t LOW_INTERNAL_HEAP = 48 * 1024;
+
+static void wipeString(std::string& s) {
+    if (!s.empty()) Crypto::secureZero(&s[0], s.size());
+    s.clear();
+}
+
+static void recordPath(uint32_t id, char* path, size_t len) {
+    snprintf(path, len, "%s/%08lx.bin", STORE_DIR, (unsigned long)id);
+}
+
+// =============================================================================
+// Binary record codec
+// =============================================================================
+// Little-endian integers, strings as u16 length + bytes, keys as raw bytes.
+
+class RecordWriter {
+public:
+    explicit RecordWriter(std::string& out) : _out(out) {}
+    void u8(uint8_t v) { _out.push_back((char)v); }
+    void u16(uint16_t v) { u8(v & 0xFF); u8(v >> 8); }
+    void u32(uint32_t v) { u16(v & 0xFFFF); u16(v >> 16); }
+    void bytes(const uint8_t* p, size_t n) { _out.append((const char*)p, n); }
+    void str(const std::string& s) {
+        size_t n = std::min(s.size(), (size_t)0xFFFF);
+        u16(n); _out.append(s.data(), n);
+    }
+private:
+    std::string& _out;
+};
+
+class RecordReader {
+public:
+    RecordReader(const std::string& in) : _p((const uint8_t*)in.data()), _end(_p + in.size()), _ok(true) {}
+    bool ok() const { return _ok; }
+    bool atEnd() const { return _p == _end; }
+    uint8_t u8() { return need(1) ? *_p++ : 0; }
+    uint16_t u16() { uint16_t lo = u8(); return lo | (uint16_t)(u8() << 8); }
+    uint32_t u32() { uint32_t lo = u16(); return lo | ((uint32_t)u16() << 16); }
+    const uint8_t* bytes(size_t n) { const uint8_t* p = _p; if (!need(n)) return nullptr; _p += n; return p; }
+    std::string str() {
+        size_t n = u16();
+        const uint8_t* p = bytes(n);
+        return p ? std::string((const char*)p, n) : std::string();
+    }
+private:
+    bool need(size_t n) { if (_ok && (size_t)(_end - _p) >= n) return true; _ok = false; return false; }
+    const uint8_t* _p;
+    const uint8_t* _end;
+    bool _ok;
+};
+
+static void encodeContainer(const Container& c, std::string& out) {
+    RecordWriter w(out);
+    w.u8(RECORD_VERSION);
+    w.str(c.name); w.str(c.description); w.str(c.agency); w.str(c.system);
+    w.str(c.createdDate); w.str(c.modifiedDate); w.str(c.passwordHash);
+    w.u8((c.isLocked ? 0x01 : 0) | (c.isEncrypted ? 0x02 : 0));
+    w.u16(c.groups.size());
+    for (const auto& g : c.groups) {
+        w.str(g.name); w.str(g.description);
+        w.u16(g.keysetId);
+        w.u8((g.useActiveKeyset ? 0x01 : 0) | (g.expanded ? 0x02 : 0));
+        w.u16(g.keys.size());
+        for (const auto& k : g.keys) {
+            w.str(k.name); w.str(k.description);
+            w.u8(k.algorithmId); w.u16(k.keyId); w.u16(k.sln);
+            w.u8(k.selected ? 0x01 : 0);
+            w.u8(k.keyLen); w.bytes(k.key, k.keyLen);
+        }
+    }
+}
+
+static bool decodeContainer(const std::string& in, Container& c) {
+    RecordReader r(in);
+    if (r.u8() != RECORD_VERSION) return false;
+    c.name = r.str(); c.description = r.str(); c.agency = r.str(); c.system = r.str();
+    c.createdDate = r.str(); c.modifiedDate = r.str(); c.passwordHash = r.str();
+    uint8_t flags = r.u8();
+    c.isLocked = flags & 0x01; c.isEncrypted = flags & 0x02;
+    c.groups.clear();
+    uint16_t groupCount = r.u16();
+    for (uint16_t gi = 0; gi < groupCount && r.ok(); gi++) {
+        KeyGroup g;
+        g.name = r.str(); g.description = r.str();
+        g.keysetId = r.u16();
+        flags = r.u8();
+        g.useActiveKeyset = flags & 0x01; g.expanded = flags & 0x02;
+        uint16_t keyCount = r.u16();
+        for (uint16_t ki = 0; ki < keyCount && r.ok(); ki++) {
+            KeySlot k;
+            k.name = r.str(); k.description = r.str();
+            k.algorithmId = r.u8(); k.keyId = r.u16(); k.sln = r.u16();
+            k.selected = r.u8() & 0x01;
+            uint8_t len = r.u8();
+            const uint8_t* key = r.bytes(len);
+            if (key && !k.setKey(key, len)) {
+                Console.printf("[CONT] Key \"%s\" dropped: %u bytes\n", k.name.c_str(), len);
+            }
+            g.keys.push_back(k);
+        }
+        c.groups.push_back(g);
+    }
+    c.reindex();
+    return r.ok() && r.atEnd();
+}
+
+// =============================================================================
+// Container Manager
+// =============================================================================
+
 ContainerManager& ContainerManager::instance() { static ContainerManager inst; return inst; }
 
-ContainerManager::ContainerManager() : _activeIndex(-1), _storageReady(false), _dirty(false), _lastChangeMs(0), _lastSaveMs(0) {}
+ContainerManager::ContainerManager()
+    : _activeIndex(-1), _generation(0), _storageReady(false), _unlocked(false), _dirty(false), _indexDirty(false),
+      _nextStoreId(1), _lastChangeMs(0), _lastSaveMs(0),
+      _jobQueued(false), _jobPending(false), _jobOk(false), _writerTask(nullptr), _useTick(0) {}
 
 bool ContainerManager::init() {
     if (!LittleFS.begin(true)) return false;
+    if (!LittleFS.exists(STORE_DIR)) LittleFS.mkdir(STORE_DIR);
     _storageReady = true;
+    if (!startWriter()) Console.println("[CONT] Writer task failed, saving from loop");
+    return true;
+}
+
+bool ContainerManager::startWriter(BaseType_t core) {
+    if (_writerTask) return true;
+    // Below the KFD worker, and autosave only runs while the link is idle
+    if (xTaskCreatePinnedToCore(writerTask, "cont_save", 6144, this, 1,
+                                &_writerTask, core) != pdPASS) {
+        _writerTask = nullptr;
+        return false;
+    }
     return true;
 }
 
-const Container& ContainerManager::getContainer(size_t idx) const {
+void ContainerManager::writerTask(void* arg) {
+    static_cast<ContainerManager*>(arg)->writerLoop();
+}
+
+void ContainerManager::writerLoop() {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!_jobPending) continue;
+        if (linkBusy()) {
+            // A session opened after the job was queued: hand it back unwritten,
+            // finishSaveJob() re-marks it like a failed write
+            for (auto& rec : _job.records) wipeString(rec.second);
+            _jobOk = false;
+        } else {
+            _jobOk = writeSaveJob(_job);
+        }
+        _jobPending = false;
+    }
+}
+
+void ContainerManager::markChanged(size_t idx) {
+    if (idx < _containers.size()) _containers[idx].storeDirty = true;
+    _dirty = true; _lastChangeMs = millis();
+    _generation++;
+}
+
+const Container& ContainerManager::getSummary(size_t idx) const {
     static Container empty; return idx < _containers.size() ? _containers[idx] : empty;
 }
 
+const Container& ContainerManager::getContainer(size_t idx) {
+    static Container empty;
+    if (idx >= _containers.size()) return empty;
+    pageIn(idx);
+    return _containers[idx];
+}
+
 Container& ContainerManager::getMutableContainer(size_t idx) {
-    static Container empty; return idx < _containers.size() ? _containers[idx] : empty;
+    static Container empty;
+    if (idx >= _containers.size()) return empty;
+    pageIn(idx);
+    return _containers[idx];
+}
+
+size_t ContainerManager::residentKeyCount() const {
+    size_t n = 0;
+    for (const auto& c : _containers) if (c.resident) n += c.totalKeyCount();
+    return n;
+}
+
+bool ContainerManager::pageIn(size_t idx) {
+    Container& slot = _containers[idx];
+    slot.lastUsed = ++_useTick;
+    if (slot.resident) return true;
+    
+    char path[STORE_MAX_PATH];
+    recordPath(slot.storeId, path, sizeof(path));
+    std::string record;
+    Container c;
+    bool ok = loadAndDecrypt(path, record) && decodeContainer(record, c);
+    wipeString(record);
+    if (!ok) {
+        Console.printf("[CONT] Record %s unreadable\n", path);
+        return false;
+    }
+    c.storeId = slot.storeId; c.storeDirty = false; c.lastUsed = slot.lastUsed;
+    slot = std::move(c);
+    return true;
+}
+
+void ContainerManager::evictIfNeeded() {
+    // A queued snapshot may not be on flash yet - paging it back in would read the old record
+    if (_jobQueued) return;
+    size_t budget = psramFound() ? RESIDENT_KEYS_PSRAM : RESIDENT_KEYS_INTERNAL;
+    size_t resident = residentKeyCount();
+    bool lowHeap = heap_caps_get_free_size(MALLOC_CAP_INTERNAL) < LOW_INTERNAL_HEAP;
+    while (resident > budget || lowHeap) {
+        // Least recently used clean container; the active one stays
+        int victim = -1;
+        for (size_t i = 0; i < _containers.size(); i++) {
+            const Container& c = _containers[i];
+            if (!c.resident || c.storeDirty || !c.storeId || (int)i == _activeIndex) continue;
+            if (victim < 0 || c.lastUsed < _containers[victim].lastUsed) victim = i;
+        }
+        if (victim < 0) break;
+        
+        Container& c = _containers[victim];
+        std::vector<KeyGroup>().swap(c.groups);   // KeySlot destructors wipe the keys
+        std::vector<KeyIndexEntry>().swap(c.keyIndex);
+        c.resident = false;                       // Counts stay for the summary
+        resident -= std::min(resident, (size_t)c.keyCount);
+        lowHeap = false;
+    }
 }
 
 int ContainerManager::addContainer(const Container& c) {
-    _containers.push_back(c); _dirty = true; _lastChangeMs = millis();
+    _containers.push_back(c);
+    _containers.back().storeId = 0;     // Copies get their own record
+    _containers.back().reindex();
+    _indexDirty = true;
+    markChanged(_containers.size() - 1);
     return _containers.size() - 1;
 }
 
 bool ContainerManager::updateContainer(size_t idx, const Container& c) {
     if (idx >= _containers.size()) return false;
-    _containers[idx] = c; _containers[idx].touch(); _dirty = true; _lastChangeMs = millis();
+    uint32_t id = _containers[idx].storeId;
+    _containers[idx] = c; _containers[idx].storeId = id; _containers[idx].touch();
+    _containers[idx].reindex();
+    markChanged(idx);
     return true;
 }
 
 bool ContainerManager::deleteContainer(size_t idx) {
     if (idx >= _containers.size()) return false;
+    if (_containers[idx].storeId) _removedIds.push_back(_containers[idx].storeId);
     _containers.erase(_containers.begin() + idx);
     if (_activeIndex == (int)idx) _activeIndex = -1;
     else if (_activeIndex > (int)idx) _activeIndex--;
-    _dirty = true; _lastChangeMs = millis();
+    _indexDirty = true;
+    markChanged(_containers.size());
     return true;
 }
 
 bool ContainerManager::setActiveIndex(int idx) {
     if (idx < -1 || idx >= (int)_containers.size()) return false;
+    if (idx >= 0 && !pageIn(idx)) return false;
     _activeIndex = idx;
     return true;
 }
 
-const Container* ContainerManager::getActiveContainer() const {
-    return (_activeIndex >= 0 && _activeIndex < (int)_containers.size()) ? &_containers[_activeIndex] : nullptr;
+const Container* ContainerManager::getActiveContainer() {
+    return getActiveContainerMutable();
 }
 
 Container* ContainerManager::getActiveContainerMutable() {
-    return (_activeIndex >= 0 && _activeIndex < (int)_containers.size()) ? &_containers[_activeIndex] : nullptr;
+    if (_activeIndex < 0 || _activeIndex >= (int)_containers.size()) return nullptr;
+    pageIn(_activeIndex);
+    return &_containers[_activeIndex];
 }
 
 bool ContainerManager::addGroup(size_t ci, const KeyGroup& g) {
     if (ci >= _containers.size()) return false;
-    _containers[ci].groups.push_back(g); _containers[ci].touch(); _dirty = true; _lastChangeMs = millis();
+    _containers[ci].groups.push_back(g); _containers[ci].reindex(); _containers[ci].touch(); markChanged(ci);
+    return true;
+}
+
+bool ContainerManager::updateGroup(size_t ci, size_t gi, const KeyGroup& g) {
+    if (ci >= _containers.size() || gi >= _containers[ci].groups.size()) return false;
+    _containers[ci].groups[gi] = g; _containers[ci].reindex(); _containers[ci].touch(); markChanged(ci);
+    return true;
+}
+
+bool ContainerManager::deleteGroup(size_t ci, size_t gi) {
+    if (ci >= _containers.size() || gi >= _containers[ci].groups.size()) return false;
+    Container& c = _containers[ci];
+    c.groups.erase(c.groups.begin() + gi); c.reindex(); c.touch(); markChanged(ci);
     return true;
 }
 
 bool ContainerManager::addKey(size_t ci, size_t gi, const KeySlot& k) {
     if (ci >= _containers.size() || gi >= _containers[ci].groups.size()) return false;
-    _containers[ci].groups[gi].keys.push_back(k); _containers[ci].touch(); _dirty = true; _lastChangeMs = millis();
+    Container& c = _containers[ci];
+    c.groups[gi].keys.push_back(k);
+    c.indexInsert({(uint16_t)gi, (uint16_t)(c.groups[gi].keys.size() - 1)});
+    c.touch(); markChanged(ci);
+    return true;
+}
+
+bool ContainerManager::updateKey(size_t ci, size_t gi, size_t ki, const KeySlot& k) {
+    if (ci >= _containers.size() || gi >= _containers[ci].groups.size() ||
+        ki >= _containers[ci].groups[gi].keys.size()) return false;
+    Container& c = _containers[ci];
+    KeyRef ref = {(uint16_t)gi, (uint16_t)ki};
+    c.indexErase(ref);
+    c.groups[gi].keys[ki] = k;
+    c.indexInsert(ref);
+    c.touch(); markChanged(ci);
+    return true;
+}
+
+bool ContainerManager::deleteKey(size_t ci, size_t gi, size_t ki) {
+    if (ci >= _containers.size() || gi >= _containers[ci].groups.size() ||
+        ki >= _containers[ci].groups[gi].keys.size()) return false;
+    Container& c = _containers[ci];
+    c.groups[gi].keys.erase(c.groups[gi].keys.begin() + ki);
+    c.reindex();    // Later positions in the group shift
+    c.touch(); markChanged(ci);
+    return true;
+}
+
+bool ContainerManager::setKeySelected(size_t ci, size_t gi, size_t ki, bool selected) {
+    if (ci >= _containers.size() || gi >= _containers[ci].groups.size() ||
+        ki >= _containers[ci].groups[gi].keys.size()) return false;
+    Container& c = _containers[ci];
+    KeySlot& k = c.groups[gi].keys[ki];
+    if (k.selected == selected) return true;
+    k.selected = selected;
+    if (selected) c.selectedCount++;
+    else if (c.selectedCount) c.selectedCount--;
+    markChanged(ci);
     return true;
 }
 
 bool ContainerManager::load() {
     if (!_storageReady && !init()) return false;
-    File f = LittleFS.open("/containers.json", "r");
-    if (!f) return false;
-    String json = f.readString(); f.close();
-    return deserializeContainers(json.c_str());
+    if (!_unlocked) return false;
+    if (LittleFS.exists(INDEX_FILE)) return loadRecords();
+    return migrateLegacy();
 }
 
-bool ContainerManager::save() { _dirty = true; _lastChangeMs = millis(); return true; }
+bool ContainerManager::loadRecords() {
+    // Index: version, next ID, count, then per container in display order
+    // the record ID and (version 2) name, modified date and key counts.
+    // Records themselves are paged in on first access.
+    std::string index;
+    if (!loadAndDecrypt(INDEX_FILE, index)) return false;
+    RecordReader r(index);
+    uint8_t version = r.u8();
+    if (version != 1 && version != INDEX_VERSION) return false;
+    uint32_t nextId = r.u32();
+    uint16_t count = r.u16();
+    std::vector<Container> loaded(count);
+    std::vector<uint32_t> ids;
+    for (uint16_t i = 0; i < count && r.ok(); i++) {
+        Container& c = loaded[i];
+        c.storeId = r.u32();
+        c.storeDirty = false;
+        c.resident = false;
+        if (version == INDEX_VERSION) {
+            c.name = r.str();
+            c.modifiedDate = r.str();
+            c.keyCount = r.u16();
+            c.selectedCount = r.u16();
+        }
+        ids.push_back(c.storeId);
+    }
+    wipeString(index);
+    if (!r.ok()) return false;
+    
+    _containers.swap(loaded);
+    _generation++;
+    _nextStoreId = nextId;
+    _indexDirty = false; _dirty = false;
+    if (version == 1) {
+        // No summaries yet - read every record once and rewrite the index
+        for (size_t i = 0; i < _containers.size(); i++) {
+            if (!pageIn(i)) { _containers.clear(); return false; }
+        }
+        _indexDirty = true; _dirty = true;
+    }
+    removeOrphans(ids);
+    return true;
+}
+
+bool ContainerManager::migrateLegacy() {
+    std::string json;
+    bool ok;
+    if (LittleFS.exists(LEGACY_ENC_FILE)) {
+        ok = loadAndDecrypt(LEGACY_ENC_FILE, json) && deserializeContainers(json);
+    } else {
+        File f = LittleFS.open(LEGACY_CONTAINER_FILE, "r");
+        if (!f) return false;
+        json.resize(f.size());
+        size_t n = json.empty() ? 0 : f.read((uint8_t*)&json[0], json.size());
+        f.close();
+        json.resize(n);
+        ok = deserializeContainers(json);
+    }
+    wipeString(json);
+    if (!ok) return false;
+
+    _indexDirty = true; _dirty = true;
+    if (saveNow()) {
+        LittleFS.remove(LEGACY_ENC_FILE);
+        LittleFS.remove(LEGACY_CONTAINER_FILE);
+        Console.printf("[CONT] Migrated %u containers to record storage\n", (unsigned)_containers.size());
+    }
+    return true;
+}
+
+bool ContainerManager::save() {
+    // UI edits go through getActiveContainerMutable(); without one, rewrite everything
+    if (_activeIndex >= 0) {
+        _containers[_activeIndex].reindex();    // Edited in place
+        markChanged(_activeIndex);
+    } else {
+        for (auto& c : _containers) c.storeDirty = true;
+        markChanged(_containers.size());
+    }
+    return true;
+}
 
 bool ContainerManager::saveNow() {
-    if (!_storageReady) return false;
-    std::string json = serializeContainers();
-    File f = LittleFS.open("/containers.json", "w");
+    if (!_storageReady || !_unlocked) return false;
+    waitForWriter();
+    buildSaveJob(_job);
+    bool ok = writeSaveJob(_job);
+    finishSaveJob(ok);
+    return ok;
+}
+
+void ContainerManager::buildSaveJob(SaveJob& job) {
+    for (auto& c : _containers) {
+        if (!c.resident || (!c.storeDirty && c.storeId)) continue;
+        if (!c.storeId) { c.storeId = _nextStoreId++; _indexDirty = true; }
+        job.records.emplace_back(c.storeId, std::string());
+        encodeContainer(c, job.records.back().second);
+        c.storeDirty = false;
+    }
+    // The index carries names and key counts, so it follows every record write
+    if (_indexDirty || !job.records.empty()) {
+        RecordWriter w(job.index);
+        w.u8(INDEX_VERSION);
+        w.u32(_nextStoreId);
+        w.u16(_containers.size());
+        for (const auto& c : _containers) {
+            w.u32(c.storeId);
+            w.str(c.name);
+            w.str(c.modifiedDate);
+            w.u16(c.totalKeyCount());
+            w.u16(c.selectedKeyCount());
+        }
+        job.removed.swap(_removedIds);
+        _indexDirty = false;
+    }
+    _dirty = false;
+}
+
+bool ContainerManager::writeSaveJob(SaveJob& job) {
+    bool ok = true;
+    for (auto& rec : job.records) {
+        char path[STORE_MAX_PATH];
+        recordPath(rec.first, path, sizeof(path));
+        ok = encryptAndSave(path, rec.second) && ok;
+        wipeString(rec.second);
+    }
+    // The index may only reference records that are on flash
+    if (ok && !job.index.empty()) {
+        ok = encryptAndSave(INDEX_FILE, job.index);
+        if (ok) {
+            for (uint32_t id : job.removed) {
+                char path[STORE_MAX_PATH];
+                recordPath(id, path, sizeof(path));
+                LittleFS.remove(path);
+            }
+        }
+    }
+    return ok;
+}
+
+void ContainerManager::finishSaveJob(bool ok) {
+    if (ok) {
+        _lastSaveMs = millis();
+    } else {
+        // Retry everything on the next autosave
+        for (auto& c : _containers) c.storeDirty = true;
+        if (!_job.index.empty()) {
+            _indexDirty = true;
+            _removedIds.insert(_removedIds.end(), _job.removed.begin(), _job.removed.end());
+        }
+        _dirty = true; _lastChangeMs = millis();
+    }
+    _job.records.clear();
+    _job.index.clear();
+    _job.removed.clear();
+}
+
+void ContainerManager::waitForWriter() {
+    if (!_jobQueued) return;
+    while (_jobPending) vTaskDelay(1);
+    _jobQueued = false;
+    finishSaveJob(_jobOk);
+}
+
+void ContainerManager::removeOrphans(const std::vector<uint32_t>& ids) {
+    // Leftovers of an interrupted save: temp files and records no index references
+    std::vector<std::string> stale;
+    File dir = LittleFS.open(STORE_DIR);
+    if (!dir || !dir.isDirectory()) return;
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+        std::string name = f.name();
+        bool keep = name == "index.bin";
+        for (size_t i = 0; !keep && i < ids.size(); i++) {
+            char expected[STORE_MAX_PATH];
+            snprintf(expected, sizeof(expected), "%08lx.bin", (unsigned long)ids[i]);
+            keep = name == expected;
+        }
+        if (!keep) stale.push_back(std::string(STORE_DIR) + "/" + name);
+    }
+    dir.close();
+    for (const auto& p : stale) {
+        LittleFS.remove(p.c_str());
+        Console.printf("[CONT] Removed stale %s\n", p.c_str());
+    }
+}
+
+bool ContainerManager::unlock() {
+    if (_unlocked) return true;
+    if (!DeviceManager::instance().getStorageKey()) return false;
+    _unlocked = true;
+    if (load()) return true;
+    if (_storageReady &&
+        (LittleFS.exists(INDEX_FILE) || LittleFS.exists(LEGACY_ENC_FILE) || LittleFS.exists(LEGACY_CONTAINER_FILE))) {
+        // Present but unreadable - never overwrite it with defaults
+        Console.println("[CONT] Container store failed to decrypt");
+        _containers.clear(); _activeIndex = -1; _generation++;
+        _unlocked = false;
+        return false;
+    }
+    loadDefaults();
+    return true;
+}
+
+void ContainerManager::lock() {
+    if (!_unlocked) return;
+    waitForWriter();
+    if (_dirty) saveNow();
+    for (auto& c : _containers)
+        for (auto& g : c.groups)
+            for (auto& k : g.keys) k.clearKey();
+    _containers.clear(); _activeIndex = -1; _password.clear();
+    _removedIds.clear();
+    _unlocked = false; _dirty = false; _indexDirty = false;
+    _generation++;
+    if (_storeCallback) _storeCallback(STORE_LOCKED);
+}
+
+static size_t buildAad(const uint8_t* header, const char* path, uint8_t* aad) {
+    size_t pathLen = strnlen(path, STORE_MAX_PATH);
+    memcpy(aad, header, STORE_HEADER_SIZE);
+    memcpy(aad + STORE_HEADER_SIZE, path, pathLen);
+    return STORE_HEADER_SIZE + pathLen;
+}
+
+bool ContainerManager::encryptAndSave(const char* path, const std::string& plaintext) {
+    const uint8_t* key = DeviceManager::instance().getStorageKey();
+    if (!key) return false;
+
+    uint8_t header[STORE_HEADER_SIZE] = {0};
+    memcpy(header, STORE_MAGIC, sizeof(STORE_MAGIC));
+    header[4] = STORE_VERSION;
+    uint8_t iv[GCM_IV_SIZE];
+    if (!Crypto::generateRandom(iv, sizeof(iv))) return false;   // Fresh nonce per write
+    uint8_t aad[STORE_HEADER_SIZE + STORE_MAX_PATH];
+    size_t aadLen = buildAad(header, path, aad);
+
+    // Written beside the target and renamed over it (LittleFS replaces atomically)
+    char tmpPath[STORE_MAX_PATH + 4];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    Crypto::GcmStream gcm;
+    if (!gcm.begin(key, iv, sizeof(iv), true, aad, aadLen)) return false;
+    File f = LittleFS.open(tmpPath, "w");
+    if (!f) return false;
+    f.write(header, sizeof(header));
+    f.write(iv, sizeof(iv));
+
+    uint8_t out[STORE_CHUNK + AES_BLOCK_SIZE];
+    const uint8_t* in = (const uint8_t*)plaintext.data();
+    bool ok = true;
+    for (size_t off = 0; ok && off < plaintext.size(); off += STORE_CHUNK) {
+        size_t n = std::min(STORE_CHUNK, plaintext.size() - off);
+        int w = gcm.update(in + off, n, out);
+        ok = w >= 0 && f.write(out, w) == (size_t)w;
+    }
+    uint8_t tag[GCM_TAG_SIZE];
+    int w = ok ? gcm.finish(out, tag) : -1;
+    ok = w >= 0 && f.write(out, w) == (size_t)w && f.write(tag, sizeof(tag)) == sizeof(tag);
+    f.close();
+    Crypto::secureZero(out, sizeof(out));
+    ok = ok && LittleFS.rename(tmpPath, path);
+    if (!ok) {
+        LittleFS.remove(tmpPath);
+        Console.printf("[CONT] Encrypted save of %s failed\n", path);
+    }
+    return ok;
+}
+
+bool ContainerManager::loadAndDecrypt(const char* path, std::string& plaintext) {
+    plaintext.clear();
+    const uint8_t* key = DeviceManager::instance().getStorageKey();
+    if (!key) return false;
+    File f = LittleFS.open(path, "r");
     if (!f) return false;
-    f.print(json.c_str()); f.close();
-    _dirty = false; _lastSaveMs = millis();
+
+    uint8_t header[STORE_HEADER_SIZE];
+    uint8_t iv[GCM_IV_SIZE];
+    size_t size = f.size();
+    if (size < sizeof(header) + sizeof(iv) + GCM_TAG_SIZE ||
+        f.read(header, sizeof(header)) != sizeof(header) ||
+        memcmp(header, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0 || header[4] != STORE_VERSION ||
+        f.read(iv, sizeof(iv)) != sizeof(iv)) {
+        f.close();
+        return false;
+    }
+    // The single-file store of the previous firmware authenticated the header only
+    uint8_t aad[STORE_HEADER_SIZE + STORE_MAX_PATH];
+    size_t aadLen = (strcmp(path, LEGACY_ENC_FILE) == 0) ? (memcpy(aad, header, sizeof(header)), sizeof(header))
+                                                         : buildAad(header, path, aad);
+
+    Crypto::GcmStream gcm;
+    if (!gcm.begin(key, iv, sizeof(iv), false, aad, aadLen)) { f.close(); return false; }
+    size_t remaining = size - sizeof(header) - sizeof(iv) - GCM_TAG_SIZE;
+    plaintext.reserve(remaining);
+    uint8_t in[STORE_CHUNK];
+    uint8_t out[STORE_CHUNK + AES_BLOCK_SIZE];
+    bool ok = true;
+    while (ok && remaining > 0) {
+        size_t n = std::min(STORE_CHUNK, remaining);
+        int w = (f.read(in, n) == n) ? gcm.update(in, n, out) : -1;
+        if (w >= 0) plaintext.append((const char*)out, w);
+        ok = w >= 0;
+        remaining -= n;
+    }
+    uint8_t tag[GCM_TAG_SIZE];
+    ok = ok && f.read(tag, sizeof(tag)) == sizeof(tag);
+    f.close();
+    int w = ok ? gcm.finish(out, tag) : -1;
+    if (w > 0) plaintext.append((const char*)out, w);
+    Crypto::secureZero(out, sizeof(out));
+    if (w < 0) {
+        wipeString(plaintext);   // Unauthenticated output is discarded
+        return false;
+    }
     return true;
 }
 
 void ContainerManager::service() {
+    if (_jobQueued) {
+        if (_jobPending) return;
+        _jobQueued = false;
+        finishSaveJob(_jobOk);
+    }
+    if (!_unlocked) return;
+    evictIfNeeded();
     if (!_dirty) return;
     uint32_t now = millis();
-    if (now - _lastChangeMs > 3000 && now - _lastSaveMs > 5000) saveNow();
+    if (now - _lastChangeMs <= 3000 || now - _lastSaveMs <= 5000) return;
+    if (linkBusy()) return;
+    if (!_writerTask) { saveNow(); return; }
+    
+    // Encoding is cheap; sealing and flash writes happen on the writer task
+    buildSaveJob(_job);
+    _jobQueued = true;
+    _jobPending = true;
+    xTaskNotifyGive(_writerTask);
+}
+
+// One key in the JSON layout shared by the legacy store and SD export/import
+static void keyToJson(const KeySlot& k, JsonObject ko) {
+    ko["name"] = k.name; ko["algo"] = k.algorithmId;
+    ko["keyId"] = k.keyId; ko["sln"] = k.sln;
+    ko["key"] = k.keyHex(); ko["sel"] = k.selected;
+}
+
+static bool keyFromJson(JsonObjectConst ko, KeySlot& k) {
+    k.name = ko["name"] | "Key";
+    k.algorithmId = ko["algo"] | P25::ALGO_AES_256;
+    k.keyId = ko["keyId"] | 1; k.sln = ko["sln"] | 1;
+    k.selected = ko["sel"] | true;
+    return k.setKeyHex(ko["key"] | "");
 }
 
 std::string ContainerManager::serializeContainers() {
@@ -165,12 +896,7 @@ std::string ContainerManager::serializeContainers() {
             JsonObject go = groups.add<JsonObject>();
             go["name"] = g.name; go["keyset"] = g.keysetId;
             JsonArray keys = go["keys"].to<JsonArray>();
-            for (const auto& k : g.keys) {
-                JsonObject ko = keys.add<JsonObject>();
-                ko["name"] = k.name; ko["algo"] = k.algorithmId;
-                ko["keyId"] = k.keyId; ko["sln"] = k.sln;
-                ko["key"] = k.keyHex; ko["sel"] = k.selected;
-            }
+            for (const auto& k : g.keys) keyToJson(k, keys.add<JsonObject>());
         }
     }
     String out; serializeJson(doc, out);
@@ -181,6 +907,7 @@ bool ContainerManager::deserializeContainers(const std::string& json) {
     JsonDocument doc;
     if (deserializeJson(doc, json)) return false;
     _containers.clear();
+    _generation++;
     JsonArray arr = doc.as<JsonArray>();
     for (JsonObject co : arr) {
         Container c; c.name = co["name"] | "Unnamed"; c.description = co["desc"] | "";
@@ -189,14 +916,12 @@ bool ContainerManager::deserializeContainers(const std::string& json) {
             KeyGroup g; g.name = go["name"] | "Group"; g.keysetId = go["keyset"] | 1;
             JsonArray keys = go["keys"];
             for (JsonObject ko : keys) {
-                KeySlot k; k.name = ko["name"] | "Key";
-                k.algorithmId = ko["algo"] | P25::ALGO_AES_256;
-                k.keyId = ko["keyId"] | 1; k.sln = ko["sln"] | 1;
-                k.keyHex = ko["key"] | ""; k.selected = ko["sel"] | true;
+                KeySlot k; keyFromJson(ko, k);
                 g.keys.push_back(k);
             }
             c.groups.push_back(g);
         }
+        c.reindex();
         _containers.push_back(c);
     }
     return true;
@@ -204,32 +929,632 @@ bool ContainerManager::deserializeContainers(const std::string& json) {
 
 void ContainerManager::loadDefaults() {
     _containers.clear();
+    _generation++;
     Container c; c.name = "Demo Container"; c.description = "Sample container";
     KeyGroup g; g.name = "Test Keys"; g.keysetId = 1;
     KeySlot k1; k1.name = "Test AES Key"; k1.algorithmId = P25::ALGO_AES_256;
     k1.keyId = 1; k1.sln = 1;
-    k1.keyHex = "0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF";
+    k1.setKeyHex("0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF");
     k1.selected = true; g.keys.push_back(k1);
-    c.groups.push_back(g); _containers.push_back(c); _activeIndex = 0;
+    c.groups.push_back(g); c.reindex(); _containers.push_back(c); _activeIndex = 0;
 }
 
 bool ContainerManager::factoryReset() {
+    waitForWriter();
     _containers.clear(); _activeIndex = -1; _password.clear();
-    if (_storageReady) LittleFS.remove("/containers.json");
+    _removedIds.clear(); _nextStoreId = 1;
+    _generation++;
+    _dirty = false; _indexDirty = false;
+    if (_storageReady) {
+        std::vector<std::string> paths;
+        File dir = LittleFS.open(STORE_DIR);
+        if (dir && dir.isDirectory()) {
+            for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+                paths.push_back(std::string(STORE_DIR) + "/" + f.name());
+            }
+        }
+        for (const auto& p : paths) LittleFS.remove(p.c_str());
+        LittleFS.remove(LEGACY_ENC_FILE);
+        LittleFS.remove(LEGACY_CONTAINER_FILE);
+    }
     return true;
 }
 
 bool ContainerManager::setPassword(const std::string& p) { _password = p; return true; }
 bool ContainerManager::verifyPassword(const std::string& p) const { return _password == p; }
-bool ContainerManager::backupToSd(const char*) { return false; }
-bool ContainerManager::restoreFromSd(const char*) { return false; }
-bool ContainerManager::listSdBackups(std::vector<std::string>&) { return false; }
-bool ContainerManager::exportToJson(const char*) { return false; }
-bool ContainerManager::importFromJson(const char*) { return false; }
-bool ContainerManager::updateGroup(size_t, size_t, const KeyGroup&) { return false; }
-bool ContainerManager::deleteGroup(size_t, size_t) { return false; }
-bool ContainerManager::updateKey(size_t, size_t, size_t, const KeySlot&) { return false; }
-bool ContainerManager::deleteKey(size_t, size_t, size_t) { return false; }
+
+// =============================================================================
+// SD card backup, JSON export and import
+// =============================================================================
+// Everything streams through fixed-size buffers: one container (or one key
+// object, for JSON) is in RAM at a time, and restored or imported containers
+// are sealed straight into their own records and kept as index summaries.
+//
+// Backup: magic 'KFDB', version, 3 reserved | IV (12) | AES-256-GCM ciphertext | tag (16)
+// Plaintext: container count (u32), then per container the record length
+// (u32) and the binary record. Sealed with the device storage key (header as
+// AAD), so a backup restores on this device; JSON export is the portable form.
+
+static const char* SD_DIR = "/kfdtool";
+static const char* SD_BACKUP_EXT = ".kbk";
+static const char* SD_JSON_EXT = ".json";
+static const uint8_t BACKUP_MAGIC[4] = {'K', 'F', 'D', 'B'};
+static const uint8_t BACKUP_VERSION = 1;
+static const uint32_t BACKUP_MAX_RECORD = 4 * 1024 * 1024;
+static const size_t SD_READ_CHUNK = 512;
+
+// Bare names go to SD_DIR with a default extension; absolute paths are used as given
+static std::string sdPath(const char* name, const char* ext) {
+    std::string path = (name && *name) ? name : "containers";
+    if (path[0] != '/') path = std::string(SD_DIR) + "/" + path;
+    if (path.find('.', path.rfind('/')) == std::string::npos) path += ext;
+    return path;
+}
+
+static fs::FS* sdMount() {
+    if (!SdCard::instance().mount()) {
+        Console.println("[CONT] No SD card");
+        return nullptr;
+    }
+    fs::FS& sd = SdCard::instance().fs();
+    if (!sd.exists(SD_DIR)) sd.mkdir(SD_DIR);
+    return &sd;
+}
+
+static void putU32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF; p[2] = (v >> 16) & 0xFF; p[3] = v >> 24;
+}
+
+static uint32_t getU32(const char* p) {
+    const uint8_t* b = (const uint8_t*)p;
+    return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+// GCM-sealed output to a file, fed in pieces of any size
+class SealedFileWriter {
+public:
+    explicit SealedFileWriter(File& f) : _f(f), _ok(true) {}
+    ~SealedFileWriter() { Crypto::secureZero(_out, sizeof(_out)); }
+    bool ok() const { return _ok; }
+    
+    bool begin(const uint8_t* key, const uint8_t* header) {
+        uint8_t iv[GCM_IV_SIZE];
+        _ok = Crypto::generateRandom(iv, sizeof(iv)) &&
+              _gcm.begin(key, iv, sizeof(iv), true, header, STORE_HEADER_SIZE) &&
+              _f.write(header, STORE_HEADER_SIZE) == STORE_HEADER_SIZE &&
+              _f.write(iv, sizeof(iv)) == sizeof(iv);
+        return _ok;
+    }
+    
+    void write(const uint8_t* p, size_t n) {
+        while (_ok && n > 0) {
+            size_t c = std::min(STORE_CHUNK, n);
+            int w = _gcm.update(p, c, _out);
+            _ok = w >= 0 && _f.write(_out, w) == (size_t)w;
+            p += c; n -= c;
+        }
+    }
+    
+    void u32(uint32_t v) { uint8_t b[4]; putU32(b, v); write(b, sizeof(b)); }
+    
+    bool finish() {
+        uint8_t tag[GCM_TAG_SIZE];
+        int w = _ok ? _gcm.finish(_out, tag) : -1;
+        _ok = w >= 0 && _f.write(_out, w) == (size_t)w && _f.write(tag, sizeof(tag)) == sizeof(tag);
+        return _ok;
+    }
+    
+private:
+    File& _f;
+    Crypto::GcmStream _gcm;
+    uint8_t _out[STORE_CHUNK + AES_BLOCK_SIZE];
+    bool _ok;
+};
+
+// Reads a file in SD_READ_CHUNK blocks; also an ArduinoJson reader (read/readBytes)
+class ChunkedReader {
+public:
+    explicit ChunkedReader(File& f) : _f(f), _pos(0), _len(0), _consumed(0) {}
+    int peek() { return fill() ? _buf[_pos] : -1; }
+    int read() { if (!fill()) return -1; _consumed++; return _buf[_pos++]; }
+    size_t readBytes(char* out, size_t n) {
+        size_t got = 0;
+        while (got < n && fill()) {
+            size_t c = std::min(n - got, _len - _pos);
+            memcpy(out + got, &_buf[_pos], c);
+            _pos += c; got += c; _consumed += c;
+        }
+        return got;
+    }
+    size_t consumed() const { return _consumed; }
+    
+private:
+    bool fill() {
+        if (_pos < _len) return true;
+        _len = _f.read(_buf, sizeof(_buf));
+        _pos = 0;
+        return _len > 0 && _len != (size_t)-1;
+    }
+    File& _f;
+    uint8_t _buf[SD_READ_CHUNK];
+    size_t _pos;
+    size_t _len;
+    size_t _consumed;
+};
+
+// Pull parser for the container file layout. Arrays and objects are walked
+// member by member; only leaf values (a key object, a name) are handed to
+// ArduinoJson, so the document never exceeds one key.
+class JsonStreamReader {
+public:
+    explicit JsonStreamReader(ChunkedReader& in) : _in(in), _ok(true) {
+        _skip.set(false);   // Filter that keeps nothing
+    }
+    bool ok() const { return _ok; }
+    size_t position() const { return _in.consumed(); }
+    
+    int peek() {
+        for (;;) {
+            int c = _in.peek();
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == 0xEF || c == 0xBB || c == 0xBF) _in.read();
+            else return c;      // UTF-8 BOM bytes are skipped with the whitespace
+        }
+    }
+    
+    bool expect(char ch) {
+        if (_ok && peek() == ch) { _in.read(); return true; }
+        _ok = false;
+        return false;
+    }
+    
+    // Next array element; false at the end (']' consumed) or on error
+    bool nextElement(bool& first) {
+        if (!_ok) return false;
+        int c = peek();
+        if (c == ']') { _in.read(); return false; }
+        if (!first && !expect(',')) return false;
+        first = false;
+        return true;
+    }
+    
+    // Next member name; false at the end ('}' consumed) or on error
+    bool nextMember(bool& first, std::string& name) {
+        if (!_ok) return false;
+        int c = peek();
+        if (c == '}') { _in.read(); return false; }
+        if (!first && !expect(',')) return false;
+        first = false;
+        return readName(name) && expect(':');
+    }
+    
+    // Any value into doc. Objects, arrays and strings end on their own
+    // delimiter; numbers and literals are cut here, before the ',' or '}'
+    // that ArduinoJson would otherwise swallow.
+    bool readValue(JsonDocument& doc, const JsonDocument* filter = nullptr) {
+        if (!_ok) return false;
+        int c = peek();
+        DeserializationError err;
+        if (c == '{' || c == '[' || c == '"') {
+            err = filter ? deserializeJson(doc, _in, DeserializationOption::Filter(*filter))
+                         : deserializeJson(doc, _in);
+        } else {
+            char tok[32];
+            size_t n = 0;
+            while (n < sizeof(tok) - 1) {
+                c = _in.peek();
+                if (c < 0 || c == ',' || c == '}' || c == ']' || isspace(c)) break;
+                tok[n++] = (char)_in.read();
+            }
+            tok[n] = '\0';
+            err = deserializeJson(doc, tok);
+        }
+        if (err) _ok = false;
+        return _ok;
+    }
+    
+    bool skipValue() {
+        JsonDocument doc;
+        return readValue(doc, &_skip);
+    }
+    
+private:
+    bool readName(std::string& name) {
+        if (!expect('"')) return false;
+        name.clear();
+        for (;;) {
+            int c = _in.read();
+            if (c == '"') break;
+            if (c == '\\') {
+                // Only ASCII names are matched - escapes need not decode exactly
+                c = _in.read();
+                if (c == 'u') { for (int i = 0; i < 4; i++) _in.read(); c = '?'; }
+            }
+            if (c < 0 || name.size() > 64) { _ok = false; return false; }
+            name.push_back((char)c);
+        }
+        return true;
+    }
+    
+    ChunkedReader& _in;
+    JsonDocument _skip;
+    bool _ok;
+};
+
+static bool readGroupJson(JsonStreamReader& in, KeyGroup& g, const JsonDocument& keyFilter, uint32_t& badKeys) {
+    JsonDocument doc;
+    std::string member;
+    bool first = true;
+    if (!in.expect('{')) return false;
+    while (in.nextMember(first, member)) {
+        if (member == "keys") {
+            bool firstKey = true;
+            if (!in.expect('[')) return false;
+            while (in.nextElement(firstKey)) {
+                if (!in.readValue(doc, &keyFilter)) return false;
+                KeySlot k;
+                if (!keyFromJson(doc.as<JsonObjectConst>(), k)) badKeys++;
+                g.keys.push_back(std::move(k));
+            }
+        } else if (member == "name" || member == "keyset") {
+            if (!in.readValue(doc)) return false;
+            if (member == "name") g.name = doc | "Group";
+            else g.keysetId = doc | 1;
+        } else if (!in.skipValue()) {
+            return false;
+        }
+    }
+    return in.ok();
+}
+
+static bool readContainerJson(JsonStreamReader& in, Container& c, const JsonDocument& keyFilter, uint32_t& badKeys) {
+    JsonDocument doc;
+    std::string member;
+    bool first = true;
+    c.name = "Unnamed";
+    if (!in.expect('{')) return false;
+    while (in.nextMember(first, member)) {
+        if (member == "groups") {
+            bool firstGroup = true;
+            if (!in.expect('[')) return false;
+            while (in.nextElement(firstGroup)) {
+                KeyGroup g;
+                g.name = "Group";
+                if (!readGroupJson(in, g, keyFilter, badKeys)) return false;
+                c.groups.push_back(std::move(g));
+            }
+        } else if (member == "name" || member == "desc") {
+            if (!in.readValue(doc)) return false;
+            if (member == "name") c.name = doc | "Unnamed";
+            else c.description = doc | "";
+        } else if (!in.skipValue()) {
+            return false;
+        }
+    }
+    return in.ok();
+}
+
+static bool printJsonString(Print& out, const std::string& s) {
+    JsonDocument doc;
+    doc.set(s);
+    return serializeJson(doc, out) > 0;
+}
+
+static bool writeContainerJson(Print& out, const Container& c) {
+    bool ok = out.print("{\"name\":") > 0 && printJsonString(out, c.name) &&
+              out.print(",\"desc\":") > 0 && printJsonString(out, c.description) &&
+              out.print(",\"groups\":[") > 0;
+    for (size_t gi = 0; ok && gi < c.groups.size(); gi++) {
+        const KeyGroup& g = c.groups[gi];
+        ok = (gi == 0 || out.print(",") > 0) &&
+             out.print("{\"name\":") > 0 && printJsonString(out, g.name) &&
+             out.printf(",\"keyset\":%u,\"keys\":[", g.keysetId) > 0;
+        for (size_t ki = 0; ok && ki < g.keys.size(); ki++) {
+            JsonDocument doc;
+            keyToJson(g.keys[ki], doc.to<JsonObject>());
+            ok = (ki == 0 || out.print(",") > 0) && serializeJson(doc, out) > 0;
+        }
+        ok = ok && out.print("]}") > 0;
+    }
+    return ok && out.print("]}") > 0;
+}
+
+bool ContainerManager::recordOf(size_t idx, std::string& record) {
+    const Container& c = _containers[idx];
+    if (c.resident) {
+        encodeContainer(c, record);
+        return true;
+    }
+    char path[STORE_MAX_PATH];
+    recordPath(c.storeId, path, sizeof(path));
+    return loadAndDecrypt(path, record);
+}
+
+bool ContainerManager::stageContainer(Container& c, std::vector<Container>& staged) {
+    c.reindex();
+    c.storeId = _nextStoreId++;
+    std::string record;
+    encodeContainer(c, record);
+    char path[STORE_MAX_PATH];
+    recordPath(c.storeId, path, sizeof(path));
+    bool ok = encryptAndSave(path, record);
+    wipeString(record);
+    if (!ok) return false;
+    
+    // Only the summary stays; the record pages in on first access
+    std::vector<KeyGroup>().swap(c.groups);     // KeySlot destructors wipe the keys
+    std::vector<KeyIndexEntry>().swap(c.keyIndex);
+    c.resident = false;
+    c.storeDirty = false;
+    staged.push_back(std::move(c));
+    return true;
+}
+
+void ContainerManager::discardStaged(std::vector<Container>& staged) {
+    for (const auto& c : staged) {
+        char path[STORE_MAX_PATH];
+        recordPath(c.storeId, path, sizeof(path));
+        LittleFS.remove(path);
+    }
+    staged.clear();
+}
+
+bool ContainerManager::commitStaged(std::vector<Container>& staged, bool replace) {
+    if (replace) {
+        for (const auto& c : _containers) if (c.storeId) _removedIds.push_back(c.storeId);
+        _containers.clear();
+        _activeIndex = -1;
+    }
+    for (auto& c : staged) _containers.push_back(std::move(c));
+    staged.clear();
+    _indexDirty = true;
+    markChanged(_containers.size());
+    bool ok = saveNow();
+    if (_storeCallback) _storeCallback(replace ? STORE_REPLACED : STORE_IMPORTED);
+    return ok;
+}
+
+bool ContainerManager::backupToSd(const char* filename) {
+    const uint8_t* key = DeviceManager::instance().getStorageKey();
+    if (!_unlocked || !key) return false;
+    fs::FS* sd = sdMount();
+    if (!sd) return false;
+    waitForWriter();        // Records of paged-out containers must be current
+    
+    std::string path = sdPath(filename, SD_BACKUP_EXT);
+    std::string tmpPath = path + ".tmp";
+    File f = sd->open(tmpPath.c_str(), FILE_WRITE);
+    if (!f) {
+        Console.printf("[CONT] Cannot create %s\n", tmpPath.c_str());
+        return false;
+    }
+    
+    uint8_t header[STORE_HEADER_SIZE] = {0};
+    memcpy(header, BACKUP_MAGIC, sizeof(BACKUP_MAGIC));
+    header[4] = BACKUP_VERSION;
+    SealedFileWriter w(f);
+    bool ok = w.begin(key, header);
+    w.u32(_containers.size());
+    for (size_t i = 0; ok && i < _containers.size(); i++) {
+        std::string record;
+        ok = recordOf(i, record);
+        w.u32(record.size());
+        w.write((const uint8_t*)record.data(), record.size());
+        wipeString(record);
+        ok = ok && w.ok();
+    }
+    ok = w.finish() && ok;
+    f.close();
+    
+    if (ok) {
+        sd->remove(path.c_str());
+        ok = sd->rename(tmpPath.c_str(), path.c_str());
+    }
+    if (!ok) {
+        sd->remove(tmpPath.c_str());
+        Console.printf("[CONT] Backup to %s failed\n", path.c_str());
+        return false;
+    }
+    Console.printf("[CONT] Backed up %u containers to %s\n", (unsigned)_containers.size(), path.c_str());
+    return true;
+}
+
+bool ContainerManager::restoreFromSd(const char* filename) {
+    const uint8_t* key = DeviceManager::instance().getStorageKey();
+    if (!_unlocked || !_storageReady || !key) return false;
+    fs::FS* sd = sdMount();
+    if (!sd) return false;
+    
+    std::string path = sdPath(filename, SD_BACKUP_EXT);
+    File f = sd->open(path.c_str(), FILE_READ);
+    if (!f) {
+        Console.printf("[CONT] %s not found\n", path.c_str());
+        return false;
+    }
+    uint8_t header[STORE_HEADER_SIZE];
+    uint8_t iv[GCM_IV_SIZE];
+    size_t size = f.size();
+    Crypto::GcmStream gcm;
+    if (size < sizeof(header) + sizeof(iv) + GCM_TAG_SIZE ||
+        f.read(header, sizeof(header)) != sizeof(header) ||
+        memcmp(header, BACKUP_MAGIC, sizeof(BACKUP_MAGIC)) != 0 || header[4] != BACKUP_VERSION ||
+        f.read(iv, sizeof(iv)) != sizeof(iv) ||
+        !gcm.begin(key, iv, sizeof(iv), false, header, sizeof(header))) {
+        f.close();
+        Console.printf("[CONT] %s is not a backup\n", path.c_str());
+        return false;
+    }
+    waitForWriter();
+    
+    // Records are staged as they decrypt and only committed once the tag
+    // verifies; a bad tag deletes them again
+    std::vector<Container> staged;
+    std::string pending;            // Decrypted, not yet parsed
+    uint32_t count = 0;
+    bool haveCount = false;
+    auto drain = [&]() -> bool {
+        size_t pos = 0;
+        bool ok = true;
+        while (ok) {
+            size_t avail = pending.size() - pos;
+            if (avail < 4) break;
+            uint32_t len = getU32(&pending[pos]);
+            if (!haveCount) {
+                count = len; haveCount = true; pos += 4;
+                continue;
+            }
+            if (len > BACKUP_MAX_RECORD || staged.size() >= count) { ok = false; break; }
+            if (avail - 4 < len) break;
+            std::string record(pending, pos + 4, len);
+            pos += 4 + len;
+            Container c;
+            ok = decodeContainer(record, c) && stageContainer(c, staged);
+            wipeString(record);
+        }
+        if (pos) {
+            Crypto::secureZero(&pending[0], pos);
+            pending.erase(0, pos);
+        }
+        return ok;
+    };
+    
+    size_t remaining = size - sizeof(header) - sizeof(iv) - GCM_TAG_SIZE;
+    uint8_t in[STORE_CHUNK];
+    uint8_t out[STORE_CHUNK + AES_BLOCK_SIZE];
+    bool ok = true;
+    while (ok && remaining > 0) {
+        size_t n = std::min(STORE_CHUNK, remaining);
+        int w = (f.read(in, n) == n) ? gcm.update(in, n, out) : -1;
+        if (w > 0) pending.append((const char*)out, w);
+        ok = w >= 0 && drain();
+        remaining -= n;
+    }
+    uint8_t tag[GCM_TAG_SIZE];
+    ok = ok && f.read(tag, sizeof(tag)) == sizeof(tag);
+    f.close();
+    int w = ok ? gcm.finish(out, tag) : -1;
+    if (w > 0) pending.append((const char*)out, w);
+    ok = w >= 0 && drain() && haveCount && staged.size() == count && pending.empty();
+    Crypto::secureZero(out, sizeof(out));
+    wipeString(pending);
+    
+    if (!ok) {
+        discardStaged(staged);
+        Console.printf("[CONT] Restore from %s failed (damaged or another device's backup)\n", path.c_str());
+        return false;
+    }
+    ok = commitStaged(staged, true);
+    Console.printf("[CONT] Restored %u containers from %s\n", (unsigned)count, path.c_str());
+    return ok;
+}
+
+bool ContainerManager::listSdBackups(std::vector<std::string>& files) {
+    files.clear();
+    fs::FS* sd = sdMount();
+    if (!sd) return false;
+    File dir = sd->open(SD_DIR);
+    if (!dir || !dir.isDirectory()) return false;
+    const size_t extLen = strlen(SD_BACKUP_EXT);
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+        std::string name = f.name();
+        if (!f.isDirectory() && name.size() > extLen &&
+            name.compare(name.size() - extLen, extLen, SD_BACKUP_EXT) == 0) {
+            files.push_back(name);
+        }
+    }
+    dir.close();
+    std::sort(files.begin(), files.end());
+    return true;
+}
+
+bool ContainerManager::exportToJson(const char* filename) {
+    if (!_unlocked) return false;
+    fs::FS* sd = sdMount();
+    if (!sd) return false;
+    waitForWriter();
+    
+    std::string path = sdPath(filename, SD_JSON_EXT);
+    std::string tmpPath = path + ".tmp";
+    File f = sd->open(tmpPath.c_str(), FILE_WRITE);
+    if (!f) {
+        Console.printf("[CONT] Cannot create %s\n", tmpPath.c_str());
+        return false;
+    }
+    
+    // Paged-out containers are decoded from their records one at a time
+    // without becoming resident
+    bool ok = f.print("[") > 0;
+    for (size_t i = 0; ok && i < _containers.size(); i++) {
+        ok = i == 0 || f.print(",") > 0;
+        if (_containers[i].resident) {
+            ok = ok && writeContainerJson(f, _containers[i]);
+            continue;
+        }
+        std::string record;
+        Container c;
+        ok = ok && recordOf(i, record) && decodeContainer(record, c) && writeContainerJson(f, c);
+        wipeString(record);
+    }
+    ok = ok && f.print("]") > 0;
+    f.close();
+    
+    if (ok) {
+        sd->remove(path.c_str());
+        ok = sd->rename(tmpPath.c_str(), path.c_str());
+    }
+    if (!ok) {
+        sd->remove(tmpPath.c_str());
+        Console.printf("[CONT] Export to %s failed\n", path.c_str());
+        return false;
+    }
+    Console.printf("[CONT] Exported %u containers to %s (unencrypted)\n", (unsigned)_containers.size(), path.c_str());
+    return true;
+}
+
+bool ContainerManager::importFromJson(const char* filename) {
+    if (!_unlocked || !_storageReady) return false;
+    fs::FS* sd = sdMount();
+    if (!sd) return false;
+    
+    std::string path = sdPath(filename, SD_JSON_EXT);
+    File f = sd->open(path.c_str(), FILE_READ);
+    if (!f) {
+        Console.printf("[CONT] %s not found\n", path.c_str());
+        return false;
+    }
+    waitForWriter();
+    
+    JsonDocument keyFilter;
+    for (const char* field : {"name", "algo", "keyId", "sln", "key", "sel"}) keyFilter[field] = true;
+    
+    // Either an array of containers (export format) or a single container
+    ChunkedReader reader(f);
+    JsonStreamReader in(reader);
+    std::vector<Container> staged;
+    uint32_t badKeys = 0;
+    bool ok = true;
+    bool single = in.peek() == '{';
+    bool first = true;
+    if (!single && !in.expect('[')) ok = false;
+    while (ok && (single ? staged.empty() : in.nextElement(first))) {
+        Container c;
+        ok = readContainerJson(in, c, keyFilter, badKeys) && stageContainer(c, staged);
+    }
+    ok = ok && in.ok();
+    size_t at = in.position();
+    f.close();
+    
+    if (!ok) {
+        discardStaged(staged);
+        Console.printf("[CONT] Import of %s failed near byte %u\n", path.c_str(), (unsigned)at);
+        return false;
+    }
+    size_t n = staged.size();
+    ok = commitStaged(staged, false);
+    Console.printf("[CONT] Imported %u containers from %s\n", (unsigned)n, path.c_str());
+    if (badKeys) Console.printf("[CONT] %u keys had malformed key material (left empty)\n", (unsigned)badKeys);
+    return ok;
+}
+
 
 namespace KeyGen {
     std::string generateKey(uint8_t algo) {
@@ -4,7 +4,9 @@
  */
 
 #include "device_info.h"
+#include "console.h"
 #include "crypto.h"
+#include "container.h"
 #include <Arduino.h>
 #include <LittleFS.h>
 #include <ArduinoJson.h>
@@ -53,6 +55,9 @@ void DeviceSettings::setDefaults() {
     autoSaveDelay = 3;
     confirmDelete = true;
     backupOnSave = false;
+    strncpy(radioModel, "default", sizeof(radioModel));
+    memset(radioProfiles, 0, sizeof(radioProfiles));
+    radioProfileCount = 0;
 }
 
 bool DeviceSettings::validate() const {
@@ -76,7 +81,48 @@ DeviceManager& DeviceManager::instance() {
     return inst;
 }
 
-DeviceManager::DeviceManager() : _initialized(false), _settingsDirty(false) {}
+// Container storage key, AES-256-GCM wrapped per role under PBKDF2(PIN):
+// {"op": {"salt", "iter", "iv", "key", "tag"}, "adm": {...}}, AAD = role tag
+static const char* STORAGE_KEYS_FILE = "/keys.json";
+
+static const char* storageRoleTag(UserRole role) {
+    return role == ROLE_ADMIN ? "adm" : "op";
+}
+
+static bool loadStorageKeys(JsonDocument& doc) {
+    File f = LittleFS.open(STORAGE_KEYS_FILE, "r");
+    if (!f) return false;
+    DeserializationError err = deserializeJson(doc, f);
+    f.close();
+    return !err;
+}
+
+// The only wrapped copies of the storage key: written beside the file and
+// renamed over it, so a brown-out leaves the old or the new set, never a torn one
+static bool saveStorageKeys(const JsonDocument& doc) {
+    static const char* TMP_FILE = "/keys.json.tmp";
+    File f = LittleFS.open(TMP_FILE, "w");
+    if (!f) return false;
+    size_t expected = measureJson(doc);
+    bool ok = serializeJson(doc, f) == expected;
+    f.close();
+    ok = ok && LittleFS.rename(TMP_FILE, STORAGE_KEYS_FILE);
+    if (!ok) {
+        LittleFS.remove(TMP_FILE);
+        Console.println("[DEV] Storage key file write failed");
+    }
+    return ok;
+}
+
+// Guards the queued profile updates - written from the KFD worker
+static portMUX_TYPE s_pendingMux = portMUX_INITIALIZER_UNLOCKED;
+
+DeviceManager::DeviceManager() : _initialized(false), _settingsDirty(false), _storageKeyValid(false),
+                                 _storageError(nullptr) {
+    memset(_storageKey, 0, sizeof(_storageKey));
+    memset(&_pendingDelay, 0, sizeof(_pendingDelay));
+    memset(&_pendingLink, 0, sizeof(_pendingLink));
+}
 
 bool DeviceManager::init() {
     _info.init();
@@ -105,6 +151,20 @@ bool DeviceManager::saveSettings() {
     doc["sessionTimeout"] = _settings.sessionTimeout;
     doc["opHash"] = _settings.operatorPinHash;
     doc["admHash"] = _settings.adminPinHash;
+    doc["radioModel"] = _settings.radioModel;
+    
+    JsonArray profiles = doc["radioProfiles"].to<JsonArray>();
+    for (uint8_t i = 0; i < _settings.radioProfileCount; i++) {
+        JsonObject p = profiles.add<JsonObject>();
+        p["model"] = _settings.radioProfiles[i].model;
+        p["readyDelayUs"] = _settings.radioProfiles[i].postReadyDelayUs;
+        if (_settings.radioProfiles[i].txKilobaud) {
+            p["txKbaud"] = _settings.radioProfiles[i].txKilobaud;
+            p["rxKbaud"] = _settings.radioProfiles[i].rxKilobaud;
+            p["stopBits"] = _settings.radioProfiles[i].stopBits;
+            p["gapBits"] = _settings.radioProfiles[i].gapBits;
+        }
+    }
     
     File f = LittleFS.open("/settings.json", "w");
     if (!f) return false;
@@ -133,12 +193,144 @@ bool DeviceManager::loadSettings() {
     
     const char* opHash = doc["opHash"];
     const char* admHash = doc["admHash"];
-    if (opHash) strncpy(_settings.operatorPinHash, opHash, sizeof(_settings.operatorPinHash));
-    if (admHash) strncpy(_settings.adminPinHash, admHash, sizeof(_settings.adminPinHash));
+    if (opHash) {
+        strncpy(_settings.operatorPinHash, opHash, sizeof(_settings.operatorPinHash) - 1);
+        _settings.operatorPinHash[sizeof(_settings.operatorPinHash) - 1] = '\0';
+    }
+    if (admHash) {
+        strncpy(_settings.adminPinHash, admHash, sizeof(_settings.adminPinHash) - 1);
+        _settings.adminPinHash[sizeof(_settings.adminPinHash) - 1] = '\0';
+    }
+    
+    const char* model = doc["radioModel"] | "default";
+    strncpy(_settings.radioModel, model, sizeof(_settings.radioModel) - 1);
+    _settings.radioModel[sizeof(_settings.radioModel) - 1] = '\0';
+    
+    _settings.radioProfileCount = 0;
+    for (JsonObject p : doc["radioProfiles"].as<JsonArray>()) {
+        if (_settings.radioProfileCount >= MAX_RADIO_PROFILES) break;
+        const char* name = p["model"];
+        if (!name) continue;
+        RadioProfile& rp = _settings.radioProfiles[_settings.radioProfileCount++];
+        strncpy(rp.model, name, sizeof(rp.model) - 1);
+        rp.model[sizeof(rp.model) - 1] = '\0';
+        rp.postReadyDelayUs = p["readyDelayUs"] | 0;
+        rp.txKilobaud = p["txKbaud"] | 0;
+        rp.rxKilobaud = p["rxKbaud"] | 0;
+        rp.stopBits = p["stopBits"] | 4;
+        rp.gapBits = p["gapBits"] | 2;
+    }
     
     return true;
 }
 
+const RadioProfile* DeviceManager::getRadioProfile(const char* model) const {
+    if (!model) return nullptr;
+    for (uint8_t i = 0; i < _settings.radioProfileCount; i++) {
+        if (strncmp(_settings.radioProfiles[i].model, model, sizeof(_settings.radioProfiles[i].model)) == 0) {
+            return &_settings.radioProfiles[i];
+        }
+    }
+    return nullptr;
+}
+
+RadioProfile* DeviceManager::findOrAddProfile(const char* model) {
+    RadioProfile* rp = const_cast<RadioProfile*>(getRadioProfile(model));
+    if (rp) return rp;
+    
+    // Table full - recycle the oldest entry
+    if (_settings.radioProfileCount >= MAX_RADIO_PROFILES) {
+        memmove(&_settings.radioProfiles[0], &_settings.radioProfiles[1],
+                sizeof(RadioProfile) * (MAX_RADIO_PROFILES - 1));
+        _settings.radioProfileCount--;
+    }
+    rp = &_settings.radioProfiles[_settings.radioProfileCount++];
+    memset(rp, 0, sizeof(*rp));
+    strncpy(rp->model, model, sizeof(rp->model) - 1);
+    rp->stopBits = 4;
+    rp->gapBits = 2;
+    return rp;
+}
+
+uint32_t DeviceManager::getPostReadyDelay(const char* model) const {
+    const RadioProfile* rp = getRadioProfile(model);
+    return rp ? rp->postReadyDelayUs : 0;
+}
+
+bool DeviceManager::setPostReadyDelay(const char* model, uint32_t delayUs) {
+    if (!model || !model[0]) return false;
+    
+    RadioProfile* rp = findOrAddProfile(model);
+    if (rp->postReadyDelayUs == delayUs) return true;
+    rp->postReadyDelayUs = delayUs;
+    return saveSettings();
+}
+
+bool DeviceManager::setLinkTiming(const char* model, uint8_t txKilobaud, uint8_t rxKilobaud,
+                                  uint8_t stopBits, uint8_t gapBits) {
+    if (!model || !model[0]) return false;
+    
+    RadioProfile* rp = findOrAddProfile(model);
+    if (rp->txKilobaud == txKilobaud && rp->rxKilobaud == rxKilobaud &&
+        rp->stopBits == stopBits && rp->gapBits == gapBits) {
+        return true;
+    }
+    rp->txKilobaud = txKilobaud;
+    rp->rxKilobaud = rxKilobaud;
+    rp->stopBits = stopBits;
+    rp->gapBits = gapBits;
+    return saveSettings();
+}
+
+void DeviceManager::queuePostReadyDelay(const char* model, uint32_t delayUs) {
+    if (!model || !model[0]) return;
+    portENTER_CRITICAL(&s_pendingMux);
+    strncpy(_pendingDelay.model, model, sizeof(_pendingDelay.model) - 1);
+    _pendingDelay.model[sizeof(_pendingDelay.model) - 1] = '\0';
+    _pendingDelay.delayUs = delayUs;
+    _pendingDelay.valid = true;
+    portEXIT_CRITICAL(&s_pendingMux);
+}
+
+void DeviceManager::queueLinkTiming(const char* model, uint8_t txKilobaud, uint8_t rxKilobaud,
+                                    uint8_t stopBits, uint8_t gapBits) {
+    if (!model || !model[0]) return;
+    portENTER_CRITICAL(&s_pendingMux);
+    strncpy(_pendingLink.model, model, sizeof(_pendingLink.model) - 1);
+    _pendingLink.model[sizeof(_pendingLink.model) - 1] = '\0';
+    _pendingLink.txKilobaud = txKilobaud;
+    _pendingLink.rxKilobaud = rxKilobaud;
+    _pendingLink.stopBits = stopBits;
+    _pendingLink.gapBits = gapBits;
+    _pendingLink.valid = true;
+    portEXIT_CRITICAL(&s_pendingMux);
+}
+
+void DeviceManager::applyPendingProfiles() {
+    if (_linkBusy && _linkBusy()) return;
+    
+    PendingDelay delay;
+    PendingLink link;
+    portENTER_CRITICAL(&s_pendingMux);
+    delay = _pendingDelay;
+    link = _pendingLink;
+    _pendingDelay.valid = false;
+    _pendingLink.valid = false;
+    portEXIT_CRITICAL(&s_pendingMux);
+    
+    if (delay.valid) setPostReadyDelay(delay.model, delay.delayUs);
+    if (link.valid) {
+        setLinkTiming(link.model, link.txKilobaud, link.rxKilobaud, link.stopBits, link.gapBits);
+    }
+}
+
+bool DeviceManager::setRadioModel(const char* model) {
+    if (!model || !model[0]) return false;
+    strncpy(_settings.radioModel, model, sizeof(_settings.radioModel) - 1);
+    _settings.radioModel[sizeof(_settings.radioModel) - 1] = '\0';
+    return saveSettings();
+}
+
 void DeviceManager::resetSettingsToDefaults() {
     _settings.setDefaults();
     saveSettings();
@@ -167,33 +359,139 @@ bool DeviceManager::login(UserRole role, const std::string& pin) {
     _session.lastActivityTime = _session.loginTime;
     _session.failedAttempts = 0;
     
+    // The only key derivation of the session - saves and loads reuse the key.
+    // The login stands without it (PIN changes and reset stay reachable), but
+    // the UI reports the locked store instead of showing an empty library.
+    _storageError = nullptr;
+    if (!unlockStorage(role, pin)) {
+        if (!_storageError) _storageError = "Storage key could not be created";
+    } else if (!ContainerManager::instance().unlock()) {
+        _storageError = "Container store failed to decrypt";
+    }
+    
     return true;
 }
 
 void DeviceManager::logout() {
+    ContainerManager::instance().lock();
+    wipeStorageKey();
+    _storageError = nullptr;
     _session.role = ROLE_NONE;
     _session.username.clear();
 }
 
+bool DeviceManager::unlockStorage(UserRole role, const std::string& pin) {
+    if (_storageKeyValid) return true;
+    
+    JsonDocument doc;
+    loadStorageKeys(doc);
+    UserRole other = (role == ROLE_ADMIN) ? ROLE_OPERATOR : ROLE_ADMIN;
+    JsonObject wrap = doc[storageRoleTag(role)];
+    
+    if (!wrap.isNull()) {
+        uint8_t salt[SALT_SIZE], iv[GCM_IV_SIZE], wrapped[AES256_KEY_SIZE], tag[GCM_TAG_SIZE];
+        uint32_t iterations = wrap["iter"] | PBKDF2_ITERATIONS;
+        if (Crypto::hexToBytes(wrap["salt"] | "", salt, sizeof(salt)) != (int)sizeof(salt) ||
+            Crypto::hexToBytes(wrap["iv"] | "", iv, sizeof(iv)) != (int)sizeof(iv) ||
+            Crypto::hexToBytes(wrap["key"] | "", wrapped, sizeof(wrapped)) != (int)sizeof(wrapped) ||
+            Crypto::hexToBytes(wrap["tag"] | "", tag, sizeof(tag)) != (int)sizeof(tag)) {
+            Console.println("[DEV] Storage key file is corrupt");
+            _storageError = "Storage key file is corrupt";
+            return false;
+        }
+        
+        uint8_t kek[AES256_KEY_SIZE];
+        const char* aad = storageRoleTag(role);
+        Crypto::GcmStream gcm;
+        bool ok = Crypto::deriveKey(pin.c_str(), salt, sizeof(salt), kek, iterations) &&
+                  gcm.begin(kek, iv, sizeof(iv), false, (const uint8_t*)aad, strlen(aad)) &&
+                  gcm.update(wrapped, sizeof(wrapped), _storageKey) == (int)sizeof(wrapped) &&
+                  gcm.finish(nullptr, tag) == 0;
+        Crypto::secureZero(kek, sizeof(kek));
+        if (!ok) {
+            Crypto::secureZero(_storageKey, sizeof(_storageKey));
+            Console.println("[DEV] Storage key did not unwrap");
+            _storageError = "Storage key did not unwrap for this PIN";
+            return false;
+        }
+        _storageKeyValid = true;
+    } else if (doc[storageRoleTag(other)].isNull()) {
+        // First login: create the key that encrypts the container store
+        if (!Crypto::generateKey256(_storageKey)) return false;
+        _storageKeyValid = true;
+        if (!wrapStorageKey(role, pin)) {
+            wipeStorageKey();
+            return false;
+        }
+    } else {
+        Console.printf("[DEV] No storage key for %s - log in as %s and set this PIN\n",
+                      storageRoleTag(role), storageRoleTag(other));
+        _storageError = (role == ROLE_ADMIN) ? "No storage key for admin - log in as operator and set the admin PIN"
+                                             : "No storage key for operator - log in as admin and set the operator PIN";
+        return false;
+    }
+    
+    // A role still on its default PIN gets a wrap too, so it can unlock later
+    const char* otherHash = (other == ROLE_ADMIN) ? _settings.adminPinHash : _settings.operatorPinHash;
+    if (doc[storageRoleTag(other)].isNull() && otherHash[0] == '\0') {
+        wrapStorageKey(other, other == ROLE_ADMIN ? DEFAULT_ADMIN_PIN : DEFAULT_OPERATOR_PIN);
+    }
+    return true;
+}
+
+bool DeviceManager::wrapStorageKey(UserRole role, const std::string& pin) {
+    if (!_storageKeyValid) return false;
+    
+    uint8_t salt[SALT_SIZE], iv[GCM_IV_SIZE], wrapped[AES256_KEY_SIZE], tag[GCM_TAG_SIZE];
+    if (!Crypto::generateRandom(salt, sizeof(salt)) || !Crypto::generateRandom(iv, sizeof(iv))) return false;
+    
+    uint8_t kek[AES256_KEY_SIZE];
+    const char* aad = storageRoleTag(role);
+    Crypto::GcmStream gcm;
+    bool ok = Crypto::deriveKey(pin.c_str(), salt, sizeof(salt), kek) &&
+              gcm.begin(kek, iv, sizeof(iv), true, (const uint8_t*)aad, strlen(aad)) &&
+              gcm.update(_storageKey, sizeof(_storageKey), wrapped) == (int)sizeof(wrapped) &&
+              gcm.finish(nullptr, tag) == 0;
+    Crypto::secureZero(kek, sizeof(kek));
+    if (!ok) return false;
+    
+    JsonDocument doc;
+    loadStorageKeys(doc);
+    JsonObject wrap = doc[aad].to<JsonObject>();
+    wrap["salt"] = Crypto::bytesToHex(salt, sizeof(salt));
+    wrap["iter"] = PBKDF2_ITERATIONS;
+    wrap["iv"] = Crypto::bytesToHex(iv, sizeof(iv));
+    wrap["key"] = Crypto::bytesToHex(wrapped, sizeof(wrapped));
+    wrap["tag"] = Crypto::bytesToHex(tag, sizeof(tag));
+    
+    return saveStorageKeys(doc);
+}
+
+void DeviceManager::wipeStorageKey() {
+    Crypto::secureZero(_storageKey, sizeof(_storageKey));
+    _storageKeyValid = false;
+}
+
 bool DeviceManager::changePIN(UserRole role, const std::string& oldPin, const std::string& newPin) {
     if (!verifyPIN(role, oldPin)) return false;
     return setPIN(role, newPin);
 }
 
 bool DeviceManager::setPIN(UserRole role, const std::string& pin) {
+    if (role != ROLE_OPERATOR && role != ROLE_ADMIN) return false;
     std::string hash = hashPIN(pin);
-    if (role == ROLE_OPERATOR) {
-        strncpy(_settings.operatorPinHash, hash.c_str(), sizeof(_settings.operatorPinHash));
-    } else if (role == ROLE_ADMIN) {
-        strncpy(_settings.adminPinHash, hash.c_str(), sizeof(_settings.adminPinHash));
-    } else {
-        return false;
+    if (hash.empty()) return false;
+    char* stored = (role == ROLE_OPERATOR) ? _settings.operatorPinHash : _settings.adminPinHash;
+    strncpy(stored, hash.c_str(), sizeof(_settings.operatorPinHash) - 1);
+    stored[sizeof(_settings.operatorPinHash) - 1] = '\0';
+    // Re-wrap the storage key so the new PIN unlocks the containers
+    if (_storageKeyValid && !wrapStorageKey(role, pin)) {
+        Console.println("[DEV] Storage key re-wrap failed");
     }
     return saveSettings();
 }
 
 bool DeviceManager::verifyPIN(UserRole role, const std::string& pin) {
-    std::string hash = hashPIN(pin);
     const char* stored = nullptr;
     const char* defaultPin = nullptr;
     
@@ -209,7 +507,19 @@ bool DeviceManager::verifyPIN(UserRole role, const std::string& pin) {
     
     // Check stored hash
     if (stored && stored[0] != '\0') {
-        return hash == stored;
+        bool legacy = false;
+        if (!matchPIN(pin, stored, legacy)) return false;
+        if (legacy) {
+            // Unsalted hash from older firmware - replace it now the PIN is known
+            std::string hash = hashPIN(pin);
+            char* dst = (role == ROLE_OPERATOR) ? _settings.operatorPinHash : _settings.adminPinHash;
+            if (!hash.empty()) {
+                strncpy(dst, hash.c_str(), sizeof(_settings.operatorPinHash) - 1);
+                dst[sizeof(_settings.operatorPinHash) - 1] = '\0';
+                saveSettings();
+            }
+        }
+        return true;
     }
     
     // Check default PIN
@@ -226,6 +536,7 @@ void DeviceManager::service() {
     if (!_initialized) return;
     
     _info.uptimeSeconds = millis() / 1000;
+    applyPendingProfiles();
     
     if (_session.isLoggedIn() && _settings.sessionTimeout > 0) {
         if (_session.isTimedOut(_settings.sessionTimeout)) {
@@ -248,17 +559,52 @@ bool DeviceManager::factoryReset() {
     _settings.setDefaults();
     _info.init();
     _session = UserSession();
+    wipeStorageKey();
     
     LittleFS.remove("/settings.json");
     LittleFS.remove("/device.json");
+    LittleFS.remove(STORAGE_KEYS_FILE);
     
     return true;
 }
 
 std::string DeviceManager::hashPIN(const std::string& pin) {
-    uint8_t hash[32];
-    Crypto::sha256((const uint8_t*)pin.c_str(), pin.length(), hash);
-    return Crypto::bytesToHex(hash, 32);
+    // Salted and stretched like the storage key wrap - a 4-8 digit PIN must
+    // not fall to one SHA-256 per guess when the flash is read out
+    uint8_t salt[SALT_SIZE], hash[32];
+    if (!Crypto::generateRandom(salt, sizeof(salt)) ||
+        !Crypto::deriveKey(pin.c_str(), salt, sizeof(salt), hash, PBKDF2_ITERATIONS)) {
+        return std::string();
+    }
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "p2:%u:", (unsigned)PBKDF2_ITERATIONS);
+    std::string out = prefix + Crypto::bytesToHex(salt, sizeof(salt)) + ":" + Crypto::bytesToHex(hash, sizeof(hash));
+    Crypto::secureZero(hash, sizeof(hash));
+    return out;
+}
+
+bool DeviceManager::matchPIN(const std::string& pin, const char* stored, bool& legacy) {
+    uint8_t expected[32] = {0}, hash[32] = {0};
+    legacy = strncmp(stored, "p2:", 3) != 0;
+    bool ok;
+    if (legacy) {
+        ok = Crypto::hexToBytes(stored, expected, sizeof(expected)) == (int)sizeof(expected) &&
+             Crypto::sha256((const uint8_t*)pin.c_str(), pin.length(), hash);
+    } else {
+        unsigned iterations = 0;
+        char saltHex[2 * SALT_SIZE + 1], hashHex[2 * sizeof(hash) + 1];
+        uint8_t salt[SALT_SIZE];
+        ok = sscanf(stored, "p2:%u:%32[0-9a-fA-F]:%64[0-9a-fA-F]", &iterations, saltHex, hashHex) == 3 &&
+             iterations > 0 &&
+             Crypto::hexToBytes(saltHex, salt, sizeof(salt)) == (int)sizeof(salt) &&
+             Crypto::hexToBytes(hashHex, expected, sizeof(expected)) == (int)sizeof(expected) &&
+             Crypto::deriveKey(pin.c_str(), salt, sizeof(salt), hash, iterations);
+    }
+    // Constant-time compare
+    uint8_t diff = ok ? 0 : 1;
+    for (size_t i = 0; i < sizeof(hash); i++) diff |= expected[i] ^ hash[i];
+    Crypto::secureZero(hash, sizeof(hash));
+    return diff == 0;
 }
 
 bool DeviceManager::saveInfoToStorage() {
@@ -0,0 +1,226 @@
+/**
+ * @file fleet_loader.cpp
+ * @brief Gang-fill keyload implementation
+ */
+
+#include "fleet_loader.h"
+#include "console.h"
+#include "metrics.h"
+
+static const uint32_t PORT_TASK_STACK = 8192;
+static const UBaseType_t PORT_TASK_PRIO = 3;    // Same as the KFD worker
+static const BaseType_t PORT_TASK_CORE = 0;     // Off the LVGL core
+
+struct FixturePort {
+    int dataPin;
+    int sensePin;
+    int rmtTxChannel;
+};
+
+// Ports 1..3 (port 0 is the front-panel pair set up by main.cpp)
+static const FixturePort FIXTURE_PORTS[FleetLoader::MAX_PORTS - 1] = {
+    { 12, 13, 1 },
+    { 14, 21, 2 },
+    {  2,  1, 3 },
+};
+
+static TWI_HAL s_fixtureHal[FleetLoader::MAX_PORTS - 1];
+static KFDProtocol s_fixtureKfd[FleetLoader::MAX_PORTS - 1];
+
+FleetLoader& FleetLoader::instance() {
+    static FleetLoader inst;
+    return inst;
+}
+
+FleetLoader::FleetLoader() : _ports(), _portCount(0), _activePorts(0), _running(false), _generation(0) {
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+bool FleetLoader::init(TWI_HAL* mainHal, KFDProtocol* mainKfd, uint8_t txKilobaud, uint8_t rxKilobaud) {
+    if (_portCount) return true;
+
+    uint8_t count = FLEET_PORTS;
+    if (count < 1) count = 1;
+    if (count > MAX_PORTS) count = MAX_PORTS;
+
+    bool ok = true;
+    _ports[0].hal = mainHal;
+    _ports[0].kfd = mainKfd;
+
+    // With other ports on the line, port 0 must not mask interrupts per byte
+    if (count > 1 && mainHal->getTxBackend() != TWI_HAL::TX_RMT &&
+        !mainHal->setTxBackend(TWI_HAL::TX_RMT)) {
+        Console.println("[FLEET] Port 0: RMT unavailable - bit-bang TX will disturb the other ports");
+    }
+
+    for (uint8_t i = 1; i < count; i++) {
+        const FixturePort& fp = FIXTURE_PORTS[i - 1];
+        TWI_HAL& hal = s_fixtureHal[i - 1];
+        KFDProtocol& kfd = s_fixtureKfd[i - 1];
+
+        TWI_HAL::Config cfg;
+        cfg.dataPin = fp.dataPin;
+        cfg.sensePin = fp.sensePin;
+        cfg.txKilobaud = txKilobaud;
+        cfg.rxKilobaud = rxKilobaud;
+        cfg.txBackend = TWI_HAL::TX_RMT;
+        cfg.rmtTxChannel = fp.rmtTxChannel;
+        cfg.rxBackend = TWI_HAL::RX_EDGE_CAPTURE;
+
+        if (!hal.init(cfg) || hal.getTxBackend() != TWI_HAL::TX_RMT || !kfd.init(&hal, false)) {
+            Console.printf("[FLEET] Port %u (DATA=%d SENSE=%d) unavailable\n", i, fp.dataPin, fp.sensePin);
+            _ports[i].hal = nullptr;
+            _ports[i].kfd = nullptr;
+            ok = false;
+            continue;
+        }
+        kfd.setRadioModel(mainKfd->getRadioModel(), mainKfd->getPostReadyDelay());
+        kfd.setLinkTiming(mainKfd->getLinkTiming());
+
+        _ports[i].hal = &hal;
+        _ports[i].kfd = &kfd;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        Port& p = _ports[i];
+        memset(&p.st, 0, sizeof(p.st));
+        if (!p.kfd) {
+            p.st.state = PORT_FAILED;
+            strncpy(p.st.status, "Port unavailable", sizeof(p.st.status) - 1);
+            continue;
+        }
+
+        char name[16];
+        snprintf(name, sizeof(name), "fleet_p%u", i);
+        if (xTaskCreatePinnedToCore(portTask, name, PORT_TASK_STACK, (void*)(uintptr_t)i,
+                                    PORT_TASK_PRIO, &p.task, PORT_TASK_CORE) != pdPASS) {
+            Console.printf("[FLEET] Port %u: failed to start task\n", i);
+            p.kfd = nullptr;
+            p.st.state = PORT_FAILED;
+            strncpy(p.st.status, "Port unavailable", sizeof(p.st.status) - 1);
+            ok = false;
+        }
+    }
+
+    _portCount = count;
+    Console.printf("[FLEET] %u port(s)\n", _portCount);
+    return ok;
+}
+
+bool FleetLoader::start(const KFDProtocol::KeyloadPlan& plan, uint32_t portMask) {
+    if (_running || plan.empty()) return false;
+    // Port 0 shares its protocol object with the async worker
+    if (_ports[0].kfd && _ports[0].kfd->isOperationInProgress()) return false;
+
+    uint8_t selected = 0;
+    for (uint8_t i = 0; i < _portCount; i++) {
+        if ((portMask & (1u << i)) && _ports[i].kfd) selected |= (1u << i);
+    }
+    if (!selected) return false;
+
+    _plan = plan;
+    const uint16_t total = (uint16_t)_plan.keyCount();
+
+    portENTER_CRITICAL(&_mux);
+    for (uint8_t i = 0; i < _portCount; i++) {
+        if (!_ports[i].kfd) continue;
+        PortStatus& st = _ports[i].st;
+        memset(&st, 0, sizeof(st));
+        st.total = total;
+        if (selected & (1u << i)) {
+            st.state = PORT_RUNNING;
+            strncpy(st.status, "Waiting...", sizeof(st.status) - 1);
+        }
+    }
+    _activePorts = __builtin_popcount(selected);
+    _running = true;
+    _generation++;
+    portEXIT_CRITICAL(&_mux);
+
+    for (uint8_t i = 0; i < _portCount; i++) {
+        if (selected & (1u << i)) xTaskNotifyGive(_ports[i].task);
+    }
+    return true;
+}
+
+void FleetLoader::abort() {
+    for (uint8_t i = 0; i < _portCount; i++) {
+        if (_ports[i].kfd && _ports[i].st.state == PORT_RUNNING) _ports[i].kfd->abort();
+    }
+}
+
+FleetLoader::PortStatus FleetLoader::status(uint8_t port) const {
+    PortStatus st = {};
+    if (port >= _portCount) return st;
+    portENTER_CRITICAL(&_mux);
+    st = _ports[port].st;
+    portEXIT_CRITICAL(&_mux);
+    return st;
+}
+
+bool FleetLoader::isRadioConnected(uint8_t port) {
+    return port < _portCount && _ports[port].hal && _ports[port].hal->isRadioConnected();
+}
+
+// =============================================================================
+// Port tasks
+// =============================================================================
+
+void FleetLoader::portTask(void* arg) {
+    FleetLoader::instance().portLoop((uint8_t)(uintptr_t)arg);
+}
+
+void FleetLoader::setStatus(uint8_t idx, PortState state, int current, int total, const char* msg) {
+    Port& p = _ports[idx];
+    portENTER_CRITICAL(&_mux);
+    p.st.state = state;
+    p.st.current = (uint16_t)current;
+    p.st.total = (uint16_t)total;
+    p.st.elapsedMs = millis() - p.startMs;
+    strncpy(p.st.status, msg ? msg : "", sizeof(p.st.status) - 1);
+    p.st.status[sizeof(p.st.status) - 1] = '\0';
+    _generation++;
+    portEXIT_CRITICAL(&_mux);
+}
+
+void FleetLoader::portLoop(uint8_t idx) {
+    Port& p = _ports[idx];
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        p.startMs = millis();
+        const int keyCount = (int)_plan.keyCount();
+
+        KFDProtocol::Result result = p.kfd->keyloadPlan(_plan, [this, idx](int current, int total, const char* status) {
+            setStatus(idx, PORT_RUNNING, current, total, status);
+        });
+
+        uint16_t ok = 0;
+        for (const auto& ks : result.keyStatus) {
+            if (ks.status == P25::STATUS_COMMAND_PERFORMED) ok++;
+        }
+
+        portENTER_CRITICAL(&_mux);
+        p.st.keysOk = ok;
+        p.st.keysFailed = (uint16_t)(keyCount - ok);
+        portEXIT_CRITICAL(&_mux);
+        setStatus(idx, result.success ? PORT_DONE : PORT_FAILED, keyCount, keyCount, result.message.c_str());
+        Metrics::recordOp(Metrics::OP_KEYLOAD_MULTI, p.st.elapsedMs * 1000, result.success);
+
+        portENTER_CRITICAL(&_mux);
+        bool last = --_activePorts == 0;
+        portEXIT_CRITICAL(&_mux);
+
+        Console.printf("[FLEET] Port %u: %s (%u ms)\n", idx, result.message.c_str(), (unsigned)p.st.elapsedMs);
+
+        // The last port out wipes the shared key material
+        if (last) {
+            _plan.clear();
+            portENTER_CRITICAL(&_mux);
+            _running = false;
+            _generation++;
+            portEXIT_CRITICAL(&_mux);
+        }
+    }
+}
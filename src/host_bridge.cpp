@@ -0,0 +1,498 @@
+/**
+ * @file host_bridge.cpp
+ * @brief USB CDC host bridge implementation
+ */
+
+#include "host_bridge.h"
+#include "console.h"
+#include "device_info.h"
+#include "metrics.h"
+#include <esp_timer.h>
+#include <algorithm>
+#include <vector>
+
+// Frame delimiters and escapes (KFDtool adapter serial protocol)
+static const uint8_t SOM = 0x61;
+static const uint8_t SOM_PLACEHOLDER = 0x91;
+static const uint8_t EOM = 0x63;
+static const uint8_t EOM_PLACEHOLDER = 0x93;
+static const uint8_t ESC = 0x62;
+static const uint8_t ESC_PLACEHOLDER = 0x92;
+
+// KFDtool adapter commands
+enum : uint8_t {
+    CMD_READ          = 0x11,
+    CMD_WRITE_INFO    = 0x12,
+    CMD_ENTER_BSL     = 0x13,
+    CMD_RESET         = 0x14,
+    CMD_SELF_TEST     = 0x15,
+    CMD_SEND_KEY_SIG  = 0x16,
+    CMD_SEND_BYTE     = 0x17,
+
+    RSP_ERROR         = 0x20,
+    RSP_READ          = 0x21,
+    RSP_RESET         = 0x24,
+    RSP_SELF_TEST     = 0x25,
+    RSP_SEND_KEY_SIG  = 0x26,
+    RSP_SEND_BYTE     = 0x27,
+
+    BCST_RECEIVE_BYTE = 0x31,
+
+    // Bridge extensions
+    CMD_KMM_EXCHANGE  = 0x40,
+    CMD_SESSION_OPEN  = 0x41,
+    CMD_SESSION_CLOSE = 0x42,
+    CMD_READ_STATS    = 0x43,
+    CMD_EXIT          = 0x4F,
+    RSP_KMM_EXCHANGE  = 0x50,
+    RSP_SESSION_OPEN  = 0x51,
+    RSP_SESSION_CLOSE = 0x52,
+    RSP_READ_STATS    = 0x53,
+    RSP_EXIT          = 0x5F,
+};
+
+// CMD_READ items
+enum : uint8_t {
+    READ_AP_VER     = 0x01,
+    READ_FW_VER     = 0x02,
+    READ_UNIQUE_ID  = 0x03,
+    READ_MODEL_ID   = 0x04,
+    READ_HW_REV     = 0x05,
+    READ_SER_NUM    = 0x06,
+};
+
+// RSP_ERROR codes
+enum : uint8_t {
+    ERR_OTHER              = 0x00,
+    ERR_INVALID_CMD_LENGTH = 0x01,
+    ERR_INVALID_CMD_OPCODE = 0x02,
+    ERR_INVALID_READ_OPCODE = 0x03,
+    ERR_BUSY               = 0x10,   // Bridge: KFD operation running elsewhere
+    ERR_RADIO              = 0x11,   // Bridge: no session / no reply (text follows)
+};
+
+static const uint8_t AP_VERSION[3] = { 2, 0, 0 };
+static const uint8_t MODEL_ID = 0x01;
+
+static const size_t FRAME_QUEUE_BYTES = 4096;
+static const size_t SERIAL_RX_BUFFER = 4096;
+static const uint32_t RX_TASK_STACK = 3072;
+static const uint32_t CMD_TASK_STACK = 8192;
+static const uint32_t RADIO_POLL_MS = 2;     // Byte mode: radio bytes reach the host within ~1 byte time
+
+HostBridge& HostBridge::instance() {
+    static HostBridge inst;
+    return inst;
+}
+
+HostBridge::HostBridge() : _hal(nullptr), _kfd(nullptr), _rxTask(nullptr), _cmdTask(nullptr),
+                           _frames(nullptr), _active(false), _stopRequested(false), _byteMode(false),
+                           _session(nullptr), _kfdDebug(false), _halDebug(false), _stats() {}
+
+bool HostBridge::start(TWI_HAL* hal, KFDProtocol* kfd) {
+    if (_active) return true;
+    if (!hal || !kfd) return false;
+    _hal = hal;
+    _kfd = kfd;
+
+    if (!_frames) {
+        _frames = xRingbufferCreate(FRAME_QUEUE_BYTES, RINGBUF_TYPE_NOSPLIT);
+        if (!_frames) return false;
+    }
+
+    // Nothing but frames on the port from here on: all text goes through
+    // Console, and debug output isn't even formatted
+    Console.setMuted(true);
+    _kfdDebug = kfd->isDebugEnabled();
+    _halDebug = hal->isDebugEnabled();
+    kfd->setDebug(false);
+    hal->enableDebug(false);
+    Serial.setRxBufferSize(SERIAL_RX_BUFFER);
+    while (Serial.available()) Serial.read();
+
+    _byteMode = false;
+    _stopRequested = false;
+    _active = true;
+
+    // Command task on the protocol core, deframing next to the USB stack
+    if ((!_cmdTask && xTaskCreatePinnedToCore(cmdTask, "bridge_cmd", CMD_TASK_STACK, this, 3, &_cmdTask, 0) != pdPASS) ||
+        (!_rxTask && xTaskCreatePinnedToCore(rxTask, "bridge_rx", RX_TASK_STACK, this, 2, &_rxTask, 1) != pdPASS)) {
+        _active = false;
+        kfd->setDebug(_kfdDebug);
+        hal->enableDebug(_halDebug);
+        Console.setMuted(false);
+        return false;
+    }
+    return true;
+}
+
+void HostBridge::stop() {
+    if (!_active) return;
+    // The command task closes the session and restores debug output
+    _stopRequested = true;
+}
+
+// =============================================================================
+// RX task - deframes USB bytes into the frame queue
+// =============================================================================
+
+void HostBridge::rxTask(void* arg) {
+    static_cast<HostBridge*>(arg)->rxLoop();
+}
+
+void HostBridge::rxLoop() {
+    size_t len = 0;
+    bool inFrame = false;
+    bool escaped = false;
+    uint8_t chunk[64];
+
+    for (;;) {
+        if (!_active) {
+            inFrame = false;
+            vTaskDelay(pdMS_TO_TICKS(50));
+            continue;
+        }
+
+        int avail = Serial.available();
+        if (avail <= 0) {
+            vTaskDelay(1);
+            continue;
+        }
+
+        size_t n = Serial.readBytes(chunk, std::min<size_t>(sizeof(chunk), (size_t)avail));
+        for (size_t i = 0; i < n; i++) {
+            uint8_t b = chunk[i];
+
+            if (b == SOM) {
+                // A SOM inside a frame abandons the partial one
+                if (inFrame) _stats.badFrames++;
+                inFrame = true;
+                escaped = false;
+                len = 0;
+                continue;
+            }
+            if (!inFrame) continue;
+
+            if (b == EOM) {
+                inFrame = false;
+                if (escaped || len == 0) {
+                    _stats.badFrames++;
+                } else if (xRingbufferSend(_frames, _rxFrame, len, 0) != pdTRUE) {
+                    _stats.overruns++;
+                } else {
+                    _stats.framesRx++;
+                }
+                continue;
+            }
+
+            if (escaped) {
+                escaped = false;
+                if (b == SOM_PLACEHOLDER) b = SOM;
+                else if (b == EOM_PLACEHOLDER) b = EOM;
+                else if (b == ESC_PLACEHOLDER) b = ESC;
+                else { _stats.badFrames++; inFrame = false; continue; }
+            } else if (b == ESC) {
+                escaped = true;
+                continue;
+            }
+
+            if (len >= sizeof(_rxFrame)) {
+                _stats.badFrames++;
+                inFrame = false;
+                continue;
+            }
+            _rxFrame[len++] = b;
+        }
+    }
+}
+
+// =============================================================================
+// Command task - one command at a time, TWI timing runs here
+// =============================================================================
+
+void HostBridge::cmdTask(void* arg) {
+    static_cast<HostBridge*>(arg)->cmdLoop();
+}
+
+void HostBridge::cmdLoop() {
+    for (;;) {
+        if (_stopRequested) {
+            closeSession();
+            setByteMode(false);
+            _kfd->setDebug(_kfdDebug);
+            _hal->enableDebug(_halDebug);
+            _stopRequested = false;
+            _active = false;
+            Console.setMuted(false);
+            Console.println("\n[BRIDGE] Host bridge off - text console");
+        }
+        if (!_active) {
+            vTaskDelay(pdMS_TO_TICKS(50));
+            continue;
+        }
+
+        size_t len = 0;
+        TickType_t wait = _byteMode ? pdMS_TO_TICKS(RADIO_POLL_MS) : pdMS_TO_TICKS(50);
+        uint8_t* frame = (uint8_t*)xRingbufferReceive(_frames, &len, wait);
+        if (frame) {
+            handleFrame(frame, len);
+            vRingbufferReturnItem(_frames, frame);
+        }
+        if (_byteMode) forwardRadioBytes();
+    }
+}
+
+void HostBridge::setByteMode(bool on) {
+    if (on == _byteMode) return;
+    // The host reads the RX ring byte by byte between commands, so the port
+    // stays claimed from the first key signature/byte until byte mode ends
+    if (on) _kfd->beginOperation();     // Nested in the command's claim - can't fail
+    else _kfd->endOperation();
+    _byteMode = on;
+}
+
+void HostBridge::forwardRadioBytes() {
+    uint8_t b;
+    while (_hal->available() && _hal->receiveByte(&b, 1)) {
+        const uint8_t bcst[3] = { BCST_RECEIVE_BYTE, 0x00, b };
+        send(bcst, sizeof(bcst));
+    }
+}
+
+void HostBridge::handleFrame(const uint8_t* frame, size_t len) {
+    const uint8_t op = frame[0];
+    const uint8_t* args = frame + 1;
+    const size_t argLen = len - 1;
+
+    // Direct line access and KMMs both need the port to ourselves - claimed
+    // for the whole command, so the UI or the worker can't start one midway
+    bool needsPort = (op == CMD_RESET || op == CMD_SELF_TEST || op == CMD_SEND_KEY_SIG || op == CMD_SEND_BYTE ||
+                      op == CMD_KMM_EXCHANGE || op == CMD_SESSION_OPEN);
+    if (needsPort && !_kfd->beginOperation()) {
+        sendError(ERR_BUSY, "Operation in progress");
+        return;
+    }
+
+    switch (op) {
+    case CMD_READ:
+        handleRead(args, argLen);
+        break;
+
+    case CMD_RESET:
+        // Adapter reset = bridge state reset; the USB link stays up
+        closeSession();
+        setByteMode(false);
+        _hal->flushRx();
+        sendByteRsp(RSP_RESET);
+        break;
+
+    case CMD_SELF_TEST: {
+        const uint8_t rsp[2] = { RSP_SELF_TEST, _hal->selfTest() };
+        send(rsp, sizeof(rsp));
+        break;
+    }
+
+    case CMD_SEND_KEY_SIG:
+        closeSession();
+        _hal->flushRx();
+        _hal->sendKeySignature();
+        setByteMode(true);
+        sendByteRsp(RSP_SEND_KEY_SIG);
+        break;
+
+    case CMD_SEND_BYTE:
+        // Reserved byte, data byte
+        if (argLen != 2) { sendError(ERR_INVALID_CMD_LENGTH); break; }
+        _hal->sendByte(args[1]);
+        setByteMode(true);
+        sendByteRsp(RSP_SEND_BYTE);
+        break;
+
+    case CMD_KMM_EXCHANGE:
+        handleKmmExchange(args, argLen);
+        break;
+
+    case CMD_SESSION_OPEN: {
+        setByteMode(false);
+        // A held session that dropped since the last command reconnects here
+        if (!_session) _session = new KFDProtocol::Session(*_kfd);
+        else _session->reopen();
+        if (!_session->ok()) {
+            closeSession();
+            sendError(ERR_RADIO, "Failed to connect to radio");
+            break;
+        }
+        const uint8_t rsp[2] = { RSP_SESSION_OPEN,
+                                 (uint8_t)(_session->deviceType() == KFDProtocol::DEVICE_KVL ?
+                                           P25::TWI_READY_MODE_KVL : P25::TWI_READY_MODE_MR) };
+        send(rsp, sizeof(rsp));
+        break;
+    }
+
+    case CMD_SESSION_CLOSE:
+        closeSession();
+        sendByteRsp(RSP_SESSION_CLOSE);
+        break;
+
+    case CMD_READ_STATS: {
+        uint8_t rsp[1 + 16];
+        rsp[0] = RSP_READ_STATS;
+        const uint32_t v[4] = { _stats.framesRx, _stats.framesTx, _stats.badFrames, _stats.overruns };
+        for (int i = 0; i < 4; i++) {
+            rsp[1 + i * 4] = (v[i] >> 24) & 0xFF;
+            rsp[2 + i * 4] = (v[i] >> 16) & 0xFF;
+            rsp[3 + i * 4] = (v[i] >> 8) & 0xFF;
+            rsp[4 + i * 4] = v[i] & 0xFF;
+        }
+        send(rsp, sizeof(rsp));
+        break;
+    }
+
+    case CMD_EXIT:
+        sendByteRsp(RSP_EXIT);
+        Serial.flush();
+        stop();
+        break;
+
+    default:
+        // CMD_WRITE_INFO / CMD_ENTER_BSL are adapter manufacturing commands
+        sendError(ERR_INVALID_CMD_OPCODE);
+        break;
+    }
+    if (needsPort) _kfd->endOperation();
+}
+
+void HostBridge::handleRead(const uint8_t* args, size_t len) {
+    if (len != 1) {
+        sendError(ERR_INVALID_CMD_LENGTH);
+        return;
+    }
+
+    const DeviceInfo& info = DeviceManager::instance().getInfo();
+    uint8_t rsp[2 + 16];
+    size_t n = 0;
+    rsp[n++] = RSP_READ;
+    rsp[n++] = args[0];
+
+    switch (args[0]) {
+    case READ_AP_VER:
+        memcpy(&rsp[n], AP_VERSION, sizeof(AP_VERSION));
+        n += sizeof(AP_VERSION);
+        break;
+
+    case READ_FW_VER: {
+        // "major.minor.patch" -> three bytes
+        unsigned v[3] = { 0, 0, 0 };
+        sscanf(info.firmwareVer, "%u.%u.%u", &v[0], &v[1], &v[2]);
+        for (unsigned x : v) rsp[n++] = (uint8_t)x;
+        break;
+    }
+
+    case READ_UNIQUE_ID: {
+        // Length-prefixed, 0 when absent
+        rsp[n++] = 4;
+        for (int shift = 24; shift >= 0; shift -= 8) rsp[n++] = (info.uniqueId >> shift) & 0xFF;
+        break;
+    }
+
+    case READ_MODEL_ID:
+        rsp[n++] = MODEL_ID;
+        break;
+
+    case READ_HW_REV: {
+        unsigned major = 0, minor = 0;
+        sscanf(info.hardwareRev, "%u.%u", &major, &minor);
+        rsp[n++] = (uint8_t)major;
+        rsp[n++] = (uint8_t)minor;
+        break;
+    }
+
+    case READ_SER_NUM: {
+        size_t sl = strnlen(info.serialNumber, 12);
+        rsp[n++] = (uint8_t)sl;
+        memcpy(&rsp[n], info.serialNumber, sl);
+        n += sl;
+        break;
+    }
+
+    default:
+        sendError(ERR_INVALID_READ_OPCODE);
+        return;
+    }
+
+    send(rsp, n);
+}
+
+void HostBridge::handleKmmExchange(const uint8_t* args, size_t len) {
+    if (len < 2 + 10) {
+        sendError(ERR_INVALID_CMD_LENGTH);
+        return;
+    }
+    setByteMode(false);
+
+    uint32_t timeoutMs = ((uint32_t)args[0] << 8) | args[1];
+    if (timeoutMs == 0) timeoutMs = 5000;
+
+    std::vector<uint8_t> reply;
+    uint64_t t0 = esp_timer_get_time();
+    KFDProtocol::Result r = _kfd->exchangeKmm(args + 2, len - 2, reply, timeoutMs);
+    Metrics::recordOp(Metrics::OP_KMM_EXCHANGE, (uint32_t)(esp_timer_get_time() - t0), r.success);
+    if (!r.success) {
+        sendError(ERR_RADIO, r.message.c_str());
+        return;
+    }
+
+    // Reply KMM behind the response opcode - built in place
+    std::vector<uint8_t> rsp;
+    rsp.reserve(1 + reply.size());
+    rsp.push_back(RSP_KMM_EXCHANGE);
+    rsp.insert(rsp.end(), reply.begin(), reply.end());
+    if (!send(rsp.data(), rsp.size())) sendError(ERR_OTHER, "Reply too long");
+}
+
+void HostBridge::closeSession() {
+    if (!_session) return;
+    delete _session;
+    _session = nullptr;
+}
+
+// =============================================================================
+// Response framing
+// =============================================================================
+
+bool HostBridge::send(const uint8_t* payload, size_t len) {
+    size_t n = 0;
+    _txBuf[n++] = SOM;
+    for (size_t i = 0; i < len; i++) {
+        // Room for an escaped byte and EOM, else nothing goes out
+        if (n + 3 > sizeof(_txBuf)) return false;
+        uint8_t b = payload[i];
+        if (b == SOM) { _txBuf[n++] = ESC; _txBuf[n++] = SOM_PLACEHOLDER; }
+        else if (b == EOM) { _txBuf[n++] = ESC; _txBuf[n++] = EOM_PLACEHOLDER; }
+        else if (b == ESC) { _txBuf[n++] = ESC; _txBuf[n++] = ESC_PLACEHOLDER; }
+        else _txBuf[n++] = b;
+    }
+    _txBuf[n++] = EOM;
+
+    // One write per frame - the CDC driver sends it as whole USB packets
+    Serial.write(_txBuf, n);
+    _stats.framesTx++;
+    return true;
+}
+
+void HostBridge::sendByteRsp(uint8_t rsp) {
+    send(&rsp, 1);
+}
+
+void HostBridge::sendError(uint8_t code, const char* message) {
+    uint8_t rsp[2 + 64];
+    size_t n = 0;
+    rsp[n++] = RSP_ERROR;
+    rsp[n++] = code;
+    if (message) {
+        size_t ml = strnlen(message, sizeof(rsp) - n);
+        memcpy(&rsp[n], message, ml);
+        n += ml;
+    }
+    send(rsp, n);
+}
@@ -4,56 +4,18 @@
  */
 
 #include "kfd_protocol.h"
+#include "console.h"
+#include "crypto.h"
+#include "crc16.h"
+#include "metrics.h"
+#include "trace.h"
 #include <Arduino.h>
+#include <esp_timer.h>
 #include <stdarg.h>
+#include <string.h>
+#include <algorithm>
 
 namespace P25 {
-    // CRC16 table from TIA 102.AACD-A Annex A (same as KFDtool)
-    static const uint16_t crc16Table[256] = {
-        0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
-        0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7,
-        0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E,
-        0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876,
-        0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD,
-        0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5,
-        0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C,
-        0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974,
-        0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB,
-        0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3,
-        0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A,
-        0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72,
-        0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9,
-        0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1,
-        0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738,
-        0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70,
-        0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7,
-        0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF,
-        0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036,
-        0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E,
-        0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5,
-        0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD,
-        0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134,
-        0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C,
-        0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3,
-        0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB,
-        0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232,
-        0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A,
-        0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1,
-        0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9,
-        0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330,
-        0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78
-    };
-    
-    uint16_t calculateCrc16(const uint8_t* data, size_t len) {
-        uint16_t crc = 0xFFFF;
-        for (size_t i = 0; i < len; i++) {
-            crc = (uint16_t)(crc16Table[data[i] ^ (crc & 0xFF)] ^ (crc >> 8));
-        }
-        // Note: KFDtool reference does NOT do final XOR, even though TIA spec says to
-        // The self-test "123456789" = 0x6F91 (not 0x906E) matches KFDtool behavior
-        return crc;
-    }
-    
     bool validateKeysetId(int id) { return id >= 1 && id <= 255; }
     bool validateSln(int sln, bool isKek) {
         if (isKek) return sln >= 0xF000 && sln <= 0xFFFF;
@@ -68,29 +30,38 @@ namespace P25 {
 }
 
 KFDProtocol::KFDProtocol() : _hal(nullptr), _initialized(false), _debug(true),
-                             _operationInProgress(false), _mrEmulatorRunning(false),
+                             _opOwner(nullptr), _opDepth(0), _mrEmulatorRunning(false),
                              _abortRequested(false), _useFastSend(true), 
-                             _postReadyDelayUs(0) {}
+                             _batchKeyload(true), _postReadyDelayUs(0),
+                             _radioModel("default"), _modelDelayUs(0), _modelResponseUs(0),
+                             _linkBase(), _linkTiming(), _linkProbing(false), _crcErrors(0), _linkErrMark(0), _rxMark(),
+                             _txEndUs(0), _replyPending(false),
+                             _firstKmmPending(false),
+                             _sessionOpen(false), _sessionBroken(false), _sessionDepth(0),
+                             _sessionHandles(0), _sessionLastUs(0), _sessionIdleTimeoutMs(3000),
+                             _sessionType(DEVICE_NONE),
+                             _mrTask(nullptr), _mrDeliverTask(nullptr), _mrKeyQueue(nullptr),
+                             _mrStats(), _mrHalDebug(false), _mrSelfStop(false),
+                             _workerTask(nullptr), _opQueue(nullptr), _eventQueue(nullptr),
+                             _asyncBusy(false), _asyncSyncErase(false) {
+    _asyncKeysMux = portMUX_INITIALIZER_UNLOCKED;
+}
 
 KFDProtocol::~KFDProtocol() { stopMrEmulator(); }
 
-bool KFDProtocol::init(TWI_HAL* hal) {
+bool KFDProtocol::init(TWI_HAL* hal, bool async) {
     if (!hal) return false;
     _hal = hal;
+    _linkBase = _linkTiming = hal->getLineTiming();
     
-    // CRC self-test - verify our algorithm matches KFDtool reference
-    // Test vector: CRC of "123456789" = 0x6F91 (KFDtool) or 0x906E (TIA with complement)
-    // KFDtool does NOT do final complement, so we expect 0x6F91
-    const uint8_t testData[] = {'1','2','3','4','5','6','7','8','9'};
-    uint16_t testCrc = P25::calculateCrc16(testData, 9);
-    
-    // Also test with our actual frame structure
-    const uint8_t testFrame[] = {0x00, 0xFF, 0xFF, 0xFF};  // control + destRSI
-    uint16_t frameCrc = P25::calculateCrc16(testFrame, 4);
+    // CRC self-test - verify the table path matches the KFDtool reference
+    // ("123456789" = 0x6F91, no final complement) and that the ROM path agrees
+    if (!Crc16::selfTest(_debug)) {
+        Console.println("[KFD] CRC self-test FAILED - frames will not validate");
+    }
     
-    if (_debug) {
-        Serial.printf("[KFD] CRC self-test: '123456789' = 0x%04X (expected 0x6F91 for KFDtool compat)\n", testCrc);
-        Serial.printf("[KFD] CRC of [00 FF FF FF] = 0x%04X\n", frameCrc);
+    if (async && !startWorker()) {
+        Console.println("[KFD] Failed to start worker task - async operations unavailable");
     }
     
     _initialized = true;
@@ -119,11 +90,11 @@ bool KFDProtocol::detectMr(DeviceType* deviceType) {
     
     if (response == P25::TWI_READY_MODE_MR) {
         if (deviceType) *deviceType = DEVICE_MR;
-        endSession();
+        disconnect();
         return true;
     } else if (response == P25::TWI_READY_MODE_KVL) {
         if (deviceType) *deviceType = DEVICE_KVL;
-        endSession();
+        disconnect();
         return true;
     }
     
@@ -131,54 +102,508 @@ bool KFDProtocol::detectMr(DeviceType* deviceType) {
     return false;
 }
 
-bool KFDProtocol::beginSession(DeviceType* deviceType) {
-    if (!_initialized || !_hal) return false;
+// Margin on a model's observed READY_REQ answer time for the first window
+static const uint32_t READY_WINDOW_SLACK_MS = 20;
+
+bool KFDProtocol::handshake(DeviceType* deviceType) {
+    const ConnectConfig& cfg = _connectConfig;
+    uint64_t t0 = esp_timer_get_time();
+    uint32_t backoffMs = cfg.firstBackoffMs;
+    
+    // The window ends early on the start bit, so only a silent radio pays
+    // for a long one - wide enough that a slow model answers the first try
+    uint32_t windowMs = cfg.firstWindowMs;
+    if (_modelResponseUs > 0) {
+        windowMs = std::max(windowMs, 2 * _modelResponseUs / 1000 + READY_WINDOW_SLACK_MS);
+    }
+    windowMs = std::min(windowMs, cfg.maxWindowMs);
     
-    // Try multiple times - timing can be tricky
-    for (int attempt = 1; attempt <= 3; attempt++) {
+    bool keySignature = true;
+    uint8_t readyRetries = 0;
+    for (int attempt = 1; attempt <= cfg.maxAttempts; attempt++) {
         if (_debug) {
-            if (attempt == 1) Serial.println("[KFD] Beginning session...");
-            else Serial.printf("[KFD] Retry attempt %d...\n", attempt);
+            if (attempt == 1) Console.println("[KFD] Beginning session...");
+            else Console.printf("[KFD] Retry attempt %d (%s, window %u ms)...\n", attempt,
+                               keySignature ? "key signature" : "READY_REQ", windowMs);
         }
         
-        // Send key signature + READY_REQ
-        _hal->sendKeySignatureAndReadyReq();
+        // Drop anything left over from a previous exchange
+        _hal->flushRx();
+        Trace::record(Trace::EV_SESSION_BEGIN, 0, attempt);
+        
+        // Key signature + READY_REQ, or READY_REQ alone on a quick retry
+        uint64_t ksUs = esp_timer_get_time();
+        if (keySignature) {
+            _hal->sendKeySignatureAndReadyReq();
+            Metrics::recordPhase(Metrics::PH_KEY_SIGNATURE, (uint32_t)(esp_timer_get_time() - ksUs));
+        } else {
+            _hal->sendByte(P25::TWI_READY_REQ);
+        }
+        _connectStats.attempts++;
+        if (attempt > 1) Metrics::count(Metrics::CNT_HANDSHAKE_RETRIES);
         
         // Don't print before receive - radio responds fast!
+        // Wake on the start bit: a silent radio is retried after the window,
+        // a responding one only needs the rest of the byte
+        uint32_t responseUs = 0;
         uint8_t response;
-        if (_hal->receiveByte(&response, 2000)) {
+        if (_hal->waitForRxStart(windowMs * 1000, &responseUs) && _hal->receiveByte(&response, 20)) {
             // Don't print here - minimize delay!
             
-            if (response == P25::TWI_READY_MODE_MR) {
-                if (_debug) Serial.println("[KFD] Got 0xD0 - MR mode ready");
+            if (response == P25::TWI_READY_MODE_MR || response == P25::TWI_READY_MODE_KVL) {
                 // Small delay for radio to transition - tunable via setPostReadyDelay()
                 if (_postReadyDelayUs > 0) {
                     delayMicroseconds(_postReadyDelayUs);
                 }
-                if (deviceType) *deviceType = DEVICE_MR;
-                return true;
-            } else if (response == P25::TWI_READY_MODE_KVL) {
-                if (_debug) Serial.println("[KFD] Got 0xD1 - KVL mode ready");
-                if (_postReadyDelayUs > 0) {
-                    delayMicroseconds(_postReadyDelayUs);
-                }
-                if (deviceType) *deviceType = DEVICE_KVL;
+                
+                uint32_t connectUs = (uint32_t)(esp_timer_get_time() - t0);
+                _connectStats.sessions++;
+                _connectStats.lastConnectUs = connectUs;
+                _connectStats.lastResponseUs = responseUs;
+                _connectStats.lastAttempts = attempt;
+                // Decays so one slow answer doesn't widen the window for good
+                _modelResponseUs = std::max(responseUs, _modelResponseUs - _modelResponseUs / 4);
+                _connectStats.totalConnectUs += connectUs;
+                if (connectUs < _connectStats.minConnectUs) _connectStats.minConnectUs = connectUs;
+                if (connectUs > _connectStats.maxConnectUs) _connectStats.maxConnectUs = connectUs;
+                Metrics::recordPhase(Metrics::PH_READY_WAIT, responseUs);
+                Metrics::recordPhase(Metrics::PH_CONNECT, connectUs);
+                Metrics::count(Metrics::CNT_SESSIONS);
+                _firstKmmPending = true;
+                
+                // The first KMM follows immediately - no printing here,
+                // details are in the trace and getConnectStats()
+                bool mr = (response == P25::TWI_READY_MODE_MR);
+                Trace::record(Trace::EV_READY, response, attempt);
+                if (deviceType) *deviceType = mr ? DEVICE_MR : DEVICE_KVL;
                 return true;
             }
             
-            if (_debug) Serial.printf("[KFD] Unexpected response: 0x%02X (expected 0xD0 or 0xD1)\n", response);
+            if (_debug) Console.printf("[KFD] Unexpected response: 0x%02X (expected 0xD0 or 0xD1)\n", response);
+            keySignature = true;        // Out of step - start over
+            readyRetries = 0;
         } else {
-            if (_debug) Serial.println("[KFD] No response from radio!");
+            if (_debug) Console.println("[KFD] No response from radio!");
+            // Silence may just be a slow radio: ask again before signalling again
+            keySignature = readyRetries >= cfg.readyRetries;
+            readyRetries = keySignature ? 0 : readyRetries + 1;
+        }
+        
+        if (attempt == cfg.maxAttempts) break;
+        
+        // Short back-off before retry - in slices so abort() is honoured
+        for (uint32_t waited = 0; waited < backoffMs && !_abortRequested; waited += 10) {
+            delay(std::min<uint32_t>(10, backoffMs - waited));
+        }
+        if (_abortRequested) {
+            if (_debug) Console.println("[KFD] Session start aborted");
+            break;
         }
         
-        // Longer delay before retry
-        delay(500);
+        windowMs = std::min(windowMs * 2, cfg.maxWindowMs);
+        backoffMs = std::min(backoffMs * 2, cfg.maxBackoffMs);
     }
     
+    _connectStats.failures++;
+    Metrics::count(Metrics::CNT_HANDSHAKE_FAILS);
     return false;
 }
 
+void KFDProtocol::setRadioModel(const char* model, uint32_t postReadyDelayUs) {
+    _radioModel = (model && model[0]) ? model : "default";
+    _postReadyDelayUs = postReadyDelayUs;
+    _modelDelayUs = postReadyDelayUs;
+    _modelResponseUs = 0;
+    if (_debug) Console.printf("[KFD] Radio model '%s', post-0xD0 delay %u us\n",
+                              _radioModel.c_str(), postReadyDelayUs);
+    
+    // A new model starts at the standard timing until its own is restored
+    _linkTiming = _linkBase;
+    if (_hal) _hal->setLineTiming(_linkBase);
+}
+
+void KFDProtocol::noteFirstKmm(bool answered) {
+    if (!_firstKmmPending) return;
+    _firstKmmPending = false;
+    
+    if (answered) {
+        // This delay works for the model - remember it
+        if (_postReadyDelayUs != _modelDelayUs) {
+            _modelDelayUs = _postReadyDelayUs;
+            if (_debug) Console.printf("[KFD] Post-0xD0 delay %u us confirmed for '%s'\n",
+                                      _postReadyDelayUs, _radioModel.c_str());
+            if (_tuningCallback) _tuningCallback(_radioModel.c_str(), _postReadyDelayUs);
+        }
+        return;
+    }
+    
+    // Radio went quiet after 0xD0 - it may need longer to switch modes.
+    // Step the delay up for the next session; it is only saved once it works
+    static const uint32_t steps[] = { 500, 1000, 2000, 5000, 10000 };
+    for (uint32_t step : steps) {
+        if (step > _postReadyDelayUs) {
+            if (_debug) Console.printf("[KFD] First KMM unanswered - post-0xD0 delay %u -> %u us\n",
+                                      _postReadyDelayUs, step);
+            _postReadyDelayUs = step;
+            break;
+        }
+    }
+}
+
+// =============================================================================
+// Line Timing
+// =============================================================================
+
+// Bit rates tried by probeLink(), in order (setTxSpeed() takes 1-9 kbaud)
+static const uint8_t LINK_PROBE_KBAUD[] = { 5, 6, 7, 8, 9 };
+static const uint8_t LINK_PROBE_CANARIES = 3;       // Inventory commands per step
+static const uint32_t LINK_PROBE_TIMEOUT_MS = 1000; // Inventory answer at any sane rate
+static const uint32_t LINK_PROBE_SETTLE_MS = 50;    // Let the radio drop a garbled frame
+
+// Line time of one byte relative to the standard timing, in percent
+static uint32_t linkByteTimePct(const TWI_HAL::LineTiming& t, const TWI_HAL::LineTiming& base) {
+    uint32_t bits = 10 + t.stopBits + t.gapBits;
+    uint32_t baseBits = 10 + base.stopBits + base.gapBits;
+    return (bits * base.txKilobaud * 100) / (baseBits * t.txKilobaud);
+}
+
+void KFDProtocol::setLinkTiming(const TWI_HAL::LineTiming& timing) {
+    _linkTiming = timing;
+    if (_hal) _hal->setLineTiming(timing);
+    if (_debug && timing != _linkBase) {
+        Console.printf("[KFD] Line timing: TX %u / RX %u kbaud, %u stop, %u gap bits\n",
+                      timing.txKilobaud, timing.rxKilobaud, timing.stopBits, timing.gapBits);
+    }
+}
+
+uint32_t KFDProtocol::lineErrors() const {
+    TWI_HAL::RxStats rx = _hal->getRxStats();
+    return rx.parityErrors + rx.framingErrors + _crcErrors;
+}
+
+void KFDProtocol::fallBackLink(const char* reason) {
+    // Mid-session: the trace records it, text only in debug
+    Trace::record(Trace::EV_LINK_FALLBACK, _linkTiming.txKilobaud, _linkTiming.rxKilobaud);
+    if (_debug) Console.printf("[KFD] %s at TX %u / RX %u kbaud - back to standard timing\n",
+                               reason, _linkTiming.txKilobaud, _linkTiming.rxKilobaud);
+    _linkTiming = _linkBase;
+    _hal->setLineTiming(_linkBase);
+    Metrics::count(Metrics::CNT_LINK_FALLBACKS);
+    if (_linkCallback) _linkCallback(_radioModel.c_str(), _linkBase);
+}
+
+bool KFDProtocol::linkCanary(uint8_t count) {
+    uint32_t errors = lineErrors();
+    for (uint8_t i = 0; i < count; i++) {
+        if (_abortRequested) return false;
+        
+        const uint8_t* kmm = nullptr;
+        size_t len = 0;
+        if (!inventoryExchange(P25::INV_LIST_ACTIVE_KSET_IDS, nullptr, 0, kmm, len, LINK_PROBE_TIMEOUT_MS)) {
+            return false;
+        }
+        P25::KmmReader r(kmm, len);
+        if (!parseInventoryResponse(r, P25::INV_LIST_ACTIVE_KSET_IDS)) return false;
+    }
+    // A parity error on a byte the CRC happened to accept still fails the step
+    return lineErrors() == errors;
+}
+
+KFDProtocol::LinkTrial KFDProtocol::tryLinkTiming(const TWI_HAL::LineTiming& trial,
+                                                  const TWI_HAL::LineTiming& good) {
+    _hal->setLineTiming(trial);
+    _hal->flushRx();
+    if (linkCanary(LINK_PROBE_CANARIES)) return LINK_OK;
+    
+    if (_debug) Console.printf("[KFD] Probe: TX %u / RX %u kbaud, %u stop, %u gap failed (%s)\n",
+                              trial.txKilobaud, trial.rxKilobaud, trial.stopBits, trial.gapBits,
+                              _lastError.c_str());
+    
+    // Undo and make sure the radio still answers at the last good timing
+    _hal->setLineTiming(good);
+    delay(LINK_PROBE_SETTLE_MS);
+    _hal->flushRx();
+    if (_abortRequested) return LINK_LOST;
+    if (linkCanary(1)) return LINK_REJECTED;
+    
+    // It lost track of the session - start a new one
+    teardownSession(false);
+    delay(LINK_PROBE_SETTLE_MS);
+    if (beginSession() && linkCanary(1)) return LINK_REJECTED;
+    return LINK_LOST;
+}
+
+KFDProtocol::Result KFDProtocol::probeLink(ProgressCallback progress) {
+    if (!_initialized) return Result(false, "Not initialized");
+    if (!beginOperation()) return Result(false, "Operation in progress");
+    
+    _linkProbing = true;
+    
+    const int total = sizeof(LINK_PROBE_KBAUD) + 3 + 2;  // Speeds, stop bits 3-1, gap 1-0
+    int step = 0;
+    
+    // Start from the standard timing - a cached one may be what is failing
+    TWI_HAL::LineTiming good = _linkBase;
+    _hal->setLineTiming(good);
+    
+    if (progress) progress(0, total, "Connecting to radio...");
+    if (!beginSession()) {
+        _linkProbing = false;
+        _hal->setLineTiming(_linkTiming);
+        endOperation();
+        return Result(false, _abortRequested ? "Aborted by user" : "Failed to connect to radio");
+    }
+    
+    if (!linkCanary(LINK_PROBE_CANARIES)) {
+        std::string why = _lastError;
+        endSession();
+        _linkProbing = false;
+        _hal->setLineTiming(_linkTiming);
+        endOperation();
+        return Result(false, "Fails at standard timing: " + why);
+    }
+    
+    bool lost = false;
+    char buf[64];
+    
+    // Bit rate: the radio answering at our rate, else only our TX faster
+    for (uint8_t kb : LINK_PROBE_KBAUD) {
+        step++;
+        if (kb <= good.txKilobaud) continue;
+        snprintf(buf, sizeof(buf), "Trying %u kbaud...", kb);
+        if (progress) progress(step, total, buf);
+        
+        TWI_HAL::LineTiming t = good;
+        t.txKilobaud = kb;
+        t.rxKilobaud = kb;
+        LinkTrial r = tryLinkTiming(t, good);
+        if (r == LINK_REJECTED && good.rxKilobaud != kb) {
+            t.rxKilobaud = good.rxKilobaud;
+            r = tryLinkTiming(t, good);
+        }
+        if (r == LINK_OK) good = t;
+        else { lost = (r == LINK_LOST); break; }
+    }
+    
+    // Stop bits, then the inter-byte gap, at the best rate
+    for (uint8_t sb = good.stopBits - 1; !lost && sb >= 1; sb--) {
+        step = sizeof(LINK_PROBE_KBAUD) + (4 - sb);
+        snprintf(buf, sizeof(buf), "Trying %u stop bits...", sb);
+        if (progress) progress(step, total, buf);
+        
+        TWI_HAL::LineTiming t = good;
+        t.stopBits = sb;
+        LinkTrial r = tryLinkTiming(t, good);
+        if (r == LINK_OK) good = t;
+        else { lost = (r == LINK_LOST); break; }
+    }
+    for (int gap = (int)good.gapBits - 1; !lost && gap >= 0; gap--) {
+        step = sizeof(LINK_PROBE_KBAUD) + 3 + (2 - gap);
+        snprintf(buf, sizeof(buf), "Trying %d gap bits...", gap);
+        if (progress) progress(step, total, buf);
+        
+        TWI_HAL::LineTiming t = good;
+        t.gapBits = (uint8_t)gap;
+        LinkTrial r = tryLinkTiming(t, good);
+        if (r == LINK_OK) good = t;
+        else { lost = (r == LINK_LOST); break; }
+    }
+    
+    _hal->setLineTiming(good);
+    if (_sessionOpen) endSession();
+    _linkProbing = false;
+    
+    Result result;
+    if (lost) {
+        // The radio did not come back - keep the timing proven before the loss
+        result.success = false;
+        result.message = _abortRequested ? "Aborted by user" : "Radio lost during probe";
+    } else {
+        result.success = true;
+        result.status = P25::STATUS_COMMAND_PERFORMED;
+    }
+    
+    if (good != _linkTiming) {
+        _linkTiming = good;
+        if (_linkCallback) _linkCallback(_radioModel.c_str(), good);
+    }
+    
+    snprintf(buf, sizeof(buf), "TX %u / RX %u kbaud, %u stop, %u gap - %u%% line time",
+             good.txKilobaud, good.rxKilobaud, good.stopBits, good.gapBits,
+             (unsigned)linkByteTimePct(good, _linkBase));
+    if (result.success) result.message = buf;
+    else result.message += std::string(" - ") + buf;
+    if (progress) progress(total, total, result.success ? "Complete!" : "Incomplete");
+    if (_debug) Console.printf("[KFD] Link probe: %s\n", result.message.c_str());
+    
+    endOperation();
+    return result;
+}
+
+// =============================================================================
+// Port Ownership
+// =============================================================================
+
+bool KFDProtocol::claimPort(TaskHandle_t owner) {
+    TaskHandle_t none = nullptr;
+    if (!_opOwner.compare_exchange_strong(none, owner)) return false;
+    _opDepth = 1;
+    _abortRequested = false;    // Fresh claims only - an abort of a queued op stands
+    return true;
+}
+
+bool KFDProtocol::beginOperation() {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    if (_opOwner.load() == self) {
+        _opDepth++;
+        return true;
+    }
+    return claimPort(self);
+}
+
+void KFDProtocol::endOperation() {
+    if (_opDepth > 0 && --_opDepth > 0) return;
+    _opOwner.store(nullptr);
+}
+
+// =============================================================================
+// Session Management
+// =============================================================================
+
+bool KFDProtocol::beginSession(DeviceType* deviceType) {
+    if (!_initialized || !_hal) return false;
+    
+    if (_sessionOpen) {
+        const char* stale = sessionStale();
+        if (!stale) {
+            _sessionDepth++;
+            _connectStats.reused++;
+            if (deviceType) *deviceType = _sessionType;
+            if (_debug) Console.println("[KFD] Joining open session");
+            return true;
+        }
+        if (_debug) Console.printf("[KFD] Session dropped (%s) - reconnecting\n", stale);
+        teardownSession(strcmp(stale, "SENSE lost") != 0);
+    }
+    
+    DeviceType type = DEVICE_NONE;
+    if (!handshake(&type)) {
+        // A radio that is plugged in but ignores us may not take the faster
+        // READY_REQ - try once more at the standard timing
+        if (_linkProbing || _linkTiming == _linkBase || _abortRequested || !isRadioConnected()) return false;
+        fallBackLink("No answer to key signature");
+        if (!handshake(&type)) return false;
+    }
+    
+    _linkErrMark = lineErrors();
+    _rxMark = _hal->getRxStats();
+    _sessionOpen = true;
+    _sessionBroken = false;
+    _sessionDepth = 1;
+    _sessionType = type;
+    _sessionLastUs = esp_timer_get_time();
+    if (deviceType) *deviceType = type;
+    return true;
+}
+
 void KFDProtocol::endSession() {
+    if (!_sessionOpen) return;
+    
+    _sessionLastUs = esp_timer_get_time();
+    if (!_sessionBroken && !_abortRequested) {
+        // An outer operation or a Session handle keeps it open
+        if (_sessionDepth > 0) _sessionDepth--;
+        if (_sessionDepth > 0 || _sessionHandles > 0) return;
+    }
+    teardownSession(true);
+}
+
+bool KFDProtocol::holdSession() {
+    if (!beginSession()) return false;
+    _sessionDepth--;        // Held by the handles, not by an operation
+    return true;
+}
+
+const char* KFDProtocol::sessionStale() {
+    if (!isRadioConnected()) return "SENSE lost";
+    if (_sessionBroken) return "no response";
+    if (_abortRequested) return "aborted";
+    if (_sessionIdleTimeoutMs > 0 &&
+        esp_timer_get_time() - _sessionLastUs > (uint64_t)_sessionIdleTimeoutMs * 1000) {
+        return "idle timeout";
+    }
+    return nullptr;
+}
+
+void KFDProtocol::teardownSession(bool graceful) {
+    Trace::record(Trace::EV_SESSION_END, graceful);
+    
+    // Radio gone - nobody to say goodbye to
+    uint64_t t0 = esp_timer_get_time();
+    if (graceful) disconnect();
+    else if (_hal) _hal->disableInterface();
+    if (graceful) Metrics::recordPhase(Metrics::PH_TEARDOWN, (uint32_t)(esp_timer_get_time() - t0));
+    if (_hal) {
+        TWI_HAL::RxStats rx = _hal->getRxStats();
+        Metrics::count(Metrics::CNT_PARITY_ERRORS, rx.parityErrors - _rxMark.parityErrors);
+        Metrics::count(Metrics::CNT_FRAMING_ERRORS, rx.framingErrors - _rxMark.framingErrors);
+    }
+    
+    // Parity/framing errors at a cached timing - the next session runs standard
+    if (!_linkProbing && _linkTiming != _linkBase && lineErrors() != _linkErrMark) {
+        fallBackLink("Line errors");
+    }
+    
+    _sessionOpen = false;
+    _sessionDepth = 0;
+    _firstKmmPending = false;
+}
+
+KFDProtocol::Session::Session(KFDProtocol& kfd) : _kfd(nullptr) {
+    if (!kfd.beginOperation()) return;  // Another task has the port
+    // Held even if the handshake fails - the next operation connects
+    _kfd = &kfd;
+    kfd._sessionHandles++;
+    kfd.holdSession();
+    kfd.endOperation();
+}
+
+KFDProtocol::Session::Session(Session&& other) : _kfd(other._kfd) {
+    other._kfd = nullptr;
+}
+
+bool KFDProtocol::Session::ok() const {
+    return _kfd && _kfd->_sessionOpen && !_kfd->_sessionBroken;
+}
+
+KFDProtocol::DeviceType KFDProtocol::Session::deviceType() const {
+    return ok() ? _kfd->_sessionType : DEVICE_NONE;
+}
+
+bool KFDProtocol::Session::reopen() {
+    if (!_kfd || !_kfd->beginOperation()) return false;
+    bool up = (_kfd->_sessionOpen && !_kfd->sessionStale()) || _kfd->holdSession();
+    _kfd->endOperation();
+    return up;
+}
+
+void KFDProtocol::Session::close() {
+    if (!_kfd) return;
+    KFDProtocol& kfd = *_kfd;
+    _kfd = nullptr;
+    bool claimed = kfd.beginOperation();
+    if (kfd._sessionHandles > 0) kfd._sessionHandles--;
+    // Last handle, no operation inside: end it (radio gone - nobody to tell).
+    // If another task's operation is running, its endSession() ends it.
+    if (claimed) {
+        if (kfd._sessionHandles == 0 && kfd._sessionOpen && kfd._sessionDepth == 0) {
+            kfd.teardownSession(kfd.isRadioConnected());
+        }
+        kfd.endOperation();
+    }
+}
+
+void KFDProtocol::disconnect() {
     if (!_hal) return;
     _hal->sendByte(P25::TWI_TRANSFER_DONE);
     
@@ -196,173 +621,219 @@ void KFDProtocol::endSession() {
 
 bool KFDProtocol::sendKmm(const std::vector<uint8_t>& kmm) {
     if (!_hal) return false;
-    auto frame = buildKmmFrame(kmm);
     
-    // Debug: print entire frame
-    if (_debug) {
-        Serial.printf("[KFD] KMM frame hex (%d bytes): ", frame.size());
-        for (size_t i = 0; i < frame.size(); i++) {
-            Serial.printf("%02X ", frame[i]);
-        }
-        Serial.println();
+    P25::KmmWriter w(_txFrame, sizeof(_txFrame));
+    w.begin(P25::MSG_MODIFY_KEY_CMD);
+    w.put(kmm.data(), kmm.size());
+    size_t len = w.end();
+    if (len == 0) {
+        setError("KMM too large (%d bytes)", (int)kmm.size());
+        return false;
     }
     
+    return sendFrame(_txFrame, len);
+}
+
+bool KFDProtocol::sendFrame(const uint8_t* frame, size_t len) {
+    if (!_hal || !frame || len == 0) return false;
+    
     // Suppress debug during transmission for consistent timing
     bool debugWas = _hal->isDebugEnabled();
     _hal->enableDebug(false);
     
     // Send frame using fast mode for consistent timing
-    _hal->sendBytesFast(frame.data(), frame.size());
+    if (len > 7 && frame[0] == P25::TWI_KMM) Trace::record(Trace::EV_KMM_TX, frame[7], len);
+    uint64_t t0 = esp_timer_get_time();
+    bool sent = _hal->sendBytesFast(frame, len);
+    if (sent) noteFrameSent(t0);
     
     _hal->enableDebug(debugWas);
+    if (!sent) {
+        noteTxFailed();
+        return false;
+    }
     
-    if (_debug) Serial.printf("[TWI] Sent %d bytes (normal mode)\n", frame.size());
-    
-    // Check line state immediately after send
-    if (_debug) {
-        bool isIdle = _hal->isLineIdle();
-        Serial.printf("[KFD] Line after TX: %s\n", isIdle ? "HIGH (idle)" : "LOW (radio responding?)");
-        
-        // Poll line state for 100ms to see if it changes
-        uint32_t start = millis();
-        while ((millis() - start) < 100) {
-            if (_hal->isLineBusy()) {
-                Serial.printf("[KFD] Line went LOW at +%dms!\n", (int)(millis() - start));
-                break;
-            }
-            delayMicroseconds(100);
+    // No line poll here: the receiver buffers the reply, the trace records
+    // the radio's first edge and Metrics times the turnaround
+    return true;
+}
+
+void KFDProtocol::noteTxFailed() {
+    // The frame never finished going out - the radio saw part of it at best
+    setError("Transmit timeout");
+    if (_sessionOpen) _sessionBroken = true;
+}
+
+void KFDProtocol::noteFrameSent(uint64_t startUs) {
+    _txEndUs = esp_timer_get_time();
+    _replyPending = true;
+    Metrics::recordPhase(Metrics::PH_TX_FRAME, (uint32_t)(_txEndUs - startUs));
+}
+
+bool KFDProtocol::receiveKmm(std::vector<uint8_t>& kmm, uint32_t timeoutMs) {
+    const uint8_t* p = nullptr;
+    size_t len = 0;
+    if (!receiveKmm(p, len, timeoutMs)) return false;
+    kmm.assign(p, p + len);
+    return true;
+}
+
+bool KFDProtocol::readFrameBody(size_t len, uint32_t timeoutMs) {
+    if (len < 2 || len > sizeof(_rxFrame)) return false;
+    
+    // Drain the receive buffer - the receiver keeps decoding while we copy,
+    // and the CRC is accumulated per chunk so it is ready when the last byte lands
+    uint8_t* body = _rxFrame;
+    size_t got = 0;
+    size_t crcEnd = len - 2;
+    Crc16::Kmm crc;
+    while (got < len) {
+        size_t n = 0;
+        if (!_hal->receiveBytes(&body[got], len - got, &n, timeoutMs)) {
+            Metrics::count(Metrics::CNT_RX_TIMEOUTS);
+            setError("Timeout at byte %d of %d", (int)got, (int)len);
+            return false;
         }
+        if (got < crcEnd) crc.update(&body[got], std::min(n, crcEnd - got));
+        got += n;
     }
     
+    uint16_t rxCrc = (uint16_t)body[len - 2] | ((uint16_t)body[len - 1] << 8);
+    if (rxCrc != crc.value()) {
+        Trace::record(Trace::EV_CRC_ERROR, 0, rxCrc);
+        setError("KMM CRC mismatch: received 0x%04X, computed 0x%04X", rxCrc, crc.value());
+        _crcErrors++;
+        Metrics::count(Metrics::CNT_CRC_ERRORS);
+        if (!_linkProbing && _linkTiming != _linkBase) fallBackLink("KMM CRC error");
+        return false;
+    }
     return true;
 }
 
-bool KFDProtocol::receiveKmm(std::vector<uint8_t>& kmm, uint32_t timeoutMs) {
+bool KFDProtocol::receiveKmm(const uint8_t*& kmm, size_t& kmmLen, uint32_t timeoutMs) {
+    kmm = nullptr;
+    kmmLen = 0;
     if (!_hal) return false;
     
-    if (_debug) Serial.printf("[KFD] Waiting for KMM response (timeout=%dms)...\n", timeoutMs);
-    
+    // No printing until the frame is in - the radio answers while we wait.
+    // Waking on the start bit times the radio's turnaround (from the end of
+    // our frame) apart from the frame itself.
     uint8_t opcode;
-    if (!_hal->receiveByte(&opcode, timeoutMs)) {
-        if (_debug) Serial.println("[KFD] No KMM opcode received");
+    uint32_t turnaroundUs = 0;
+    bool answered = _hal->waitForRxStart(timeoutMs * 1000, &turnaroundUs);
+    uint64_t rxStartUs = esp_timer_get_time();
+    answered = answered && _hal->receiveByte(&opcode, timeoutMs);
+    noteFirstKmm(answered);
+    bool replyPending = _replyPending;
+    _replyPending = false;
+    if (!answered) {
+        Metrics::count(Metrics::CNT_RX_TIMEOUTS);
+        if (_debug) Console.println("[KFD] No KMM opcode received");
+        // Don't reuse a session the radio may have abandoned
+        _sessionBroken = true;
         return false;
     }
-    
-    if (_debug) Serial.printf("[KFD] Got opcode: 0x%02X\n", opcode);
+    _sessionLastUs = esp_timer_get_time();
     
     // If opcode is 0xC3 (unknown/error), just dump all bytes we can receive
     if (opcode == 0xC3) {
-        if (_debug) Serial.println("[KFD] Got 0xC3 (possible CRC error response) - dumping raw response...");
-        std::vector<uint8_t> raw;
-        raw.push_back(opcode);
+        if (_debug) Console.println("[KFD] Got 0xC3 (possible CRC error response) - dumping raw response...");
+        uint8_t* raw = _rxFrame;
+        size_t rawLen = 0;
+        raw[rawLen++] = opcode;
         
         // Keep reading bytes until timeout (with short timeout between bytes)
         uint8_t b;
         while (_hal->receiveByte(&b, 500)) {  // 500ms timeout between bytes
-            raw.push_back(b);
-            if (raw.size() > 100) break;  // Safety limit
+            raw[rawLen++] = b;
+            if (rawLen > 100) break;  // Safety limit
         }
         
-        Serial.printf("[KFD] 0xC3 response (%d bytes): ", raw.size());
-        for (size_t i = 0; i < raw.size(); i++) {
-            Serial.printf("%02X ", raw[i]);
+        Console.printf("[KFD] 0xC3 response (%d bytes): ", rawLen);
+        for (size_t i = 0; i < rawLen; i++) {
+            Console.printf("%02X ", raw[i]);
         }
-        Serial.println();
+        Console.println();
         
         // Try to interpret the response
-        if (raw.size() >= 8) {
-            Serial.println("[KFD] Interpreting 0xC3 response:");
-            Serial.printf("  Bytes 1-2: 0x%02X%02X (possibly length or error code)\n", raw[1], raw[2]);
-            Serial.printf("  Bytes 3-4: 0x%02X%02X (possibly error details)\n", raw[3], raw[4]);
-            Serial.printf("  Bytes 5-6: 0x%02X%02X (0x84=AES256, 0x83=unknown)\n", raw[5], raw[6]);
-            Serial.printf("  Byte 7: 0x%02X\n", raw[7]);
+        if (rawLen >= 8) {
+            Console.println("[KFD] Interpreting 0xC3 response:");
+            Console.printf("  Bytes 1-2: 0x%02X%02X (possibly length or error code)\n", raw[1], raw[2]);
+            Console.printf("  Bytes 3-4: 0x%02X%02X (possibly error details)\n", raw[3], raw[4]);
+            Console.printf("  Bytes 5-6: 0x%02X%02X (0x84=AES256, 0x83=unknown)\n", raw[5], raw[6]);
+            Console.printf("  Byte 7: 0x%02X\n", raw[7]);
         }
         
         // Return the raw response so caller can analyze
         kmm = raw;
+        kmmLen = rawLen;
         return true;  // We got a response, just not what we expected
     }
     
     // Standard KMM (0xC2) handling
     if (opcode != P25::TWI_KMM) {
-        if (_debug) Serial.printf("[KFD] Unexpected opcode (expected 0xC2)\n");
+        if (_debug) Console.printf("[KFD] Unexpected opcode (expected 0xC2)\n");
         // Try to read more bytes to see what the radio is sending
         if (_debug) {
-            Serial.print("[KFD] Debug - reading more bytes: ");
+            Console.print("[KFD] Debug - reading more bytes: ");
             for (int i = 0; i < 10; i++) {
                 uint8_t b;
                 if (_hal->receiveByte(&b, 100)) {
-                    Serial.printf("%02X ", b);
+                    Console.printf("%02X ", b);
                 } else {
                     break;
                 }
             }
-            Serial.println();
+            Console.println();
         }
         return false;
     }
     
     uint8_t lenHi, lenLo;
     if (!_hal->receiveByte(&lenHi, timeoutMs)) {
-        if (_debug) Serial.println("[KFD] Timeout reading length high byte");
+        if (_debug) Console.println("[KFD] Timeout reading length high byte");
         return false;
     }
     if (!_hal->receiveByte(&lenLo, timeoutMs)) {
-        if (_debug) Serial.println("[KFD] Timeout reading length low byte");
+        if (_debug) Console.println("[KFD] Timeout reading length low byte");
         return false;
     }
     uint16_t len = ((uint16_t)lenHi << 8) | lenLo;
     
-    if (_debug) Serial.printf("[KFD] Frame length: %d bytes\n", len);
-    
-    if (len < 6 || len > 512) {
-        if (_debug) Serial.printf("[KFD] Invalid length, reading raw bytes...\n");
-        Serial.print("[KFD] Raw bytes: ");
-        Serial.printf("%02X %02X ", lenHi, lenLo);
+    if (len < 6 || len > P25::TWI_MAX_FRAME_LEN) {
+        if (_debug) Console.printf("[KFD] Invalid length, reading raw bytes...\n");
+        Console.print("[KFD] Raw bytes: ");
+        Console.printf("%02X %02X ", lenHi, lenLo);
         for (int i = 0; i < 20; i++) {
             uint8_t b;
             if (_hal->receiveByte(&b, 100)) {
-                Serial.printf("%02X ", b);
+                Console.printf("%02X ", b);
             } else {
                 break;
             }
         }
-        Serial.println();
+        Console.println();
         return false;
     }
     
-    std::vector<uint8_t> body(len);
-    for (size_t i = 0; i < len; i++) {
-        if (!_hal->receiveByte(&body[i], timeoutMs)) {
-            if (_debug) Serial.printf("[KFD] Timeout at byte %d of %d\n", i, len);
-            return false;
-        }
-    }
-    
-    if (_debug) {
-        Serial.printf("[KFD] Raw frame (%d bytes): ", len);
-        for (size_t i = 0; i < len && i < 20; i++) {
-            Serial.printf("%02X ", body[i]);
-        }
-        if (len > 20) Serial.print("...");
-        Serial.println();
+    if (!readFrameBody(len, timeoutMs)) {
+        if (_debug) Console.printf("[KFD] %s\n", _lastError.c_str());
+        return false;
     }
+    uint8_t* body = _rxFrame;
     
     // Skip control and dest RSI (4 bytes), extract KMM body (excluding 2-byte CRC)
     if (len > 6) {
-        kmm.assign(body.begin() + 4, body.end() - 2);
+        kmm = body + 4;
+        kmmLen = len - 6;
     } else {
-        kmm.assign(body.begin(), body.end());
-    }
-    
-    if (_debug) {
-        Serial.printf("[KFD] Received KMM body (%d bytes): ", kmm.size());
-        for (size_t i = 0; i < kmm.size() && i < 16; i++) {
-            Serial.printf("%02X ", kmm[i]);
-        }
-        if (kmm.size() > 16) Serial.print("...");
-        Serial.println();
+        kmm = body;
+        kmmLen = len;
     }
+    Trace::record(Trace::EV_KMM_RX, kmmLen > 0 ? kmm[0] : 0, kmmLen);
+    // A byte already buffered has no start time (latency 0)
+    if (replyPending && turnaroundUs > 0) Metrics::recordPhase(Metrics::PH_TURNAROUND, turnaroundUs);
+    Metrics::recordPhase(Metrics::PH_RX_FRAME, (uint32_t)(esp_timer_get_time() - rxStartUs));
     
     return true;
 }
@@ -417,108 +888,20 @@ std::vector<uint8_t> KFDProtocol::buildModifyKeyCommand(const P25::KeyItem& key)
 
 std::vector<uint8_t> KFDProtocol::buildKmmFrame(const std::vector<uint8_t>& kmmBody, uint8_t messageId, uint8_t responseKind) {
     // Build complete KMM frame for TWI transmission
-    // Reference: ThreeWireProtocol.CreateKmmFrame() and KmmFrame.ToBytesWithPreamble()
-    
-    // First, build the inner KMM Frame (KmmFrame.ToBytes())
-    std::vector<uint8_t> kmmFrame;
-    
-    // Message ID
-    kmmFrame.push_back(messageId);
-    
-    // Message Length (7 + body length)
-    int messageLength = 7 + kmmBody.size();
-    kmmFrame.push_back((messageLength >> 8) & 0xFF);
-    kmmFrame.push_back(messageLength & 0xFF);
-    
-    // Message Format - bits 7,6 = ResponseKind (0b11 = Immediate, 0b10 = Delayed)
-    kmmFrame.push_back(responseKind);
-    
-    // Destination RSI (3 bytes)
-    kmmFrame.push_back(0xFF);
-    kmmFrame.push_back(0xFF);
-    kmmFrame.push_back(0xFF);
-    
-    // Source RSI (3 bytes)
-    kmmFrame.push_back(0xFF);
-    kmmFrame.push_back(0xFF);
-    kmmFrame.push_back(0xFF);
-    
-    // KMM Body
-    kmmFrame.insert(kmmFrame.end(), kmmBody.begin(), kmmBody.end());
-    
-    // CRITICAL: For THREE-WIRE protocol, KFDtool does NOT use preamble!
-    // Preamble is only for DLI (Data Link Independent) over UDP/IP
-    // Reference: ManualRekeyApplication.cs - WithPreamble = false for ThreeWireProtocol
-    bool usePreamble = false;
-    
-    std::vector<uint8_t> fullKmm;
-    
-    if (usePreamble) {
-        // Build the preamble (ToBytesWithPreamble)
-        std::vector<uint8_t> preamble;
-        preamble.push_back(0x00);  // Version
-        preamble.push_back(0x00);  // MFID
-        preamble.push_back(0x80);  // AlgID (clear)
-        preamble.push_back(0x00);  // Key ID high
-        preamble.push_back(0x00);  // Key ID low
-        // MI (Message Indicator) - 9 bytes of zeros
-        for (int i = 0; i < 9; i++) {
-            preamble.push_back(0x00);
-        }
-        
-        // Combine preamble + KMM frame
-        fullKmm.insert(fullKmm.end(), preamble.begin(), preamble.end());
-        fullKmm.insert(fullKmm.end(), kmmFrame.begin(), kmmFrame.end());
-        
-        if (_debug) Serial.println("[KFD] WITH preamble (14 bytes) - DLI mode");
-    } else {
-        // No preamble - standard for THREE-WIRE protocol
-        fullKmm = kmmFrame;
-        if (_debug) Serial.println("[KFD] NO preamble (THREE-WIRE mode)");
-    }
-    
-    // Now build the TWI frame (CreateKmmFrame)
-    std::vector<uint8_t> twiBody;
-    twiBody.push_back(0x00);  // Control
-    twiBody.push_back(0xFF);  // Dest RSI high
-    twiBody.push_back(0xFF);  // Dest RSI mid
-    twiBody.push_back(0xFF);  // Dest RSI low
-    twiBody.insert(twiBody.end(), fullKmm.begin(), fullKmm.end());
-    
-    // Calculate CRC over the body (control + destRSI + kmm)
-    uint16_t crc = P25::calculateCrc16(twiBody.data(), twiBody.size());
-    
-    // Debug: show CRC calculation details
-    if (_debug) {
-        Serial.printf("[KFD] CRC over %d bytes: ", twiBody.size());
-        for (size_t i = 0; i < twiBody.size() && i < 16; i++) {
-            Serial.printf("%02X ", twiBody[i]);
-        }
-        if (twiBody.size() > 16) Serial.print("...");
-        Serial.printf("\n[KFD] CRC = 0x%04X, sending LOW-HIGH order: %02X %02X\n", 
-                      crc, crc & 0xFF, (crc >> 8) & 0xFF);
-    }
-    
-    // Build final frame
-    std::vector<uint8_t> frame;
-    frame.push_back(P25::TWI_KMM);  // Opcode 0xC2
-    
-    // Length = body + CRC (2 bytes)
-    int length = twiBody.size() + 2;
-    frame.push_back((length >> 8) & 0xFF);
-    frame.push_back(length & 0xFF);
-    
-    // Body
-    frame.insert(frame.end(), twiBody.begin(), twiBody.end());
-    
-    // CRC byte order: KFDtool CalculateCrc() returns [low, high] and CreateKmmFrame adds them in that order
-    // So we send LOW byte first, then HIGH byte
-    frame.push_back(crc & 0xFF);          // CRC low byte first
-    frame.push_back((crc >> 8) & 0xFF);   // CRC high byte second
-    
-    if (_debug) {
-        Serial.printf("[KFD] KMM frame: msgID=0x%02X, len=%d, CRC=0x%04X (sent as %02X %02X)\n", 
-                      messageId, length, crc, crc & 0xFF, (crc >> 8) & 0xFF);
+    // Reference: ThreeWireProtocol.CreateKmmFrame() and KmmFrame.ToBytes()
+    // THREE-WIRE frames carry no preamble (KFDtool: WithPreamble = false)
+    std::vector<uint8_t> frame(P25::TWI_MAX_FRAME_BYTES);
+    
+    P25::KmmWriter w(frame.data(), frame.size());
+    w.begin(messageId, responseKind);
+    w.put(kmmBody.data(), kmmBody.size());
+    size_t len = w.end();
+    frame.resize(len);
+    
+    if (_debug && len > 0) {
+        uint16_t crc = frame[len - 2] | ((uint16_t)frame[len - 1] << 8);
+        Console.printf("[KFD] KMM frame: msgID=0x%02X, len=%d, CRC=0x%04X (sent as %02X %02X)\n", 
+                      messageId, (int)len - 3, crc, crc & 0xFF, (crc >> 8) & 0xFF);
     }
     
     return frame;
@@ -573,16 +956,84 @@ std::vector<uint8_t> KFDProtocol::buildModifyKeyCommand(const std::vector<P25::K
     return body;
 }
 
+void KFDProtocol::writeModifyKeyHeader(P25::KmmWriter& w, const P25::KeyItem& first, size_t count) {
+    // Same layout as buildModifyKeyCommand(), written in place
+    w.put(0x00);                       // Decryption instruction format
+    w.put(0x00);                       // Extended decryption instruction format
+    w.put(0x80);                       // KEK Algorithm ID (clear)
+    w.put16(0x0000);                   // KEK Key ID
+    w.put(first.keysetId & 0xFF);      // Keyset ID
+    w.put(first.algorithmId);          // Algorithm ID
+    w.put(first.key.size() & 0xFF);    // Key Length
+    w.put(count & 0xFF);               // Number of keys
+}
+
+void KFDProtocol::writeModifyKeyItem(P25::KmmWriter& w, const P25::KeyItem& key) {
+    w.put(key.erase ? 0x20 : 0x00);    // Key format (bit 5 = erase)
+    w.put16(key.sln);
+    w.put16(key.keyId);
+    w.put(key.key.data(), key.key.size());
+}
+
 std::vector<uint8_t> KFDProtocol::buildZeroizeCommand() {
     return { P25::MSG_ZEROIZE_CMD };
 }
 
+// =============================================================================
+// KMM Response parsers
+// =============================================================================
+// kmm starts at the message ID (see receiveKmm); the body follows the
+// 10-byte KMM header
+
+bool KFDProtocol::parseRekeyAck(const uint8_t* kmm, size_t len,
+                                std::vector<P25::KeyStatus>& status) {
+    status.clear();
+    P25::KmmReader r(kmm, len);
+    if (!r.valid() || r.messageId() != P25::MSG_REKEY_ACK) return false;
+    
+    // Some radios send an empty ack
+    if (r.remaining() == 0) return true;
+    
+    // Message ID acknowledged (1), number of items (2)
+    r.get();
+    uint16_t count = r.get16();
+    if (!r.ok()) return false;
+    
+    // Items: algorithm ID (1), key ID (2), status (1)
+    for (uint16_t i = 0; i < count && r.remaining() >= 4; i++) {
+        P25::KeyStatus ks;
+        ks.algorithmId = r.get();
+        ks.keyId = r.get16();
+        ks.status = r.get();
+        status.push_back(ks);
+    }
+    
+    return status.size() == count;
+}
+
+bool KFDProtocol::parseNegativeAck(const uint8_t* kmm, size_t len,
+                                   P25::OperationStatus& status) {
+    P25::KmmReader r(kmm, len);
+    if (!r.valid() || r.messageId() != P25::MSG_NEGATIVE_ACK) return false;
+    
+    // Message ID acknowledged (1), message number (2), status (1)
+    r.get();
+    r.get16();
+    uint8_t st = r.get();
+    if (!r.ok()) return false;
+    
+    status = (P25::OperationStatus)st;
+    return true;
+}
+
 KFDProtocol::Result KFDProtocol::testInventory() {
     if (!_initialized) return Result(false, "Not initialized");
+    if (!beginOperation()) return Result(false, "Operation in progress");
     
-    if (_debug) Serial.println("[KFD] === Testing with InventoryCommand ===");
+    if (_debug) Console.println("[KFD] === Testing with InventoryCommand ===");
     
     if (!beginSession()) {
+        endOperation();
         return Result(false, "Failed to connect");
     }
     
@@ -595,57 +1046,56 @@ KFDProtocol::Result KFDProtocol::testInventory() {
     // Build frame with InventoryCommand message ID (0x00) and Immediate response (0xC0)
     auto frame = buildKmmFrame(inventoryBody, P25::MSG_INVENTORY_CMD, 0xC0);
     
-    // Print COMPLETE frame hex before sending
-    if (_debug) {
-        Serial.printf("[KFD] Inventory frame (%d bytes): ", frame.size());
-        for (size_t i = 0; i < frame.size(); i++) {
-            Serial.printf("%02X ", frame[i]);
-        }
-        Serial.println();
-    }
-    
-    // Send immediately - no debug prints before sending!
+    // Send immediately - no debug prints before sending! The frame is in the trace.
+    bool halDebug = _hal->isDebugEnabled();
     _hal->enableDebug(false);
+    Trace::record(Trace::EV_KMM_TX, P25::MSG_INVENTORY_CMD, frame.size());
+    uint64_t txStartUs = esp_timer_get_time();
+    bool sent = true;
     if (_useFastSend) {
-        _hal->sendBytesFast(frame.data(), frame.size());
+        sent = _hal->sendBytesFast(frame.data(), frame.size());
     } else {
         for (size_t i = 0; i < frame.size(); i++) {
             _hal->sendByte(frame[i]);
         }
     }
-    _hal->enableDebug(true);
-    
-    if (_debug) Serial.printf("[TWI] Sent inventory (%d bytes)\n", frame.size());
-    
-    if (_debug) {
-        bool isIdle = _hal->isLineIdle();
-        Serial.printf("[KFD] Line after TX: %s\n", isIdle ? "HIGH (idle)" : "LOW (radio responding?)");
+    if (sent) noteFrameSent(txStartUs);
+    _hal->enableDebug(halDebug);
+    if (!sent) {
+        noteTxFailed();
+        endSession();
+        endOperation();
+        return Result(false, "Transmit timeout");
     }
     
     // Wait for response
     std::vector<uint8_t> response;
     if (!receiveKmm(response, 5000)) {
-        if (_debug) Serial.println("[KFD] No inventory response");
+        if (_debug) Console.println("[KFD] No inventory response");
         endSession();
+        endOperation();
         return Result(false, "No response to inventory");
     }
     
     if (_debug) {
-        Serial.printf("[KFD] Got inventory response: %d bytes, msgID=0x%02X\n", 
+        Console.printf("[KFD] Got inventory response: %d bytes, msgID=0x%02X\n", 
                       response.size(), response.empty() ? 0 : response[0]);
     }
     
     endSession();
+    endOperation();
     return Result(true, "Inventory succeeded");
 }
 
 KFDProtocol::Result KFDProtocol::testDESKey() {
     // Try loading an AES-256 key to SLN 202 (known working slot from user's radio)
     if (!_initialized) return Result(false, "Not initialized");
+    if (!beginOperation()) return Result(false, "Operation in progress");
     
-    if (_debug) Serial.println("[KFD] === Testing AES key at SLN 202 (known working slot) ===");
+    if (_debug) Console.println("[KFD] === Testing AES key at SLN 202 (known working slot) ===");
     
     if (!beginSession()) {
+        endOperation();
         return Result(false, "Failed to connect");
     }
     
@@ -675,175 +1125,567 @@ KFDProtocol::Result KFDProtocol::testDESKey() {
     
     auto frame = buildKmmFrame(body, P25::MSG_MODIFY_KEY_CMD, 0xC0);
     
-    if (_debug) {
-        Serial.printf("[KFD] AES@SLN202 frame hex (%d bytes): ", frame.size());
-        for (size_t i = 0; i < frame.size(); i++) {
-            Serial.printf("%02X ", frame[i]);
-        }
-        Serial.println();
-    }
-    
+    bool halDebug = _hal->isDebugEnabled();
     _hal->enableDebug(false);
+    Trace::record(Trace::EV_KMM_TX, P25::MSG_MODIFY_KEY_CMD, frame.size());
+    uint64_t txStartUs = esp_timer_get_time();
+    bool sent = true;
     if (_useFastSend) {
-        _hal->sendBytesFast(frame.data(), frame.size());
+        sent = _hal->sendBytesFast(frame.data(), frame.size());
     } else {
         for (size_t i = 0; i < frame.size(); i++) {
             _hal->sendByte(frame[i]);
         }
     }
-    _hal->enableDebug(true);
-    
-    if (_debug) Serial.printf("[TWI] Sent AES@SLN202 frame (%d bytes)\n", frame.size());
+    if (sent) noteFrameSent(txStartUs);
+    _hal->enableDebug(halDebug);
+    if (!sent) {
+        noteTxFailed();
+        endSession();
+        endOperation();
+        return Result(false, "Transmit timeout");
+    }
     
     std::vector<uint8_t> response;
     if (!receiveKmm(response, 5000)) {
-        if (_debug) Serial.println("[KFD] No response");
+        if (_debug) Console.println("[KFD] No response");
         endSession();
+        endOperation();
         return Result(false, "No response");
     }
     
     if (_debug) {
-        Serial.printf("[KFD] Response: %d bytes\n", response.size());
+        Console.printf("[KFD] Response: %d bytes\n", response.size());
     }
     
     endSession();
+    endOperation();
     return Result(true, "Test complete");
 }
 
 KFDProtocol::Result KFDProtocol::keyload(const P25::KeyItem& key) {
     if (!_initialized) return Result(false, "Not initialized");
-    if (_operationInProgress) return Result(false, "Operation in progress");
-    
-    _operationInProgress = true;
-    _abortRequested = false;
+    if (!beginOperation()) return Result(false, "Operation in progress");
     
     if (_debug) {
-        Serial.println("[KFD] === Starting keyload ===");
-        Serial.printf("[KFD] Keyset: %d, SLN: %d, KeyID: %d, Algo: 0x%02X\n",
+        Console.println("[KFD] === Starting keyload ===");
+        Console.printf("[KFD] Keyset: %d, SLN: %d, KeyID: %d, Algo: 0x%02X\n",
                       key.keysetId, key.sln, key.keyId, key.algorithmId);
     }
     
+    // CRITICAL: Minimize delay between getting 0xD0 and sending KMM!
+    // Radio may have timeout for expecting next command, so the frame is
+    // serialized into the session buffer before the handshake
+    P25::KmmWriter w(_txFrame, sizeof(_txFrame));
+    w.begin(P25::MSG_MODIFY_KEY_CMD);
+    writeModifyKeyHeader(w, key, 1);
+    writeModifyKeyItem(w, key);
+    size_t frameLen = w.end();
+    if (frameLen == 0) {
+        Crypto::secureZero(_txFrame, sizeof(_txFrame));
+        endOperation();
+        return Result(false, "Key too large for one frame");
+    }
+    
+    if (_debug) {
+        Console.printf("[KFD] Sending KMM: %d bytes, CRC computed\n", frameLen);
+    }
+    
     if (!beginSession()) {
-        _operationInProgress = false;
+        Crypto::secureZero(_txFrame, frameLen);
+        endOperation();
         return Result(false, "Failed to connect to radio");
     }
     
-    // CRITICAL: Minimize delay between getting 0xD0 and sending KMM!
-    // Radio may have timeout for expecting next command
-    
     // Disable HAL debug for faster TX (less serial output)
+    bool halDebug = _hal->isDebugEnabled();
     _hal->enableDebug(false);
     
-    // Build and send KMM immediately - don't print anything in between
-    auto kmm = buildModifyKeyCommand(key);
-    
-    // Print frame info BEFORE sending (debug happens after TX starts would be too late)
-    auto frame = buildKmmFrame(kmm);
-    if (_debug) {
-        Serial.printf("[KFD] Sending KMM: %d bytes, CRC computed\n", frame.size());
-    }
-    
     // Now send the pre-built frame directly using fast mode
-    _hal->sendBytesFast(frame.data(), frame.size());
-    
-    _hal->enableDebug(true);
-    if (_debug) Serial.println("[KFD] KMM sent, waiting for response...");
+    Trace::record(Trace::EV_KMM_TX, P25::MSG_MODIFY_KEY_CMD, frameLen);
+    uint64_t txStartUs = esp_timer_get_time();
+    bool sent = _hal->sendBytesFast(_txFrame, frameLen);
+    if (sent) noteFrameSent(txStartUs);
+    Crypto::secureZero(_txFrame, frameLen);   // Plaintext key
+    
+    _hal->enableDebug(halDebug);
+    if (!sent) {
+        noteTxFailed();
+        endSession();
+        endOperation();
+        return Result(false, "Transmit timeout");
+    }
     
     // Wait for radio to process and respond (10 seconds max)
-    std::vector<uint8_t> response;
-    if (!receiveKmm(response, 10000)) {
-        if (_debug) Serial.println("[KFD] No KMM response received");
+    const uint8_t* response = nullptr;
+    size_t responseLen = 0;
+    if (!receiveKmm(response, responseLen, 10000)) {
+        if (_debug) Console.println("[KFD] No KMM response received");
         
         endSession();
-        _operationInProgress = false;
+        endOperation();
         return Result(false, "No response from radio after keyload");
     }
     
     endSession();
-    _operationInProgress = false;
+    endOperation();
     
-    if (response.empty()) return Result(false, "Empty response");
+    if (responseLen == 0) return Result(false, "Empty response");
     
-    if (_debug) Serial.printf("[KFD] Response message ID: 0x%02X\n", response[0]);
+    if (_debug) Console.printf("[KFD] Response message ID: 0x%02X\n", response[0]);
     
     if (response[0] == P25::MSG_REKEY_ACK) {
-        if (_debug) Serial.println("[KFD] === KEY LOADED SUCCESSFULLY ===");
-        return Result(true, "Key loaded successfully");
-    } else if (response[0] == P25::MSG_NEGATIVE_ACK) {
-        P25::OperationStatus status = (response.size() > 2) ? (P25::OperationStatus)response[2] : P25::STATUS_INVALID_MN;
-        char buf[64];
+        std::vector<P25::KeyStatus> acks;
+        if (parseRekeyAck(response, responseLen, acks) && !acks.empty() &&
+            acks[0].status != P25::STATUS_COMMAND_PERFORMED) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "Key rejected: status 0x%02X", acks[0].status);
+            if (_debug) Console.printf("[KFD] %s\n", buf);
+            Result r(false, buf);
+            r.status = (P25::OperationStatus)acks[0].status;
+            r.keyStatus = acks;
+            return r;
+        }
+        if (_debug) Console.println("[KFD] === KEY LOADED SUCCESSFULLY ===");
+        Result r(true, "Key loaded successfully");
+        r.keyStatus = acks;
+        return r;
+    } else if (response[0] == P25::MSG_NEGATIVE_ACK) {
+        P25::OperationStatus status = P25::STATUS_INTERNAL_ERROR;
+        parseNegativeAck(response, responseLen, status);
+        char buf[64];
         snprintf(buf, sizeof(buf), "NAK received: status 0x%02X", status);
-        if (_debug) Serial.printf("[KFD] %s\n", buf);
+        if (_debug) Console.printf("[KFD] %s\n", buf);
         Result r(false, buf);
         r.status = status;
         return r;
     }
     
-    if (_debug) Serial.printf("[KFD] Unknown response: 0x%02X\n", response[0]);
+    if (_debug) Console.printf("[KFD] Unknown response: 0x%02X\n", response[0]);
     return Result(false, "Unexpected response");
 }
 
+std::vector<std::vector<size_t>> KFDProtocol::planKeyloadBatches(const std::vector<P25::KeyItem>& keys,
+                                                                 size_t maxPerKmm) {
+    // Group keys sharing keyset/algorithm/length (a Modify Key body carries
+    // those once), in order of first appearance, then cut each group into
+    // runs that fit in one TWI frame
+    std::vector<std::vector<size_t>> groups;
+    for (size_t i = 0; i < keys.size(); i++) {
+        const auto& k = keys[i];
+        bool placed = false;
+        for (auto& g : groups) {
+            const auto& first = keys[g[0]];
+            if (first.keysetId == k.keysetId && first.algorithmId == k.algorithmId &&
+                first.key.size() == k.key.size()) {
+                g.push_back(i);
+                placed = true;
+                break;
+            }
+        }
+        if (!placed) groups.push_back({i});
+    }
+    
+    const size_t fixed = P25::TWI_FRAME_OVERHEAD + P25::KMM_HEADER_LEN + P25::MODIFY_KEY_HEADER_LEN;
+    
+    std::vector<std::vector<size_t>> batches;
+    for (const auto& g : groups) {
+        size_t itemLen = P25::MODIFY_KEY_ITEM_OVERHEAD + keys[g[0]].key.size();
+        size_t perKmm = (P25::TWI_MAX_FRAME_LEN - fixed) / itemLen;
+        if (perKmm > 255) perKmm = 255;  // Number of keys is a single byte
+        if (perKmm > maxPerKmm) perKmm = maxPerKmm;
+        if (perKmm == 0) perKmm = 1;
+        
+        for (size_t i = 0; i < g.size(); i += perKmm) {
+            size_t n = std::min(perKmm, g.size() - i);
+            batches.emplace_back(g.begin() + i, g.begin() + i + n);
+        }
+    }
+    return batches;
+}
+
+void KFDProtocol::KeyloadPlan::clear() {
+    for (auto& f : frames) {
+        if (!f.wire.empty()) Crypto::secureZero(f.wire.data(), f.wire.size() * sizeof(uint16_t));
+    }
+    frames.clear();
+    keys.clear();
+}
+
+bool KFDProtocol::compilePlan(const std::vector<P25::KeyItem>& keys, KeyloadPlan& plan) {
+    plan.clear();
+    if (!_hal || keys.empty()) return false;
+    
+    plan.keys.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        plan.keys[i].keysetId = keys[i].keysetId;
+        plan.keys[i].sln = keys[i].sln;
+        plan.keys[i].keyId = keys[i].keyId;
+        plan.keys[i].algorithmId = keys[i].algorithmId;
+        plan.keys[i].status = P25::STATUS_INTERNAL_ERROR;
+    }
+    
+    auto batches = planKeyloadBatches(keys, _batchKeyload ? 255 : 1);
+    
+    // Local scratch: compiling runs on the UI task and must not touch
+    // _txFrame, which belongs to whoever holds the port
+    uint8_t frame[P25::TWI_MAX_FRAME_BYTES];
+    bool ok = true;
+    
+    for (const auto& batch : batches) {
+        P25::KmmWriter w(frame, sizeof(frame));
+        w.begin(P25::MSG_MODIFY_KEY_CMD);
+        writeModifyKeyHeader(w, keys[batch[0]], batch.size());
+        for (size_t idx : batch) writeModifyKeyItem(w, keys[idx]);
+        size_t len = w.end();
+        if (len == 0) {
+            ok = false;
+            break;
+        }
+        
+        KeyloadPlan::Frame f;
+        f.wire.resize(len);
+        _hal->encodeBytes(frame, len, f.wire.data());
+        f.keyIndex = batch;
+        plan.frames.push_back(std::move(f));
+    }
+    
+    // Plaintext copy is no longer needed
+    Crypto::secureZero(frame, sizeof(frame));
+    
+    if (!ok) {
+        plan.clear();
+        setError("Keyload batch does not fit in a frame");
+        return false;
+    }
+    
+    if (_debug) Console.printf("[KFD] Compiled keyload plan: %d keys in %d KMM(s)\n",
+                              (int)plan.keys.size(), (int)plan.frames.size());
+    
+    return !plan.frames.empty();
+}
+
 KFDProtocol::Result KFDProtocol::keyloadMultiple(const std::vector<P25::KeyItem>& keys,
                                                   ProgressCallback progress) {
     if (!_initialized) return Result(false, "Not initialized");
-    if (_operationInProgress) return Result(false, "Operation in progress");
     if (keys.empty()) return Result(false, "No keys to load");
     
-    _operationInProgress = true;
-    _abortRequested = false;
+    KeyloadPlan plan;
+    if (!compilePlan(keys, plan)) return Result(false, "Failed to build keyload");
+    return keyloadPlan(plan, progress);
+}
+
+KFDProtocol::Result KFDProtocol::keyloadPlan(const KeyloadPlan& plan, ProgressCallback progress) {
+    if (!_initialized) return Result(false, "Not initialized");
+    if (plan.empty()) return Result(false, "No keys to load");
+    if (!beginOperation()) return Result(false, "Operation in progress");
+    
+    const size_t total = plan.keys.size();
     
-    if (progress) progress(0, keys.size(), "Connecting to radio...");
+    Result result;
+    result.keyStatus = plan.keys;  // Status starts as "not attempted"
+    
+    if (progress) progress(0, total, "Connecting to radio...");
     
     if (!beginSession()) {
-        _operationInProgress = false;
-        return Result(false, "Failed to connect to radio");
+        endOperation();
+        return Result(false, _abortRequested ? "Aborted by user" : "Failed to connect to radio");
     }
     
-    int loaded = 0;
-    for (size_t i = 0; i < keys.size(); i++) {
+    const char* stopReason = nullptr;
+    size_t done = 0;
+    std::vector<P25::KeyStatus> acks;
+    acks.reserve(255);
+    
+    for (const auto& frame : plan.frames) {
         if (_abortRequested) {
-            endSession();
-            _operationInProgress = false;
-            return Result(false, "Aborted by user");
+            stopReason = "Aborted by user";
+            break;
         }
         
+        const auto& batch = frame.keyIndex;
+        
         char status[64];
-        snprintf(status, sizeof(status), "Loading key %d of %d...", (int)(i+1), (int)keys.size());
-        if (progress) progress(i, keys.size(), status);
+        if (batch.size() == 1) {
+            snprintf(status, sizeof(status), "Loading key %d of %d...", (int)(done + 1), (int)total);
+        } else {
+            snprintf(status, sizeof(status), "Loading keys %d-%d of %d...",
+                     (int)(done + 1), (int)(done + batch.size()), (int)total);
+        }
+        if (progress) progress(done, total, status);
         
-        auto kmm = buildModifyKeyCommand(keys[i]);
-        if (!sendKmm(kmm)) {
-            endSession();
-            _operationInProgress = false;
-            return Result(false, "Failed to send key");
+        // Frame is already CRC'd and wire-encoded
+        bool debugWas = _hal->isDebugEnabled();
+        _hal->enableDebug(false);
+        Trace::record(Trace::EV_KMM_TX, P25::MSG_MODIFY_KEY_CMD, frame.wire.size());
+        uint64_t txStartUs = esp_timer_get_time();
+        bool sent = _hal->sendEncoded(frame.wire.data(), frame.wire.size());
+        if (sent) noteFrameSent(txStartUs);
+        _hal->enableDebug(debugWas);
+        if (!sent) {
+            noteTxFailed();
+            stopReason = "Transmit timeout";
+            break;
         }
         
-        std::vector<uint8_t> response;
-        if (!receiveKmm(response, 5000)) {
-            endSession();
-            _operationInProgress = false;
-            return Result(false, "No response from radio");
+        const uint8_t* response = nullptr;
+        size_t responseLen = 0;
+        if (!receiveKmm(response, responseLen, 5000)) {
+            stopReason = "No response from radio";
+            break;
         }
         
-        if (response.empty() || response[0] != P25::MSG_REKEY_ACK) {
-            char buf[64];
-            snprintf(buf, sizeof(buf), "Key %d failed", (int)(i+1));
-            endSession();
-            _operationInProgress = false;
-            return Result(false, buf);
+        if (responseLen > 0 && response[0] == P25::MSG_REKEY_ACK) {
+            parseRekeyAck(response, responseLen, acks);
+            if (acks.empty()) {
+                // Ack without items - the whole KMM was accepted
+                for (size_t idx : batch) result.keyStatus[idx].status = P25::STATUS_COMMAND_PERFORMED;
+            } else {
+                for (size_t j = 0; j < batch.size(); j++) {
+                    size_t idx = batch[j];
+                    const P25::KeyStatus* match = nullptr;
+                    if (acks.size() == batch.size()) {
+                        // Items come back in command order
+                        match = &acks[j];
+                    } else {
+                        for (const auto& a : acks) {
+                            if (a.keyId == plan.keys[idx].keyId && a.algorithmId == plan.keys[idx].algorithmId) {
+                                match = &a;
+                                break;
+                            }
+                        }
+                    }
+                    result.keyStatus[idx].status = match ? match->status : P25::STATUS_KEY_NOT_LOADED;
+                }
+            }
+        } else if (responseLen > 0 && response[0] == P25::MSG_NEGATIVE_ACK) {
+            P25::OperationStatus nak = P25::STATUS_INTERNAL_ERROR;
+            parseNegativeAck(response, responseLen, nak);
+            if (_debug) Console.printf("[KFD] Batch NAK: status 0x%02X - continuing\n", nak);
+            for (size_t idx : batch) result.keyStatus[idx].status = nak;
+        } else {
+            if (_debug) Console.printf("[KFD] Unexpected response 0x%02X - continuing\n",
+                                      responseLen > 0 ? response[0] : 0);
         }
         
-        loaded++;
+        done += batch.size();
     }
     
-    if (progress) progress(keys.size(), keys.size(), "Complete!");
+    endSession();
+    endOperation();
+    
+    int loaded = 0;
+    int failed = 0;
+    for (const auto& ks : result.keyStatus) {
+        if (ks.status == P25::STATUS_COMMAND_PERFORMED) {
+            loaded++;
+        } else {
+            if (failed == 0) result.status = (P25::OperationStatus)ks.status;
+            failed++;
+        }
+    }
+    
+    if (progress) progress(total, total, failed == 0 ? "Complete!" : "Complete with errors");
+    
+    char buf[96];
+    if (failed == 0) {
+        snprintf(buf, sizeof(buf), "%d keys loaded successfully", loaded);
+        result.success = true;
+        result.status = P25::STATUS_COMMAND_PERFORMED;
+    } else if (stopReason) {
+        snprintf(buf, sizeof(buf), "%s - %d of %d keys loaded", stopReason, loaded, (int)total);
+    } else {
+        snprintf(buf, sizeof(buf), "%d of %d keys loaded, %d failed", loaded, (int)total, failed);
+    }
+    result.message = buf;
+    
+    return result;
+}
+
+// =============================================================================
+// Host-built KMMs
+// =============================================================================
+
+KFDProtocol::Result KFDProtocol::exchangeKmm(const uint8_t* kmm, size_t len, std::vector<uint8_t>& response,
+                                             uint32_t timeoutMs) {
+    response.clear();
+    if (!_initialized) return Result(false, "Not initialized");
+    
+    // Control + dest RSI + KMM + CRC must fit the TWI length field
+    const size_t twiLen = 4 + len + 2;
+    if (!kmm || len < 10 || twiLen > P25::TWI_MAX_FRAME_LEN) return Result(false, "Bad KMM length");
+    if (!beginOperation()) return Result(false, "Operation in progress");
+    
+    if (!beginSession()) {
+        endOperation();
+        return Result(false, _abortRequested ? "Aborted by user" : "Failed to connect to radio");
+    }
+    
+    _txFrame[0] = P25::TWI_KMM;
+    _txFrame[1] = (twiLen >> 8) & 0xFF;
+    _txFrame[2] = twiLen & 0xFF;
+    _txFrame[3] = 0x00;   // Control
+    _txFrame[4] = 0xFF;   // Dest RSI
+    _txFrame[5] = 0xFF;
+    _txFrame[6] = 0xFF;
+    memcpy(&_txFrame[7], kmm, len);
+    uint16_t crc = P25::calculateCrc16(&_txFrame[3], 4 + len);
+    _txFrame[7 + len] = crc & 0xFF;
+    _txFrame[8 + len] = (crc >> 8) & 0xFF;
+    
+    _lastError.clear();
+    Result result;
+    const uint8_t* rsp = nullptr;
+    size_t rspLen = 0;
+    bool sent = sendFrame(_txFrame, 9 + len);
+    Crypto::secureZero(_txFrame, 9 + len);   // The host's KMM may carry keys
+    if (sent && receiveKmm(rsp, rspLen, timeoutMs)) {
+        response.assign(rsp, rsp + rspLen);
+        result = Result(true, "OK");
+    } else {
+        result = Result(false, _lastError.empty() ? "No response from radio" : _lastError);
+    }
     
     endSession();
-    _operationInProgress = false;
+    endOperation();
+    return result;
+}
+
+// =============================================================================
+// Differential keyload
+// =============================================================================
+
+size_t KFDProtocol::diffKeys(const std::vector<P25::KeyItem>& wanted,
+                             const std::vector<P25::KeyStatus>& radio,
+                             bool eraseExtras, std::vector<P25::KeyItem>& out) {
+    out.clear();
+    
+    // Radio keys indexed by keyset/SLN - a slot holds one key
+    auto slot = [](uint16_t keysetId, uint16_t sln) {
+        return ((uint32_t)(keysetId & 0xFF) << 16) | sln;
+    };
+    std::vector<std::pair<uint32_t, size_t>> index;
+    index.reserve(radio.size());
+    for (size_t i = 0; i < radio.size(); i++) {
+        index.emplace_back(slot(radio[i].keysetId, radio[i].sln), i);
+    }
+    std::sort(index.begin(), index.end());
     
-    char buf[64];
-    snprintf(buf, sizeof(buf), "%d keys loaded successfully", loaded);
-    return Result(true, buf);
+    auto find = [&](uint32_t s) -> const P25::KeyStatus* {
+        auto it = std::lower_bound(index.begin(), index.end(), std::make_pair(s, (size_t)0));
+        return (it != index.end() && it->first == s) ? &radio[it->second] : nullptr;
+    };
+    
+    size_t unchanged = 0;
+    for (const auto& k : wanted) {
+        const P25::KeyStatus* have = k.erase ? nullptr : find(slot(k.keysetId, k.sln));
+        if (have && have->keyId == k.keyId && have->algorithmId == k.algorithmId) {
+            unchanged++;
+            continue;
+        }
+        out.push_back(k);  // Missing or different - Modify Key overwrites the slot
+    }
+    
+    if (!eraseExtras) return unchanged;
+    
+    // Only touch keysets the selection covers - the rest of the radio is
+    // not ours to clean up
+    std::vector<uint32_t> wantedSlots;
+    std::vector<uint8_t> keysets;
+    wantedSlots.reserve(wanted.size());
+    for (const auto& k : wanted) {
+        wantedSlots.push_back(slot(k.keysetId, k.sln));
+        if (std::find(keysets.begin(), keysets.end(), (uint8_t)k.keysetId) == keysets.end()) {
+            keysets.push_back((uint8_t)k.keysetId);
+        }
+    }
+    std::sort(wantedSlots.begin(), wantedSlots.end());
+    
+    for (const auto& r : radio) {
+        if (std::find(keysets.begin(), keysets.end(), r.keysetId) == keysets.end()) continue;
+        if (std::binary_search(wantedSlots.begin(), wantedSlots.end(), slot(r.keysetId, r.sln))) continue;
+        
+        P25::KeyItem e;
+        e.keysetId = r.keysetId;
+        e.sln = r.sln;
+        e.keyId = r.keyId;
+        e.algorithmId = r.algorithmId;
+        e.isKek = P25::getKeyType(r.sln) == P25::KEY_TYPE_KEK;
+        e.erase = true;
+        out.push_back(e);
+    }
+    return unchanged;
+}
+
+KFDProtocol::Result KFDProtocol::syncKeys(const std::vector<P25::KeyItem>& keys, bool eraseExtras,
+                                          ProgressCallback progress) {
+    if (!_initialized) return Result(false, "Not initialized");
+    if (keys.empty()) return Result(false, "No keys to load");
+    
+    // Held across the inventory and the load - nothing gets in between
+    if (!beginOperation()) return Result(false, "Operation in progress");
+    Result result = runSync(keys, eraseExtras, progress);
+    endOperation();
+    return result;
+}
+
+KFDProtocol::Result KFDProtocol::runSync(const std::vector<P25::KeyItem>& keys, bool eraseExtras,
+                                         ProgressCallback progress) {
+    _syncStats = SyncStats();
+    _syncStats.selected = keys.size();
+    
+    if (progress) progress(0, keys.size(), "Connecting to radio...");
+    
+    // Inventory and load share one session
+    Session session(*this);
+    if (!session) return Result(false, _abortRequested ? "Aborted by user" : "Failed to connect to radio");
+    
+    if (progress) progress(0, keys.size(), "Reading radio inventory...");
+    
+    std::vector<P25::KeyStatus> radio;
+    Result inv = viewKeyInfo(radio);
+    if (!inv.success) return Result(false, "Inventory failed: " + inv.message);
+    if (_abortRequested) return Result(false, "Aborted by user");
+    
+    std::vector<P25::KeyItem> needed;
+    size_t unchanged = diffKeys(keys, radio, eraseExtras, needed);
+    
+    _syncStats.radioKeys = radio.size();
+    _syncStats.unchanged = unchanged;
+    for (const auto& k : needed) {
+        if (k.erase) _syncStats.toErase++;
+        else _syncStats.toLoad++;
+    }
+    
+    if (_debug) Console.printf("[KFD] Sync: radio %u keys, %u selected, %u unchanged, %u to load, %u to erase\n",
+                              _syncStats.radioKeys, _syncStats.selected, _syncStats.unchanged,
+                              _syncStats.toLoad, _syncStats.toErase);
+    
+    if (needed.empty()) {
+        if (progress) progress(1, 1, "Complete!");
+        char buf[64];
+        snprintf(buf, sizeof(buf), "Radio up to date - %d keys unchanged", (int)unchanged);
+        return Result(true, buf);
+    }
+    
+    KeyloadPlan plan;
+    bool built = compilePlan(needed, plan);
+    for (auto& k : needed) {
+        if (!k.key.empty()) Crypto::secureZero(k.key.data(), k.key.size());
+    }
+    if (!built) return Result(false, "Failed to build keyload");
+    
+    Result result = keyloadPlan(plan, progress);
+    
+    char buf[96];
+    snprintf(buf, sizeof(buf), "%s (%d unchanged", result.message.c_str(), (int)unchanged);
+    result.message = buf;
+    if (_syncStats.toErase > 0) {
+        snprintf(buf, sizeof(buf), ", %d erased", _syncStats.toErase);
+        result.message += buf;
+    }
+    result.message += ")";
+    return result;
 }
 
 KFDProtocol::Result KFDProtocol::eraseKey(uint16_t keysetId, uint16_t sln) {
@@ -856,42 +1698,187 @@ KFDProtocol::Result KFDProtocol::eraseKey(uint16_t keysetId, uint16_t sln) {
 
 KFDProtocol::Result KFDProtocol::eraseAllKeys() {
     if (!_initialized) return Result(false, "Not initialized");
-    if (_operationInProgress) return Result(false, "Operation in progress");
-    
-    _operationInProgress = true;
+    if (!beginOperation()) return Result(false, "Operation in progress");
     
     if (!beginSession()) {
-        _operationInProgress = false;
+        endOperation();
         return Result(false, "Failed to connect to radio");
     }
     
     auto kmm = buildZeroizeCommand();
     if (!sendKmm(kmm)) {
         endSession();
-        _operationInProgress = false;
+        endOperation();
         return Result(false, "Failed to send zeroize command");
     }
     
     std::vector<uint8_t> response;
     if (!receiveKmm(response, 10000)) {
         endSession();
-        _operationInProgress = false;
+        endOperation();
         return Result(false, "No response");
     }
     
     endSession();
-    _operationInProgress = false;
+    endOperation();
     
     return Result(true, "All keys erased");
 }
 
-KFDProtocol::Result KFDProtocol::viewKeyInfo(std::vector<P25::KeyStatus>& keys) {
-    // Simplified implementation
-    return Result(false, "Not implemented");
+// =============================================================================
+// Inventory
+// =============================================================================
+
+bool KFDProtocol::inventoryExchange(P25::InventoryType type, const uint8_t* args, size_t argLen,
+                                    const uint8_t*& kmm, size_t& len, uint32_t timeoutMs) {
+    P25::KmmWriter w(_txFrame, sizeof(_txFrame));
+    w.begin(P25::MSG_INVENTORY_CMD);
+    w.put(type);
+    if (argLen > 0) w.put(args, argLen);
+    size_t frameLen = w.end();
+    if (frameLen == 0) {
+        setError("Inventory command too large");
+        return false;
+    }
+    
+    if (!sendFrame(_txFrame, frameLen)) {
+        setError("Failed to send inventory command");
+        return false;
+    }
+    
+    if (!receiveKmm(kmm, len, timeoutMs)) {
+        setError("No response to inventory command");
+        return false;
+    }
+    return true;
+}
+
+bool KFDProtocol::parseInventoryResponse(P25::KmmReader& r, P25::InventoryType expectedType) {
+    if (!r.valid()) {
+        setError("Malformed inventory response");
+        return false;
+    }
+    
+    if (r.messageId() == P25::MSG_NEGATIVE_ACK) {
+        // Message ID acknowledged (1), message number (2), status (1)
+        r.get();
+        r.get16();
+        setError("Inventory rejected: status 0x%02X", r.get());
+        return false;
+    }
+    
+    if (r.messageId() != P25::MSG_INVENTORY_RSP) {
+        setError("Unexpected response 0x%02X to inventory", r.messageId());
+        return false;
+    }
+    
+    uint8_t type = r.get();
+    if (!r.ok() || type != expectedType) {
+        setError("Inventory type 0x%02X, expected 0x%02X", type, expectedType);
+        return false;
+    }
+    return true;
+}
+
+KFDProtocol::Result KFDProtocol::inventoryOperation(const std::function<Result()>& exchange) {
+    if (!_initialized) return Result(false, "Not initialized");
+    if (!beginOperation()) return Result(false, "Operation in progress");
+    
+    if (!beginSession()) {
+        endOperation();
+        return Result(false, _abortRequested ? "Aborted by user" : "Failed to connect to radio");
+    }
+    
+    Result result = exchange();
+    
+    endSession();
+    endOperation();
+    return result;
+}
+
+KFDProtocol::Result KFDProtocol::viewKeyInfo(std::vector<P25::KeyStatus>& keys, KeyInfoCallback onItems) {
+    keys.clear();
+    
+    return inventoryOperation([&]() -> Result {
+        uint32_t marker = 0;
+        int pages = 0;
+        
+        do {
+            if (_abortRequested) return Result(false, "Aborted by user");
+            
+            // Inventory marker (3) - where the previous page stopped, max items (2)
+            const uint8_t args[5] = {
+                (uint8_t)(marker >> 16), (uint8_t)(marker >> 8), (uint8_t)marker,
+                (uint8_t)(P25::INV_MAX_KEYS_PER_FRAME >> 8), (uint8_t)(P25::INV_MAX_KEYS_PER_FRAME & 0xFF),
+            };
+            const uint8_t* kmm = nullptr;
+            size_t len = 0;
+            if (!inventoryExchange(P25::INV_LIST_ACTIVE_KEYS, args, sizeof(args), kmm, len)) {
+                return Result(false, _lastError);
+            }
+            
+            P25::KmmReader r(kmm, len);
+            if (!parseInventoryResponse(r, P25::INV_LIST_ACTIVE_KEYS)) return Result(false, _lastError);
+            
+            // Next marker (3, 0 = done), number of items (2)
+            marker = r.get24();
+            uint16_t count = r.get16();
+            if (!r.ok()) return Result(false, "Malformed inventory response");
+            
+            size_t first = keys.size();
+            keys.reserve(first + count);
+            for (uint16_t i = 0; i < count && r.remaining() >= P25::INV_KEY_ITEM_LEN; i++) {
+                P25::KeyStatus ks;
+                ks.keysetId = r.get();
+                ks.sln = r.get16();
+                ks.algorithmId = r.get();
+                ks.keyId = r.get16();
+                keys.push_back(ks);
+            }
+            pages++;
+            
+            if (_debug) Console.printf("[KFD] Key inventory page %d: %u items, marker 0x%06X\n",
+                                      pages, count, marker);
+            
+            if (onItems && keys.size() > first) onItems(&keys[first], keys.size() - first);
+            
+            // A radio that returns a marker without items would loop forever
+            if (count == 0) break;
+        } while (marker != 0);
+        
+        char buf[48];
+        snprintf(buf, sizeof(buf), "%d keys in radio", (int)keys.size());
+        return Result(true, buf);
+    });
 }
 
 KFDProtocol::Result KFDProtocol::viewRsi(std::vector<P25::RsiItem>& rsiItems) {
-    return Result(false, "Not implemented");
+    rsiItems.clear();
+    
+    return inventoryOperation([&]() -> Result {
+        const uint8_t* kmm = nullptr;
+        size_t len = 0;
+        if (!inventoryExchange(P25::INV_LIST_RSI_ITEMS, nullptr, 0, kmm, len)) {
+            return Result(false, _lastError);
+        }
+        
+        P25::KmmReader r(kmm, len);
+        if (!parseInventoryResponse(r, P25::INV_LIST_RSI_ITEMS)) return Result(false, _lastError);
+        
+        // Number of items (2), items: RSI (3), message number (2)
+        uint16_t count = r.get16();
+        for (uint16_t i = 0; i < count && r.remaining() >= 5; i++) {
+            P25::RsiItem item;
+            item.rsi = r.get24();
+            item.messageNumber = r.get16();
+            rsiItems.push_back(item);
+        }
+        if (!r.ok()) return Result(false, "Malformed RSI inventory");
+        
+        char buf[48];
+        snprintf(buf, sizeof(buf), "%d RSI items", (int)rsiItems.size());
+        return Result(true, buf);
+    });
 }
 
 KFDProtocol::Result KFDProtocol::loadRsi(uint32_t rsi, uint16_t mn) {
@@ -899,7 +1886,29 @@ KFDProtocol::Result KFDProtocol::loadRsi(uint32_t rsi, uint16_t mn) {
 }
 
 KFDProtocol::Result KFDProtocol::viewKmfRsi(std::vector<P25::KmfRsiItem>& kmfItems) {
-    return Result(false, "Not implemented");
+    kmfItems.clear();
+    
+    return inventoryOperation([&]() -> Result {
+        const uint8_t* kmm = nullptr;
+        size_t len = 0;
+        if (!inventoryExchange(P25::INV_LIST_KMF_RSI, nullptr, 0, kmm, len)) {
+            return Result(false, _lastError);
+        }
+        
+        P25::KmmReader r(kmm, len);
+        if (!parseInventoryResponse(r, P25::INV_LIST_KMF_RSI)) return Result(false, _lastError);
+        
+        // KMF RSI (3)
+        P25::KmfRsiItem item;
+        item.rsi = r.get24();
+        item.mn = 0;
+        if (!r.ok()) return Result(false, "Malformed KMF RSI inventory");
+        kmfItems.push_back(item);
+        
+        char buf[48];
+        snprintf(buf, sizeof(buf), "KMF RSI %06X", (unsigned)item.rsi);
+        return Result(true, buf);
+    });
 }
 
 KFDProtocol::Result KFDProtocol::loadKmfRsi(uint32_t rsi, uint16_t mn) {
@@ -907,7 +1916,29 @@ KFDProtocol::Result KFDProtocol::loadKmfRsi(uint32_t rsi, uint16_t mn) {
 }
 
 KFDProtocol::Result KFDProtocol::viewMnp(std::vector<P25::MnpInfo>& mnpItems) {
-    return Result(false, "Not implemented");
+    mnpItems.clear();
+    
+    return inventoryOperation([&]() -> Result {
+        const uint8_t* kmm = nullptr;
+        size_t len = 0;
+        if (!inventoryExchange(P25::INV_LIST_MNP, nullptr, 0, kmm, len)) {
+            return Result(false, _lastError);
+        }
+        
+        P25::KmmReader r(kmm, len);
+        if (!parseInventoryResponse(r, P25::INV_LIST_MNP)) return Result(false, _lastError);
+        
+        // Message number period (2)
+        P25::MnpInfo info;
+        info.rsi = 0;
+        info.mn = r.get16();
+        if (!r.ok()) return Result(false, "Malformed MNP inventory");
+        mnpItems.push_back(info);
+        
+        char buf[48];
+        snprintf(buf, sizeof(buf), "MNP %u", info.mn);
+        return Result(true, buf);
+    });
 }
 
 KFDProtocol::Result KFDProtocol::loadMnp(uint32_t rsi, uint16_t mn) {
@@ -915,19 +1946,691 @@ KFDProtocol::Result KFDProtocol::loadMnp(uint32_t rsi, uint16_t mn) {
 }
 
 KFDProtocol::Result KFDProtocol::viewKeysetInfo(std::vector<P25::KeysetInfo>& keysets) {
-    return Result(false, "Not implemented");
+    keysets.clear();
+    
+    return inventoryOperation([&]() -> Result {
+        // Active keysets first, then inactive - both on the same session
+        static const P25::InventoryType types[] = {
+            P25::INV_LIST_ACTIVE_KSET_IDS, P25::INV_LIST_INACTIVE_KSET_IDS,
+        };
+        for (P25::InventoryType type : types) {
+            const uint8_t* kmm = nullptr;
+            size_t len = 0;
+            if (!inventoryExchange(type, nullptr, 0, kmm, len)) return Result(false, _lastError);
+            
+            P25::KmmReader r(kmm, len);
+            if (!parseInventoryResponse(r, type)) return Result(false, _lastError);
+            
+            // Number of items (2), keyset IDs (1 each)
+            uint16_t count = r.get16();
+            for (uint16_t i = 0; i < count && r.remaining() > 0; i++) {
+                P25::KeysetInfo ks;
+                ks.keysetId = r.get();
+                ks.algorithmId = 0;
+                ks.active = (type == P25::INV_LIST_ACTIVE_KSET_IDS);
+                keysets.push_back(ks);
+            }
+            if (!r.ok()) return Result(false, "Malformed keyset inventory");
+        }
+        
+        char buf[48];
+        snprintf(buf, sizeof(buf), "%d keysets", (int)keysets.size());
+        return Result(true, buf);
+    });
 }
 
 KFDProtocol::Result KFDProtocol::activateKeyset(uint8_t keysetId) {
     return Result(false, "Not implemented");
 }
 
+void KFDProtocol::abort() {
+    _abortRequested = true;
+    // A held session is not reused after an abort
+    if (_sessionOpen) _sessionBroken = true;
+}
+
+// =============================================================================
+// MR Emulator
+// =============================================================================
+// The engine task owns the line: it sleeps in the HAL until the receiver
+// sees a key signature, answers READY_REQ, then serves KMMs until the KFD
+// disconnects (or goes quiet) and re-arms. Everything time-critical - the
+// 0xD0, TRANSFER_DONE and KMM replies - is sent before any bookkeeping;
+// received keys are queued to a lower-priority delivery task that runs the
+// user callback.
+
+namespace {
+    const uint32_t MR_READY_TIMEOUT_MS   = 250;    // Key signature end to READY_REQ
+    const uint32_t MR_SESSION_TIMEOUT_MS = 10000;  // Silence that ends a session
+    const uint32_t MR_BYTE_TIMEOUT_MS    = 200;    // Between bytes of one frame
+    const size_t   MR_MAX_KEYS           = 256;    // Emulated key storage
+    const size_t   MR_KEY_QUEUE_LEN      = 32;
+}
+
 KFDProtocol::Result KFDProtocol::startMrEmulator(MrKeyCallback callback) {
-    return Result(false, "Not implemented");
+    if (!_initialized) return Result(false, "Not initialized");
+    if (_mrEmulatorRunning) return Result(false, "Emulator already running");
+    // Held for the emulator as a whole, not by this task: no other
+    // operation nests inside it. Released by mrFinish().
+    if (!claimPort(reinterpret_cast<TaskHandle_t>(this))) return Result(false, "Operation in progress");
+    
+    _mrKeyQueue = xQueueCreate(MR_KEY_QUEUE_LEN, sizeof(MrKeyMsg));
+    if (!_mrKeyQueue) {
+        endOperation();
+        return Result(false, "Out of memory");
+    }
+    
+    _mrCallback = callback;
+    _mrStats = MrEmulatorStats();
+    _mrKeys.clear();
+    _mrKeys.reserve(MR_MAX_KEYS);
+    
+    // The KFD on the other end drives SENSE; keep the HAL quiet so nothing
+    // prints between a received byte and our reply
+    _hal->releaseSenseLine();
+    _mrHalDebug = _hal->isDebugEnabled();
+    _hal->enableDebug(false);
+    _hal->flushRx();
+    
+    _mrEmulatorRunning = true;
+    
+    if (xTaskCreatePinnedToCore(mrDeliverTask, "kfd_mr_cb", 6144, this, 1,
+                                &_mrDeliverTask, 0) != pdPASS) {
+        _mrDeliverTask = nullptr;
+    }
+    if (!_mrDeliverTask ||
+        xTaskCreatePinnedToCore(mrTask, "kfd_mr_emu", 8192, this, 3, &_mrTask, 0) != pdPASS) {
+        _mrTask = nullptr;
+        stopMrEmulator();
+        return Result(false, "Failed to start emulator task");
+    }
+    
+    if (_debug) Console.println("[KFD] MR emulator started - waiting for key signature");
+    return Result(true, "MR emulator running");
+}
+
+void KFDProtocol::stopMrEmulator() {
+    if (!_mrEmulatorRunning && !_mrTask && !_mrDeliverTask) return;
+    _mrEmulatorRunning = false;
+    
+    // Called from the key callback - the delivery task finishes the stop
+    // once it returns
+    if (_mrDeliverTask && xTaskGetCurrentTaskHandle() == _mrDeliverTask) {
+        _mrSelfStop = true;
+        return;
+    }
+    
+    // Both tasks wake at least every MR_BYTE_TIMEOUT_MS to check the flag
+    uint32_t start = millis();
+    while ((_mrTask || _mrDeliverTask) && (millis() - start) < 2000) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    mrFinish();
+}
+
+void KFDProtocol::mrFinish() {
+    if (_mrKeyQueue) {
+        MrKeyMsg msg;
+        while (xQueueReceive(_mrKeyQueue, &msg, 0) == pdTRUE) Crypto::secureZero(&msg, sizeof(msg));
+        vQueueDelete(_mrKeyQueue);
+        _mrKeyQueue = nullptr;
+    }
+    _mrKeys.clear();
+    _mrSelfStop = false;
+    
+    if (_hal) {
+        _hal->enableDebug(_mrHalDebug);
+        _hal->setSenseLine(true);  // Back to KFD mode - SENSE connected
+        _hal->flushRx();
+    }
+    endOperation();
+    
+    if (_debug) Console.printf("[KFD] MR emulator stopped: %u sessions, %u KMMs, %u keys loaded, %u erased\n",
+                              _mrStats.sessions, _mrStats.kmms, _mrStats.keysLoaded, _mrStats.keysErased);
+}
+
+void KFDProtocol::mrTask(void* arg) {
+    KFDProtocol* self = static_cast<KFDProtocol*>(arg);
+    self->mrLoop();
+    self->_mrTask = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void KFDProtocol::mrDeliverTask(void* arg) {
+    KFDProtocol* self = static_cast<KFDProtocol*>(arg);
+    self->mrDeliverLoop();
+    if (self->_mrSelfStop) {
+        while (self->_mrTask) vTaskDelay(pdMS_TO_TICKS(10));
+        self->mrFinish();
+    }
+    self->_mrDeliverTask = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void KFDProtocol::mrDeliverLoop() {
+    MrKeyMsg msg;
+    // Keep delivering until stopped and the engine has nothing left queued
+    while (_mrEmulatorRunning || _mrTask || uxQueueMessagesWaiting(_mrKeyQueue) > 0) {
+        if (xQueueReceive(_mrKeyQueue, &msg, pdMS_TO_TICKS(MR_BYTE_TIMEOUT_MS)) != pdTRUE) continue;
+        
+        P25::KeyItem key;
+        key.keysetId = msg.keysetId;
+        key.sln = msg.sln;
+        key.keyId = msg.keyId;
+        key.algorithmId = msg.algorithmId;
+        key.isKek = P25::getKeyType(msg.sln) == P25::KEY_TYPE_KEK;
+        key.erase = msg.erase;
+        key.key.assign(msg.key, msg.key + msg.keyLen);
+        Crypto::secureZero(&msg, sizeof(msg));
+        
+        if (_mrCallback) _mrCallback(key);
+        if (!key.key.empty()) Crypto::secureZero(key.key.data(), key.key.size());
+    }
+}
+
+void KFDProtocol::mrSend(const uint8_t* data, size_t len) {
+    // The KFD may still be holding its BUSY stop bits
+    uint64_t t0 = esp_timer_get_time();
+    while (_hal->isLineBusy() && esp_timer_get_time() - t0 < 5000) {}
+    _hal->sendBytesFast(data, len);
 }
 
-void KFDProtocol::stopMrEmulator() { _mrEmulatorRunning = false; }
-void KFDProtocol::abort() { _abortRequested = true; }
+void KFDProtocol::mrSendByte(uint8_t b) { mrSend(&b, 1); }
+
+void KFDProtocol::mrLoop() {
+    enum MrState { MR_IDLE, MR_WAIT_READY, MR_SESSION };
+    MrState state = MR_IDLE;
+    uint32_t lastRxMs = 0;
+    
+    while (_mrEmulatorRunning) {
+        switch (state) {
+            case MR_IDLE: {
+                if (_hal->waitForBreak(MR_BYTE_TIMEOUT_MS)) {
+                    state = MR_WAIT_READY;
+                    break;
+                }
+                // A KFD that skips the key signature (or one we missed)
+                // still opens with READY_REQ - anything else is noise
+                uint8_t buf[16];
+                size_t n = 0;
+                if (_hal->receiveBytes(buf, sizeof(buf), &n, 0) && buf[n - 1] == P25::TWI_READY_REQ) {
+                    mrSendByte(P25::TWI_READY_MODE_MR);
+                    _mrStats.sessions++;
+                    lastRxMs = millis();
+                    state = MR_SESSION;
+                }
+                break;
+            }
+            
+            case MR_WAIT_READY: {
+                uint8_t b;
+                if (!_hal->receiveByte(&b, MR_READY_TIMEOUT_MS)) {
+                    state = MR_IDLE;
+                } else if (b == P25::TWI_READY_REQ) {
+                    mrSendByte(P25::TWI_READY_MODE_MR);
+                    _mrStats.sessions++;
+                    lastRxMs = millis();
+                    state = MR_SESSION;
+                }
+                break;
+            }
+            
+            case MR_SESSION: {
+                // A new key signature restarts the session (KFD retry or
+                // back-to-back load without a disconnect)
+                if (_hal->takeBreak()) {
+                    state = MR_WAIT_READY;
+                    break;
+                }
+                
+                uint8_t op;
+                if (!_hal->receiveByte(&op, MR_BYTE_TIMEOUT_MS)) {
+                    if (millis() - lastRxMs > MR_SESSION_TIMEOUT_MS) state = MR_IDLE;
+                    break;
+                }
+                lastRxMs = millis();
+                
+                switch (op) {
+                    case P25::TWI_READY_REQ:
+                        mrSendByte(P25::TWI_READY_MODE_MR);
+                        break;
+                    case P25::TWI_TRANSFER_DONE:
+                        mrSendByte(P25::TWI_TRANSFER_DONE);
+                        break;
+                    case P25::TWI_DISCONNECT:
+                        mrSendByte(P25::TWI_DISCONNECT_ACK);
+                        state = MR_IDLE;
+                        break;
+                    case P25::TWI_KMM:
+                        mrReceiveKmm(MR_BYTE_TIMEOUT_MS);
+                        break;
+                    default:
+                        break;  // Line noise - wait for the next opcode
+                }
+                break;
+            }
+        }
+    }
+}
+
+bool KFDProtocol::mrReceiveKmm(uint32_t timeoutMs) {
+    uint8_t lenHi, lenLo;
+    if (!_hal->receiveByte(&lenHi, timeoutMs) || !_hal->receiveByte(&lenLo, timeoutMs)) return false;
+    
+    size_t len = ((size_t)lenHi << 8) | lenLo;
+    if (len < P25::TWI_FRAME_OVERHEAD + P25::KMM_HEADER_LEN || len > P25::TWI_MAX_FRAME_LEN) {
+        _hal->flushRx();
+        return false;
+    }
+    
+    if (!readFrameBody(len, timeoutMs)) {
+        _mrStats.crcErrors++;
+        return false;
+    }
+    _mrStats.kmms++;
+    
+    // Skip control and dest RSI, drop the CRC
+    mrHandleKmm(_rxFrame + 4, len - P25::TWI_FRAME_OVERHEAD);
+    return true;
+}
+
+void KFDProtocol::mrNak(P25::KmmWriter& w, uint8_t messageId, P25::OperationStatus status) {
+    // Message ID acknowledged (1), message number (2), status (1)
+    w.begin(P25::MSG_NEGATIVE_ACK, 0x00);
+    w.put(messageId);
+    w.put16(0x0000);
+    w.put(status);
+    _mrStats.naks++;
+}
+
+void KFDProtocol::mrHandleKmm(const uint8_t* kmm, size_t len) {
+    P25::KmmReader r(kmm, len);
+    P25::KmmWriter w(_txFrame, sizeof(_txFrame));
+    uint8_t messageId = r.messageId();
+    
+    switch (messageId) {
+        case P25::MSG_MODIFY_KEY_CMD:
+            mrModifyKey(r, w);
+            break;
+            
+        case P25::MSG_ZEROIZE_CMD:
+            _mrStats.keysErased += _mrKeys.size();
+            _mrKeys.clear();
+            w.begin(P25::MSG_ZEROIZE_RSP, 0x00);
+            break;
+            
+        case P25::MSG_INVENTORY_CMD:
+            mrInventory(r, w);
+            break;
+            
+        default:
+            mrNak(w, messageId, P25::STATUS_INVALID_MESSAGE_ID);
+            break;
+    }
+    
+    size_t frameLen = w.end();
+    if (frameLen > 0) mrSend(_txFrame, frameLen);
+    _mrStats.storedKeys = _mrKeys.size();
+    
+    // Plaintext keys went through the rx buffer
+    Crypto::secureZero(_rxFrame, sizeof(_rxFrame));
+}
+
+void KFDProtocol::mrModifyKey(P25::KmmReader& r, P25::KmmWriter& w) {
+    // Decryption instruction format (1), extended format (1), KEK algorithm (1),
+    // KEK key ID (2), keyset (1), algorithm (1), key length (1), number of keys (1)
+    r.get();
+    r.get();
+    uint8_t kekAlgo = r.get();
+    r.get16();
+    uint8_t keysetId = r.get();
+    uint8_t algo = r.get();
+    uint8_t keyLen = r.get();
+    uint8_t count = r.get();
+    if (!r.ok()) {
+        mrNak(w, P25::MSG_MODIFY_KEY_CMD, P25::STATUS_INVALID_MESSAGE_ID);
+        return;
+    }
+    
+    // Rekey ack: message ID acknowledged (1), number of items (2), then
+    // algorithm (1), key ID (2), status (1) per item - count patched below
+    w.begin(P25::MSG_REKEY_ACK, 0x00);
+    w.put(P25::MSG_MODIFY_KEY_CMD);
+    w.put16(count);
+    
+    size_t expectLen = P25::getKeyLength(algo);
+    uint8_t items = 0;
+    
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t format = r.get();
+        uint16_t sln = r.get16();
+        uint16_t keyId = r.get16();
+        const uint8_t* key = r.take(keyLen);
+        if (!r.ok()) break;
+        
+        bool erase = (format & 0x20) != 0;
+        P25::OperationStatus status = P25::STATUS_COMMAND_PERFORMED;
+        
+        auto it = std::find_if(_mrKeys.begin(), _mrKeys.end(), [&](const MrStoredKey& k) {
+            return k.keysetId == keysetId && k.sln == sln;
+        });
+        
+        if (erase) {
+            if (it != _mrKeys.end()) {
+                _mrKeys.erase(it);
+                _mrStats.keysErased++;
+            } else {
+                status = P25::STATUS_KEY_PREVIOUSLY_ERASED;
+            }
+        } else if (kekAlgo != P25::ALGO_CLEAR) {
+            status = P25::STATUS_UNSUPPORTED_FEATURE;  // No KEK to unwrap with
+        } else if ((expectLen != 0 && keyLen != expectLen) || keyLen > sizeof(MrKeyMsg::key)) {
+            status = P25::STATUS_INVALID_KEY_LENGTH;
+        } else if (it == _mrKeys.end() && _mrKeys.size() >= MR_MAX_KEYS) {
+            status = P25::STATUS_KEY_STORAGE_FULL;
+        } else {
+            if (it != _mrKeys.end()) {
+                it->keyId = keyId;
+                it->algorithmId = algo;
+                status = P25::STATUS_KEY_OVERWRITTEN;
+            } else {
+                _mrKeys.push_back({ keysetId, sln, keyId, algo });
+            }
+            _mrStats.keysLoaded++;
+        }
+        
+        w.put(algo);
+        w.put16(keyId);
+        w.put(status);
+        items++;
+        
+        bool accepted = (status == P25::STATUS_COMMAND_PERFORMED || status == P25::STATUS_KEY_OVERWRITTEN);
+        if (accepted && _mrCallback) {
+            MrKeyMsg msg;
+            msg.keysetId = keysetId;
+            msg.sln = sln;
+            msg.keyId = keyId;
+            msg.algorithmId = algo;
+            msg.erase = erase;
+            msg.keyLen = erase ? 0 : keyLen;
+            if (msg.keyLen) memcpy(msg.key, key, msg.keyLen);
+            if (xQueueSend(_mrKeyQueue, &msg, 0) != pdTRUE) _mrStats.dropped++;
+            Crypto::secureZero(&msg, sizeof(msg));
+        }
+    }
+    
+    // Truncated command - ack what was parsed
+    if (items != count) {
+        _txFrame[P25::KmmWriter::BODY_OFFSET + 1] = 0;
+        _txFrame[P25::KmmWriter::BODY_OFFSET + 2] = items;
+    }
+}
+
+void KFDProtocol::mrInventory(P25::KmmReader& r, P25::KmmWriter& w) {
+    uint8_t type = r.get();
+    if (!r.ok()) {
+        mrNak(w, P25::MSG_INVENTORY_CMD, P25::STATUS_INVALID_MESSAGE_ID);
+        return;
+    }
+    
+    switch (type) {
+        case P25::INV_LIST_ACTIVE_KEYS: {
+            // Marker (3) = index of the first item, max items (2)
+            uint32_t marker = r.get24();
+            uint16_t maxItems = r.get16();
+            if (!r.ok()) maxItems = P25::INV_MAX_KEYS_PER_FRAME;
+            if (maxItems == 0 || maxItems > P25::INV_MAX_KEYS_PER_FRAME) maxItems = P25::INV_MAX_KEYS_PER_FRAME;
+            
+            size_t first = std::min((size_t)marker, _mrKeys.size());
+            size_t n = std::min((size_t)maxItems, _mrKeys.size() - first);
+            size_t next = (first + n < _mrKeys.size()) ? first + n : 0;
+            
+            w.begin(P25::MSG_INVENTORY_RSP, 0x00);
+            w.put(type);
+            w.put24(next);
+            w.put16(n);
+            for (size_t i = first; i < first + n; i++) {
+                const auto& k = _mrKeys[i];
+                w.put(k.keysetId);
+                w.put16(k.sln);
+                w.put(k.algorithmId);
+                w.put16(k.keyId);
+            }
+            break;
+        }
+        
+        case P25::INV_LIST_ACTIVE_KSET_IDS:
+        case P25::INV_LIST_INACTIVE_KSET_IDS: {
+            // Every keyset holding a key is reported active
+            uint8_t ids[MR_MAX_KEYS];
+            size_t n = 0;
+            if (type == P25::INV_LIST_ACTIVE_KSET_IDS) {
+                for (const auto& k : _mrKeys) {
+                    if (std::find(ids, ids + n, k.keysetId) == ids + n) ids[n++] = k.keysetId;
+                }
+            }
+            w.begin(P25::MSG_INVENTORY_RSP, 0x00);
+            w.put(type);
+            w.put16(n);
+            w.put(ids, n);
+            break;
+        }
+        
+        default:
+            mrNak(w, P25::MSG_INVENTORY_CMD, P25::STATUS_UNSUPPORTED_FEATURE);
+            break;
+    }
+}
+
+// =============================================================================
+// Asynchronous Operations
+// =============================================================================
+
+bool KFDProtocol::startWorker(BaseType_t core) {
+    if (_workerTask) return true;
+    
+    if (!_opQueue) _opQueue = xQueueCreate(1, sizeof(AsyncOp));
+    if (!_eventQueue) _eventQueue = xQueueCreate(16, sizeof(AsyncEvent));
+    if (!_opQueue || !_eventQueue) return false;
+    
+    // Above the Arduino loop task so TWI timing isn't disturbed by the UI;
+    // the worker blocks in the HAL while waiting on the radio
+    if (xTaskCreatePinnedToCore(workerTask, "kfd_worker", 8192, this, 3,
+                                &_workerTask, core) != pdPASS) {
+        _workerTask = nullptr;
+        return false;
+    }
+    
+    if (_debug) Console.printf("[KFD] Worker task started on core %d\n", (int)core);
+    return true;
+}
+
+bool KFDProtocol::claimForWorker() {
+    // The claim is the worker's from here, so no sync caller gets in between
+    // submit and the worker picking the op up. Released by workerLoop().
+    return _initialized && _workerTask && claimPort(_workerTask);
+}
+
+bool KFDProtocol::queueOp(AsyncOp op) {
+    _asyncBusy = true;
+    if (xQueueSend(_opQueue, &op, 0) == pdTRUE) return true;
+    _asyncBusy = false;
+    return false;
+}
+
+bool KFDProtocol::submitKeyload(const P25::KeyItem& key) {
+    if (!claimForWorker()) return false;
+    _asyncKey = key;
+    if (queueOp(ASYNC_KEYLOAD)) return true;
+    if (!_asyncKey.key.empty()) Crypto::secureZero(_asyncKey.key.data(), _asyncKey.key.size());
+    endOperation();
+    return false;
+}
+
+bool KFDProtocol::submitKeyloadPlan(const KeyloadPlan& plan) {
+    if (plan.empty() || !claimForWorker()) return false;
+    _asyncPlan = plan;
+    if (queueOp(ASYNC_KEYLOAD_PLAN)) return true;
+    _asyncPlan.clear();
+    endOperation();
+    return false;
+}
+
+bool KFDProtocol::submitSync(const std::vector<P25::KeyItem>& keys, bool eraseExtras) {
+    if (keys.empty() || !claimForWorker()) return false;
+    _asyncSyncKeys = keys;
+    _asyncSyncErase = eraseExtras;
+    if (queueOp(ASYNC_SYNC)) return true;
+    for (auto& k : _asyncSyncKeys) {
+        if (!k.key.empty()) Crypto::secureZero(k.key.data(), k.key.size());
+    }
+    _asyncSyncKeys.clear();
+    endOperation();
+    return false;
+}
+
+bool KFDProtocol::submit(AsyncOp op) {
+    if (op != ASYNC_TEST_INVENTORY && op != ASYNC_TEST_DES_KEY &&
+        op != ASYNC_ERASE_ALL && op != ASYNC_VIEW_KEYS) return false;
+    if (!claimForWorker()) return false;
+    if (queueOp(op)) return true;
+    endOperation();
+    return false;
+}
+
+size_t KFDProtocol::getAsyncKeys(std::vector<P25::KeyStatus>& out, size_t from) {
+    // Only the worker replaces _asyncKeys (by swap), so copy a snapshot of
+    // the size first and the items after - both under the lock
+    portENTER_CRITICAL(&_asyncKeysMux);
+    size_t total = _asyncKeys.size();
+    portEXIT_CRITICAL(&_asyncKeysMux);
+    
+    if (from >= total) return total;
+    
+    std::vector<P25::KeyStatus> tail(total - from);
+    portENTER_CRITICAL(&_asyncKeysMux);
+    size_t n = std::min(tail.size(), _asyncKeys.size() > from ? _asyncKeys.size() - from : 0);
+    std::copy(_asyncKeys.begin() + from, _asyncKeys.begin() + from + n, tail.begin());
+    portEXIT_CRITICAL(&_asyncKeysMux);
+    
+    out.insert(out.end(), tail.begin(), tail.begin() + n);
+    return total;
+}
+
+bool KFDProtocol::pollEvent(AsyncEvent& ev) {
+    return _eventQueue && xQueueReceive(_eventQueue, &ev, 0) == pdTRUE;
+}
+
+void KFDProtocol::postEvent(AsyncEvent::Kind kind, AsyncOp op, bool success,
+                            int current, int total, const char* status) {
+    AsyncEvent ev;
+    ev.kind = kind;
+    ev.op = op;
+    ev.success = success;
+    ev.current = current;
+    ev.total = total;
+    snprintf(ev.status, sizeof(ev.status), "%s", status ? status : "");
+    
+    if (kind == AsyncEvent::PROGRESS) {
+        // Progress is best-effort - drop it if the UI is behind
+        xQueueSend(_eventQueue, &ev, 0);
+        return;
+    }
+    
+    // Completion must get through - make room by dropping the oldest event
+    while (xQueueSend(_eventQueue, &ev, 0) != pdTRUE) {
+        AsyncEvent drop;
+        xQueueReceive(_eventQueue, &drop, 0);
+    }
+}
+
+KFDProtocol::Result KFDProtocol::runAsync(AsyncOp op) {
+    auto progress = [this, op](int current, int total, const char* status) {
+        postEvent(AsyncEvent::PROGRESS, op, false, current, total, status);
+    };
+    
+    switch (op) {
+        case ASYNC_KEYLOAD:
+            progress(0, 1, "Loading key...");
+            return keyload(_asyncKey);
+        case ASYNC_KEYLOAD_PLAN:   return keyloadPlan(_asyncPlan, progress);
+        case ASYNC_SYNC:           return syncKeys(_asyncSyncKeys, _asyncSyncErase, progress);
+        case ASYNC_TEST_INVENTORY: return testInventory();
+        case ASYNC_TEST_DES_KEY:   return testDESKey();
+        case ASYNC_ERASE_ALL:      return eraseAllKeys();
+        case ASYNC_VIEW_KEYS: {
+            portENTER_CRITICAL(&_asyncKeysMux);
+            _asyncKeys.clear();
+            portEXIT_CRITICAL(&_asyncKeysMux);
+            
+            std::vector<P25::KeyStatus> keys;
+            return viewKeyInfo(keys, [this, &progress](const P25::KeyStatus* items, size_t count) {
+                // Reserve outside the critical section - no allocation with interrupts off
+                std::vector<P25::KeyStatus> next;
+                next.reserve(_asyncKeys.size() + count);
+                next = _asyncKeys;
+                next.insert(next.end(), items, items + count);
+                portENTER_CRITICAL(&_asyncKeysMux);
+                _asyncKeys.swap(next);
+                size_t total = _asyncKeys.size();
+                portEXIT_CRITICAL(&_asyncKeysMux);
+                
+                char status[40];
+                snprintf(status, sizeof(status), "%d keys received...", (int)total);
+                progress((int)total, 0, status);
+            });
+        }
+        default:                   return Result(false, "Unknown operation");
+    }
+}
+
+void KFDProtocol::recordOpMetrics(AsyncOp op, uint32_t us, bool success) {
+    Metrics::Op m;
+    switch (op) {
+        case ASYNC_KEYLOAD:        m = Metrics::OP_KEYLOAD; break;
+        case ASYNC_KEYLOAD_PLAN:   m = Metrics::OP_KEYLOAD_MULTI; break;
+        case ASYNC_SYNC:           m = Metrics::OP_SYNC; break;
+        case ASYNC_VIEW_KEYS:      m = Metrics::OP_INVENTORY; break;
+        case ASYNC_ERASE_ALL:      m = Metrics::OP_ERASE_ALL; break;
+        case ASYNC_TEST_INVENTORY:
+        case ASYNC_TEST_DES_KEY:   m = Metrics::OP_TEST; break;
+        default:                   return;
+    }
+    Metrics::recordOp(m, us, success);
+}
+
+void KFDProtocol::workerTask(void* arg) {
+    static_cast<KFDProtocol*>(arg)->workerLoop();
+}
+
+void KFDProtocol::workerLoop() {
+    for (;;) {
+        AsyncOp op;
+        if (xQueueReceive(_opQueue, &op, portMAX_DELAY) != pdTRUE) continue;
+        
+        // abort() between submit and start cancels the queued operation
+        uint64_t t0 = esp_timer_get_time();
+        bool cancelled = _abortRequested;
+        Result r = cancelled ? Result(false, "Aborted by user") : runAsync(op);
+        if (!cancelled) recordOpMetrics(op, (uint32_t)(esp_timer_get_time() - t0), r.success);
+        
+        // Drop key material as soon as the radio has it
+        if (!_asyncKey.key.empty()) {
+            Crypto::secureZero(_asyncKey.key.data(), _asyncKey.key.size());
+            _asyncKey.key.clear();
+        }
+        _asyncPlan.clear();
+        for (auto& k : _asyncSyncKeys) {
+            if (!k.key.empty()) Crypto::secureZero(k.key.data(), k.key.size());
+        }
+        _asyncSyncKeys.clear();
+        
+        _asyncResult = r;
+        _asyncBusy = false;
+        endOperation();
+        postEvent(AsyncEvent::DONE, op, r.success, 1, 1, r.message.c_str());
+    }
+}
 
 void KFDProtocol::setError(const char* fmt, ...) {
     char buf[256];
@@ -0,0 +1,147 @@
+/**
+ * @file kmm_frame.cpp
+ * @brief In-place KMM frame writer and reader implementation
+ */
+
+#include "kmm_frame.h"
+#include <string.h>
+
+namespace P25 {
+
+// =============================================================================
+// KmmWriter
+// =============================================================================
+
+KmmWriter::KmmWriter(uint8_t* buf, size_t capacity)
+    : _buf(buf), _cap(capacity), _pos(0), _overflow(false) {}
+
+void KmmWriter::begin(uint8_t messageId, uint8_t responseKind) {
+    _pos = 0;
+    _overflow = (_buf == nullptr || _cap < BODY_OFFSET + 2);
+    if (_overflow) return;
+
+    // TWI header - length patched in end()
+    _buf[0] = TWI_KMM;
+    _buf[1] = 0x00;
+    _buf[2] = 0x00;
+    _buf[3] = 0x00;   // Control
+    _buf[4] = 0xFF;   // Dest RSI
+    _buf[5] = 0xFF;
+    _buf[6] = 0xFF;
+
+    // KMM header - message length patched in end()
+    _buf[7] = messageId;
+    _buf[8] = 0x00;
+    _buf[9] = 0x00;
+    _buf[10] = responseKind;
+    _buf[11] = 0xFF;  // Destination RSI
+    _buf[12] = 0xFF;
+    _buf[13] = 0xFF;
+    _buf[14] = 0xFF;  // Source RSI
+    _buf[15] = 0xFF;
+    _buf[16] = 0xFF;
+
+    _pos = BODY_OFFSET;
+}
+
+void KmmWriter::put(uint8_t b) {
+    // Keep 2 bytes for the CRC
+    if (_overflow || _pos + 2 >= _cap) {
+        _overflow = true;
+        return;
+    }
+    _buf[_pos++] = b;
+}
+
+void KmmWriter::put16(uint16_t v) {
+    put((v >> 8) & 0xFF);
+    put(v & 0xFF);
+}
+
+void KmmWriter::put24(uint32_t v) {
+    put((v >> 16) & 0xFF);
+    put((v >> 8) & 0xFF);
+    put(v & 0xFF);
+}
+
+void KmmWriter::put(const uint8_t* data, size_t len) {
+    if (_overflow || _pos + len + 2 > _cap) {
+        _overflow = true;
+        return;
+    }
+    if (len > 0) memcpy(_buf + _pos, data, len);
+    _pos += len;
+}
+
+void KmmWriter::fill(uint8_t b, size_t len) {
+    if (_overflow || _pos + len + 2 > _cap) {
+        _overflow = true;
+        return;
+    }
+    memset(_buf + _pos, b, len);
+    _pos += len;
+}
+
+size_t KmmWriter::end() {
+    if (_overflow || _pos < BODY_OFFSET) return 0;
+
+    // KMM message length = 7 + body
+    size_t msgLen = _pos - 10;
+    _buf[8] = (msgLen >> 8) & 0xFF;
+    _buf[9] = msgLen & 0xFF;
+
+    // TWI length = control + dest RSI + KMM + CRC
+    size_t twiLen = _pos - 3 + 2;
+    if (twiLen > TWI_MAX_FRAME_LEN) {
+        _overflow = true;
+        return 0;
+    }
+    _buf[1] = (twiLen >> 8) & 0xFF;
+    _buf[2] = twiLen & 0xFF;
+
+    // CRC over control + dest RSI + KMM, sent low byte first (KFDtool order)
+    uint16_t crc = calculateCrc16(_buf + 3, _pos - 3);
+    _buf[_pos++] = crc & 0xFF;
+    _buf[_pos++] = (crc >> 8) & 0xFF;
+
+    return _pos;
+}
+
+// =============================================================================
+// KmmReader
+// =============================================================================
+
+KmmReader::KmmReader(const uint8_t* kmm, size_t len)
+    : _kmm(kmm), _len(kmm ? len : 0), _pos(KMM_HEADER_LEN), _ok(_len >= KMM_HEADER_LEN) {}
+
+uint8_t KmmReader::get() {
+    if (_pos >= _len) {
+        _ok = false;
+        return 0;
+    }
+    return _kmm[_pos++];
+}
+
+uint16_t KmmReader::get16() {
+    uint16_t hi = get();
+    return (hi << 8) | get();
+}
+
+uint32_t KmmReader::get24() {
+    uint32_t v = (uint32_t)get() << 16;
+    v |= (uint32_t)get() << 8;
+    return v | get();
+}
+
+const uint8_t* KmmReader::take(size_t n) {
+    if (_pos + n > _len) {
+        _ok = false;
+        _pos = _len;
+        return nullptr;
+    }
+    const uint8_t* p = _kmm + _pos;
+    _pos += n;
+    return p;
+}
+
+} // namespace P25
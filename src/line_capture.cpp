@@ -0,0 +1,614 @@
+/**
+ * @file line_capture.cpp
+ * @brief Logic-analyzer capture of the TWI DATA and SENSE lines
+ */
+
+#include "line_capture.h"
+#include "console.h"
+#include "sd_card.h"
+#include "crc16.h"
+#include "p25_defs.h"
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <driver/gpio.h>
+#include <soc/gpio_reg.h>
+#include <freertos/ringbuf.h>
+#include <algorithm>
+
+// RMT receive timing: 80 MHz APB / 80 = 1 µs per tick
+static const uint8_t  CAP_CLK_DIV = 80;
+// No edge for this long ends an RMT block (15-bit register, < 32767)
+static const uint16_t CAP_IDLE_US = 30000;
+// Pulses shorter than this many APB cycles are glitches (1.25 µs)
+static const uint8_t  CAP_FILTER_TICKS = 100;
+// Ring buffers (internal RAM, released when the capture stops). DATA must
+// hold one burst - a full KMM frame is ~10 KB of RMT items
+static const size_t   CAP_DATA_RING = 12288;
+static const size_t   CAP_SENSE_RING = 1024;
+// Fallback edge buffer without PSRAM
+static const size_t   CAP_INTERNAL_EDGES = 4096;
+// Edge times are 30 bits of µs
+static const uint32_t CAP_MAX_WINDOW_MS = 1000000;
+// A BUSY period longer than this many bit times is a break (key signature)
+static const uint32_t CAP_BREAK_BITS = 20;
+
+static uint8_t reverseBits(uint8_t b) {
+    b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+    b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+    b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+    return b;
+}
+
+static bool gpioOutputEnabled(int pin) {
+    if (pin < 32) return (REG_READ(GPIO_ENABLE_REG) >> pin) & 0x01;
+    return (REG_READ(GPIO_ENABLE1_REG) >> (pin - 32)) & 0x01;
+}
+
+static const char* opcodeName(uint8_t op) {
+    switch (op) {
+        case P25::TWI_READY_REQ:       return "READY_REQ";
+        case P25::TWI_READY_MODE_MR:   return "READY (MR)";
+        case P25::TWI_READY_MODE_KVL:  return "READY (KVL)";
+        case P25::TWI_TRANSFER_DONE:   return "TRANSFER_DONE";
+        case P25::TWI_KMM:             return "KMM";
+        case P25::TWI_DISCONNECT:      return "DISCONNECT";
+        case P25::TWI_DISCONNECT_ACK:  return "DISCONNECT_ACK";
+        default:                       return "?";
+    }
+}
+
+LineCapture& LineCapture::instance() {
+    static LineCapture inst;
+    return inst;
+}
+
+LineCapture::LineCapture()
+    : _edges(nullptr), _capacity(0), _count(0), _overflow(false),
+      _running(false), _stopRequested(false), _startUs(0), _durationUs(0),
+      _dataInstalled(false), _senseInstalled(false),
+      _task(nullptr), _waiter(nullptr), _lastError("") {
+    _lineTimeUs[0] = _lineTimeUs[1] = 0;
+    _lineLevel[0] = _lineLevel[1] = true;
+}
+
+void LineCapture::setError(const char* msg) {
+    _lastError = msg;
+    Console.printf("[CAP] %s\n", msg);
+}
+
+// =============================================================================
+// Capture
+// =============================================================================
+
+bool LineCapture::installChannel(rmt_channel_t ch, int pin, uint8_t memBlocks, size_t ringBytes) {
+    rmt_config_t cfg = RMT_DEFAULT_CONFIG_RX((gpio_num_t)pin, ch);
+    cfg.clk_div = CAP_CLK_DIV;
+    cfg.mem_block_num = memBlocks;
+    cfg.rx_config.filter_en = true;
+    cfg.rx_config.filter_ticks_thresh = CAP_FILTER_TICKS;
+    cfg.rx_config.idle_threshold = CAP_IDLE_US;
+
+    // rmt_config() makes the pin an input - keep driving it if the HAL was
+    // (SENSE), with the input enabled so our own drive is captured too
+    bool wasOutput = gpioOutputEnabled(pin);
+    if (rmt_config(&cfg) != ESP_OK) return false;
+    if (wasOutput) gpio_set_direction((gpio_num_t)pin, GPIO_MODE_INPUT_OUTPUT);
+
+    if (rmt_driver_install(ch, ringBytes, 0) != ESP_OK) return false;
+    if (rmt_rx_start(ch, true) != ESP_OK) {
+        rmt_driver_uninstall(ch);
+        return false;
+    }
+    return true;
+}
+
+void LineCapture::releaseChannels() {
+    if (_dataInstalled) {
+        rmt_rx_stop(_config.dataChannel);
+        rmt_driver_uninstall(_config.dataChannel);
+        _dataInstalled = false;
+    }
+    if (_senseInstalled) {
+        rmt_rx_stop(_config.senseChannel);
+        rmt_driver_uninstall(_config.senseChannel);
+        _senseInstalled = false;
+    }
+}
+
+bool LineCapture::start(const Config& config) {
+    if (_running) {
+        setError("Capture already running");
+        return false;
+    }
+
+    _config = config;
+    if (_config.windowMs > CAP_MAX_WINDOW_MS) _config.windowMs = CAP_MAX_WINDOW_MS;
+    if (_config.maxEdges < 64) _config.maxEdges = 64;
+
+    // Edge buffer in PSRAM, kept between captures
+    if (!_edges || _capacity != _config.maxEdges) {
+        if (_edges) heap_caps_free(_edges);
+        _capacity = _config.maxEdges;
+        _edges = (uint32_t*)heap_caps_malloc(_capacity * sizeof(uint32_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!_edges) {
+            _capacity = std::min<size_t>(_config.maxEdges, CAP_INTERNAL_EDGES);
+            _edges = (uint32_t*)heap_caps_malloc(_capacity * sizeof(uint32_t), MALLOC_CAP_8BIT);
+            Console.printf("[CAP] No PSRAM - edge buffer limited to %u\n", (unsigned)_capacity);
+        }
+        if (!_edges) {
+            _capacity = 0;
+            setError("Out of memory for edge buffer");
+            return false;
+        }
+    }
+
+    _count = 0;
+    _overflow = false;
+    _durationUs = 0;
+    _stopRequested = false;
+    _lastError = "";
+
+    _dataInstalled = installChannel(_config.dataChannel, _config.dataPin, 2, CAP_DATA_RING);
+    _senseInstalled = _dataInstalled &&
+                      installChannel(_config.senseChannel, _config.sensePin, 1, CAP_SENSE_RING);
+    if (!_senseInstalled) {
+        releaseChannels();
+        setError("RMT receive channels unavailable");
+        return false;
+    }
+
+    // Initial levels anchor both lines at t = 0
+    _startUs = esp_timer_get_time();
+    _lineTimeUs[LINE_DATA] = _lineTimeUs[LINE_SENSE] = 0;
+    _lineLevel[LINE_DATA] = gpio_get_level((gpio_num_t)_config.dataPin) != 0;
+    _lineLevel[LINE_SENSE] = gpio_get_level((gpio_num_t)_config.sensePin) != 0;
+    _edges[_count++] = (_lineLevel[LINE_DATA] ? EDGE_LEVEL : 0);
+    _edges[_count++] = EDGE_LINE | (_lineLevel[LINE_SENSE] ? EDGE_LEVEL : 0);
+
+    _running = true;
+    // Off the protocol worker's core, above the UI loop
+    if (xTaskCreatePinnedToCore(collectTask, "line_cap", 4096, this, 4, &_task, 1) != pdPASS) {
+        _task = nullptr;
+        _running = false;
+        releaseChannels();
+        setError("Failed to start capture task");
+        return false;
+    }
+    return true;
+}
+
+void LineCapture::stop() {
+    if (!_running) return;
+    _stopRequested = true;
+    uint32_t startMs = millis();
+    while (_running && millis() - startMs < 1000) delay(1);
+}
+
+bool LineCapture::wait(uint32_t timeoutMs) {
+    uint32_t startMs = millis();
+    _waiter = xTaskGetCurrentTaskHandle();
+    while (_running && millis() - startMs < timeoutMs) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(20));
+    }
+    _waiter = nullptr;
+    return !_running;
+}
+
+void LineCapture::collectTask(void* arg) {
+    static_cast<LineCapture*>(arg)->collectLoop();
+}
+
+void LineCapture::append(uint8_t line, bool level, uint32_t timeUs) {
+    if (level == _lineLevel[line]) return;
+    if (_count >= _capacity) {
+        _overflow = true;
+        return;
+    }
+
+    // Strictly increasing per line, so sorting by (time, line) keeps order
+    if (timeUs <= _lineTimeUs[line]) timeUs = _lineTimeUs[line] + 1;
+    _lineTimeUs[line] = timeUs;
+    _lineLevel[line] = level;
+    _edges[_count++] = (line ? EDGE_LINE : 0) | (level ? EDGE_LEVEL : 0) | (timeUs & EDGE_TIME);
+}
+
+void LineCapture::drainBlock(uint8_t line, const rmt_item32_t* items, size_t n, uint32_t endUs) {
+    // A block ends when the line has been quiet for CAP_IDLE_US; the final
+    // level is an end marker with duration 0
+    uint32_t total = 0;
+    bool endMarker = false;
+    for (size_t i = 0; i < n; i++) {
+        total += items[i].duration0;
+        if (items[i].duration0 == 0) { endMarker = true; break; }
+        total += items[i].duration1;
+        if (items[i].duration1 == 0) { endMarker = true; break; }
+    }
+
+    uint32_t back = total + (endMarker ? CAP_IDLE_US : 0);
+    uint32_t t = endUs > back ? endUs - back : 0;
+
+    for (size_t i = 0; i < n; i++) {
+        append(line, items[i].level0, t);
+        if (items[i].duration0 == 0) break;
+        t += items[i].duration0;
+        append(line, items[i].level1, t);
+        if (items[i].duration1 == 0) break;
+        t += items[i].duration1;
+    }
+}
+
+void LineCapture::collectLoop() {
+    RingbufHandle_t rb[2] = { nullptr, nullptr };
+    rmt_get_ringbuf_handle(_config.dataChannel, &rb[LINE_DATA]);
+    rmt_get_ringbuf_handle(_config.senseChannel, &rb[LINE_SENSE]);
+
+    const uint64_t windowUs = (uint64_t)_config.windowMs * 1000;
+
+    while (!_stopRequested && !_overflow) {
+        uint64_t elapsed = esp_timer_get_time() - _startUs;
+        if (windowUs && elapsed >= windowUs) break;
+        if (elapsed >= EDGE_TIME) break;
+
+        // Block on DATA so its bursts are stamped on arrival; SENSE is rare
+        for (uint8_t line = LINE_DATA; line <= LINE_SENSE; line++) {
+            if (!rb[line]) continue;
+            size_t size = 0;
+            TickType_t wait = (line == LINE_DATA) ? 1 : 0;
+            rmt_item32_t* items = (rmt_item32_t*)xRingbufferReceive(rb[line], &size, wait);
+            if (!items) continue;
+            uint32_t endUs = (uint32_t)(esp_timer_get_time() - _startUs);
+            drainBlock(line, items, size / sizeof(rmt_item32_t), endUs);
+            vRingbufferReturnItem(rb[line], items);
+        }
+    }
+
+    _durationUs = (uint32_t)std::min<uint64_t>(esp_timer_get_time() - _startUs, EDGE_TIME);
+    releaseChannels();
+
+    std::sort(_edges, _edges + _count, [](uint32_t a, uint32_t b) {
+        uint32_t ta = a & EDGE_TIME, tb = b & EDGE_TIME;
+        return ta != tb ? ta < tb : (a & EDGE_LINE) < (b & EDGE_LINE);
+    });
+
+    _task = nullptr;
+    _running = false;
+    TaskHandle_t waiter = _waiter;
+    if (waiter) xTaskNotifyGive(waiter);
+    vTaskDelete(nullptr);
+}
+
+LineCapture::Edge LineCapture::edge(size_t index) const {
+    Edge e = { 0, LINE_DATA, true };
+    if (_running || index >= _count) return e;
+    uint32_t v = _edges[index];
+    e.timeUs = v & EDGE_TIME;
+    e.line = (v & EDGE_LINE) ? LINE_SENSE : LINE_DATA;
+    e.level = (v & EDGE_LEVEL) != 0;
+    return e;
+}
+
+// =============================================================================
+// Offline decoding
+// =============================================================================
+
+uint32_t LineCapture::estimateBitUs() const {
+    // Single-bit pulses are the shortest ones; average those within 1.5x
+    // of the minimum
+    uint32_t minWidth = UINT32_MAX;
+    uint32_t prev = 0;
+    bool havePrev = false;
+    for (size_t i = 0; i < _count; i++) {
+        if (_edges[i] & EDGE_LINE) continue;
+        uint32_t t = _edges[i] & EDGE_TIME;
+        if (havePrev) {
+            uint32_t w = t - prev;
+            if (w >= 40 && w <= 2000 && w < minWidth) minWidth = w;
+        }
+        prev = t;
+        havePrev = true;
+    }
+    if (minWidth == UINT32_MAX) return 0;
+
+    uint64_t sum = 0;
+    uint32_t n = 0;
+    havePrev = false;
+    for (size_t i = 0; i < _count; i++) {
+        if (_edges[i] & EDGE_LINE) continue;
+        uint32_t t = _edges[i] & EDGE_TIME;
+        if (havePrev) {
+            uint32_t w = t - prev;
+            if (w >= minWidth && w <= minWidth + minWidth / 2) {
+                sum += w;
+                n++;
+            }
+        }
+        prev = t;
+        havePrev = true;
+    }
+    return n >= 4 ? (uint32_t)(sum / n) : 0;
+}
+
+LineCapture::Summary LineCapture::decode(std::vector<DecodedByte>* bytes, std::vector<Frame>* frames) {
+    Summary s = {};
+    if (bytes) bytes->clear();
+    if (frames) frames->clear();
+    if (_running) return s;
+
+    s.durationUs = _durationUs;
+    s.edges = _count;
+    s.overflow = _overflow;
+    s.measuredBitUs = estimateBitUs();
+    s.bitUs = _config.bitUs ? _config.bitUs : s.measuredBitUs;
+    for (size_t i = 0; i < _count; i++) {
+        if (_edges[i] & EDGE_LINE) s.senseEdges++;
+        else s.dataEdges++;
+    }
+    // Anchors at t = 0 are not transitions
+    if (s.dataEdges) s.dataEdges--;
+    if (s.senseEdges) s.senseEdges--;
+    if (s.bitUs == 0) return s;
+
+    // Same decoder as the HAL edge receiver: bit i is centred at
+    // start + (i + 0.5) * T
+    enum { HUNT, FRAME, WAIT_IDLE } state = HUNT;
+    const uint32_t T = s.bitUs;
+    uint32_t frameStart = 0;
+    uint16_t shift = 0;
+    uint32_t bitCount = 0;
+    bool level = true;
+    bool first = true;
+    std::vector<DecodedByte> local;
+    std::vector<DecodedByte>& out = bytes ? *bytes : local;
+
+    auto fillBits = [&](uint32_t t, bool lvl) {
+        uint32_t count = (t - frameStart + T / 2) / T;
+        if (count > 10) count = 10;
+        for (uint32_t i = bitCount; i < count; i++) {
+            if (lvl) shift |= (1 << i);
+        }
+        if (count > bitCount) bitCount = count;
+    };
+    auto finishFrame = [&]() {
+        // Wire order: start, 8 data bits (reversed), parity - even ones overall
+        uint8_t raw = (shift >> 1) & 0xFF;
+        uint8_t ones = __builtin_popcount(raw) + ((shift >> 9) & 0x01);
+        DecodedByte b = { frameStart, reverseBits(raw), (ones & 0x01) != 0 };
+        if (b.parityError) s.parityErrors++;
+        out.push_back(b);
+        s.bytes++;
+    };
+
+    for (size_t i = 0; i < _count; i++) {
+        if (_edges[i] & EDGE_LINE) continue;
+        uint32_t t = _edges[i] & EDGE_TIME;
+        bool lvl = (_edges[i] & EDGE_LEVEL) != 0;
+        if (first) {
+            level = lvl;
+            first = false;
+            continue;
+        }
+        if (lvl == level) continue;
+
+        uint32_t elapsed = t - frameStart;
+        if (state == FRAME) {
+            fillBits(t, level);
+            if (bitCount >= 1 && (shift & 0x01)) {
+                s.framingErrors++;
+                state = HUNT;
+            } else if (bitCount >= 10) {
+                if (!level && elapsed > T * CAP_BREAK_BITS) {
+                    s.breaks++;
+                    if (elapsed > s.longestBreakUs) s.longestBreakUs = elapsed;
+                    state = HUNT;
+                } else {
+                    finishFrame();
+                    // Falling edge right after parity = BUSY stop bits
+                    state = (!lvl && elapsed < T * 10 + T / 2) ? WAIT_IDLE : HUNT;
+                }
+            }
+        } else if (state == WAIT_IDLE && lvl) {
+            state = HUNT;
+        }
+
+        if (state == HUNT && !lvl) {
+            frameStart = t;
+            shift = 0;
+            bitCount = 0;
+            state = FRAME;
+        }
+        level = lvl;
+    }
+
+    // Last frame ending IDLE has no closing edge
+    if (state == FRAME && level && _durationUs - frameStart >= T * 10 + T / 2) {
+        fillBits(_durationUs, true);
+        if (shift & 0x01) s.framingErrors++;
+        else finishFrame();
+    }
+
+    // Group bytes into opcodes and KMM frames
+    uint8_t body[P25::TWI_MAX_FRAME_LEN];
+    size_t n = out.size();
+    for (size_t i = 0; i < n; ) {
+        Frame f = { out[i].timeUs, out[i].value, i, 1, 0, 0, true };
+
+        if (f.opcode == P25::TWI_KMM && i + 2 < n) {
+            f.length = ((uint16_t)out[i + 1].value << 8) | out[i + 2].value;
+            if (f.length >= P25::TWI_FRAME_OVERHEAD && f.length <= P25::TWI_MAX_FRAME_LEN) {
+                size_t avail = std::min<size_t>(f.length, n - i - 3);
+                for (size_t k = 0; k < avail; k++) body[k] = out[i + 3 + k].value;
+                f.byteCount = 3 + avail;
+                f.messageId = avail > 4 ? body[4] : 0;
+
+                if (avail == f.length) {
+                    uint16_t rxCrc = body[f.length - 2] | ((uint16_t)body[f.length - 1] << 8);
+                    f.crcOk = (Crc16::kmm(body, f.length - 2) == rxCrc);
+                } else {
+                    f.crcOk = false;  // Truncated
+                }
+                s.frames++;
+                if (!f.crcOk) s.crcErrors++;
+            } else {
+                // Not a plausible length - count the opcode alone
+                f.length = 0;
+                f.crcOk = false;
+            }
+        }
+
+        if (frames) frames->push_back(f);
+        i += f.byteCount;
+    }
+
+    return s;
+}
+
+void LineCapture::printDecoded(Print& out) {
+    std::vector<DecodedByte> bytes;
+    std::vector<Frame> frames;
+    Summary s = decode(&bytes, &frames);
+
+    out.printf("[CAP] %lu ms, %u DATA edges, %u SENSE edges%s\n",
+               (unsigned long)(s.durationUs / 1000), s.dataEdges, s.senseEdges,
+               s.overflow ? " (buffer full)" : "");
+    if (s.measuredBitUs) {
+        out.printf("[CAP] Measured bit period %u us (%u baud), decoding at %u us\n",
+                   s.measuredBitUs, 1000000 / s.measuredBitUs, s.bitUs);
+    }
+    if (s.bitUs == 0) {
+        out.println("[CAP] No bit period - nothing decoded");
+        return;
+    }
+    out.printf("[CAP] %u bytes, %u parity errors, %u framing errors, %u breaks (longest %lu ms)\n",
+               s.bytes, s.parityErrors, s.framingErrors, s.breaks, (unsigned long)(s.longestBreakUs / 1000));
+    out.printf("[CAP] %u KMM frames, %u CRC errors\n", s.frames, s.crcErrors);
+
+    for (const Frame& f : frames) {
+        out.printf("[CAP] %10lu  %02X %-14s", (unsigned long)f.timeUs, f.opcode, opcodeName(f.opcode));
+        if (f.opcode == P25::TWI_KMM && f.length) {
+            out.printf(" len %u msg %02X CRC %s\n      ", f.length, f.messageId, f.crcOk ? "ok" : "BAD");
+            for (size_t k = 1; k < f.byteCount; k++) {
+                const DecodedByte& b = bytes[f.firstByte + k];
+                out.printf("%02X%s", b.value, b.parityError ? "! " : " ");
+                if (k % 24 == 0 && k + 1 < f.byteCount) out.print("\n      ");
+            }
+        } else if (bytes[f.firstByte].parityError) {
+            out.print(" (parity)");
+        }
+        out.println();
+    }
+}
+
+// =============================================================================
+// Export
+// =============================================================================
+
+size_t LineCapture::exportVcd(Print& out) {
+    if (_running || _count == 0) return 0;
+
+    std::vector<DecodedByte> bytes;
+    Summary s = decode(&bytes, nullptr);
+    const uint32_t byteUs = s.bitUs * 10;
+
+    out.print("$comment KFDtool Pro TWI capture $end\n");
+    out.print("$timescale 1us $end\n");
+    out.print("$scope module twi $end\n");
+    out.print("$var wire 1 d data $end\n");
+    out.print("$var wire 1 s sense $end\n");
+    out.print("$var wire 8 b byte $end\n");
+    out.print("$upscope $end\n");
+    out.print("$enddefinitions $end\n");
+
+    size_t written = 0;
+    uint32_t lastTime = UINT32_MAX;
+    auto stamp = [&](uint32_t t) {
+        if (t != lastTime) {
+            out.printf("#%lu\n", (unsigned long)t);
+            lastTime = t;
+        }
+    };
+    auto byteValue = [&](int value) {
+        char bits[9];
+        for (int k = 0; k < 8; k++) bits[k] = value < 0 ? 'x' : ((value >> (7 - k)) & 0x01) ? '1' : '0';
+        bits[8] = '\0';
+        out.printf("b%s b\n", bits);
+    };
+
+    // Edges and byte start/end events, both in time order
+    size_t bi = 0;
+    bool byteOpen = false;
+    for (size_t i = 0; i <= _count; i++) {
+        uint32_t t = (i < _count) ? (_edges[i] & EDGE_TIME) : UINT32_MAX;
+
+        while (bi < bytes.size()) {
+            uint32_t bt = byteOpen ? bytes[bi].timeUs + byteUs : bytes[bi].timeUs;
+            if (bt > t) break;
+            stamp(bt);
+            if (byteOpen) {
+                byteValue(-1);
+                bi++;
+            } else {
+                byteValue(bytes[bi].value);
+            }
+            byteOpen = !byteOpen;
+        }
+        if (i == _count) break;
+
+        stamp(t);
+        if (t == 0 && written == 0) byteValue(-1);
+        out.printf("%c%c\n", (_edges[i] & EDGE_LEVEL) ? '1' : '0', (_edges[i] & EDGE_LINE) ? 's' : 'd');
+        written++;
+    }
+    stamp(_durationUs);
+    return written;
+}
+
+size_t LineCapture::exportCsv(Print& out) {
+    if (_running || _count == 0) return 0;
+
+    out.print("time_us,data,sense\n");
+    bool level[2] = { true, true };
+    size_t written = 0;
+    for (size_t i = 0; i < _count; i++) {
+        uint32_t v = _edges[i];
+        level[(v & EDGE_LINE) ? LINE_SENSE : LINE_DATA] = (v & EDGE_LEVEL) != 0;
+        // Both anchors share t = 0 - emit one row for them
+        if (i + 1 < _count && (_edges[i + 1] & EDGE_TIME) == (v & EDGE_TIME)) continue;
+        out.printf("%lu,%d,%d\n", (unsigned long)(v & EDGE_TIME), level[LINE_DATA], level[LINE_SENSE]);
+        written++;
+    }
+    return written;
+}
+
+bool LineCapture::saveToSd(const char* baseName) {
+    if (!hasCapture()) {
+        setError("No capture to save");
+        return false;
+    }
+    if (!SdCard::instance().mount()) {
+        setError("No SD card");
+        return false;
+    }
+
+    fs::FS& sd = SdCard::instance().fs();
+    String base = String("/") + (baseName && *baseName ? baseName : "capture");
+
+    File f = sd.open(base + ".vcd", FILE_WRITE);
+    if (!f) {
+        setError("Cannot create VCD file");
+        return false;
+    }
+    size_t nVcd = exportVcd(f);
+    f.close();
+
+    f = sd.open(base + ".csv", FILE_WRITE);
+    if (!f) {
+        setError("Cannot create CSV file");
+        return false;
+    }
+    size_t nCsv = exportCsv(f);
+    f.close();
+
+    Console.printf("[CAP] Saved %s.vcd (%u edges), %s.csv (%u rows)\n",
+                  base.c_str(), (unsigned)nVcd, base.c_str(), (unsigned)nCsv);
+    return true;
+}
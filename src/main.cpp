@@ -15,9 +15,17 @@
 #include <LovyanGFX.hpp>
 #include <lvgl.h>
 
+#include "bench.h"
+#include "console.h"
 #include "device_info.h"
 #include "container.h"
+#include "crypto.h"
+#include "fleet_loader.h"
+#include "host_bridge.h"
 #include "kfd_protocol.h"
+#include "line_capture.h"
+#include "metrics.h"
+#include "trace.h"
 #include "ui.h"
 
 // =============================================================================
@@ -113,30 +121,117 @@ static LGFX lcd;
 // =============================================================================
 // LVGL Integration
 // =============================================================================
+// Draw buffer height in lines. 40 = two 25 KB stripes in internal DMA RAM;
+// 480 = full frame, allocated in PSRAM (the bus driver copies it through its
+// own DMA bounce buffer, so it trades bandwidth for fewer partial refreshes).
+#ifndef LVGL_BUF_LINES
+#define LVGL_BUF_LINES 40
+#endif
+// 1 = LVGL renders into one buffer while the other is on the bus
+#ifndef LVGL_DOUBLE_BUF
+#define LVGL_DOUBLE_BUF 1
+#endif
+
+static const int32_t LCD_WIDTH = 320;
+static const int32_t LCD_HEIGHT = 480;
+
 static lv_disp_draw_buf_t draw_buf;
-static lv_color_t lv_buf1[320 * 40];
+static lv_color_t* lv_buf1 = nullptr;
+static lv_color_t* lv_buf2 = nullptr;
+static uint32_t lv_buf_lines = 0;
+static bool lv_buf_psram = false;
+
+// Refresh timing from LVGL's monitor callback (render + flush of one frame)
+struct FrameStats {
+    uint32_t frames;
+    uint32_t totalMs;
+    uint32_t maxMs;
+    uint32_t lastMs;
+    uint32_t lastPixels;
+};
+static FrameStats frame_stats = {};
 
 static void lvgl_flush_cb(lv_disp_drv_t* disp, const lv_area_t* area, lv_color_t* color_p) {
     int32_t w = area->x2 - area->x1 + 1;
     int32_t h = area->y2 - area->y1 + 1;
 
-    if (w <= 0 || h <= 0) {
-        lv_disp_flush_ready(disp);
-        return;
+    if (w > 0 && h > 0) {
+        // One bus transaction per frame; pushImageDMA waits for the previous
+        // stripe's transfer before queueing this one and returns immediately
+        if (lcd.getStartCount() == 0) lcd.startWrite();
+        lcd.pushImageDMA(area->x1, area->y1, w, h, (lgfx::swap565_t*)&color_p->full);
     }
 
-    lcd.startWrite();
-    lcd.setAddrWindow(area->x1, area->y1, w, h);
-    lcd.pushPixels((lgfx::rgb565_t*)&color_p->full, w * h);
-    lcd.endWrite();
+    if (lv_disp_flush_is_last(disp)) {
+        lcd.endWrite();     // Waits for the last transfer and releases the bus
+    } else if (!LVGL_DOUBLE_BUF) {
+        lcd.waitDMA();      // Single buffer: LVGL must not draw into it yet
+    }
+
+    // With two buffers LVGL now renders into the other one; this buffer is
+    // only reused after the next flush, which first waits for its transfer
     lv_disp_flush_ready(disp);
 }
 
+static void lvgl_monitor_cb(lv_disp_drv_t* disp, uint32_t time, uint32_t px) {
+    (void)disp;
+    frame_stats.frames++;
+    frame_stats.totalMs += time;
+    frame_stats.lastMs = time;
+    frame_stats.lastPixels = px;
+    if (time > frame_stats.maxMs) frame_stats.maxMs = time;
+}
+
+/**
+ * @brief Allocate the LVGL draw buffer(s), halving the stripe height until they fit
+ */
+static bool alloc_draw_buffers() {
+    uint32_t lines = LVGL_BUF_LINES;
+    if (lines > (uint32_t)LCD_HEIGHT) lines = LCD_HEIGHT;
+    if (lines < 10) lines = 10;
+
+    for (; lines >= 10; lines /= 2) {
+        size_t bytes = LCD_WIDTH * lines * sizeof(lv_color_t);
+        bool psram = lines == (uint32_t)LCD_HEIGHT && psramFound();
+        uint32_t caps = psram ? MALLOC_CAP_SPIRAM : (MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+
+        lv_buf1 = (lv_color_t*)heap_caps_malloc(bytes, caps);
+        lv_buf2 = LVGL_DOUBLE_BUF ? (lv_color_t*)heap_caps_malloc(bytes, caps) : nullptr;
+        if (lv_buf1 && (lv_buf2 || !LVGL_DOUBLE_BUF)) {
+            lv_buf_lines = lines;
+            lv_buf_psram = psram;
+            return true;
+        }
+        heap_caps_free(lv_buf1);
+        heap_caps_free(lv_buf2);
+        lv_buf1 = lv_buf2 = nullptr;
+    }
+    return false;
+}
+
+// FT6336U INT (active low while a touch is reported). LovyanGFX keeps
+// polling over I2C; the line only wakes the loop and restarts that polling.
+static const int TOUCH_INT_PIN = 7;
+static const uint8_t TOUCH_IDLE_READS = 3;  // Released reads before polling pauses
+
+static TaskHandle_t loop_task = nullptr;
+static volatile bool touch_irq = false;
+static lv_indev_drv_t indev_drv;
+
+static void IRAM_ATTR touch_isr() {
+    touch_irq = true;
+    if (loop_task) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(loop_task, &woken);
+        if (woken) portYIELD_FROM_ISR();
+    }
+}
+
 static bool last_pressed = false;
 static int16_t last_x = 0, last_y = 0;
+static uint8_t released_reads = 0;
 
-static void lvgl_touch_read(lv_indev_drv_t* indev_drv, lv_indev_data_t* data) {
-    (void)indev_drv;
+static void lvgl_touch_read(lv_indev_drv_t* drv, lv_indev_data_t* data) {
     uint16_t x, y;
     bool pressed = lcd.getTouch(&x, &y);
 
@@ -147,29 +242,66 @@ static void lvgl_touch_read(lv_indev_drv_t* indev_drv, lv_indev_data_t* data) {
         last_x = x;
         last_y = y;
         last_pressed = true;
+        released_reads = 0;
     } else {
         data->state = LV_INDEV_STATE_RELEASED;
         last_pressed = false;
+
+        // Nothing on the panel: stop the 16 ms I2C poll until the next INT.
+        // Clear the flag before sampling INT, so an edge between the two
+        // either shows as INT low or sets the flag again - never lost.
+        if (++released_reads >= TOUCH_IDLE_READS) {
+            touch_irq = false;
+            bool idle = digitalRead(TOUCH_INT_PIN) == HIGH;
+            if (idle && !touch_irq) {
+                released_reads = 0;
+                lv_timer_pause(drv->read_timer);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Resume touch polling after an INT edge (loop task context)
+ */
+static void touch_wake() {
+    if (!touch_irq) return;
+    touch_irq = false;
+    if (indev_drv.read_timer) {
+        lv_timer_resume(indev_drv.read_timer);
+        lv_timer_ready(indev_drv.read_timer);
     }
 }
 
 static void setup_lvgl() {
     lv_init();
-    lv_disp_draw_buf_init(&draw_buf, lv_buf1, nullptr, 320 * 40);
+    if (!alloc_draw_buffers()) {
+        Console.println("[LVGL] ERROR: no memory for draw buffer");
+        return;
+    }
+    lv_disp_draw_buf_init(&draw_buf, lv_buf1, lv_buf2, LCD_WIDTH * lv_buf_lines);
+    Console.printf("[LVGL] Draw buffer: %u x %u lines%s (%s)\n",
+                  lv_buf2 ? 2u : 1u, (unsigned)lv_buf_lines,
+                  lv_buf_lines == (uint32_t)LCD_HEIGHT ? " (full frame)" : "",
+                  lv_buf_psram ? "PSRAM" : "internal DMA");
 
     static lv_disp_drv_t disp_drv;
     lv_disp_drv_init(&disp_drv);
-    disp_drv.hor_res = 320;
-    disp_drv.ver_res = 480;
+    disp_drv.hor_res = LCD_WIDTH;
+    disp_drv.ver_res = LCD_HEIGHT;
     disp_drv.flush_cb = lvgl_flush_cb;
+    disp_drv.monitor_cb = lvgl_monitor_cb;
     disp_drv.draw_buf = &draw_buf;
     lv_disp_drv_register(&disp_drv);
 
-    static lv_indev_drv_t indev_drv;
     lv_indev_drv_init(&indev_drv);
     indev_drv.type = LV_INDEV_TYPE_POINTER;
     indev_drv.read_cb = lvgl_touch_read;
     lv_indev_drv_register(&indev_drv);
+
+    loop_task = xTaskGetCurrentTaskHandle();
+    pinMode(TOUCH_INT_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(TOUCH_INT_PIN), touch_isr, FALLING);
 }
 
 // =============================================================================
@@ -181,6 +313,29 @@ static KFDProtocol g_kfd;
 TWI_HAL& getTwiHal() { return g_twiHal; }
 KFDProtocol& getKfdProtocol() { return g_kfd; }
 
+/**
+ * @brief True while a TWI exchange may be running - settings and container
+ * writes wait for it (flash writes stall both cores and the edge ISR)
+ */
+static bool link_busy() {
+    return g_kfd.isOperationInProgress() || g_kfd.isSessionOpen() || FleetLoader::instance().isRunning();
+}
+
+/**
+ * @brief Restore the connect delay and line timing saved for the selected radio model
+ */
+static void apply_radio_profile() {
+    DeviceManager& dm = DeviceManager::instance();
+    const char* model = dm.getSettings().radioModel;
+    g_kfd.setRadioModel(model, dm.getPostReadyDelay(model));
+    
+    const RadioProfile* rp = dm.getRadioProfile(model);
+    if (rp && rp->txKilobaud) {
+        TWI_HAL::LineTiming t = { rp->txKilobaud, rp->rxKilobaud, rp->stopBits, rp->gapBits };
+        g_kfd.setLinkTiming(t);
+    }
+}
+
 // =============================================================================
 // Splash Screen
 // =============================================================================
@@ -268,31 +423,39 @@ void setup() {
     Serial.begin(115200);
     delay(100);
     
-    Serial.println("\n========================================");
-    Serial.println("KFDtool Professional - ESP32-S3");
-    Serial.println("P25 Key Fill Device");
-    Serial.println("TIA-102.AACD-A Compliant");
-    Serial.println("========================================\n");
+    Console.println("\n========================================");
+    Console.println("KFDtool Professional - ESP32-S3");
+    Console.println("P25 Key Fill Device");
+    Console.println("TIA-102.AACD-A Compliant");
+    Console.println("========================================\n");
     
     // Initialize LCD
-    Serial.println("[INIT] Initializing LCD...");
+    Console.println("[INIT] Initializing LCD...");
     lcd.init();
     lcd.setColorDepth(16);
     lcd.setRotation(0);  // Portrait 320x480
     lcd.setBrightness(200);
-    Serial.println("[INIT] LCD initialized");
+    Console.println("[INIT] LCD initialized");
+    
+    // Crypto known-answer tests (PBKDF2, CBC, GCM)
+    if (!Crypto::init()) {
+        Console.println("[INIT] WARNING: crypto self-test failed!");
+    }
     
     // Initialize device manager (loads settings, generates serial)
-    Serial.println("[INIT] Initializing device manager...");
+    Console.println("[INIT] Initializing device manager...");
     DeviceManager::instance().init();
-    Serial.printf("[INIT] Serial: %s\n", DeviceManager::instance().getSerialNumber());
+    Console.printf("[INIT] Serial: %s\n", DeviceManager::instance().getSerialNumber());
     
     // Show splash screen
     show_splash_screen();
     delay(500);
     
+    // Protocol trace output runs off the TWI worker's core
+    Trace::startTask(1);
+    
     // Initialize TWI hardware
-    Serial.println("[INIT] Initializing TWI hardware...");
+    Console.println("[INIT] Initializing TWI hardware...");
     TWI_HAL::Config twiConfig;
     twiConfig.dataPin = DeviceManager::instance().getSettings().twiDataPin;
     twiConfig.sensePin = DeviceManager::instance().getSettings().twiSensePin;
@@ -300,519 +463,675 @@ void setup() {
     twiConfig.rxKilobaud = DeviceManager::instance().getSettings().twiRxSpeed;
     
     if (g_twiHal.init(twiConfig)) {
-        Serial.println("[INIT] TWI hardware initialized");
-        Serial.printf("[INIT]   DATA=%d, SENSE=%d\n", twiConfig.dataPin, twiConfig.sensePin);
-        Serial.printf("[INIT]   TX=%d kbaud, RX=%d kbaud\n", twiConfig.txKilobaud, twiConfig.rxKilobaud);
+        Console.println("[INIT] TWI hardware initialized");
+        Console.printf("[INIT]   DATA=%d, SENSE=%d\n", twiConfig.dataPin, twiConfig.sensePin);
+        Console.printf("[INIT]   TX=%d kbaud, RX=%d kbaud\n", twiConfig.txKilobaud, twiConfig.rxKilobaud);
     } else {
-        Serial.println("[INIT] WARNING: TWI hardware init failed!");
+        Console.println("[INIT] WARNING: TWI hardware init failed!");
     }
     
     // Initialize KFD protocol
-    Serial.println("[INIT] Initializing KFD protocol...");
+    Console.println("[INIT] Initializing KFD protocol...");
     if (g_kfd.init(&g_twiHal)) {
-        Serial.println("[INIT] KFD protocol initialized");
+        Console.println("[INIT] KFD protocol initialized");
+        
+        // Restore the connect tuning learned for the selected radio model
+        apply_radio_profile();
+        g_kfd.setTuningCallback([](const char* m, uint32_t delayUs) {
+            DeviceManager::instance().queuePostReadyDelay(m, delayUs);
+        });
+        g_kfd.setLinkCallback([](const char* m, const TWI_HAL::LineTiming& t) {
+            // The standard timing is stored as "no cached timing"
+            if (t == g_kfd.getStandardLinkTiming()) DeviceManager::instance().queueLinkTiming(m, 0, 0, 4, 2);
+            else DeviceManager::instance().queueLinkTiming(m, t.txKilobaud, t.rxKilobaud, t.stopBits, t.gapBits);
+        });
     } else {
-        Serial.println("[INIT] WARNING: KFD protocol init failed!");
+        Console.println("[INIT] WARNING: KFD protocol init failed!");
     }
     
-    // Load containers
-    Serial.println("[INIT] Loading container data...");
+    // Gang-fill fixture ports (FLEET_PORTS > 1)
+    FleetLoader::instance().init(&g_twiHal, &g_kfd, twiConfig.txKilobaud, twiConfig.rxKilobaud);
+    Bench::init(&g_twiHal, &g_kfd);
+    
+    // Containers are encrypted at rest and load at login (DeviceManager::login)
+    Console.println("[INIT] Initializing container storage...");
     ContainerManager::instance().init();
-    if (!ContainerManager::instance().load()) {
-        Serial.println("[INIT] No saved containers, loading defaults");
-        ContainerManager::instance().loadDefaults();
-    }
-    Serial.printf("[INIT] %d containers loaded\n", ContainerManager::instance().getContainerCount());
+    ContainerManager::instance().setLinkBusyCheck(link_busy);
+    DeviceManager::instance().setLinkBusyCheck(link_busy);
     
     // Initialize LVGL
-    Serial.println("[INIT] Initializing LVGL...");
+    Console.println("[INIT] Initializing LVGL...");
     setup_lvgl();
-    Serial.println("[INIT] LVGL initialized");
+    Console.println("[INIT] LVGL initialized");
     
     // Initialize UI
-    Serial.println("[INIT] Initializing UI...");
+    Console.println("[INIT] Initializing UI...");
     ui_init();
-    Serial.println("[INIT] UI initialized");
-    
-    Serial.println("\n========================================");
-    Serial.println("Initialization complete!");
-    Serial.println("========================================");
-    Serial.println("\nHARDWARE SETUP:");
-    Serial.println("\n=== TWI Pins ===");
-    Serial.printf("  DATA: GPIO %d (using internal pullup - no external resistor needed!)\n", twiConfig.dataPin);
-    Serial.printf("  SENSE: GPIO %d\n", twiConfig.sensePin);
-    Serial.println("");
-    Serial.println("  Wiring: DATA -> Radio DATA, SENSE -> Radio SENSE, GND -> Radio GND");
-    Serial.println("  No external resistors required when using internal pullup.");
-    Serial.println("\nCABLE PINOUT (3.5mm TRS):");
-    Serial.println("  Tip    → DATA");
-    Serial.println("  Ring   → SENSE");
-    Serial.println("  Shield → GND");
-    Serial.println("\nReady for operation.\n");
+    Console.println("[INIT] UI initialized");
+    
+    // Service and console timers drive the event loop
+    setup_timers();
+    
+#if HOST_BRIDGE_ON_BOOT
+    HostBridge::instance().start(&g_twiHal, &g_kfd);
+#endif
+    
+    Console.println("\n========================================");
+    Console.println("Initialization complete!");
+    Console.println("========================================");
+    Console.println("\nHARDWARE SETUP:");
+    Console.println("\n=== TWI Pins ===");
+    Console.printf("  DATA: GPIO %d (using internal pullup - no external resistor needed!)\n", twiConfig.dataPin);
+    Console.printf("  SENSE: GPIO %d\n", twiConfig.sensePin);
+    Console.println("");
+    Console.println("  Wiring: DATA -> Radio DATA, SENSE -> Radio SENSE, GND -> Radio GND");
+    Console.println("  No external resistors required when using internal pullup.");
+    Console.println("\nCABLE PINOUT (3.5mm TRS):");
+    Console.println("  Tip    → DATA");
+    Console.println("  Ring   → SENSE");
+    Console.println("  Shield → GND");
+    Console.println("\nReady for operation.\n");
+    
+#if KFD_BENCH
+    // Bench build: one full run, loopback included when wired
+    Bench::run(Bench::T_ALL, Console);
+#endif
 }
 
 // =============================================================================
-// Arduino Loop
+// Serial Console
 // =============================================================================
-void loop() {
-    // Service LVGL
-    lv_timer_handler();
-    
-    // Service device manager (session timeout, etc)
-    DeviceManager::instance().service();
-    
-    // Service container manager (autosave)
-    ContainerManager::instance().service();
-    
-    // Serial command handler for debugging
-    if (Serial.available()) {
-        String cmd = Serial.readStringUntil('\n');
-        cmd.trim();
-        
-        if (cmd == "test" || cmd == "t") {
-            Serial.println("\n[TEST] Running inventory test...");
-            auto result = g_kfd.testInventory();
-            Serial.printf("[TEST] Result: %s - %s\n", result.success ? "SUCCESS" : "FAILED", result.message.c_str());
-        }
-        else if (cmd == "aes" || cmd == "a") {
-            Serial.println("\n[TEST] Testing AES key at SLN 202...");
-            auto result = g_kfd.testDESKey();  // Actually tests AES despite the name
-            Serial.printf("[TEST] Result: %s - %s\n", result.success ? "SUCCESS" : "FAILED", result.message.c_str());
-        }
-        else if (cmd == "stop0") {
-            g_twiHal.setStopBitMode(false);
-            Serial.println("[CONFIG] Stop bits set to IDLE (standard async)");
-        }
-        else if (cmd == "stop1") {
-            g_twiHal.setStopBitMode(true);
-            Serial.println("[CONFIG] Stop bits set to BUSY (KFDtool style)");
-        }
-        else if (cmd == "status" || cmd == "s") {
-            Serial.println("\n[STATUS]");
-            Serial.printf("  Stop bit mode: %s\n", g_twiHal.getStopBitMode() ? "BUSY (KFDtool)" : "IDLE (standard)");
-            Serial.printf("  Send mode: %s\n", g_kfd.getFastSendMode() ? "FAST" : "SLOW (byte-by-byte)");
-            Serial.printf("  Post-0xD0 delay: %u µs\n", g_kfd.getPostReadyDelay());
-            Serial.printf("  DATA line: %s\n", g_twiHal.isLineIdle() ? "HIGH (idle)" : "LOW (busy)");
-            Serial.printf("  SENSE line: %s\n", g_twiHal.readSenseLine() ? "LOW (connected)" : "HIGH (disconnected)");
-        }
-        else if (cmd == "selftest") {
-            Serial.println("\n[SELFTEST] Running hardware self-test...");
-            uint8_t result = g_twiHal.selfTest();
-            if (result == 0) {
-                Serial.println("[SELFTEST] PASSED - All hardware OK");
-            } else {
-                Serial.printf("[SELFTEST] FAILED - Error code: 0x%02X\n", result);
+static void handle_serial_command(const String& cmd) {
+    if (cmd == "test" || cmd == "t") {
+        Console.println("\n[TEST] Running inventory test...");
+        auto result = g_kfd.testInventory();
+        Console.printf("[TEST] Result: %s - %s\n", result.success ? "SUCCESS" : "FAILED", result.message.c_str());
+    }
+    else if (cmd == "keys") {
+        Console.println("\n[TEST] Reading key inventory...");
+        std::vector<P25::KeyStatus> keys;
+        auto result = g_kfd.viewKeyInfo(keys, [](const P25::KeyStatus* items, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                Console.printf("  KSET %3u  SLN %5u  KID %5u  %s\n", items[i].keysetId, items[i].sln,
+                              items[i].keyId, P25::getAlgorithmName(items[i].algorithmId));
             }
-        }
-        else if (cmd == "sniff") {
-            // Sniffer mode - capture traffic from another KFD
-            Serial.println("\n[SNIFF] === TWI Sniffer Mode ===");
-            Serial.println("[SNIFF] Connect KFDNano DATA to GPIO12, GND to GND");
-            Serial.println("[SNIFF] Press any key to exit...");
-            Serial.println("[SNIFF] Waiting for traffic...\n");
-            
-            uint32_t lastChangeTime = 0;
-            bool lastState = true;  // Assume IDLE (HIGH)
-            
-            // Clear any pending serial
-            while (Serial.available()) Serial.read();
-            
-            uint32_t startTime = micros();
-            while (!Serial.available()) {
-                bool currentState = g_twiHal.isLineIdle();
-                uint32_t now = micros();
-                
-                if (currentState != lastState) {
-                    uint32_t duration = now - lastChangeTime;
-                    
-                    // Log state changes
-                    if (duration > 50) {  // Filter noise < 50us
-                        if (!lastState) {  // Was LOW, now HIGH
-                            Serial.printf("[%8u] LOW  %5u µs\n", lastChangeTime - startTime, duration);
-                        } else {  // Was HIGH, now LOW
-                            Serial.printf("[%8u] HIGH %5u µs\n", lastChangeTime - startTime, duration);
-                        }
-                    }
-                    
-                    lastChangeTime = now;
-                    lastState = currentState;
-                }
-                
-                delayMicroseconds(5);  // Sample at ~200kHz for better resolution
+        });
+        Console.printf("[TEST] Result: %s - %s\n", result.success ? "SUCCESS" : "FAILED", result.message.c_str());
+    }
+    else if (cmd == "sync" || cmd == "sync erase") {
+        const Container* c = ContainerManager::instance().getActiveContainer();
+        if (!c) {
+            Console.println("[TEST] No active container");
+        } else {
+            bool eraseExtras = (cmd == "sync erase");
+            Console.printf("\n[TEST] Syncing %d selected keys%s...\n", (int)c->selectedKeyCount(),
+                          eraseExtras ? " (erasing extras)" : "");
+            auto keys = c->getSelectedKeyItems();
+            auto result = g_kfd.syncKeys(keys, eraseExtras);
+            for (auto& k : keys) {
+                if (!k.key.empty()) Crypto::secureZero(k.key.data(), k.key.size());
             }
-            Serial.println("\n[SNIFF] Exited sniffer mode");
+            const auto& st = g_kfd.getSyncStats();
+            Console.printf("[TEST] Radio %u keys: %u unchanged, %u loaded, %u erased\n",
+                          st.radioKeys, st.unchanged, st.toLoad, st.toErase);
+            Console.printf("[TEST] Result: %s - %s\n", result.success ? "SUCCESS" : "FAILED", result.message.c_str());
         }
-        else if (cmd == "measure") {
-            // Measure actual bit timing from KFDNano
-            Serial.println("\n[MEASURE] === Bit Timing Measurement ===");
-            Serial.println("[MEASURE] Connect KFDNano DATA to GPIO12");
-            Serial.println("[MEASURE] Run a command on KFDNano, will measure bit periods");
-            Serial.println("[MEASURE] Press any key to exit...\n");
-            
-            while (Serial.available()) Serial.read();
-            
-            // Wait for key signature first
-            Serial.println("[MEASURE] Waiting for key signature...");
-            while (!Serial.available()) {
-                if (g_twiHal.isLineBusy()) {
-                    uint32_t lowStart = micros();
-                    while (g_twiHal.isLineBusy() && !Serial.available());
-                    uint32_t lowDuration = micros() - lowStart;
-                    if (lowDuration > 50000) {  // Key sig is ~100ms
-                        Serial.printf("[MEASURE] Key signature: %u µs\n", lowDuration);
-                        break;
-                    }
-                }
+    }
+    else if (cmd == "aes" || cmd == "a") {
+        Console.println("\n[TEST] Testing AES key at SLN 202...");
+        auto result = g_kfd.testDESKey();  // Actually tests AES despite the name
+        Console.printf("[TEST] Result: %s - %s\n", result.success ? "SUCCESS" : "FAILED", result.message.c_str());
+    }
+    else if (cmd == "stop0") {
+        g_twiHal.setStopBitMode(false);
+        Console.println("[CONFIG] Stop bits set to IDLE (standard async)");
+    }
+    else if (cmd == "stop1") {
+        g_twiHal.setStopBitMode(true);
+        Console.println("[CONFIG] Stop bits set to BUSY (KFDtool style)");
+    }
+    else if (cmd == "status" || cmd == "s") {
+        Console.println("\n[STATUS]");
+        Console.printf("  Stop bit mode: %s\n", g_twiHal.getStopBitMode() ? "BUSY (KFDtool)" : "IDLE (standard)");
+        Console.printf("  Send mode: %s\n", g_kfd.getFastSendMode() ? "FAST" : "SLOW (byte-by-byte)");
+        Console.printf("  TX backend: %s\n", g_twiHal.getTxBackend() == TWI_HAL::TX_RMT ? "RMT" : "bit-bang");
+        Console.printf("  RX backend: %s\n", g_twiHal.getRxBackend() == TWI_HAL::RX_EDGE_CAPTURE ? "edge capture" : "polled");
+        auto rx = g_twiHal.getRxStats();
+        Console.printf("  RX stats: %u bytes, %u parity, %u framing, %u overrun, %u breaks\n",
+                      rx.bytes, rx.parityErrors, rx.framingErrors, rx.overruns, rx.breaks);
+        Console.printf("  Radio model: %s\n", g_kfd.getRadioModel());
+        Console.printf("  Post-0xD0 delay: %u µs\n", g_kfd.getPostReadyDelay());
+        auto lt = g_kfd.getLinkTiming();
+        Console.printf("  Line timing: TX %u / RX %u kbaud, %u stop, %u gap bits%s\n", lt.txKilobaud, lt.rxKilobaud,
+                      lt.stopBits, lt.gapBits, lt == g_kfd.getStandardLinkTiming() ? " (standard)" : "");
+        Console.printf("  DATA line: %s\n", g_twiHal.isLineIdle() ? "HIGH (idle)" : "LOW (busy)");
+        Console.printf("  SENSE line: %s\n", g_twiHal.readSenseLine() ? "LOW (connected)" : "HIGH (disconnected)");
+    }
+    else if (cmd == "selftest") {
+        Console.println("\n[SELFTEST] Running hardware self-test...");
+        uint8_t result = g_twiHal.selfTest();
+        if (result == 0) {
+            Console.println("[SELFTEST] PASSED - All hardware OK");
+        } else {
+            Console.printf("[SELFTEST] FAILED - Error code: 0x%02X\n", result);
+        }
+    }
+    else if (cmd == "sniff" || cmd == "measure" || cmd == "capture" || cmd.startsWith("capture ")) {
+        // Logic-analyzer capture of DATA and SENSE - the RMT peripheral
+        // timestamps every edge, decoding happens after the window
+        LineCapture& cap = LineCapture::instance();
+        String arg = cmd.startsWith("capture ") ? cmd.substring(8) : String("");
+        arg.trim();
+        
+        if (arg.startsWith("save")) {
+            String name = arg.length() > 4 ? arg.substring(5) : String("capture");
+            name.trim();
+            if (!cap.saveToSd(name.c_str())) {
+                Console.printf("[CAP] Save failed: %s\n", cap.getLastError());
             }
+        } else if (arg == "show") {
+            if (cap.hasCapture()) cap.printDecoded(Console);
+            else Console.println("[CAP] No capture");
+        } else if (arg == "vcd") {
+            cap.exportVcd(Console);
+        } else if (arg == "csv") {
+            cap.exportCsv(Console);
+        } else {
+            TWI_HAL::Config hc = g_twiHal.getConfig();
+            LineCapture::Config cc;
+            cc.dataPin = hc.dataPin;
+            cc.sensePin = hc.sensePin;
+            // sniff/measure run until a key press; measure estimates the bit period
+            cc.windowMs = (cmd == "capture") ? 5000 : (arg.length() ? (uint32_t)arg.toInt() : 0);
+            cc.bitUs = (cmd == "measure") ? 0 : 1000 / (hc.rxKilobaud ? hc.rxKilobaud : 4);
             
-            if (Serial.available()) { 
-                Serial.println("[MEASURE] Exited"); 
+            while (Serial.available()) Serial.read();
+            if (!cap.start(cc)) {
+                Console.printf("[CAP] %s\n", cap.getLastError());
             } else {
-                // Wait for idle period
-                uint32_t idleStart = micros();
-                while (g_twiHal.isLineIdle() && !Serial.available() && (micros() - idleStart) < 20000);
-                Serial.printf("[MEASURE] Idle period: %u µs\n", micros() - idleStart);
-                
-                // Now measure individual bit transitions during READY_REQ byte
-                Serial.println("[MEASURE] Capturing bit transitions...");
-                
-                uint32_t transitions[100];
-                int transCount = 0;
-                bool lastState = g_twiHal.isLineIdle();
-                uint32_t lastTime = micros();
-                uint32_t measureStart = micros();
-                
-                // Capture transitions for ~50ms (enough for several bytes)
-                while (transCount < 100 && (micros() - measureStart) < 50000 && !Serial.available()) {
-                    bool state = g_twiHal.isLineIdle();
-                    if (state != lastState) {
-                        uint32_t now = micros();
-                        transitions[transCount++] = now - lastTime;
-                        lastTime = now;
-                        lastState = state;
-                    }
-                }
-                
-                Serial.printf("\n[MEASURE] Captured %d transitions:\n", transCount);
-                uint32_t totalPeriod = 0;
-                int periodCount = 0;
-                for (int i = 0; i < transCount && i < 50; i++) {
-                    Serial.printf("  %3d: %4u µs\n", i, transitions[i]);
-                    // Look for bit-period sized transitions (150-350µs range)
-                    if (transitions[i] >= 150 && transitions[i] <= 350) {
-                        totalPeriod += transitions[i];
-                        periodCount++;
-                    }
+                if (cc.windowMs) Console.printf("\n[CAP] Capturing DATA/SENSE for %u ms (any key stops)...\n", cc.windowMs);
+                else Console.println("\n[CAP] Capturing DATA/SENSE - press any key to stop...");
+                while (!cap.wait(50)) {
+                    if (Serial.available()) cap.stop();
                 }
+                while (Serial.available()) Serial.read();
+                cap.printDecoded(Console);
                 
-                if (periodCount > 0) {
-                    uint32_t avgPeriod = totalPeriod / periodCount;
-                    uint32_t baudRate = 1000000 / avgPeriod;
-                    Serial.printf("\n[MEASURE] Estimated bit period: %u µs\n", avgPeriod);
-                    Serial.printf("[MEASURE] Estimated baud rate: %u baud\n", baudRate);
-                    Serial.printf("[MEASURE] Our setting: 250 µs = 4000 baud\n");
-                    if (avgPeriod < 240) {
-                        Serial.println("[MEASURE] KFDNano is FASTER - try baud5 or baud6");
-                    } else if (avgPeriod > 260) {
-                        Serial.println("[MEASURE] KFDNano is SLOWER - try baud3");
+                if (cmd == "measure") {
+                    LineCapture::Summary cs = cap.decode();
+                    uint32_t ourUs = 1000 / (hc.rxKilobaud ? hc.rxKilobaud : 4);
+                    if (cs.measuredBitUs == 0) {
+                        Console.println("[MEASURE] No bit-length pulses captured");
+                    } else if (cs.measuredBitUs < ourUs - ourUs / 25) {
+                        Console.printf("[MEASURE] Sender is FASTER than our %u us - try a higher baud\n", ourUs);
+                    } else if (cs.measuredBitUs > ourUs + ourUs / 25) {
+                        Console.printf("[MEASURE] Sender is SLOWER than our %u us - try a lower baud\n", ourUs);
                     } else {
-                        Serial.println("[MEASURE] Timing looks close to 4 kbaud");
+                        Console.printf("[MEASURE] Timing matches our %u us bit period\n", ourUs);
                     }
                 }
-                
-                Serial.println("[MEASURE] Done");
+                Console.println("[CAP] 'capture save [name]' writes VCD/CSV to SD");
             }
         }
-        else if (cmd == "sniffbytes") {
-            // Byte-level sniffer - try to decode actual bytes
-            Serial.println("\n[SNIFF] === Byte Sniffer Mode ===");
-            Serial.println("[SNIFF] Connect KFDNano DATA to GPIO12");
-            Serial.println("[SNIFF] Press any key to exit...\n");
-            
-            // Clear serial
-            while (Serial.available()) Serial.read();
-            
-            while (!Serial.available()) {
-                uint8_t b;
-                if (g_twiHal.receiveByte(&b, 100)) {
-                    Serial.printf("[SNIFF] Byte: 0x%02X\n", b);
-                }
+    }
+    else if (cmd == "sniffbytes") {
+        // Byte-level sniffer - try to decode actual bytes
+        Console.println("\n[SNIFF] === Byte Sniffer Mode ===");
+        Console.println("[SNIFF] Connect KFDNano DATA to GPIO12");
+        Console.println("[SNIFF] Press any key to exit...\n");
+        
+        // Clear serial
+        while (Serial.available()) Serial.read();
+        
+        while (!Serial.available()) {
+            uint8_t b;
+            if (g_twiHal.receiveByte(&b, 100)) {
+                Console.printf("[SNIFF] Byte: 0x%02X\n", b);
             }
-            Serial.println("[SNIFF] Exited");
         }
-        else if (cmd == "emulate" || cmd == "emu") {
-            // Radio emulator mode - pretend to be a radio, capture what KFD sends
-            Serial.println("\n[EMU] === Radio Emulator Mode ===");
-            Serial.println("[EMU] Connect KFDNano to ESP32:");
-            Serial.println("[EMU]   KFDNano DATA  -> GPIO12");
-            Serial.println("[EMU]   KFDNano SENSE -> GPIO13");
-            Serial.println("[EMU]   KFDNano GND   -> GND");
-            Serial.println("[EMU] Then run inventory/keyload on KFDNano software");
-            Serial.println("[EMU] Press any key to exit...\n");
-            
-            // Clear serial
-            while (Serial.available()) Serial.read();
-            
-            // Release lines - let KFDNano drive them
-            g_twiHal.reset();
-            
+        Console.println("[SNIFF] Exited");
+    }
+    else if (cmd == "emulate" || cmd == "emu") {
+        // Radio emulator mode - act as a radio for another KFD
+        Console.println("\n[EMU] === Radio Emulator Mode ===");
+        Console.println("[EMU] Connect the KFD to the TWI port (DATA, SENSE, GND)");
+        Console.println("[EMU] Then run inventory/keyload on the KFD - sessions re-arm automatically");
+        Console.println("[EMU] Press any key to exit...\n");
+        
+        while (Serial.available()) Serial.read();
+        
+        // Runs on the delivery task, after the KFD has been acked
+        auto result = g_kfd.startMrEmulator([](const P25::KeyItem& key) {
+            Console.printf("[EMU] %s KSET %u SLN %u KID %u %s (%u bytes)\n",
+                          key.erase ? "Erased" : "Key", key.keysetId, key.sln, key.keyId,
+                          P25::getAlgorithmName(key.algorithmId), (unsigned)key.key.size());
+        });
+        if (!result.success) {
+            Console.printf("[EMU] %s\n", result.message.c_str());
+        } else {
+            uint32_t sessions = 0;
             while (!Serial.available()) {
-                // Wait for key signature (line goes LOW for extended period)
-                Serial.println("[EMU] Waiting for key signature...");
-                
-                uint32_t lowStart = 0;
-                bool gotKeySig = false;
-                
-                // Wait for line to go LOW
-                uint32_t waitStart = millis();
-                while (!Serial.available() && (millis() - waitStart) < 30000) {
-                    if (g_twiHal.isLineBusy()) {
-                        lowStart = millis();
-                        // Wait for it to stay LOW for >50ms (key signature)
-                        while (g_twiHal.isLineBusy() && !Serial.available()) {
-                            if ((millis() - lowStart) > 50) {
-                                gotKeySig = true;
-                                break;
-                            }
-                        }
-                        if (gotKeySig) break;
-                    }
-                    delay(1);
-                }
-                
-                if (Serial.available()) break;
-                if (!gotKeySig) continue;
-                
-                uint32_t keySigDuration = millis() - lowStart;
-                
-                // Wait for line to go HIGH (end of key signature)
-                while (g_twiHal.isLineBusy() && !Serial.available()) {
-                    delay(1);
-                }
-                uint32_t totalLow = millis() - lowStart;
-                Serial.printf("[EMU] Key signature: LOW for %u ms\n", totalLow);
-                
-                // Wait for IDLE period
-                uint32_t idleStart = millis();
-                while (g_twiHal.isLineIdle() && !Serial.available() && (millis() - idleStart) < 100) {
-                    delayMicroseconds(100);
-                }
-                uint32_t idleDuration = millis() - idleStart;
-                Serial.printf("[EMU] Idle period: %u ms\n", idleDuration);
-                
-                if (Serial.available()) break;
-                
-                // Now receive READY_REQ (0xC0)
-                uint8_t readyReq;
-                if (g_twiHal.receiveByte(&readyReq, 1000)) {
-                    Serial.printf("[EMU] Got READY_REQ: 0x%02X\n", readyReq);
-                    
-                    // Send 0xD0 response (MR mode ready)
-                    delay(1);  // Small delay before response
-                    g_twiHal.sendByte(0xD0);
-                    Serial.println("[EMU] Sent 0xD0 (MR ready)");
-                    
-                    // Now capture the KMM frame
-                    Serial.println("[EMU] Waiting for KMM frame...");
-                    
-                    uint8_t kmmBuffer[256];
-                    int kmmLen = 0;
-                    uint32_t lastByteTime = millis();
-                    
-                    while (kmmLen < 256 && (millis() - lastByteTime) < 2000) {
-                        uint8_t b;
-                        if (g_twiHal.receiveByte(&b, 500)) {
-                            kmmBuffer[kmmLen++] = b;
-                            lastByteTime = millis();
-                            Serial.printf("[EMU] Byte %d: 0x%02X\n", kmmLen, b);
-                        }
-                    }
-                    
-                    if (kmmLen > 0) {
-                        Serial.printf("\n[EMU] === Captured KMM Frame (%d bytes) ===\n", kmmLen);
-                        Serial.print("[EMU] HEX: ");
-                        for (int i = 0; i < kmmLen; i++) {
-                            Serial.printf("%02X ", kmmBuffer[i]);
-                        }
-                        Serial.println();
-                        
-                        // Parse the frame
-                        if (kmmLen >= 3 && kmmBuffer[0] == 0xC2) {
-                            int len = (kmmBuffer[1] << 8) | kmmBuffer[2];
-                            Serial.printf("[EMU] Opcode: 0x%02X (KMM)\n", kmmBuffer[0]);
-                            Serial.printf("[EMU] Length: %d bytes\n", len);
-                            if (kmmLen >= 7) {
-                                Serial.printf("[EMU] Control: 0x%02X\n", kmmBuffer[3]);
-                                Serial.printf("[EMU] Dest RSI: %02X %02X %02X\n", 
-                                              kmmBuffer[4], kmmBuffer[5], kmmBuffer[6]);
-                            }
-                            if (kmmLen >= 2) {
-                                Serial.printf("[EMU] CRC bytes: %02X %02X\n", 
-                                              kmmBuffer[kmmLen-2], kmmBuffer[kmmLen-1]);
-                            }
-                        }
-                        
-                        // Send a dummy response (NegativeAck to avoid confusing the KFD)
-                        Serial.println("[EMU] Sending NAK response...");
-                        delay(5);
-                        // Simple NAK: C2 00 06 00 FF FF FF 2C 00 [CRC]
-                        uint8_t nak[] = {0xC2, 0x00, 0x08, 0x00, 0xFF, 0xFF, 0xFF, 0x2C, 0x00, 0x00};
-                        // Add simple CRC (just for completeness)
-                        for (int i = 0; i < 10; i++) {
-                            g_twiHal.sendByte(nak[i]);
-                        }
-                        Serial.println("[EMU] Done - waiting for disconnect...");
-                    } else {
-                        Serial.println("[EMU] No KMM bytes received");
-                    }
-                } else {
-                    Serial.println("[EMU] No READY_REQ received");
+                const auto& st = g_kfd.getMrEmulatorStats();
+                if (st.sessions != sessions) {
+                    sessions = st.sessions;
+                    Console.printf("[EMU] Session %u started\n", sessions);
                 }
-                
-                // Wait a bit before next cycle
-                delay(1000);
+                delay(50);
             }
-            Serial.println("[EMU] Exited emulator mode");
+            g_kfd.stopMrEmulator();
+            
+            const auto& st = g_kfd.getMrEmulatorStats();
+            Console.printf("[EMU] %u sessions, %u KMMs, %u loaded, %u erased, %u CRC errors, %u NAKs, %u dropped\n",
+                          st.sessions, st.kmms, st.keysLoaded, st.keysErased, st.crcErrors, st.naks, st.dropped);
+        }
+        while (Serial.available()) Serial.read();
+        Console.println("[EMU] Exited emulator mode");
+    }
+    else if (cmd == "help" || cmd == "h" || cmd == "?") {
+        Console.println("\n=== KFDtool Debug Commands ===");
+        Console.println("  test, t     - Run inventory test");
+        Console.println("  aes, a      - Test AES key at SLN 202");
+        Console.println("  stop0       - Use IDLE stop bits (standard)");
+        Console.println("  stop1       - Use BUSY stop bits (KFDtool)");
+        Console.println("  baud2-9     - Set baud rate (2/3/4/5/6/9 kbaud)");
+        Console.println("  fast        - Use fast send mode");
+        Console.println("  slow        - Use byte-by-byte send mode");
+        Console.println("  txrmt       - Transmit via RMT peripheral");
+        Console.println("  txbb        - Transmit via bit-bang (default)");
+        Console.println("  rxedge      - Receive via edge interrupt (default)");
+        Console.println("  rxpoll      - Receive via polling");
+        Console.println("  delay0/1/5  - Set delay after 0xD0 (0/1/5 ms)");
+        Console.println("  keys        - List keys in the radio (inventory)");
+        Console.println("  sync [erase]- Load only selected keys the radio lacks");
+        Console.println("  radio <m>   - Select radio model (restores its tuning)");
+        Console.println("  connstats   - Show session connect latency statistics");
+        Console.println("  linkprobe   - Find and save the fastest line timing for this radio");
+        Console.println("  linkreset   - Forget the saved line timing (back to standard)");
+        Console.println("  fleet [load|abort] - Gang-fill status, load selected keys on all ports");
+        Console.println("  bridge      - Binary KFDtool host bridge on USB (host EXIT cmd returns)");
+        Console.println("  backup [name] / restore <name> / backups - Encrypted container backup on SD");
+        Console.println("  export [name] / import <name> - Containers as plain JSON on SD");
+        Console.println("  display [reset] - Show LVGL draw buffer and frame time");
+        Console.println("  cryptobench [n] - Time PBKDF2 (n iterations) and AES/SHA throughput");
+        Console.println("  metrics [csv|save [name]|reset] - Phase/operation latency histograms, error counters");
+        Console.println("  bench [test|show|csv|baseline] - Benchmark suite, loopback keyloads, regression check");
+        Console.println("  trace [cmd] - Protocol trace: dump/events/on/off/edges/stream/clear/stats");
+        Console.println("  emulate     - Act as radio for another KFD (MR emulator)");
+        Console.println("  capture [ms]- Capture DATA/SENSE (default 5 s), decode bytes/KMM");
+        Console.println("  capture save [name] / show / vcd / csv - Export last capture");
+        Console.println("  measure     - Capture until key, estimate sender bit timing");
+        Console.println("  sniff       - Capture until key, decode traffic");
+        Console.println("  status, s   - Show current status");
+        Console.println("  help, h     - Show this help");
+    }
+    else if (cmd == "baud2") {
+        g_twiHal.setTxSpeed(2);
+        g_twiHal.setRxSpeed(2);
+        Console.println("[CONFIG] Baud rate set to 2 kbaud (500µs/bit)");
+    }
+    else if (cmd == "baud3") {
+        g_twiHal.setTxSpeed(3);
+        g_twiHal.setRxSpeed(3);
+        Console.println("[CONFIG] Baud rate set to 3 kbaud (333µs/bit)");
+    }
+    else if (cmd == "baud4") {
+        g_twiHal.setTxSpeed(4);
+        g_twiHal.setRxSpeed(4);
+        Console.println("[CONFIG] Baud rate set to 4 kbaud (250µs/bit)");
+    }
+    else if (cmd == "baud5") {
+        g_twiHal.setTxSpeed(5);
+        g_twiHal.setRxSpeed(5);
+        Console.println("[CONFIG] Baud rate set to 5 kbaud (200µs/bit)");
+    }
+    else if (cmd == "baud6") {
+        g_twiHal.setTxSpeed(6);
+        g_twiHal.setRxSpeed(6);
+        Console.println("[CONFIG] Baud rate set to 6 kbaud (167µs/bit)");
+    }
+    else if (cmd == "baud9") {
+        g_twiHal.setTxSpeed(9);
+        g_twiHal.setRxSpeed(9);
+        Console.println("[CONFIG] Baud rate set to 9.6 kbaud (104µs/bit)");
+    }
+    else if (cmd == "fast") {
+        g_kfd.setFastSendMode(true);
+        Console.println("[CONFIG] Send mode: FAST (sendBytesFast)");
+    }
+    else if (cmd == "slow") {
+        g_kfd.setFastSendMode(false);
+        Console.println("[CONFIG] Send mode: SLOW (byte-by-byte)");
+    }
+    else if (cmd == "txrmt") {
+        if (g_twiHal.setTxBackend(TWI_HAL::TX_RMT)) {
+            Console.println("[CONFIG] TX backend: RMT (hardware timed)");
+        } else {
+            Console.println("[CONFIG] RMT init failed - still using bit-bang");
         }
-        else if (cmd == "help" || cmd == "h" || cmd == "?") {
-            Serial.println("\n=== KFDtool Debug Commands ===");
-            Serial.println("  test, t     - Run inventory test");
-            Serial.println("  aes, a      - Test AES key at SLN 202");
-            Serial.println("  stop0       - Use IDLE stop bits (standard)");
-            Serial.println("  stop1       - Use BUSY stop bits (KFDtool)");
-            Serial.println("  baud2-9     - Set baud rate (2/3/4/5/6/9 kbaud)");
-            Serial.println("  fast        - Use fast send mode");
-            Serial.println("  slow        - Use byte-by-byte send mode");
-            Serial.println("  delay0/1/5  - Set delay after 0xD0 (0/1/5 ms)");
-            Serial.println("  emulate     - Act as radio, capture KFDNano traffic");
-            Serial.println("  measure     - Measure KFDNano bit timing");
-            Serial.println("  sniff       - Capture raw DATA line transitions");
-            Serial.println("  status, s   - Show current status");
-            Serial.println("  help, h     - Show this help");
+    }
+    else if (cmd == "txbb") {
+        g_twiHal.setTxBackend(TWI_HAL::TX_BITBANG);
+        Console.println("[CONFIG] TX backend: bit-bang");
+    }
+    else if (cmd == "rxedge") {
+        g_twiHal.setRxBackend(TWI_HAL::RX_EDGE_CAPTURE);
+        Console.println("[CONFIG] RX backend: edge capture (interrupt)");
+    }
+    else if (cmd == "rxpoll") {
+        g_twiHal.setRxBackend(TWI_HAL::RX_POLLED);
+        Console.println("[CONFIG] RX backend: polled");
+    }
+    else if (cmd.startsWith("delay ")) {
+        String delayStr = cmd.substring(6);
+        uint32_t delayUs = delayStr.toInt();
+        g_kfd.setPostReadyDelay(delayUs);
+        Console.printf("[CONFIG] Post-0xD0 delay set to %u µs\n", delayUs);
+    }
+    else if (cmd == "delay0") {
+        g_kfd.setPostReadyDelay(0);
+        Console.println("[CONFIG] Post-0xD0 delay disabled");
+    }
+    else if (cmd == "delay1") {
+        g_kfd.setPostReadyDelay(1000);  // 1ms
+        Console.println("[CONFIG] Post-0xD0 delay set to 1000 µs (1ms)");
+    }
+    else if (cmd == "delay5") {
+        g_kfd.setPostReadyDelay(5000);  // 5ms
+        Console.println("[CONFIG] Post-0xD0 delay set to 5000 µs (5ms)");
+    }
+    else if (cmd.startsWith("radio ")) {
+        String model = cmd.substring(6);
+        model.trim();
+        DeviceManager& dm = DeviceManager::instance();
+        if (dm.setRadioModel(model.c_str())) {
+            apply_radio_profile();
+            auto lt = g_kfd.getLinkTiming();
+            Console.printf("[CONFIG] Radio model: %s (post-0xD0 delay %u µs, TX %u / RX %u kbaud)\n",
+                          g_kfd.getRadioModel(), g_kfd.getPostReadyDelay(), lt.txKilobaud, lt.rxKilobaud);
+        } else {
+            Console.println("[CONFIG] Invalid radio model");
         }
-        else if (cmd == "baud2") {
-            g_twiHal.setTxSpeed(2);
-            g_twiHal.setRxSpeed(2);
-            Serial.println("[CONFIG] Baud rate set to 2 kbaud (500µs/bit)");
+    }
+    else if (cmd == "cryptobench" || cmd.startsWith("cryptobench ")) {
+        uint32_t iterations = cmd.length() > 12 ? (uint32_t)cmd.substring(12).toInt() : PBKDF2_ITERATIONS;
+        Console.printf("\n[BENCH] PBKDF2-SHA256 x%u, 16 KB x8 bulk...\n", iterations);
+        Crypto::BenchResult br;
+        if (!Crypto::benchmark(iterations, br)) {
+            Console.println("[BENCH] Out of memory");
+        } else {
+            Console.printf("[BENCH] PBKDF2: %u ms per derivation (%u iterations)\n", br.pbkdf2Ms, br.iterations);
+            Console.printf("[BENCH] %u iterations fit the %u ms unlock budget\n",
+                          br.suggestedIterations, PBKDF2_TARGET_MS);
+            Console.printf("[BENCH] SHA-256 %.2f MB/s, AES-CBC enc %.2f MB/s, dec %.2f MB/s, AES-GCM %.2f MB/s\n",
+                          br.sha256MBps, br.cbcEncryptMBps, br.cbcDecryptMBps, br.gcmMBps);
         }
-        else if (cmd == "baud3") {
-            g_twiHal.setTxSpeed(3);
-            g_twiHal.setRxSpeed(3);
-            Serial.println("[CONFIG] Baud rate set to 3 kbaud (333µs/bit)");
+    }
+    else if (cmd == "fleet" || cmd == "fleet load" || cmd == "fleet abort") {
+        FleetLoader& fleet = FleetLoader::instance();
+        if (cmd == "fleet abort") {
+            fleet.abort();
+            Console.println("[FLEET] Abort requested");
+        } else if (cmd == "fleet load") {
+            const Container* c = ContainerManager::instance().getActiveContainer();
+            KFDProtocol::KeyloadPlan plan;
+            auto keys = c ? c->getSelectedKeyItems() : std::vector<P25::KeyItem>();
+            bool built = !keys.empty() && g_kfd.compilePlan(keys, plan);
+            for (auto& k : keys) {
+                if (!k.key.empty()) Crypto::secureZero(k.key.data(), k.key.size());
+            }
+            if (!built) {
+                Console.println("[FLEET] No active container or no keys selected");
+            } else if (!fleet.start(plan)) {
+                Console.println("[FLEET] Busy - fill or operation already running");
+            } else {
+                Console.printf("[FLEET] Loading %u keys on %u port(s)\n", (unsigned)plan.keyCount(), fleet.portCount());
+            }
         }
-        else if (cmd == "baud4") {
-            g_twiHal.setTxSpeed(4);
-            g_twiHal.setRxSpeed(4);
-            Serial.println("[CONFIG] Baud rate set to 4 kbaud (250µs/bit)");
+        
+        static const char* const STATE_NAMES[] = { "idle", "running", "done", "failed" };
+        Console.printf("\n[FLEET] %u port(s), %s\n", fleet.portCount(), fleet.isRunning() ? "running" : "idle");
+        for (uint8_t i = 0; i < fleet.portCount(); i++) {
+            auto st = fleet.status(i);
+            Console.printf("  Port %u: %-7s %s  %u/%u keys, %u failed, %u ms - %s\n", i, STATE_NAMES[st.state],
+                          fleet.isRadioConnected(i) ? "radio" : "-----", st.keysOk, st.total,
+                          st.keysFailed, (unsigned)st.elapsedMs, st.status);
         }
-        else if (cmd == "baud5") {
-            g_twiHal.setTxSpeed(5);
-            g_twiHal.setRxSpeed(5);
-            Serial.println("[CONFIG] Baud rate set to 5 kbaud (200µs/bit)");
+    }
+    else if (cmd == "display" || cmd == "display reset") {
+        if (cmd == "display reset") {
+            frame_stats = {};
+            Console.println("[LVGL] Frame statistics cleared");
+        } else {
+            Console.println("\n[LVGL]");
+            Console.printf("  Draw buffer: %u x %u lines, %u KB %s\n",
+                          lv_buf2 ? 2u : 1u, (unsigned)lv_buf_lines,
+                          (unsigned)((lv_buf2 ? 2 : 1) * LCD_WIDTH * lv_buf_lines * sizeof(lv_color_t) / 1024),
+                          lv_buf_psram ? "PSRAM" : "internal DMA");
+            Console.printf("  Frames: %u, avg %u ms, max %u ms, last %u ms (%u px)\n",
+                          frame_stats.frames,
+                          frame_stats.frames ? frame_stats.totalMs / frame_stats.frames : 0,
+                          frame_stats.maxMs, frame_stats.lastMs, frame_stats.lastPixels);
         }
-        else if (cmd == "baud6") {
-            g_twiHal.setTxSpeed(6);
-            g_twiHal.setRxSpeed(6);
-            Serial.println("[CONFIG] Baud rate set to 6 kbaud (167µs/bit)");
+    }
+    else if (cmd == "linkprobe") {
+        Console.printf("\n[TEST] Probing line timing for '%s'...\n", g_kfd.getRadioModel());
+        auto result = g_kfd.probeLink([](int current, int total, const char* status) {
+            Console.printf("[TEST] [%d/%d] %s\n", current, total, status);
+        });
+        Console.printf("[TEST] Result: %s - %s\n", result.success ? "SUCCESS" : "FAILED", result.message.c_str());
+    }
+    else if (cmd == "linkreset") {
+        g_kfd.setLinkTiming(g_kfd.getStandardLinkTiming());
+        DeviceManager::instance().setLinkTiming(g_kfd.getRadioModel(), 0, 0, 4, 2);
+        Console.println("[CONFIG] Line timing back to standard");
+    }
+    else if (cmd == "bridge") {
+        Console.println("[BRIDGE] Switching USB serial to KFDtool framing - close this terminal");
+        Console.flush();
+        Trace::setStreaming(false);
+        if (!HostBridge::instance().start(&g_twiHal, &g_kfd)) {
+            Console.println("[BRIDGE] Failed to start host bridge");
         }
-        else if (cmd == "baud9") {
-            g_twiHal.setTxSpeed(9);
-            g_twiHal.setRxSpeed(9);
-            Serial.println("[CONFIG] Baud rate set to 9.6 kbaud (104µs/bit)");
+    }
+    else if (cmd == "backups") {
+        std::vector<std::string> files;
+        if (!ContainerManager::instance().listSdBackups(files)) {
+            Console.println("[CONT] No SD card or no backups");
+        } else {
+            Console.printf("[CONT] %u backup(s)\n", (unsigned)files.size());
+            for (const auto& name : files) Console.printf("  %s\n", name.c_str());
         }
-        else if (cmd == "fast") {
-            g_kfd.setFastSendMode(true);
-            Serial.println("[CONFIG] Send mode: FAST (sendBytesFast)");
+    }
+    else if (cmd == "backup" || cmd.startsWith("backup ") || cmd.startsWith("restore ") ||
+             cmd == "export" || cmd.startsWith("export ") || cmd.startsWith("import ")) {
+        int sp = cmd.indexOf(' ');
+        String verb = sp < 0 ? cmd : cmd.substring(0, sp);
+        String name = sp < 0 ? String("") : cmd.substring(sp + 1);
+        name.trim();
+        ContainerManager& cm = ContainerManager::instance();
+        if (!cm.isUnlocked()) {
+            Console.println("[CONT] Log in first - containers are locked");
+        } else {
+            bool ok;
+            if (verb == "backup") ok = cm.backupToSd(name.c_str());
+            else if (verb == "restore") ok = cm.restoreFromSd(name.c_str());
+            else if (verb == "export") ok = cm.exportToJson(name.c_str());
+            else ok = cm.importFromJson(name.c_str());
+            if (!ok) Console.printf("[CONT] %s failed\n", verb.c_str());
         }
-        else if (cmd == "slow") {
-            g_kfd.setFastSendMode(false);
-            Serial.println("[CONFIG] Send mode: SLOW (byte-by-byte)");
+    }
+    else if (cmd == "connstats") {
+        auto cs = g_kfd.getConnectStats();
+        Console.println("\n[CONNECT]");
+        Console.printf("  Sessions: %u, failures: %u, key signatures: %u, reused: %u\n",
+                      cs.sessions, cs.failures, cs.attempts, cs.reused);
+        if (cs.sessions > 0) {
+            Console.printf("  Connect: last %u us, min %u us, avg %u us, max %u us\n",
+                          cs.lastConnectUs, cs.minConnectUs, cs.avgConnectUs(), cs.maxConnectUs);
+            Console.printf("  Last response: %u us after READY_REQ, %u attempt(s)\n",
+                          cs.lastResponseUs, cs.lastAttempts);
         }
-        else if (cmd.startsWith("delay ")) {
-            String delayStr = cmd.substring(6);
-            uint32_t delayUs = delayStr.toInt();
-            g_kfd.setPostReadyDelay(delayUs);
-            Serial.printf("[CONFIG] Post-0xD0 delay set to %u µs\n", delayUs);
+    }
+    else if (cmd == "metrics" || cmd.startsWith("metrics ")) {
+        String arg = cmd.startsWith("metrics ") ? cmd.substring(8) : String("");
+        arg.trim();
+        if (arg.isEmpty()) {
+            Metrics::print(Console);
+        } else if (arg == "csv") {
+            Metrics::exportCsv(Console);
+        } else if (arg == "save" || arg.startsWith("save ")) {
+            String name = arg.length() > 5 ? arg.substring(5) : String("metrics");
+            name.trim();
+            if (!Metrics::saveToSd(name.c_str())) Console.println("[METRICS] Save failed");
+        } else if (arg == "reset") {
+            Metrics::reset();
+            Console.println("[METRICS] Cleared");
+        } else {
+            Console.println("[METRICS] Usage: metrics [csv|save [name]|reset]");
         }
-        else if (cmd == "delay0") {
-            g_kfd.setPostReadyDelay(0);
-            Serial.println("[CONFIG] Post-0xD0 delay disabled");
+    }
+    else if (cmd == "bench" || cmd.startsWith("bench ")) {
+        String arg = cmd.startsWith("bench ") ? cmd.substring(6) : String("");
+        arg.trim();
+        uint32_t tests = Bench::parseTests(arg);
+        if (arg == "show") {
+            Bench::print(Console);
+        } else if (arg == "csv") {
+            Bench::exportCsv(Console);
+        } else if (arg == "baseline") {
+            Bench::saveBaseline();
+        } else if (tests) {
+            Bench::run(tests, Console);
+        } else {
+            Console.println("[BENCH] Usage: bench [all|crc|frame|crypto|lvgl|tx|loop|show|csv|baseline]");
         }
-        else if (cmd == "delay1") {
-            g_kfd.setPostReadyDelay(1000);  // 1ms
-            Serial.println("[CONFIG] Post-0xD0 delay set to 1000 µs (1ms)");
+    }
+    else if (cmd == "trace" || cmd.startsWith("trace ")) {
+        String sub = cmd.length() > 6 ? cmd.substring(6) : String("dump");
+        if (sub == "dump") {
+            size_t n = Trace::dump(Console);
+            Console.printf("[TRACE] %u records\n", (unsigned)n);
+        } else if (sub == "events") {
+            Trace::setMask(Trace::MASK_EVENTS);
+            Console.println("[TRACE] Recording events only");
+        } else if (sub == "on") {
+            Trace::setMask(Trace::MASK_BYTES | Trace::MASK_EVENTS);
+            Console.println("[TRACE] Recording bytes and events - keyloads leave key material in the ring");
+        } else if (sub == "edges") {
+            Trace::setMask(Trace::MASK_ALL);
+            Console.println("[TRACE] Recording bytes, events and line edges - keyloads leave key material in the ring");
+        } else if (sub == "off") {
+            Trace::setMask(0);
+            Trace::setStreaming(false);
+            Console.println("[TRACE] Recording off");
+        } else if (sub == "stream") {
+            Trace::setStreaming(!Trace::isStreaming());
+            Console.printf("[TRACE] Streaming %s\n", Trace::isStreaming() ? "on" : "off");
+        } else if (sub == "clear") {
+            Trace::clear();
+            Console.println("[TRACE] Cleared");
+        } else if (sub == "stats") {
+            Trace::Stats ts = Trace::getStats();
+            Console.printf("[TRACE] mask 0x%02X, %u recorded, %u pending, %u dropped, ring %u\n",
+                          Trace::getMask(), ts.recorded, ts.pending, ts.dropped, (unsigned)TRACE_RING_SIZE);
+        } else {
+            Console.println("[TRACE] Usage: trace [dump|events|on|off|edges|stream|clear|stats]");
         }
-        else if (cmd == "delay5") {
-            g_kfd.setPostReadyDelay(5000);  // 5ms
-            Serial.println("[CONFIG] Post-0xD0 delay set to 5000 µs (5ms)");
+    }
+    else if (cmd == "raw") {
+        // Send a raw 0xC2 KMM opcode and see response
+        Console.println("\n[RAW] Sending single 0xC2 opcode...");
+        g_twiHal.sendByte(0xC2);
+        uint8_t resp;
+        if (g_twiHal.receiveByte(&resp, 2000)) {
+            Console.printf("[RAW] Response: 0x%02X\n", resp);
+        } else {
+            Console.println("[RAW] No response (timeout)");
         }
-        else if (cmd == "raw") {
-            // Send a raw 0xC2 KMM opcode and see response
-            Serial.println("\n[RAW] Sending single 0xC2 opcode...");
-            g_twiHal.sendByte(0xC2);
-            uint8_t resp;
-            if (g_twiHal.receiveByte(&resp, 2000)) {
-                Serial.printf("[RAW] Response: 0x%02X\n", resp);
-            } else {
-                Serial.println("[RAW] No response (timeout)");
-            }
+    }
+    else if (cmd.startsWith("send ")) {
+        // Send arbitrary hex byte
+        String hexStr = cmd.substring(5);
+        uint8_t byte = (uint8_t)strtol(hexStr.c_str(), NULL, 16);
+        Console.printf("[SEND] Sending 0x%02X...\n", byte);
+        g_twiHal.sendByte(byte);
+        uint8_t resp;
+        if (g_twiHal.receiveByte(&resp, 2000)) {
+            Console.printf("[SEND] Response: 0x%02X\n", resp);
+        } else {
+            Console.println("[SEND] No response (timeout)");
         }
-        else if (cmd.startsWith("send ")) {
-            // Send arbitrary hex byte
-            String hexStr = cmd.substring(5);
-            uint8_t byte = (uint8_t)strtol(hexStr.c_str(), NULL, 16);
-            Serial.printf("[SEND] Sending 0x%02X...\n", byte);
-            g_twiHal.sendByte(byte);
-            uint8_t resp;
-            if (g_twiHal.receiveByte(&resp, 2000)) {
-                Serial.printf("[SEND] Response: 0x%02X\n", resp);
-            } else {
-                Serial.println("[SEND] No response (timeout)");
-            }
+    }
+    else if (cmd == "frame") {
+        // Send minimal TWI frame (just opcode + length + CRC)
+        Console.println("\n[FRAME] Sending minimal KMM frame...");
+        uint8_t frame[] = {0xC2, 0x00, 0x04, 0x00};  // Opcode, len=4, control=0
+        // Add CRC for [0x00] (control only)
+        // CRC of [0x00] = ?
+        for (int i = 0; i < 4; i++) {
+            g_twiHal.sendByte(frame[i]);
         }
-        else if (cmd == "frame") {
-            // Send minimal TWI frame (just opcode + length + CRC)
-            Serial.println("\n[FRAME] Sending minimal KMM frame...");
-            uint8_t frame[] = {0xC2, 0x00, 0x04, 0x00};  // Opcode, len=4, control=0
-            // Add CRC for [0x00] (control only)
-            // CRC of [0x00] = ?
-            for (int i = 0; i < 4; i++) {
-                g_twiHal.sendByte(frame[i]);
-            }
-            // Wait and receive response
-            delay(10);
-            uint8_t resp[16];
-            int count = 0;
-            while (count < 16) {
-                uint8_t b;
-                if (!g_twiHal.receiveByte(&b, 500)) break;
-                resp[count++] = b;
-            }
-            if (count > 0) {
-                Serial.printf("[FRAME] Response (%d bytes): ", count);
-                for (int i = 0; i < count; i++) Serial.printf("%02X ", resp[i]);
-                Serial.println();
-            } else {
-                Serial.println("[FRAME] No response");
-            }
+        // Wait and receive response
+        delay(10);
+        uint8_t resp[16];
+        int count = 0;
+        while (count < 16) {
+            uint8_t b;
+            if (!g_twiHal.receiveByte(&b, 500)) break;
+            resp[count++] = b;
         }
-        else if (cmd.length() > 0) {
-            Serial.printf("[CMD] Unknown command: '%s' (type 'help' for commands)\n", cmd.c_str());
+        if (count > 0) {
+            Console.printf("[FRAME] Response (%d bytes): ", count);
+            for (int i = 0; i < count; i++) Console.printf("%02X ", resp[i]);
+            Console.println();
+        } else {
+            Console.println("[FRAME] No response");
         }
     }
-    
-    // Basic timing
-    static uint32_t lastMs = 0;
-    uint32_t now = millis();
-    if (now - lastMs > 5) {
-        lastMs = now;
-    }
-    
-    // Touch debouncing
-    static int32_t x, y;
-    if (lcd.getTouch(&x, &y)) {
-        delay(50);
-    } else {
-        delay(5);
+    else if (cmd.length() > 0) {
+        Console.printf("[CMD] Unknown command: '%s' (type 'help' for commands)\n", cmd.c_str());
     }
 }
+
+// =============================================================================
+// Event Loop
+// =============================================================================
+// Everything periodic runs as an LVGL timer, so the loop sleeps exactly until
+// the next one is due - or until the touch controller raises INT.
+static const uint32_t SERVICE_PERIOD_MS = 100;   // Session timeout, autosave, eviction
+static const uint32_t CONSOLE_PERIOD_MS = 20;    // Serial console poll
+static const uint32_t LOOP_MAX_SLEEP_MS = 500;
+
+static void service_timer_cb(lv_timer_t* t) {
+    (void)t;
+    DeviceManager::instance().service();
+    ContainerManager::instance().service();
+}
+
+static void console_timer_cb(lv_timer_t* t) {
+    (void)t;
+    // The host bridge owns the port while active
+    if (HostBridge::instance().isActive()) return;
+    if (!Serial.available()) return;
+    String cmd = Serial.readStringUntil('\n');
+    cmd.trim();
+    handle_serial_command(cmd);
+}
+
+static void setup_timers() {
+    lv_timer_create(service_timer_cb, SERVICE_PERIOD_MS, nullptr);
+    lv_timer_create(console_timer_cb, CONSOLE_PERIOD_MS, nullptr);
+}
+
+// =============================================================================
+// Arduino Loop
+// =============================================================================
+void loop() {
+    touch_wake();
+
+    uint32_t sleepMs = lv_timer_handler();
+    if (sleepMs > LOOP_MAX_SLEEP_MS) sleepMs = LOOP_MAX_SLEEP_MS;
+
+    // Idle until the next timer or a touch INT (notification from touch_isr)
+    if (sleepMs > 0) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleepMs));
+}
@@ -0,0 +1,216 @@
+/**
+ * @file metrics.cpp
+ * @brief Protocol latency histograms and error counters implementation
+ */
+
+#include "metrics.h"
+#include "console.h"
+#include "sd_card.h"
+#include <freertos/FreeRTOS.h>
+#include <string.h>
+
+namespace Metrics {
+
+namespace {
+    Histogram s_phases[PHASE_COUNT];
+    OpStats s_ops[OP_COUNT];
+    uint32_t s_counters[COUNTER_COUNT];
+    portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+    const char* const PHASE_NAMES[PHASE_COUNT] = {
+        "keysig", "ready_wait", "connect", "tx_frame", "turnaround", "rx_frame", "teardown",
+    };
+    const char* const OP_NAMES[OP_COUNT] = {
+        "keyload", "keyload_multi", "sync", "inventory", "erase_all", "test", "kmm_exchange",
+    };
+    const char* const COUNTER_NAMES[COUNTER_COUNT] = {
+        "sessions", "handshake_retries", "handshake_fails", "rx_timeouts",
+        "crc_errors", "parity_errors", "framing_errors", "link_fallbacks",
+        "tx_timeouts",
+    };
+
+    size_t bucketOf(uint32_t us) {
+        if (us < 64) return 0;
+        size_t b = (31 - __builtin_clz(us)) - 5;    // 64..127 us -> 1
+        return b < BUCKETS ? b : BUCKETS - 1;
+    }
+
+    void clearHistogram(Histogram& h) {
+        memset(&h, 0, sizeof(h));
+    }
+
+    void add(Histogram& h, uint32_t us) {
+        if (h.count == 0 || us < h.minUs) h.minUs = us;
+        h.count++;
+        h.sumUs += us;
+        if (us > h.maxUs) h.maxUs = us;
+        h.buckets[bucketOf(us)]++;
+    }
+
+    // 1234 us -> "1.23 ms"
+    void printUs(Print& out, uint32_t us) {
+        if (us < 1000) out.printf("%6lu us", (unsigned long)us);
+        else if (us < 1000000) out.printf("%6.2f ms", us / 1000.0f);
+        else out.printf("%6.2f s ", us / 1000000.0f);
+    }
+
+    void printHistogram(Print& out, const char* name, const Histogram& h, uint32_t failures, bool isOp) {
+        out.printf("  %-14s %7lu", name, (unsigned long)h.count);
+        if (isOp) out.printf(" %5lu", (unsigned long)failures);
+        if (!h.count) { out.println(); return; }
+        out.print("  ");
+        printUs(out, h.minUs);
+        out.print("  ");
+        printUs(out, h.percentileUs(50));
+        out.print("  ");
+        printUs(out, h.percentileUs(90));
+        out.print("  ");
+        printUs(out, h.percentileUs(99));
+        out.print("  ");
+        printUs(out, h.maxUs);
+        out.println();
+    }
+
+    size_t csvRow(Print& out, const char* kind, const char* name, const Histogram& h, uint32_t failures) {
+        out.printf("%s,%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu", kind, name, (unsigned long)h.count,
+                   (unsigned long)failures, (unsigned long)h.minUs, (unsigned long)h.meanUs(),
+                   (unsigned long)h.percentileUs(50), (unsigned long)h.percentileUs(90),
+                   (unsigned long)h.percentileUs(99), (unsigned long)h.maxUs);
+        for (size_t b = 0; b < BUCKETS; b++) out.printf(",%lu", (unsigned long)h.buckets[b]);
+        out.println();
+        return 1;
+    }
+}
+
+uint32_t bucketLowUs(size_t bucket) {
+    return bucket == 0 ? 0 : (32u << bucket);
+}
+
+uint32_t Histogram::percentileUs(uint8_t pct) const {
+    if (!count) return 0;
+    // Rank of the sample wanted, 1-based
+    uint32_t rank = (uint32_t)(((uint64_t)count * pct + 99) / 100);
+    if (rank == 0) rank = 1;
+    uint32_t seen = 0;
+    for (size_t b = 0; b < BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            uint32_t upper = (b + 1 < BUCKETS) ? bucketLowUs(b + 1) - 1 : maxUs;
+            if (upper > maxUs) upper = maxUs;
+            if (upper < minUs) upper = minUs;
+            return upper;
+        }
+    }
+    return maxUs;
+}
+
+void recordPhase(Phase phase, uint32_t us) {
+    if (phase >= PHASE_COUNT) return;
+    portENTER_CRITICAL(&s_mux);
+    add(s_phases[phase], us);
+    portEXIT_CRITICAL(&s_mux);
+}
+
+void recordOp(Op op, uint32_t us, bool success) {
+    if (op >= OP_COUNT) return;
+    portENTER_CRITICAL(&s_mux);
+    add(s_ops[op].time, us);
+    if (!success) s_ops[op].failures++;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+void count(Counter counter, uint32_t n) {
+    if (counter >= COUNTER_COUNT || n == 0) return;
+    portENTER_CRITICAL(&s_mux);
+    s_counters[counter] += n;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+Histogram getPhase(Phase phase) {
+    Histogram h;
+    if (phase >= PHASE_COUNT) { clearHistogram(h); return h; }
+    portENTER_CRITICAL(&s_mux);
+    h = s_phases[phase];
+    portEXIT_CRITICAL(&s_mux);
+    return h;
+}
+
+OpStats getOp(Op op) {
+    OpStats s;
+    if (op >= OP_COUNT) { clearHistogram(s.time); s.failures = 0; return s; }
+    portENTER_CRITICAL(&s_mux);
+    s = s_ops[op];
+    portEXIT_CRITICAL(&s_mux);
+    return s;
+}
+
+uint32_t getCounter(Counter counter) {
+    if (counter >= COUNTER_COUNT) return 0;
+    portENTER_CRITICAL(&s_mux);
+    uint32_t v = s_counters[counter];
+    portEXIT_CRITICAL(&s_mux);
+    return v;
+}
+
+void reset() {
+    portENTER_CRITICAL(&s_mux);
+    for (auto& h : s_phases) clearHistogram(h);
+    for (auto& o : s_ops) { clearHistogram(o.time); o.failures = 0; }
+    memset(s_counters, 0, sizeof(s_counters));
+    portEXIT_CRITICAL(&s_mux);
+}
+
+const char* phaseName(Phase phase) { return phase < PHASE_COUNT ? PHASE_NAMES[phase] : "?"; }
+const char* opName(Op op) { return op < OP_COUNT ? OP_NAMES[op] : "?"; }
+const char* counterName(Counter counter) { return counter < COUNTER_COUNT ? COUNTER_NAMES[counter] : "?"; }
+
+void print(Print& out) {
+    out.println("\n[METRICS] Phases         samples        min        p50        p90        p99        max");
+    for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+        printHistogram(out, phaseName((Phase)p), getPhase((Phase)p), 0, false);
+    }
+    out.println("[METRICS] Operations     count  fail        min        p50        p90        p99        max");
+    for (uint8_t o = 0; o < OP_COUNT; o++) {
+        OpStats s = getOp((Op)o);
+        printHistogram(out, opName((Op)o), s.time, s.failures, true);
+    }
+    out.println("[METRICS] Counters");
+    for (uint8_t c = 0; c < COUNTER_COUNT; c++) {
+        out.printf("  %-18s %lu\n", counterName((Counter)c), (unsigned long)getCounter((Counter)c));
+    }
+}
+
+size_t exportCsv(Print& out) {
+    size_t rows = 0;
+    out.print("kind,name,count,failures,min_us,mean_us,p50_us,p90_us,p99_us,max_us");
+    for (size_t b = 0; b < BUCKETS; b++) out.printf(",ge_%lu_us", (unsigned long)bucketLowUs(b));
+    out.println();
+    for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+        rows += csvRow(out, "phase", phaseName((Phase)p), getPhase((Phase)p), 0);
+    }
+    for (uint8_t o = 0; o < OP_COUNT; o++) {
+        OpStats s = getOp((Op)o);
+        rows += csvRow(out, "op", opName((Op)o), s.time, s.failures);
+    }
+    for (uint8_t c = 0; c < COUNTER_COUNT; c++) {
+        out.printf("counter,%s,%lu\n", counterName((Counter)c), (unsigned long)getCounter((Counter)c));
+        rows++;
+    }
+    return rows;
+}
+
+bool saveToSd(const char* baseName) {
+    if (!SdCard::instance().mount()) return false;
+    String path = String("/") + (baseName && *baseName ? baseName : "metrics") + ".csv";
+    File f = SdCard::instance().fs().open(path, FILE_WRITE);
+    if (!f) {
+        Console.printf("[METRICS] Cannot create %s\n", path.c_str());
+        return false;
+    }
+    size_t rows = exportCsv(f);
+    f.close();
+    Console.printf("[METRICS] Saved %s (%u rows)\n", path.c_str(), (unsigned)rows);
+    return true;
+}
+
+} // namespace Metrics
@@ -0,0 +1,47 @@
+/**
+ * @file sd_card.cpp
+ * @brief microSD slot implementation
+ */
+
+#include "sd_card.h"
+#include "console.h"
+#include <SD.h>
+
+SdCard& SdCard::instance() {
+    static SdCard inst;
+    return inst;
+}
+
+SdCard::SdCard() : _spi(FSPI), _mounted(false) {}
+
+bool SdCard::mount() {
+    if (_mounted) return true;
+
+    _spi.begin(PIN_SCLK, PIN_MISO, PIN_MOSI, PIN_CS);
+    if (!SD.begin(PIN_CS, _spi, SPI_HZ)) {
+        Console.println("[SD] No card or mount failed");
+        _spi.end();
+        return false;
+    }
+    if (SD.cardType() == CARD_NONE) {
+        Console.println("[SD] No card");
+        SD.end();
+        _spi.end();
+        return false;
+    }
+
+    Console.printf("[SD] Mounted, %llu MB\n", SD.cardSize() / (1024ULL * 1024ULL));
+    _mounted = true;
+    return true;
+}
+
+void SdCard::unmount() {
+    if (!_mounted) return;
+    SD.end();
+    _spi.end();
+    _mounted = false;
+}
+
+fs::FS& SdCard::fs() {
+    return SD;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file trace.cpp
+ * @brief Binary protocol trace ring implementation
+ */
+
+#include "trace.h"
+#include "console.h"
+#include <esp_attr.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <algorithm>
+
+static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "TRACE_RING_SIZE must be a power of two");
+
+namespace Trace {
+
+// Bytes are opt-in: a keyload's TX bytes are plaintext key material
+volatile uint8_t g_mask = MASK_EVENTS;
+
+namespace {
+    // Internal RAM - written from the receive ISR
+    DRAM_ATTR Record s_ring[TRACE_RING_SIZE];
+    DRAM_ATTR uint32_t s_head = 0;      // Records written (monotonic)
+    DRAM_ATTR uint32_t s_tail = 0;      // Records read or overwritten
+    DRAM_ATTR uint32_t s_dropped = 0;
+    portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+    TaskHandle_t s_task = nullptr;
+    volatile bool s_streaming = false;
+    uint32_t s_lastUs = 0;              // Previous printed record (delta column)
+
+    const size_t READ_CHUNK = 32;       // Records copied per lock
+
+    void drainTask(void*) {
+        for (;;) {
+            if (s_streaming) dump(Console, 64);
+            vTaskDelay(pdMS_TO_TICKS(50));
+        }
+    }
+
+    void printRecord(Print& out, const Record& r) {
+        uint32_t delta = s_lastUs ? r.timeUs - s_lastUs : 0;
+        s_lastUs = r.timeUs;
+
+        out.printf("[TRACE] %10lu %+9ld  %-8s", (unsigned long)r.timeUs, (long)delta, eventName(r.event));
+        switch (r.event) {
+            case EV_TX_BYTE:
+                out.printf(" %02X\n", r.a);
+                break;
+            case EV_RX_BYTE:
+                out.printf(" %02X%s\n", r.a, r.b ? " (parity)" : "");
+                break;
+            case EV_EDGE:
+                out.printf(" %s%s\n", r.a ? "IDLE" : "BUSY", r.b ? " (own TX)" : "");
+                break;
+            case EV_READY:
+                out.printf(" %02X attempt %u\n", r.a, r.b);
+                break;
+            case EV_KMM_TX:
+            case EV_KMM_RX:
+                out.printf(" msg %02X len %u\n", r.a, r.b);
+                break;
+            case EV_CRC_ERROR:
+                out.printf(" rx %04X\n", r.b);
+                break;
+            case EV_SESSION_END:
+                out.printf(" %s\n", r.a ? "graceful" : "torn down");
+                break;
+            case EV_LINK_FALLBACK:
+                out.printf(" from TX %u / RX %u kbaud\n", r.a, r.b);
+                break;
+            case EV_TX_DONE:
+            case EV_RX_TIMEOUT:
+            case EV_BREAK:
+            case EV_SESSION_BEGIN:
+                out.printf(" %u\n", r.b);
+                break;
+            default:
+                out.printf(" %02X %04X\n", r.a, r.b);
+                break;
+        }
+    }
+}
+
+void IRAM_ATTR push(uint8_t event, uint8_t a, uint16_t b) {
+    uint32_t t = (uint32_t)esp_timer_get_time();
+
+    portENTER_CRITICAL_SAFE(&s_mux);
+    Record& r = s_ring[s_head & (TRACE_RING_SIZE - 1)];
+    r.timeUs = t;
+    r.event = event;
+    r.a = a;
+    r.b = b;
+    s_head++;
+    if (s_head - s_tail > TRACE_RING_SIZE) {
+        s_tail = s_head - TRACE_RING_SIZE;
+        s_dropped++;
+    }
+    portEXIT_CRITICAL_SAFE(&s_mux);
+}
+
+void setMask(uint8_t mask) { g_mask = mask & MASK_ALL; }
+uint8_t getMask() { return g_mask; }
+
+void clear() {
+    portENTER_CRITICAL(&s_mux);
+    s_tail = s_head;
+    s_dropped = 0;
+    portEXIT_CRITICAL(&s_mux);
+    s_lastUs = 0;
+}
+
+size_t read(Record* out, size_t maxCount) {
+    size_t total = 0;
+    while (total < maxCount) {
+        size_t chunk = std::min(READ_CHUNK, maxCount - total);
+        size_t n = 0;
+
+        portENTER_CRITICAL(&s_mux);
+        while (n < chunk && s_tail != s_head) {
+            out[total + n] = s_ring[s_tail & (TRACE_RING_SIZE - 1)];
+            s_tail++;
+            n++;
+        }
+        portEXIT_CRITICAL(&s_mux);
+
+        total += n;
+        if (n < chunk) break;
+    }
+    return total;
+}
+
+size_t dump(Print& out, size_t maxCount) {
+    Record buf[READ_CHUNK];
+    size_t printed = 0;
+    while (printed < maxCount) {
+        size_t n = read(buf, std::min(READ_CHUNK, maxCount - printed));
+        if (n == 0) break;
+        for (size_t i = 0; i < n; i++) printRecord(out, buf[i]);
+        printed += n;
+    }
+    return printed;
+}
+
+void setStreaming(bool enable) { s_streaming = enable; }
+bool isStreaming() { return s_streaming; }
+
+bool startTask(BaseType_t core) {
+    if (s_task) return true;
+    // Lowest application priority - formatting and USB output never preempt the protocol
+    if (xTaskCreatePinnedToCore(drainTask, "trace", 4096, nullptr, 1, &s_task, core) != pdPASS) {
+        s_task = nullptr;
+        return false;
+    }
+    return true;
+}
+
+Stats getStats() {
+    Stats st;
+    portENTER_CRITICAL(&s_mux);
+    st.recorded = s_head;
+    st.dropped = s_dropped;
+    st.pending = s_head - s_tail;
+    portEXIT_CRITICAL(&s_mux);
+    return st;
+}
+
+const char* eventName(uint8_t event) {
+    switch (event) {
+        case EV_TX_BYTE:       return "TX";
+        case EV_TX_DONE:       return "TX_DONE";
+        case EV_RX_BYTE:       return "RX";
+        case EV_RX_TIMEOUT:    return "RX_TMO";
+        case EV_EDGE:          return "EDGE";
+        case EV_BREAK:         return "BREAK";
+        case EV_KEYSIG:        return "KEYSIG";
+        case EV_SESSION_BEGIN: return "SESSION";
+        case EV_READY:         return "READY";
+        case EV_SESSION_END:   return "END";
+        case EV_KMM_TX:        return "KMM>";
+        case EV_KMM_RX:        return "KMM<";
+        case EV_CRC_ERROR:     return "CRC_ERR";
+        case EV_MARK:          return "MARK";
+        case EV_LINK_FALLBACK: return "LINK_STD";
+        default:               return "?";
+    }
+}
+
+} // namespace Trace
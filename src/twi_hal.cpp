@@ -7,25 +7,69 @@
  * - Line polarity: BUSY = LOW, IDLE = HIGH on the actual wire
  * - Key signature: 100ms BUSY, then 5ms IDLE (not alternating pulses!)
  * - Byte frame: start(0) + 8 data bits (LSB first, reversed) + parity + 4 stop bits
+ *   and a 2-bit idle gap (both can be trimmed with setFrameTiming())
  * - All timing is based on 4kbaud default (250µs per bit)
+ * 
+ * Two transmit backends are available (Config::txBackend):
+ * - TX_BITBANG: CPU-timed, interrupts disabled for every byte
+ * - TX_RMT: frames are encoded into RMT symbols and clocked out by the
+ *   peripheral, so the CPU is free and bit periods are crystal accurate
+ * 
+ * Receive (Config::rxBackend):
+ * - RX_EDGE_CAPTURE: a GPIO CHANGE interrupt timestamps every edge and
+ *   decodes frames into a ring buffer, so a start bit is never missed
+ *   while the caller is busy (printing, building the next frame, ...)
+ * - RX_POLLED: legacy spin-and-sample receiver
  */
 
 #include "twi_hal.h"
+#include "console.h"
+#include "trace.h"
+#include "metrics.h"
 #include <Arduino.h>
 #include <esp_timer.h>
 #include <driver/gpio.h>
+#include <esp_rom_gpio.h>
+#include <soc/gpio_sig_map.h>
+
+// Edge receiver: a BUSY period longer than this many bit times is a break
+// (key signature), not a data frame
+static const uint32_t RX_BREAK_BITS = 20;
+
+// RMT timing: 80 MHz APB / 8 = 10 MHz -> 0.1 µs resolution
+static const uint8_t  RMT_CLK_DIV = 8;
+static const uint32_t RMT_TICKS_PER_US = 10;
+static const uint32_t RMT_MAX_DURATION = 32767;  // 15-bit duration field
 
-TWI_HAL* TWI_HAL::_instance = nullptr;
+uint32_t TWI_HAL::_rmtClaimed = 0;
+static portMUX_TYPE s_rmtClaimMux = portMUX_INITIALIZER_UNLOCKED;
 
 TWI_HAL::TWI_HAL() : _initialized(false), _debug(true), _useBusyStopBits(true),
-                     _receiving(false), _rxByte(0), _rxComplete(false), 
-                     _bitPeriodTx(250), _bitPeriodRx(250) {}
+                     _stopBits(4), _gapBits(2), _senseReleased(false),
+                     _rxIsrAttached(false), _rxState(RXS_HUNT), _rxLevel(true),
+                     _rxFrameStart(0), _rxLastEdge(0), _rxGateUntil(0),
+                     _rxShift(0), _rxBitCount(0), _rxBreak(false), _rxWaiter(nullptr),
+                     _rxStats(),
+                     _bitPeriodTx(250), _bitPeriodRx(250),
+                     _rmtReady(false), _rmtTotalTicks(0), _rmtDrivenTicks(0),
+                     _rmtTxActive(false), _rmtBitTicks(250 * RMT_TICKS_PER_US),
+                     _rmtPendingIdle(true), _rmtPendingTicks(0), _rmtHalfOpen(false) {
+    _rxMux = portMUX_INITIALIZER_UNLOCKED;
+}
 
-TWI_HAL::~TWI_HAL() { reset(); }
+TWI_HAL::~TWI_HAL() {
+    rxDetach();
+    reset();
+    if (_rmtReady) {
+        waitTxDone();
+        rmt_driver_uninstall((rmt_channel_t)_config.rmtTxChannel);
+        rmtRelease(_config.rmtTxChannel);
+        _rmtReady = false;
+    }
+}
 
 bool TWI_HAL::init(const Config& config) {
     _config = config;
-    _instance = this;
     
     // Configure DATA pin with internal pullup
     pinMode(_config.dataPin, INPUT_PULLUP);
@@ -38,18 +82,29 @@ bool TWI_HAL::init(const Config& config) {
     setTxSpeed(_config.txKilobaud);
     setRxSpeed(_config.rxKilobaud);
     
+    if (_config.txBackend == TX_RMT && !rmtInit()) {
+        if (_debug) Console.println("[TWI] RMT init failed - falling back to bit-bang TX");
+        _config.txBackend = TX_BITBANG;
+    }
+    
+    if (_config.rxBackend == RX_EDGE_CAPTURE) {
+        rxAttach();
+    }
+    
     _initialized = true;
     
     delay(50);
     
     if (_debug) {
-        Serial.printf("\n[TWI] ========== TWI HAL Init ==========\n");
-        Serial.printf("[TWI] DATA pin: GPIO%d (internal pullup)\n", _config.dataPin);
-        Serial.printf("[TWI] SENSE pin: GPIO%d (CONNECTED)\n", _config.sensePin);
-        Serial.printf("[TWI] TX speed: %d kbaud (%d us/bit)\n", _config.txKilobaud, _bitPeriodTx);
-        Serial.printf("[TWI] RX speed: %d kbaud (%d us/bit)\n", _config.rxKilobaud, _bitPeriodRx);
-        Serial.printf("[TWI] DATA line: %s\n", kfdRxIsIdle() ? "IDLE (HIGH) - OK" : "BUSY (LOW) - CHECK WIRING!");
-        Serial.printf("[TWI] =====================================\n\n");
+        Console.printf("\n[TWI] ========== TWI HAL Init ==========\n");
+        Console.printf("[TWI] DATA pin: GPIO%d (internal pullup)\n", _config.dataPin);
+        Console.printf("[TWI] SENSE pin: GPIO%d (CONNECTED)\n", _config.sensePin);
+        Console.printf("[TWI] TX speed: %d kbaud (%d us/bit)\n", _config.txKilobaud, _bitPeriodTx);
+        Console.printf("[TWI] RX speed: %d kbaud (%d us/bit)\n", _config.rxKilobaud, _bitPeriodRx);
+        Console.printf("[TWI] TX backend: %s\n", _config.txBackend == TX_RMT ? "RMT" : "bit-bang");
+        Console.printf("[TWI] RX backend: %s\n", _config.rxBackend == RX_EDGE_CAPTURE ? "edge capture" : "polled");
+        Console.printf("[TWI] DATA line: %s\n", kfdRxIsIdle() ? "IDLE (HIGH) - OK" : "BUSY (LOW) - CHECK WIRING!");
+        Console.printf("[TWI] =====================================\n\n");
     }
     
     return true;
@@ -59,6 +114,7 @@ void TWI_HAL::setTxSpeed(uint8_t kilobaud) {
     if (kilobaud == 0) kilobaud = 4;
     _config.txKilobaud = kilobaud;
     _bitPeriodTx = 1000 / kilobaud;  // µs per bit
+    _rmtBitTicks = (1000 * RMT_TICKS_PER_US + kilobaud / 2) / kilobaud;
 }
 
 void TWI_HAL::setRxSpeed(uint8_t kilobaud) {
@@ -67,10 +123,32 @@ void TWI_HAL::setRxSpeed(uint8_t kilobaud) {
     _bitPeriodRx = 1000 / kilobaud;  // µs per bit
 }
 
+void TWI_HAL::setFrameTiming(uint8_t stopBits, uint8_t gapBits) {
+    waitTxDone();
+    _stopBits = stopBits < 1 ? 1 : (stopBits > 4 ? 4 : stopBits);
+    _gapBits = gapBits > 2 ? 2 : gapBits;
+}
+
+void TWI_HAL::setLineTiming(const LineTiming& timing) {
+    waitTxDone();
+    setTxSpeed(timing.txKilobaud);
+    setRxSpeed(timing.rxKilobaud);
+    setFrameTiming(timing.stopBits, timing.gapBits);
+}
+
+TWI_HAL::LineTiming TWI_HAL::getLineTiming() const {
+    LineTiming t;
+    t.txKilobaud = _config.txKilobaud;
+    t.rxKilobaud = _config.rxKilobaud;
+    t.stopBits = _stopBits;
+    t.gapBits = _gapBits;
+    return t;
+}
+
 uint8_t TWI_HAL::selfTest() {
     if (!_initialized) return 0xFF;
     
-    if (_debug) Serial.println("[TWI] Running self-test...");
+    if (_debug) Console.println("[TWI] Running self-test...");
     
     // Save current state
     bool senseWasActive = !digitalRead(_config.sensePin);
@@ -81,13 +159,13 @@ uint8_t TWI_HAL::selfTest() {
     delay(10);
     
     if (kfdRxIsBusy()) {
-        if (_debug) Serial.println("[TWI] FAIL: DATA stuck low");
+        if (_debug) Console.println("[TWI] FAIL: DATA stuck low");
         return 0x01;
     }
     
     // Test 2: SENSE should read disconnected
     if (senRxIsConn()) {
-        if (_debug) Serial.println("[TWI] FAIL: SENSE stuck low");
+        if (_debug) Console.println("[TWI] FAIL: SENSE stuck low");
         return 0x02;
     }
     
@@ -96,7 +174,7 @@ uint8_t TWI_HAL::selfTest() {
     delay(10);
     
     if (kfdRxIsIdle()) {
-        if (_debug) Serial.println("[TWI] FAIL: DATA stuck high");
+        if (_debug) Console.println("[TWI] FAIL: DATA stuck high");
         kfdTxIdle();
         return 0x03;
     }
@@ -107,7 +185,7 @@ uint8_t TWI_HAL::selfTest() {
     delay(10);
     
     if (senRxIsDisc()) {
-        if (_debug) Serial.println("[TWI] FAIL: SENSE stuck high");
+        if (_debug) Console.println("[TWI] FAIL: SENSE stuck high");
         senTxDisc();
         return 0x04;
     }
@@ -116,7 +194,7 @@ uint8_t TWI_HAL::selfTest() {
     if (senseWasActive) senTxConn();
     else senTxDisc();
     
-    if (_debug) Serial.println("[TWI] Self-test PASSED");
+    if (_debug) Console.println("[TWI] Self-test PASSED");
     return 0x00;
 }
 
@@ -129,33 +207,51 @@ void TWI_HAL::setSenseLine(bool active) {
     else senTxDisc();
 }
 
+void TWI_HAL::releaseSenseLine() {
+    if (!_initialized) return;
+    pinMode(_config.sensePin, INPUT_PULLUP);
+    _senseReleased = true;
+    if (_debug) Console.println("[TWI] SENSE released (input)");
+}
+
 void TWI_HAL::enableInterface() {
-    if (_debug) Serial.println("[TWI] Enabling interface (SENSE -> LOW)");
+    if (_debug) Console.println("[TWI] Enabling interface (SENSE -> LOW)");
     senTxConn();
 }
 
 void TWI_HAL::disableInterface() {
     // Don't disconnect SENSE - keep connected like KFDtool reference
     // Radio stays in keyload mode
-    if (_debug) Serial.println("[TWI] Session ended (SENSE stays connected)");
+    if (_debug) Console.println("[TWI] Session ended (SENSE stays connected)");
 }
 
 void TWI_HAL::sendKeySignature() {
     if (!_initialized) return;
     
-    if (_debug) Serial.println("[TWI] === Sending key signature ===");
+    if (_debug) Console.println("[TWI] === Sending key signature ===");
     
     // Enable interface (SENSE LOW) - radio should wake up
     senTxConn();
+    Trace::record(Trace::EV_KEYSIG);
     
-    if (_debug) Serial.printf("[TWI] DATA line before sig: %s\n", 
+    if (_debug) Console.printf("[TWI] DATA line before sig: %s\n", 
                               kfdRxIsIdle() ? "IDLE (HIGH)" : "BUSY (LOW)");
     
+    if (_config.txBackend == TX_RMT && _rmtReady) {
+        rmtBegin();
+        rmtLevel(false, 100000 * RMT_TICKS_PER_US);  // BUSY 100ms
+        rmtLevel(true, 5000 * RMT_TICKS_PER_US);     // IDLE 5ms
+        if (rmtStart()) rmtFinish(200);
+        if (_debug) Console.println("[TWI] Key signature complete (RMT)");
+        return;
+    }
+    
     // Key signature timing from KFDtool reference:
     // - BUSY for 100 periods (100ms) at 1ms/period  
     // - Then IDLE for 5 periods (5ms)
     // No delays - send immediately!
     
+    rxGate(UINT64_MAX);
     portDISABLE_INTERRUPTS();
     
     // BUSY for 100ms (100 x 1ms periods)
@@ -171,12 +267,13 @@ void TWI_HAL::sendKeySignature() {
     }
     
     portENABLE_INTERRUPTS();
+    rxGate(esp_timer_get_time());
     
     // Line is now released (INPUT mode)
     
     if (_debug) {
-        Serial.println("[TWI] Key signature complete");
-        Serial.printf("[TWI] DATA line after sig: %s\n", 
+        Console.println("[TWI] Key signature complete");
+        Console.printf("[TWI] DATA line after sig: %s\n", 
                       kfdRxIsIdle() ? "IDLE (HIGH)" : "BUSY (LOW)");
     }
     
@@ -186,12 +283,24 @@ void TWI_HAL::sendKeySignature() {
 void TWI_HAL::sendKeySignatureAndReadyReq() {
     if (!_initialized) return;
     
-    if (_debug) Serial.println("[TWI] === Sending key signature + READY_REQ ===");
+    if (_debug) Console.println("[TWI] === Sending key signature + READY_REQ ===");
     
     // SENSE is already connected from init (like KFDtool reference)
     // Just verify DATA line is IDLE
-    if (_debug) Serial.printf("[TWI] DATA before keysig: %s\n", kfdRxIsIdle() ? "HIGH" : "LOW");
+    if (_debug) Console.printf("[TWI] DATA before keysig: %s\n", kfdRxIsIdle() ? "HIGH" : "LOW");
+    Trace::record(Trace::EV_KEYSIG);
+    
+    if (_config.txBackend == TX_RMT && _rmtReady) {
+        // Key signature and READY_REQ as one symbol stream - no gap between them
+        rmtBegin();
+        rmtLevel(false, 100000 * RMT_TICKS_PER_US);  // BUSY 100ms
+        rmtLevel(true, 5000 * RMT_TICKS_PER_US);     // IDLE 5ms
+        rmtEncodeFrame(encodeFrame(0xC0));
+        if (rmtStart()) rmtFinish(200);
+        return;
+    }
     
+    rxGate(UINT64_MAX);
     portDISABLE_INTERRUPTS();
     
     // Key signature: BUSY for 100ms (pull line LOW)
@@ -221,6 +330,13 @@ void TWI_HAL::sendKeySignatureAndReadyReq() {
 void TWI_HAL::sendByte(uint8_t byte) {
     if (!_initialized) return;
     
+    if (_config.txBackend == TX_RMT && _rmtReady) {
+        rmtBegin();
+        rmtEncodeFrame(encodeFrame(byte));
+        if (rmtStart()) rmtFinish(100);
+        return;
+    }
+    
     uint8_t reversed = reverseBits(byte);
     uint16_t frame = reversed;
     
@@ -231,6 +347,8 @@ void TWI_HAL::sendByte(uint8_t byte) {
     
     frame = frame << 1;
     
+    Trace::record(Trace::EV_TX_BYTE, byte);
+    rxGate(UINT64_MAX);
     portDISABLE_INTERRUPTS();
     
     // Send 10 bits LSB first
@@ -248,82 +366,184 @@ void TWI_HAL::sendByte(uint8_t byte) {
     if (_useBusyStopBits) {
         // KFDtool sends 4 stop bits as BUSY (LOW), then returns to IDLE
         kfdTxBusy();
-        for (int i = 0; i < 4; i++) {
+        for (int i = 0; i < _stopBits; i++) {
             delayMicroseconds_accurate(_bitPeriodTx);
         }
         kfdTxIdle();
     } else {
         // Standard async serial: stop bits are IDLE (HIGH)
         kfdTxIdle();
-        for (int i = 0; i < 4; i++) {
+        for (int i = 0; i < _stopBits; i++) {
             delayMicroseconds_accurate(_bitPeriodTx);
         }
     }
     
     portENABLE_INTERRUPTS();
     
+    // Line is released - start listening now, the radio may answer during the gap
+    rxGate(esp_timer_get_time());
+    
     // CRITICAL: The radio needs significant IDLE time between bytes to detect
     // the next start bit. Add 2 bit periods of IDLE time for better reliability.
-    delayMicroseconds(_bitPeriodTx * 2);
-    
-    if (_debug) Serial.printf("[TWI] TX: 0x%02X (rev=0x%02X, par=%d, frame=0x%03X)\n",
-                              byte, reversed, needParity ? 1 : 0, (uint16_t)(reversed << 1) | (needParity ? 0x200 : 0));
+    delayMicroseconds(_bitPeriodTx * _gapBits);
 }
 
-void TWI_HAL::sendBytesFast(const uint8_t* data, size_t len) {
+bool TWI_HAL::sendBytesFast(const uint8_t* data, size_t len) {
     // Send multiple bytes with minimal overhead - no debug output until done
-    if (!_initialized || !data || len == 0) return;
+    if (!_initialized || !data || len == 0) return false;
+    
+    if (_config.txBackend == TX_RMT && _rmtReady) {
+        // 10 frame bits + stop bits + gap per byte, plus settle time
+        uint32_t timeoutMs = (len * (10 + _stopBits + _gapBits) * _bitPeriodTx) / 1000 + 100;
+        if (!sendBytesAsync(data, len) || !rmtFinish(timeoutMs)) return false;
+        Trace::record(Trace::EV_TX_DONE, 0, len);
+        return true;
+    }
+    
+    rxGate(UINT64_MAX);
     
     for (size_t i = 0; i < len; i++) {
-        uint8_t byte = data[i];
-        uint8_t reversed = reverseBits(byte);
-        uint16_t frame = reversed;
-        
-        if (!isEvenParity(byte)) {
-            frame |= 0x100;
+        bitbangFrame(encodeFrame(data[i]), i == len - 1);
+    }
+    
+    // Make sure line is released at end
+    kfdTxIdle();
+    
+    // Delay to let radio process frame before we look for response
+    delayMicroseconds(1000);
+    
+    Trace::record(Trace::EV_TX_DONE, 0, len);
+    return true;
+}
+
+void TWI_HAL::encodeBytes(const uint8_t* data, size_t len, uint16_t* frames) {
+    for (size_t i = 0; i < len; i++) {
+        frames[i] = encodeFrame(data[i]);
+    }
+}
+
+bool TWI_HAL::sendEncoded(const uint16_t* frames, size_t len) {
+    // Same wire format as sendBytesFast(), minus the per-byte encoding
+    if (!_initialized || !frames || len == 0) return false;
+    
+    if (_config.txBackend == TX_RMT && _rmtReady) {
+        if (_rmtTxActive && !rmtFinish(1000)) return false;
+        rmtBegin();
+        for (size_t i = 0; i < len; i++) {
+            rmtEncodeFrame(frames[i]);
         }
-        frame = frame << 1;
-        
-        portDISABLE_INTERRUPTS();
-        
-        // Send 10 bits LSB first
-        for (int j = 0; j < 10; j++) {
-            if (frame & 0x01) {
-                kfdTxIdle();
-            } else {
-                kfdTxBusy();
-            }
-            delayMicroseconds_accurate(_bitPeriodTx);
-            frame >>= 1;
+        rmtLevel(true, 1000 * RMT_TICKS_PER_US);
+        if (!rmtStart() || !rmtFinish((len * (10 + _stopBits + _gapBits) * _bitPeriodTx) / 1000 + 100)) {
+            return false;
         }
-        
-        // 4 stop bits - use member variable
-        if (_useBusyStopBits) {
-            kfdTxBusy();
-            for (int j = 0; j < 4; j++) {
-                delayMicroseconds_accurate(_bitPeriodTx);
-            }
+        Trace::record(Trace::EV_TX_DONE, 0, len);
+        return true;
+    }
+    
+    rxGate(UINT64_MAX);
+    
+    for (size_t i = 0; i < len; i++) {
+        bitbangFrame(frames[i], i == len - 1);
+    }
+    
+    kfdTxIdle();
+    delayMicroseconds(1000);
+    
+    Trace::record(Trace::EV_TX_DONE, 0, len);
+    return true;
+}
+
+void TWI_HAL::bitbangFrame(uint16_t frame, bool last) {
+    Trace::record(Trace::EV_TX_BYTE, reverseBits((frame >> 1) & 0xFF));
+    portDISABLE_INTERRUPTS();
+    
+    // Send 10 bits LSB first
+    for (int j = 0; j < 10; j++) {
+        if (frame & 0x01) {
             kfdTxIdle();
         } else {
-            kfdTxIdle();
-            for (int j = 0; j < 4; j++) {
-                delayMicroseconds_accurate(_bitPeriodTx);
-            }
+            kfdTxBusy();
         }
-        
-        portENABLE_INTERRUPTS();
-        
-        // Inter-byte gap - give radio time to sync for next start bit
-        delayMicroseconds(_bitPeriodTx * 2);
+        delayMicroseconds_accurate(_bitPeriodTx);
+        frame >>= 1;
     }
     
-    // Make sure line is released at end
-    kfdTxIdle();
+    // Stop bits - use member variable
+    if (_useBusyStopBits) {
+        kfdTxBusy();
+        for (int j = 0; j < _stopBits; j++) {
+            delayMicroseconds_accurate(_bitPeriodTx);
+        }
+        kfdTxIdle();
+    } else {
+        kfdTxIdle();
+        for (int j = 0; j < _stopBits; j++) {
+            delayMicroseconds_accurate(_bitPeriodTx);
+        }
+    }
     
-    // Delay to let radio process frame before we look for response
-    delayMicroseconds(1000);
+    portENABLE_INTERRUPTS();
+    
+    if (last) {
+        rxGate(esp_timer_get_time());
+    }
     
-    if (_debug) Serial.printf("[TWI] Sent %d bytes (fast mode)\n", len);
+    // Inter-byte gap - give radio time to sync for next start bit
+    delayMicroseconds(_bitPeriodTx * _gapBits);
+}
+
+bool TWI_HAL::sendBytesAsync(const uint8_t* data, size_t len) {
+    if (!_initialized || !data || len == 0) return false;
+    
+    if (_config.txBackend != TX_RMT || !_rmtReady) {
+        sendBytesFast(data, len);
+        return true;
+    }
+    
+    if (_rmtTxActive && !rmtFinish(1000)) return false;
+    
+    rmtBegin();
+    for (size_t i = 0; i < len; i++) {
+        rmtEncodeFrame(encodeFrame(data[i]));
+    }
+    // Same 1ms settle time as the bit-bang path, but timed by the peripheral
+    rmtLevel(true, 1000 * RMT_TICKS_PER_US);
+    
+    return rmtStart();
+}
+
+bool TWI_HAL::waitTxDone(uint32_t timeoutMs) {
+    if (!_rmtTxActive) return true;
+    
+    // Blocks on the driver's semaphore - the CPU is free while the frame is sent
+    if (rmt_wait_tx_done((rmt_channel_t)_config.rmtTxChannel, pdMS_TO_TICKS(timeoutMs)) != ESP_OK) {
+        return false;
+    }
+    
+    _rmtTxActive = false;
+    rmtDetach();
+    return true;
+}
+
+bool TWI_HAL::rmtFinish(uint32_t timeoutMs) {
+    if (waitTxDone(timeoutMs)) return true;
+    
+    // The peripheral never finished: stop it and give the line back, so the
+    // next transmission does not queue up behind the stuck one
+    rmt_tx_stop((rmt_channel_t)_config.rmtTxChannel);
+    _rmtTxActive = false;
+    rmtDetach();
+    rxGate(0);
+    Metrics::count(Metrics::CNT_TX_TIMEOUTS);
+    if (_debug) Console.printf("[TWI] RMT TX not done after %u ms - stopped\n", timeoutMs);
+    return false;
+}
+
+bool TWI_HAL::setTxBackend(TxBackend backend) {
+    if (backend == TX_RMT && !rmtInit()) return false;
+    waitTxDone();
+    _config.txBackend = backend;
+    return true;
 }
 
 void TWI_HAL::sendBytes(const uint8_t* data, size_t len) {
@@ -335,6 +555,120 @@ void TWI_HAL::sendBytes(const uint8_t* data, size_t len) {
 bool TWI_HAL::receiveByte(uint8_t* byte, uint32_t timeoutMs) {
     if (!_initialized || !byte) return false;
     
+    if (_config.rxBackend != RX_EDGE_CAPTURE || !_rxIsrAttached) {
+        return receiveBytePolled(byte, timeoutMs);
+    }
+    
+    // Ensure line is released
+    if (!_rmtTxActive) kfdTxIdle();
+    
+    uint32_t startMs = millis();
+    bool ok = false;
+    
+    _rxWaiter = xTaskGetCurrentTaskHandle();
+    while (true) {
+        serviceRx();
+        if (_rxRing.pop(*byte)) {
+            ok = true;
+            break;
+        }
+        if (timeoutMs > 0 && (millis() - startMs) > timeoutMs) break;
+        
+        if (_rxState == RXS_FRAME && _rxLevel) {
+            // Frame in progress on IDLE bits - if nothing follows there is no
+            // closing edge, so check back shortly
+            delayMicroseconds(_bitPeriodRx / 2);
+        } else {
+            // Sleep until the ISR sees an edge of interest (or 1 tick for the timeout)
+            ulTaskNotifyTake(pdTRUE, 1);
+        }
+    }
+    _rxWaiter = nullptr;
+    
+    // The byte itself was traced by the ISR
+    if (!ok) Trace::record(Trace::EV_RX_TIMEOUT, 0, timeoutMs > 0xFFFF ? 0xFFFF : timeoutMs);
+    
+    return ok;
+}
+
+bool TWI_HAL::waitForRxStart(uint32_t timeoutUs, uint32_t* latencyUs) {
+    if (!_initialized) return false;
+    
+    if (!_rmtTxActive) kfdTxIdle();
+    
+    uint64_t t0 = esp_timer_get_time();
+    // Measure from the end of our own transmission when it is still draining
+    uint64_t gate = _rxGateUntil;
+    uint64_t ref = (gate != UINT64_MAX && gate > t0) ? gate : t0;
+    uint64_t edge = 0;
+    bool seen = false;
+    
+    if (_config.rxBackend != RX_EDGE_CAPTURE || !_rxIsrAttached) {
+        while (esp_timer_get_time() - t0 < timeoutUs) {
+            if (kfdRxIsBusy()) {
+                edge = esp_timer_get_time();
+                seen = true;
+                break;
+            }
+        }
+    } else {
+        _rxWaiter = xTaskGetCurrentTaskHandle();
+        while (true) {
+            if (!_rxRing.empty()) {
+                edge = ref;  // Already complete - start time not kept
+                seen = true;
+                break;
+            }
+            if (_rxState == RXS_FRAME) {
+                edge = _rxFrameStart;
+                seen = true;
+                break;
+            }
+            if (esp_timer_get_time() - t0 >= timeoutUs) break;
+            // The ISR notifies on the start bit edge
+            ulTaskNotifyTake(pdTRUE, 1);
+        }
+        _rxWaiter = nullptr;
+    }
+    
+    if (latencyUs) *latencyUs = (seen && edge > ref) ? (uint32_t)(edge - ref) : 0;
+    return seen;
+}
+
+bool TWI_HAL::waitForBreak(uint32_t timeoutMs) {
+    if (!_initialized) return false;
+    
+    if (!_rmtTxActive) kfdTxIdle();
+    uint32_t startMs = millis();
+    
+    if (_config.rxBackend != RX_EDGE_CAPTURE || !_rxIsrAttached) {
+        // Time BUSY periods by polling, yielding a tick between samples
+        const uint32_t breakUs = _bitPeriodRx * RX_BREAK_BITS;
+        while ((millis() - startMs) < timeoutMs) {
+            if (kfdRxIsBusy()) {
+                uint64_t lowStart = esp_timer_get_time();
+                while (kfdRxIsBusy() && (millis() - startMs) < timeoutMs + 200) {}
+                if (kfdRxIsIdle() && esp_timer_get_time() - lowStart > breakUs) return true;
+            }
+            vTaskDelay(1);
+        }
+        return false;
+    }
+    
+    // The ISR notifies when a long BUSY period ends
+    bool seen = false;
+    _rxWaiter = xTaskGetCurrentTaskHandle();
+    while (!(seen = takeBreak())) {
+        if ((millis() - startMs) >= timeoutMs) break;
+        ulTaskNotifyTake(pdTRUE, 1);
+    }
+    _rxWaiter = nullptr;
+    return seen;
+}
+
+bool TWI_HAL::receiveBytePolled(uint8_t* byte, uint32_t timeoutMs) {
+    if (!_initialized || !byte) return false;
+    
     // Ensure line is released
     kfdTxIdle();
     
@@ -343,15 +677,13 @@ bool TWI_HAL::receiveByte(uint8_t* byte, uint32_t timeoutMs) {
     // Check if line is already LOW (radio responding fast!)
     bool alreadyLow = kfdRxIsBusy();
     
-    if (alreadyLow) {
-        // Radio already started responding! Don't wait.
-        if (_debug) Serial.println("[TWI] RX: Line already LOW - fast response!");
-    } else {
+    // Nothing is printed from here to the stop bits - the radio may
+    // already be sending (line LOW)
+    if (!alreadyLow) {
         // Wait for start bit (falling edge)
-        if (_debug) Serial.println("[TWI] RX: Waiting for start bit...");
         while (kfdRxIsIdle()) {
             if (timeoutMs > 0 && (millis() - startMs) > timeoutMs) {
-                if (_debug) Serial.println("[TWI] RX timeout waiting for start bit");
+                Trace::record(Trace::EV_RX_TIMEOUT, 0, timeoutMs > 0xFFFF ? 0xFFFF : timeoutMs);
                 return false;
             }
             // Tight polling
@@ -394,7 +726,7 @@ bool TWI_HAL::receiveByte(uint8_t* byte, uint32_t timeoutMs) {
     uint8_t rawByte = rxByte & 0xFF;
     *byte = reverseBits(rawByte);
     
-    if (_debug) Serial.printf("[TWI] RX: 0x%02X (raw=0x%02X)\n", *byte, rawByte);
+    Trace::record(Trace::EV_RX_BYTE, *byte);
     
     return true;
 }
@@ -402,6 +734,17 @@ bool TWI_HAL::receiveByte(uint8_t* byte, uint32_t timeoutMs) {
 bool TWI_HAL::receiveBytes(uint8_t* buffer, size_t maxLen, size_t* received, uint32_t timeoutMs) {
     if (!received) return false;
     *received = 0;
+    if (!buffer || maxLen == 0) return false;
+    
+    if (_config.rxBackend == RX_EDGE_CAPTURE && _rxIsrAttached) {
+        serviceRx();
+        if (_rxRing.empty()) {
+            if (timeoutMs == 0 || !receiveByte(&buffer[0], timeoutMs)) return false;
+            *received = 1;
+        }
+        *received += _rxRing.read(buffer + *received, maxLen - *received);
+        return true;
+    }
     
     while (*received < maxLen) {
         uint8_t b;
@@ -434,10 +777,18 @@ bool TWI_HAL::kfdRxIsIdle() {
 }
 
 void TWI_HAL::senTxConn() {
+    if (_senseReleased) {
+        pinMode(_config.sensePin, OUTPUT);
+        _senseReleased = false;
+    }
     digitalWrite(_config.sensePin, LOW);  // Connected = drive LOW
 }
 
 void TWI_HAL::senTxDisc() {
+    if (_senseReleased) {
+        pinMode(_config.sensePin, OUTPUT);
+        _senseReleased = false;
+    }
     digitalWrite(_config.sensePin, HIGH); // Disconnected = drive HIGH  
 }
 
@@ -492,6 +843,15 @@ uint8_t TWI_HAL::reverseBits(uint8_t byte) {
     return table[byte];
 }
 
+uint16_t TWI_HAL::encodeFrame(uint8_t byte) {
+    // start(0) + 8 data bits (reversed) + parity, sent LSB first
+    uint16_t frame = reverseBits(byte);
+    if (!isEvenParity(byte)) {
+        frame |= 0x100;
+    }
+    return frame << 1;
+}
+
 bool TWI_HAL::isEvenParity(uint8_t byte) {
     int ones = 0;
     for (int i = 0; i < 8; i++) {
@@ -507,10 +867,357 @@ void TWI_HAL::delayMicroseconds_accurate(uint32_t us) {
     }
 }
 
-void IRAM_ATTR TWI_HAL::dataFallingISR() {
-    if (_instance) _instance->handleDataFalling();
+// =============================================================================
+// RMT transmit backend
+// =============================================================================
+
+bool TWI_HAL::rmtInit() {
+    if (_rmtReady) return true;
+    if (_config.rmtTxChannel < 0 || _config.rmtTxChannel >= RMT_CHANNEL_MAX) return false;
+    
+    if (!rmtClaim(_config.rmtTxChannel)) {
+        if (_debug) Console.printf("[TWI] RMT channel %d already used by another port\n", _config.rmtTxChannel);
+        return false;
+    }
+    
+    rmt_channel_t channel = (rmt_channel_t)_config.rmtTxChannel;
+    
+    rmt_config_t cfg = {};
+    cfg.rmt_mode = RMT_MODE_TX;
+    cfg.channel = channel;
+    cfg.gpio_num = _config.dataPin;
+    cfg.clk_div = RMT_CLK_DIV;
+    cfg.mem_block_num = 1;  // Driver refills from _rmtItems in its ISR
+    cfg.tx_config.carrier_en = false;
+    cfg.tx_config.loop_en = false;
+    cfg.tx_config.idle_output_en = true;
+    cfg.tx_config.idle_level = RMT_IDLE_LEVEL_HIGH;  // Released = IDLE
+    
+    if (rmt_config(&cfg) != ESP_OK || rmt_driver_install(channel, 0, 0) != ESP_OK) {
+        rmtRelease(_config.rmtTxChannel);
+        return false;
+    }
+    
+    // rmt_config() routed the pin as push-pull - give it back to the GPIO
+    // driver until we actually transmit
+    rmtDetach();
+    
+    // Worst case: 512-byte frame, ~8 items per byte
+    _rmtItems.reserve(512 * 8);
+    
+    _rmtReady = true;
+    return true;
+}
+
+bool TWI_HAL::rmtClaim(int channel) {
+    bool ok;
+    portENTER_CRITICAL(&s_rmtClaimMux);
+    ok = !(_rmtClaimed & (1u << channel));
+    if (ok) _rmtClaimed |= (1u << channel);
+    portEXIT_CRITICAL(&s_rmtClaimMux);
+    return ok;
 }
 
-void TWI_HAL::handleDataFalling() {
-    _receiving = true;
+void TWI_HAL::rmtRelease(int channel) {
+    portENTER_CRITICAL(&s_rmtClaimMux);
+    _rmtClaimed &= ~(1u << channel);
+    portEXIT_CRITICAL(&s_rmtClaimMux);
+}
+
+void TWI_HAL::rmtAttach() {
+    gpio_num_t pin = (gpio_num_t)_config.dataPin;
+    
+    // Open-drain with input enabled: output 0 = BUSY, output 1 = released (IDLE)
+    gpio_set_direction(pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_pullup_en(pin);
+    esp_rom_gpio_connect_out_signal(_config.dataPin, RMT_SIG_OUT0_IDX + _config.rmtTxChannel, false, false);
+}
+
+void TWI_HAL::rmtDetach() {
+    esp_rom_gpio_connect_out_signal(_config.dataPin, SIG_GPIO_OUT_IDX, false, false);
+    kfdTxIdle();
+}
+
+void TWI_HAL::rmtBegin() {
+    _rmtItems.clear();
+    _rmtTotalTicks = 0;
+    _rmtDrivenTicks = 0;
+    _rmtPendingIdle = true;
+    _rmtPendingTicks = 0;
+    _rmtHalfOpen = false;
+}
+
+void TWI_HAL::rmtLevel(bool idle, uint32_t ticks) {
+    if (ticks == 0) return;
+    
+    // Run-length merge: consecutive bits at the same level become one symbol
+    if (_rmtPendingTicks > 0 && idle != _rmtPendingIdle) {
+        rmtFlushRun();
+    }
+    _rmtPendingIdle = idle;
+    _rmtPendingTicks += ticks;
+    
+    _rmtTotalTicks += ticks;
+    if (!idle) _rmtDrivenTicks = _rmtTotalTicks;
+}
+
+void TWI_HAL::rmtEncodeFrame(uint16_t frame) {
+    // Traced when queued - the peripheral clocks it out shortly after
+    Trace::record(Trace::EV_TX_BYTE, reverseBits((frame >> 1) & 0xFF));
+    
+    // 10 bits LSB first
+    for (int i = 0; i < 10; i++) {
+        rmtLevel(frame & 0x01, _rmtBitTicks);
+        frame >>= 1;
+    }
+    
+    // Stop bits - level configurable via setStopBitMode()
+    rmtLevel(!_useBusyStopBits, _rmtBitTicks * _stopBits);
+    
+    // Inter-byte gap, same as the bit-bang path
+    if (_gapBits) rmtLevel(true, _rmtBitTicks * _gapBits);
+}
+
+void TWI_HAL::rmtFlushRun() {
+    uint32_t ticks = _rmtPendingTicks;
+    while (ticks > 0) {
+        uint32_t chunk = (ticks > RMT_MAX_DURATION) ? RMT_MAX_DURATION : ticks;
+        rmtPushHalf(_rmtPendingIdle, chunk);
+        ticks -= chunk;
+    }
+    _rmtPendingTicks = 0;
+}
+
+void TWI_HAL::rmtPushHalf(bool idle, uint32_t ticks) {
+    if (_rmtHalfOpen) {
+        rmt_item32_t& item = _rmtItems.back();
+        item.level1 = idle ? 1 : 0;
+        item.duration1 = ticks;
+        _rmtHalfOpen = false;
+    } else {
+        // A zero second half is the end marker if nothing follows
+        rmt_item32_t item;
+        item.level0 = idle ? 1 : 0;
+        item.duration0 = ticks;
+        item.level1 = idle ? 1 : 0;
+        item.duration1 = 0;
+        _rmtItems.push_back(item);
+        _rmtHalfOpen = true;
+    }
+}
+
+bool TWI_HAL::rmtStart() {
+    rmtFlushRun();
+    if (_rmtItems.empty()) return false;
+    
+    rmtAttach();
+    _rmtTxActive = true;
+    
+    // The pin is input-enabled while RMT drives it: ignore our own edges up to
+    // the end of the last BUSY run (plus start latency), listen from there on
+    rxGate(esp_timer_get_time() + _rmtDrivenTicks / RMT_TICKS_PER_US + 20);
+    
+    if (rmt_write_items((rmt_channel_t)_config.rmtTxChannel, _rmtItems.data(),
+                        _rmtItems.size(), false) != ESP_OK) {
+        _rmtTxActive = false;
+        rmtDetach();
+        rxGate(0);
+        return false;
+    }
+    return true;
+}
+
+// =============================================================================
+// Edge capture receiver
+// =============================================================================
+//
+// Every DATA edge is timestamped in the ISR. Bit i of a frame is centred at
+// start + (i + 0.5) * T, so at each edge all bit centres since the previous
+// edge take the level the line had before it. A frame whose last bits are
+// IDLE has no closing edge; serviceRx() finishes it once the parity bit has
+// passed. Edges before _rxGateUntil are our own transmission and ignored.
+
+void TWI_HAL::rxAttach() {
+    if (_rxIsrAttached) return;
+    flushRx();
+    _rxLevel = kfdRxIsIdle();
+    attachInterruptArg(digitalPinToInterrupt(_config.dataPin), dataEdgeISR, this, CHANGE);
+    _rxIsrAttached = true;
+}
+
+void TWI_HAL::rxDetach() {
+    if (!_rxIsrAttached) return;
+    detachInterrupt(digitalPinToInterrupt(_config.dataPin));
+    _rxIsrAttached = false;
+}
+
+void TWI_HAL::setRxBackend(RxBackend backend) {
+    _config.rxBackend = backend;
+    if (!_initialized) return;
+    if (backend == RX_EDGE_CAPTURE) rxAttach();
+    else rxDetach();
+}
+
+void TWI_HAL::rxGate(uint64_t untilUs) {
+    portENTER_CRITICAL(&_rxMux);
+    _rxGateUntil = untilUs;
+    if (untilUs == UINT64_MAX) _rxState = RXS_HUNT;
+    portEXIT_CRITICAL(&_rxMux);
+}
+
+size_t TWI_HAL::available() {
+    serviceRx();
+    return _rxRing.size();
+}
+
+void TWI_HAL::flushRx() {
+    portENTER_CRITICAL(&_rxMux);
+    _rxState = RXS_HUNT;
+    _rxBreak = false;
+    portEXIT_CRITICAL(&_rxMux);
+    _rxRing.clear();
+}
+
+bool TWI_HAL::takeBreak() {
+    portENTER_CRITICAL(&_rxMux);
+    bool seen = _rxBreak;
+    _rxBreak = false;
+    portEXIT_CRITICAL(&_rxMux);
+    return seen;
+}
+
+void TWI_HAL::resetRxStats() {
+    portENTER_CRITICAL(&_rxMux);
+    _rxStats = RxStats();
+    portEXIT_CRITICAL(&_rxMux);
+}
+
+void TWI_HAL::serviceRx() {
+    if (!_rxIsrAttached) return;
+    
+    portENTER_CRITICAL(&_rxMux);
+    if (_rxState == RXS_FRAME && _rxLevel) {
+        uint64_t now = esp_timer_get_time();
+        if (now - _rxFrameStart >= (uint64_t)_bitPeriodRx * 10 + _bitPeriodRx / 2) {
+            // Parity bit has passed with the line IDLE and no further edge
+            rxFillBits(now, true);
+            if (_rxShift & 0x01) _rxStats.framingErrors++;
+            else rxFinishFrame();
+            _rxState = RXS_HUNT;
+        }
+    }
+    portEXIT_CRITICAL(&_rxMux);
+}
+
+void IRAM_ATTR TWI_HAL::rxFillBits(uint64_t t, bool level) {
+    uint32_t count = (uint32_t)((t - _rxFrameStart + _bitPeriodRx / 2) / _bitPeriodRx);
+    if (count > 10) count = 10;
+    
+    uint16_t shift = _rxShift;
+    for (uint32_t i = _rxBitCount; i < count; i++) {
+        if (level) shift |= (1 << i);
+    }
+    _rxShift = shift;
+    if (count > _rxBitCount) _rxBitCount = count;
+}
+
+void IRAM_ATTR TWI_HAL::rxFinishFrame() {
+    // Wire order: start, 8 data bits (reversed), parity
+    uint8_t raw = (_rxShift >> 1) & 0xFF;
+    uint8_t byte = 0;
+    uint8_t ones = 0;
+    for (int i = 0; i < 8; i++) {
+        if (raw & (1 << i)) {
+            byte |= (0x80 >> i);
+            ones++;
+        }
+    }
+    if ((_rxShift >> 9) & 0x01) ones++;
+    
+    // TX sets the parity bit so the total number of ones is even
+    if (ones & 0x01) _rxStats.parityErrors++;
+    Trace::record(Trace::EV_RX_BYTE, byte, ones & 0x01);
+    
+    if (_rxRing.push(byte)) _rxStats.bytes++;
+    else _rxStats.overruns++;
+}
+
+void IRAM_ATTR TWI_HAL::dataEdgeISR(void* arg) {
+    static_cast<TWI_HAL*>(arg)->handleDataEdge();
+}
+
+void IRAM_ATTR TWI_HAL::handleDataEdge() {
+    uint64_t now = esp_timer_get_time();
+    bool level = gpio_get_level((gpio_num_t)_config.dataPin) != 0;
+    bool wake = false;
+    
+    portENTER_CRITICAL_ISR(&_rxMux);
+    
+    Trace::record(Trace::EV_EDGE, level, now < _rxGateUntil);
+    
+    if (now < _rxGateUntil) {
+        // Our own transmission
+        _rxState = RXS_HUNT;
+    } else if (level != _rxLevel) {
+        uint64_t elapsed = now - _rxFrameStart;
+        uint32_t T = _bitPeriodRx;
+        
+        switch (_rxState) {
+            case RXS_FRAME:
+                rxFillBits(now, _rxLevel);
+                if (_rxBitCount >= 1 && (_rxShift & 0x01)) {
+                    // Start bit shorter than half a bit - glitch
+                    _rxStats.framingErrors++;
+                    _rxState = RXS_HUNT;
+                } else if (_rxBitCount >= 10) {
+                    if (!_rxLevel && elapsed > (uint64_t)T * RX_BREAK_BITS) {
+                        // Long BUSY ending - key signature, not data
+                        _rxStats.breaks++;
+                        _rxBreak = true;
+                        Trace::record(Trace::EV_BREAK, 0, elapsed > 0xFFFF000ULL ? 0xFFFF : (uint16_t)(elapsed / 1000));
+                        _rxState = RXS_HUNT;
+                    } else {
+                        rxFinishFrame();
+                        // Falling edge right after parity = BUSY stop bits;
+                        // later ones are the next start bit
+                        if (!level && elapsed < (uint64_t)T * 10 + T / 2) {
+                            _rxState = RXS_WAIT_IDLE;
+                        } else {
+                            _rxState = RXS_HUNT;
+                        }
+                    }
+                    wake = true;
+                }
+                break;
+                
+            case RXS_WAIT_IDLE:
+                if (level) _rxState = RXS_HUNT;
+                break;
+                
+            case RXS_HUNT:
+            default:
+                break;
+        }
+        
+        if (_rxState == RXS_HUNT && !level) {
+            // Falling edge while hunting = start bit
+            _rxFrameStart = now;
+            _rxShift = 0;
+            _rxBitCount = 0;
+            _rxState = RXS_FRAME;
+            wake = true;
+        }
+    }
+    
+    _rxLevel = level;
+    _rxLastEdge = now;
+    TaskHandle_t waiter = _rxWaiter;
+    
+    portEXIT_CRITICAL_ISR(&_rxMux);
+    
+    if (wake && waiter) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(waiter, &woken);
+        if (woken) portYIELD_FROM_ISR();
+    }
 }
@@ -12,7 +12,10 @@
 #include "container.h"
 #include "kfd_protocol.h"
 #include "crypto.h"
+#include "fleet_loader.h"
+#include "metrics.h"
 #include "p25_defs.h"
+#include "ui_vlist.h"
 
 extern TWI_HAL& getTwiHal();
 extern KFDProtocol& getKfdProtocol();
@@ -49,6 +52,7 @@ static lv_obj_t* scr_keys = nullptr;
 static lv_obj_t* scr_key_edit = nullptr;
 static lv_obj_t* scr_keyload = nullptr;
 static lv_obj_t* scr_diagnostics = nullptr;
+static lv_obj_t* scr_inventory = nullptr;
 static lv_obj_t* scr_keyboard = nullptr;
 
 // Current state
@@ -65,14 +69,25 @@ static lv_obj_t* pin_label = nullptr;
 static lv_obj_t* login_status = nullptr;
 static lv_obj_t* keyload_status_label = nullptr;
 static lv_obj_t* keyload_progress = nullptr;
+static lv_obj_t* keyload_btn_label = nullptr;
 
 // Keyboard callback
 static lv_obj_t* kb_target = nullptr;
 static void (*kb_callback)(const char*) = nullptr;
 
 // Global keyboard object
-static lv_obj_t* g_keyboard = nullptr;
-static lv_obj_t* g_keyboard_target = nullptr;
+
+// Compiled keyload for the current selection - rebuilt only when the
+// selection or key data changes, then replayed radio after radio. Keyed on
+// the store generation and container index: containers move in memory.
+static KFDProtocol::KeyloadPlan keyload_plan;
+static uint32_t keyload_plan_gen = 0;
+static int keyload_plan_idx = -1;
+
+static void invalidate_keyload_plan() {
+    keyload_plan.clear();
+    keyload_plan_idx = -1;
+}
 
 // =============================================================================
 // Keyboard Helpers
@@ -84,43 +99,45 @@ static void keyboard_event_cb(lv_event_t* e) {
     if (code == LV_EVENT_READY || code == LV_EVENT_CANCEL) {
         // Hide keyboard
         lv_obj_add_flag(kb, LV_OBJ_FLAG_HIDDEN);
-        g_keyboard_target = nullptr;
     }
 }
 
+// Each screen with text inputs owns one keyboard
+static lv_obj_t* screen_keyboard(lv_obj_t* scr) {
+    for (uint32_t i = 0; i < lv_obj_get_child_cnt(scr); i++) {
+        lv_obj_t* child = lv_obj_get_child(scr, i);
+        if (lv_obj_check_type(child, &lv_keyboard_class)) return child;
+    }
+    return nullptr;
+}
+
 static void textarea_event_cb(lv_event_t* e) {
     lv_event_code_t code = lv_event_get_code(e);
     lv_obj_t* ta = lv_event_get_target(e);
+    lv_obj_t* kb = screen_keyboard(lv_obj_get_screen(ta));
+    if (!kb) return;
     
     if (code == LV_EVENT_FOCUSED) {
         // Show keyboard and attach to this textarea
-        if (g_keyboard) {
-            lv_keyboard_set_textarea(g_keyboard, ta);
-            lv_obj_clear_flag(g_keyboard, LV_OBJ_FLAG_HIDDEN);
-            g_keyboard_target = ta;
-        }
+        lv_keyboard_set_textarea(kb, ta);
+        lv_obj_clear_flag(kb, LV_OBJ_FLAG_HIDDEN);
     } else if (code == LV_EVENT_DEFOCUSED) {
         // Hide keyboard
-        if (g_keyboard) {
-            lv_obj_add_flag(g_keyboard, LV_OBJ_FLAG_HIDDEN);
-            g_keyboard_target = nullptr;
-        }
+        lv_obj_add_flag(kb, LV_OBJ_FLAG_HIDDEN);
     }
 }
 
-static void create_global_keyboard(lv_obj_t* parent) {
-    if (g_keyboard) return;  // Already created
-    
-    g_keyboard = lv_keyboard_create(parent);
-    lv_obj_set_size(g_keyboard, SCREEN_W, SCREEN_H / 2);
-    lv_obj_align(g_keyboard, LV_ALIGN_BOTTOM_MID, 0, 0);
-    lv_obj_add_flag(g_keyboard, LV_OBJ_FLAG_HIDDEN);  // Start hidden
-    lv_obj_add_event_cb(g_keyboard, keyboard_event_cb, LV_EVENT_ALL, NULL);
+static void create_screen_keyboard(lv_obj_t* parent) {
+    lv_obj_t* kb = lv_keyboard_create(parent);
+    lv_obj_set_size(kb, SCREEN_W, SCREEN_H / 2);
+    lv_obj_align(kb, LV_ALIGN_BOTTOM_MID, 0, 0);
+    lv_obj_add_flag(kb, LV_OBJ_FLAG_HIDDEN);  // Start hidden
+    lv_obj_add_event_cb(kb, keyboard_event_cb, LV_EVENT_ALL, NULL);
     
     // Style the keyboard
-    lv_obj_set_style_bg_color(g_keyboard, COLOR_BG_PANEL, LV_PART_MAIN);
-    lv_obj_set_style_bg_color(g_keyboard, COLOR_BUTTON, LV_PART_ITEMS);
-    lv_obj_set_style_text_color(g_keyboard, COLOR_TEXT, LV_PART_ITEMS);
+    lv_obj_set_style_bg_color(kb, COLOR_BG_PANEL, LV_PART_MAIN);
+    lv_obj_set_style_bg_color(kb, COLOR_BUTTON, LV_PART_ITEMS);
+    lv_obj_set_style_text_color(kb, COLOR_TEXT, LV_PART_ITEMS);
 }
 
 // =============================================================================
@@ -224,10 +241,34 @@ static lv_obj_t* create_footer(lv_obj_t* parent) {
     lv_obj_set_style_text_color(status_label, COLOR_TEXT_DIM, 0);
     lv_obj_set_style_text_font(status_label, &lv_font_montserrat_12, 0);
     lv_obj_align(status_label, LV_ALIGN_LEFT_MID, 4, 0);
+    lv_obj_set_user_data(parent, status_label);   // Picked up again by show_screen()
     
     return footer;
 }
 
+// Screens are built once and kept; ui_show_*() refreshes their contents and
+// loads them through here
+static void show_screen(lv_obj_t* scr) {
+    status_label = (lv_obj_t*)lv_obj_get_user_data(scr);
+    if (status_label) lv_label_set_text(status_label, "Ready");
+    
+    lv_obj_t* kb = screen_keyboard(scr);
+    if (kb) {
+        lv_keyboard_set_textarea(kb, NULL);
+        lv_obj_add_flag(kb, LV_OBJ_FLAG_HIDDEN);
+    }
+    lv_scr_load(scr);
+}
+
+static lv_obj_t* create_list(lv_obj_t* parent, lv_coord_t h, lv_coord_t row_h,
+                             ui_vlist_create_cb_t create_cb, ui_vlist_bind_cb_t bind_cb) {
+    lv_obj_t* list = ui_vlist_create(parent, SCREEN_W - 10, h, row_h, create_cb, bind_cb);
+    lv_obj_set_style_bg_color(list, COLOR_BG_DARK, 0);
+    lv_obj_set_style_border_width(list, 0, 0);
+    lv_obj_set_style_text_color(list, COLOR_TEXT_DIM, 0);
+    return list;
+}
+
 static lv_obj_t* create_labeled_input(lv_obj_t* parent, const char* label, int y, int width = SCREEN_W - 20) {
     lv_obj_t* lbl = lv_label_create(parent);
     lv_label_set_text(lbl, label);
@@ -250,16 +291,25 @@ static lv_obj_t* create_labeled_input(lv_obj_t* parent, const char* label, int y
 // =============================================================================
 // Navigation Callbacks
 // =============================================================================
+// The key library is unreachable while the store is locked - say why
+static bool storage_locked_notice() {
+    const char* err = DeviceManager::instance().getStorageError();
+    if (!err) return false;
+    ui_show_message("Storage Locked", err, 2);
+    return true;
+}
+
 static void goto_main_menu(lv_event_t* e) { (void)e; ui_show_main_menu(); }
-static void goto_containers(lv_event_t* e) { (void)e; ui_show_containers(); }
-static void goto_keyload(lv_event_t* e) { (void)e; ui_show_keyload(); }
+static void goto_containers(lv_event_t* e) { (void)e; if (!storage_locked_notice()) ui_show_containers(); }
+static void goto_keyload(lv_event_t* e) { (void)e; if (!storage_locked_notice()) ui_show_keyload(); }
 static void goto_diagnostics(lv_event_t* e) { (void)e; ui_show_diagnostics(); }
+static void goto_inventory(lv_event_t* e) { (void)e; ui_show_view_key_info(); }
 
 // =============================================================================
 // Login Screen
 // =============================================================================
 static void build_login_screen() {
-    if (scr_login) lv_obj_del(scr_login);
+    if (scr_login) return;
     scr_login = lv_obj_create(NULL);
     style_screen(scr_login);
     
@@ -330,6 +380,7 @@ static void build_login_screen() {
         } else if (strcmp(txt, LV_SYMBOL_OK) == 0) {
             if (pending_role != ROLE_NONE && DeviceManager::instance().login(pending_role, pin_buffer)) {
                 ui_show_main_menu();
+                storage_locked_notice();
             } else {
                 lv_label_set_text(login_status, "Invalid PIN");
                 lv_obj_set_style_text_color(login_status, COLOR_ERROR, 0);
@@ -355,11 +406,21 @@ static void build_login_screen() {
     lv_obj_align(serial, LV_ALIGN_BOTTOM_MID, 0, -10);
 }
 
+static void refresh_login_screen() {
+    pending_role = ROLE_NONE;
+    pin_len = 0; pin_buffer[0] = '\0';
+    lv_label_set_text(pin_label, "----");
+    lv_label_set_text(login_status, "Select role and enter PIN");
+    lv_obj_set_style_text_color(login_status, COLOR_TEXT_DIM, 0);
+}
+
 // =============================================================================
 // Main Menu
 // =============================================================================
+static lv_obj_t* menu_role_label = nullptr;
+
 static void build_main_menu() {
-    if (scr_main_menu) lv_obj_del(scr_main_menu);
+    if (scr_main_menu) return;
     scr_main_menu = lv_obj_create(NULL);
     style_screen(scr_main_menu);
     
@@ -378,10 +439,9 @@ static void build_main_menu() {
     lv_obj_set_style_text_font(t, &lv_font_montserrat_18, 0);
     lv_obj_align(t, LV_ALIGN_LEFT_MID, 10, 0);
     
-    lv_obj_t* u = lv_label_create(header);
-    lv_label_set_text(u, DeviceManager::instance().isAdmin() ? "ADMIN" : "OPER");
-    lv_obj_set_style_text_color(u, COLOR_SUCCESS, 0);
-    lv_obj_align(u, LV_ALIGN_RIGHT_MID, -10, 0);
+    menu_role_label = lv_label_create(header);
+    lv_obj_set_style_text_color(menu_role_label, COLOR_SUCCESS, 0);
+    lv_obj_align(menu_role_label, LV_ALIGN_RIGHT_MID, -10, 0);
     
     int y = HEADER_H + 15;
     
@@ -407,6 +467,17 @@ static void build_main_menu() {
     lv_obj_center(l2);
     y += BTN_H + 10;
     
+    // Radio inventory
+    lv_obj_t* b5 = lv_btn_create(scr_main_menu);
+    lv_obj_set_size(b5, SCREEN_W - 20, BTN_H);
+    lv_obj_align(b5, LV_ALIGN_TOP_MID, 0, y);
+    style_btn(b5);
+    lv_obj_add_event_cb(b5, goto_inventory, LV_EVENT_CLICKED, NULL);
+    lv_obj_t* l5 = lv_label_create(b5);
+    lv_label_set_text(l5, LV_SYMBOL_EYE_OPEN "  RADIO KEYS");
+    lv_obj_center(l5);
+    y += BTN_H + 10;
+    
     // Diagnostics
     lv_obj_t* b3 = lv_btn_create(scr_main_menu);
     lv_obj_set_size(b3, SCREEN_W - 20, BTN_H);
@@ -431,14 +502,19 @@ static void build_main_menu() {
     create_footer(scr_main_menu);
 }
 
+static void refresh_main_menu() {
+    lv_label_set_text(menu_role_label, DeviceManager::instance().isAdmin() ? "ADMIN" : "OPER");
+}
+
 // =============================================================================
 // Containers List Screen
 // =============================================================================
-static void refresh_containers_list();
 static lv_obj_t* containers_list = nullptr;
 
 static void on_container_click(lv_event_t* e) {
-    current_container_idx = (int)(uintptr_t)lv_event_get_user_data(e);
+    int32_t idx = ui_vlist_row_index(containers_list, lv_event_get_current_target(e));
+    if (idx < 0) return;
+    current_container_idx = idx;
     current_group_idx = 0;
     ContainerManager::instance().setActiveIndex(current_container_idx);
     ui_show_container_detail(current_container_idx);
@@ -456,23 +532,45 @@ static void on_add_container(lv_event_t* e) {
     ui_show_container_detail(current_container_idx);
 }
 
+// Row children: 0 name, 1 key count, 2 arrow
+static void create_container_row(lv_obj_t* item) {
+    style_panel(item);
+    lv_obj_add_flag(item, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(item, on_container_click, LV_EVENT_CLICKED, NULL);
+    
+    lv_obj_t* name = lv_label_create(item);
+    lv_obj_set_style_text_color(name, COLOR_TEXT, 0);
+    lv_obj_align(name, LV_ALIGN_LEFT_MID, 5, -8);
+    
+    lv_obj_t* info = lv_label_create(item);
+    lv_obj_set_style_text_color(info, COLOR_TEXT_DIM, 0);
+    lv_obj_set_style_text_font(info, &lv_font_montserrat_12, 0);
+    lv_obj_align(info, LV_ALIGN_LEFT_MID, 5, 10);
+    
+    lv_obj_t* arrow = lv_label_create(item);
+    lv_label_set_text(arrow, LV_SYMBOL_RIGHT);
+    lv_obj_set_style_text_color(arrow, COLOR_ACCENT, 0);
+    lv_obj_align(arrow, LV_ALIGN_RIGHT_MID, -5, 0);
+}
+
+static void bind_container_row(lv_obj_t* item, uint32_t i) {
+    const Container& c = ContainerManager::instance().getSummary(i);   // Index only - records load when opened
+    lv_label_set_text(lv_obj_get_child(item, 0), c.name.c_str());
+    char buf[32]; snprintf(buf, sizeof(buf), "%d keys", (int)c.totalKeyCount());
+    lv_label_set_text(lv_obj_get_child(item, 1), buf);
+}
+
 static void build_containers_screen() {
-    if (scr_containers) lv_obj_del(scr_containers);
+    if (scr_containers) return;
     scr_containers = lv_obj_create(NULL);
     style_screen(scr_containers);
     
     create_header(scr_containers, "KEY CONTAINERS", goto_main_menu);
     
-    containers_list = lv_obj_create(scr_containers);
-    lv_obj_set_size(containers_list, SCREEN_W - 10, SCREEN_H - HEADER_H - FOOTER_H - BTN_H - 25);
+    containers_list = create_list(scr_containers, SCREEN_H - HEADER_H - FOOTER_H - BTN_H - 25, 50,
+                                  create_container_row, bind_container_row);
     lv_obj_align(containers_list, LV_ALIGN_TOP_MID, 0, HEADER_H + 5);
-    lv_obj_set_style_bg_color(containers_list, COLOR_BG_DARK, 0);
-    lv_obj_set_style_border_width(containers_list, 0, 0);
-    lv_obj_set_style_pad_all(containers_list, 2, 0);
-    lv_obj_set_flex_flow(containers_list, LV_FLEX_FLOW_COLUMN);
-    lv_obj_set_flex_align(containers_list, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
-    
-    refresh_containers_list();
+    ui_vlist_set_empty_text(containers_list, "No containers.\nTap + to create one.");
     
     lv_obj_t* btn_add = lv_btn_create(scr_containers);
     lv_obj_set_size(btn_add, SCREEN_W - 16, BTN_H);
@@ -487,43 +585,7 @@ static void build_containers_screen() {
 }
 
 static void refresh_containers_list() {
-    lv_obj_clean(containers_list);
-    
-    ContainerManager& cm = ContainerManager::instance();
-    for (size_t i = 0; i < cm.getContainerCount(); i++) {
-        const Container& c = cm.getContainer(i);
-        
-        lv_obj_t* item = lv_obj_create(containers_list);
-        lv_obj_set_size(item, SCREEN_W - 20, 50);
-        lv_obj_clear_flag(item, LV_OBJ_FLAG_SCROLLABLE);
-        style_panel(item);
-        lv_obj_add_flag(item, LV_OBJ_FLAG_CLICKABLE);
-        lv_obj_add_event_cb(item, on_container_click, LV_EVENT_CLICKED, (void*)(uintptr_t)i);
-        
-        lv_obj_t* name = lv_label_create(item);
-        lv_label_set_text(name, c.name.c_str());
-        lv_obj_set_style_text_color(name, COLOR_TEXT, 0);
-        lv_obj_align(name, LV_ALIGN_LEFT_MID, 5, -8);
-        
-        char buf[32]; snprintf(buf, sizeof(buf), "%d keys", (int)c.totalKeyCount());
-        lv_obj_t* info = lv_label_create(item);
-        lv_label_set_text(info, buf);
-        lv_obj_set_style_text_color(info, COLOR_TEXT_DIM, 0);
-        lv_obj_set_style_text_font(info, &lv_font_montserrat_12, 0);
-        lv_obj_align(info, LV_ALIGN_LEFT_MID, 5, 10);
-        
-        lv_obj_t* arrow = lv_label_create(item);
-        lv_label_set_text(arrow, LV_SYMBOL_RIGHT);
-        lv_obj_set_style_text_color(arrow, COLOR_ACCENT, 0);
-        lv_obj_align(arrow, LV_ALIGN_RIGHT_MID, -5, 0);
-    }
-    
-    if (cm.getContainerCount() == 0) {
-        lv_obj_t* lbl = lv_label_create(containers_list);
-        lv_label_set_text(lbl, "No containers.\nTap + to create one.");
-        lv_obj_set_style_text_color(lbl, COLOR_TEXT_DIM, 0);
-        lv_obj_set_style_text_align(lbl, LV_TEXT_ALIGN_CENTER, 0);
-    }
+    ui_vlist_set_count(containers_list, ContainerManager::instance().getContainerCount());
 }
 
 // =============================================================================
@@ -531,42 +593,47 @@ static void refresh_containers_list() {
 // =============================================================================
 static lv_obj_t* keys_list = nullptr;
 static lv_obj_t* ta_container_name = nullptr;
+static int keys_list_container = -1;   // Container the list was last scrolled for
 
 static void refresh_keys_list();
 
 static void on_key_click(lv_event_t* e) {
-    current_key_idx = (int)(uintptr_t)lv_event_get_user_data(e);
+    int32_t idx = ui_vlist_row_index(keys_list, lv_event_get_current_target(e));
+    if (idx < 0) return;
+    current_key_idx = idx;
     ui_show_key_edit(current_container_idx, current_group_idx, current_key_idx);
 }
 
 static void on_key_checkbox(lv_event_t* e) {
-    int idx = (int)(uintptr_t)lv_event_get_user_data(e);
+    int32_t idx = ui_vlist_row_index(keys_list, lv_event_get_target(e));
+    if (idx < 0) return;
     lv_obj_t* cb = lv_event_get_target(e);
     bool checked = lv_obj_has_state(cb, LV_STATE_CHECKED);
     
-    Container* c = ContainerManager::instance().getActiveContainerMutable();
-    if (c && current_group_idx < (int)c->groups.size() && idx < (int)c->groups[current_group_idx].keys.size()) {
-        c->groups[current_group_idx].keys[idx].selected = checked;
+    ContainerManager& cm = ContainerManager::instance();
+    if (cm.setKeySelected(cm.getActiveIndex(), current_group_idx, idx, checked)) {
+        invalidate_keyload_plan();
     }
 }
 
 static void on_add_key(lv_event_t* e) {
     (void)e;
-    Container* c = ContainerManager::instance().getActiveContainerMutable();
+    ContainerManager& cm = ContainerManager::instance();
+    Container* c = cm.getActiveContainerMutable();
     if (!c || c->groups.empty()) return;
     
     KeySlot k;
     k.name = "New Key";
     k.algorithmId = P25::ALGO_AES_256;
     k.keyId = 1;
-    k.sln = c->groups[current_group_idx].keys.size() + 1;
-    k.keyHex = KeyGen::generateAes256();
+    k.sln = c->nextFreeSln(c->groups[current_group_idx].keysetId);
+    k.setKeyHex(KeyGen::generateAes256());
     k.selected = true;
     
-    c->groups[current_group_idx].keys.push_back(k);
-    c->touch();
-    ContainerManager::instance().save();
+    cm.addKey(cm.getActiveIndex(), current_group_idx, k);
+    invalidate_keyload_plan();
     refresh_keys_list();
+    ui_vlist_scroll_to(keys_list, ui_vlist_get_count(keys_list) - 1);
 }
 
 static void on_save_container_name(lv_event_t* e) {
@@ -583,20 +650,73 @@ static void on_save_container_name(lv_event_t* e) {
 static void on_delete_container(lv_event_t* e) {
     (void)e;
     if (current_container_idx >= 0) {
+        invalidate_keyload_plan();
         ContainerManager::instance().deleteContainer(current_container_idx);
         current_container_idx = -1;
+        keys_list_container = -1;
         ui_show_containers();
     }
 }
 
+// Row children: 0 checkbox, 1 edit area (0 name, 1 info), 2 arrow
+static void create_key_row(lv_obj_t* item) {
+    style_panel(item);
+    
+    // Checkbox for selection
+    lv_obj_t* cb = lv_checkbox_create(item);
+    lv_checkbox_set_text(cb, "");
+    lv_obj_align(cb, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_event_cb(cb, on_key_checkbox, LV_EVENT_VALUE_CHANGED, NULL);
+    
+    // Clickable area for editing
+    lv_obj_t* click_area = lv_obj_create(item);
+    lv_obj_set_size(click_area, SCREEN_W - 80, 50);
+    lv_obj_align(click_area, LV_ALIGN_LEFT_MID, 30, 0);
+    lv_obj_clear_flag(click_area, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_style_bg_opa(click_area, LV_OPA_TRANSP, 0);
+    lv_obj_set_style_border_width(click_area, 0, 0);
+    lv_obj_add_flag(click_area, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(click_area, on_key_click, LV_EVENT_CLICKED, NULL);
+    
+    lv_obj_t* name = lv_label_create(click_area);
+    lv_obj_set_style_text_color(name, COLOR_TEXT, 0);
+    lv_obj_align(name, LV_ALIGN_TOP_LEFT, 0, 0);
+    
+    lv_obj_t* info = lv_label_create(click_area);
+    lv_obj_set_style_text_color(info, COLOR_TEXT_DIM, 0);
+    lv_obj_set_style_text_font(info, &lv_font_montserrat_10, 0);
+    lv_obj_align(info, LV_ALIGN_BOTTOM_LEFT, 0, 0);
+    
+    lv_obj_t* arrow = lv_label_create(item);
+    lv_label_set_text(arrow, LV_SYMBOL_RIGHT);
+    lv_obj_set_style_text_color(arrow, COLOR_ACCENT, 0);
+    lv_obj_align(arrow, LV_ALIGN_RIGHT_MID, -5, 0);
+}
+
+static void bind_key_row(lv_obj_t* item, uint32_t i) {
+    const Container* c = ContainerManager::instance().getActiveContainer();
+    if (!c || current_group_idx >= (int)c->groups.size() ||
+        i >= c->groups[current_group_idx].keys.size()) return;
+    const KeySlot& k = c->groups[current_group_idx].keys[i];
+    
+    lv_obj_t* cb = lv_obj_get_child(item, 0);
+    if (k.selected) lv_obj_add_state(cb, LV_STATE_CHECKED);
+    else lv_obj_clear_state(cb, LV_STATE_CHECKED);
+    
+    lv_obj_t* click_area = lv_obj_get_child(item, 1);
+    lv_label_set_text(lv_obj_get_child(click_area, 0), k.name.c_str());
+    char buf[64];
+    snprintf(buf, sizeof(buf), "SLN:%d KID:%d %s", k.sln, k.keyId, P25::getAlgorithmName(k.algorithmId));
+    lv_label_set_text(lv_obj_get_child(click_area, 1), buf);
+}
+
 static void build_container_detail_screen() {
-    if (scr_keys) lv_obj_del(scr_keys);
+    if (scr_keys) return;
     scr_keys = lv_obj_create(NULL);
     style_screen(scr_keys);
     
     create_header(scr_keys, "CONTAINER", goto_containers);
     
-    const Container* c = ContainerManager::instance().getActiveContainer();
     int y = HEADER_H + 8;
     
     // Container name input
@@ -610,7 +730,6 @@ static void build_container_detail_screen() {
     lv_obj_align(ta_container_name, LV_ALIGN_TOP_LEFT, 55, y - 2);
     lv_textarea_set_one_line(ta_container_name, true);
     style_textarea(ta_container_name);
-    if (c) lv_textarea_set_text(ta_container_name, c->name.c_str());
     lv_obj_add_event_cb(ta_container_name, on_save_container_name, LV_EVENT_DEFOCUSED, NULL);
     lv_obj_add_event_cb(ta_container_name, textarea_event_cb, LV_EVENT_ALL, NULL);
     
@@ -635,15 +754,10 @@ static void build_container_detail_screen() {
     y += 18;
     
     // Keys list
-    keys_list = lv_obj_create(scr_keys);
-    lv_obj_set_size(keys_list, SCREEN_W - 10, SCREEN_H - y - FOOTER_H - BTN_H * 2 - 25);
+    keys_list = create_list(scr_keys, SCREEN_H - y - FOOTER_H - BTN_H * 2 - 25, 54,
+                            create_key_row, bind_key_row);
     lv_obj_align(keys_list, LV_ALIGN_TOP_MID, 0, y);
-    lv_obj_set_style_bg_color(keys_list, COLOR_BG_DARK, 0);
-    lv_obj_set_style_border_width(keys_list, 0, 0);
-    lv_obj_set_style_pad_all(keys_list, 2, 0);
-    lv_obj_set_flex_flow(keys_list, LV_FLEX_FLOW_COLUMN);
-    
-    refresh_keys_list();
+    ui_vlist_set_empty_text(keys_list, "No keys. Tap + to add.");
     
     // Add key button
     lv_obj_t* btn_add = lv_btn_create(scr_keys);
@@ -668,65 +782,27 @@ static void build_container_detail_screen() {
     create_footer(scr_keys);
     
     // Create keyboard (must be last so it appears on top)
-    g_keyboard = nullptr;  // Reset so it gets recreated
-    create_global_keyboard(scr_keys);
+    create_screen_keyboard(scr_keys);
 }
 
-static void refresh_keys_list() {
-    lv_obj_clean(keys_list);
+static void refresh_container_detail_screen() {
+    const Container* c = ContainerManager::instance().getActiveContainer();
+    lv_textarea_set_text(ta_container_name, c ? c->name.c_str() : "");
     
+    refresh_keys_list();
+    if (keys_list_container != current_container_idx) {
+        keys_list_container = current_container_idx;
+        ui_vlist_scroll_to(keys_list, 0);
+    }
+}
+
+static void refresh_keys_list() {
     const Container* c = ContainerManager::instance().getActiveContainer();
-    if (!c || c->groups.empty()) {
-        lv_obj_t* lbl = lv_label_create(keys_list);
-        lv_label_set_text(lbl, "No keys. Tap + to add.");
-        lv_obj_set_style_text_color(lbl, COLOR_TEXT_DIM, 0);
+    if (!c || current_group_idx >= (int)c->groups.size()) {
+        ui_vlist_set_count(keys_list, 0);
         return;
     }
-    
-    const KeyGroup& g = c->groups[current_group_idx];
-    for (size_t i = 0; i < g.keys.size(); i++) {
-        const KeySlot& k = g.keys[i];
-        
-        lv_obj_t* item = lv_obj_create(keys_list);
-        lv_obj_set_size(item, SCREEN_W - 20, 54);
-        lv_obj_clear_flag(item, LV_OBJ_FLAG_SCROLLABLE);
-        style_panel(item);
-        
-        // Checkbox for selection
-        lv_obj_t* cb = lv_checkbox_create(item);
-        lv_checkbox_set_text(cb, "");
-        lv_obj_align(cb, LV_ALIGN_LEFT_MID, 0, 0);
-        if (k.selected) lv_obj_add_state(cb, LV_STATE_CHECKED);
-        lv_obj_add_event_cb(cb, on_key_checkbox, LV_EVENT_VALUE_CHANGED, (void*)(uintptr_t)i);
-        
-        // Clickable area for editing
-        lv_obj_t* click_area = lv_obj_create(item);
-        lv_obj_set_size(click_area, SCREEN_W - 80, 50);
-        lv_obj_align(click_area, LV_ALIGN_LEFT_MID, 30, 0);
-        lv_obj_set_style_bg_opa(click_area, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(click_area, 0, 0);
-        lv_obj_add_flag(click_area, LV_OBJ_FLAG_CLICKABLE);
-        lv_obj_add_event_cb(click_area, on_key_click, LV_EVENT_CLICKED, (void*)(uintptr_t)i);
-        
-        lv_obj_t* name = lv_label_create(click_area);
-        lv_label_set_text(name, k.name.c_str());
-        lv_obj_set_style_text_color(name, COLOR_TEXT, 0);
-        lv_obj_align(name, LV_ALIGN_TOP_LEFT, 0, 0);
-        
-        char buf[64];
-        const char* algoName = P25::getAlgorithmName(k.algorithmId);
-        snprintf(buf, sizeof(buf), "SLN:%d KID:%d %s", k.sln, k.keyId, algoName);
-        lv_obj_t* info = lv_label_create(click_area);
-        lv_label_set_text(info, buf);
-        lv_obj_set_style_text_color(info, COLOR_TEXT_DIM, 0);
-        lv_obj_set_style_text_font(info, &lv_font_montserrat_10, 0);
-        lv_obj_align(info, LV_ALIGN_BOTTOM_LEFT, 0, 0);
-        
-        lv_obj_t* arrow = lv_label_create(item);
-        lv_label_set_text(arrow, LV_SYMBOL_RIGHT);
-        lv_obj_set_style_text_color(arrow, COLOR_ACCENT, 0);
-        lv_obj_align(arrow, LV_ALIGN_RIGHT_MID, -5, 0);
-    }
+    ui_vlist_set_count(keys_list, c->groups[current_group_idx].keys.size());
 }
 
 // =============================================================================
@@ -743,19 +819,29 @@ static void save_key() {
     if (!c || current_group_idx >= (int)c->groups.size() || current_key_idx < 0 ||
         current_key_idx >= (int)c->groups[current_group_idx].keys.size()) return;
     
-    KeySlot& k = c->groups[current_group_idx].keys[current_key_idx];
+    KeySlot k = c->groups[current_group_idx].keys[current_key_idx];
+    if (!k.setKeyHex(lv_textarea_get_text(ta_key_value))) {
+        ui_set_status("Invalid key hex");
+        return;
+    }
     k.name = lv_textarea_get_text(ta_key_name);
     k.sln = atoi(lv_textarea_get_text(ta_key_sln));
     k.keyId = atoi(lv_textarea_get_text(ta_key_id));
-    k.keyHex = lv_textarea_get_text(ta_key_value);
     
     uint16_t sel = lv_dropdown_get_selected(dd_algo);
     static const uint8_t algos[] = {P25::ALGO_AES_256, P25::ALGO_DES_OFB, P25::ALGO_2_KEY_3DES, P25::ALGO_3_KEY_3DES};
     if (sel < 4) k.algorithmId = algos[sel];
     
-    c->touch();
-    ContainerManager::instance().save();
-    ui_set_status("Key saved");
+    ContainerManager& cm = ContainerManager::instance();
+    cm.updateKey(cm.getActiveIndex(), current_group_idx, current_key_idx, k);
+    invalidate_keyload_plan();
+    if (c->countKeys(c->groups[current_group_idx].keysetId, k.sln) > 1) {
+        char msg[48];
+        snprintf(msg, sizeof(msg), "Key saved - SLN %u used twice", (unsigned)k.sln);
+        ui_set_status(msg);
+    } else {
+        ui_set_status("Key saved");
+    }
 }
 
 static void on_generate_key(lv_event_t* e) {
@@ -773,38 +859,37 @@ static void on_generate_key(lv_event_t* e) {
     ui_set_status("Key generated");
 }
 
+// The screen is kept after navigating away - don't leave key material in it
+static void leave_key_edit() {
+    lv_textarea_set_text(ta_key_value, "");
+    ui_show_container_detail(current_container_idx);
+}
+
 static void on_delete_key(lv_event_t* e) {
     (void)e;
     Container* c = ContainerManager::instance().getActiveContainerMutable();
     if (!c || current_group_idx >= (int)c->groups.size() || current_key_idx < 0 ||
         current_key_idx >= (int)c->groups[current_group_idx].keys.size()) return;
     
-    c->groups[current_group_idx].keys.erase(c->groups[current_group_idx].keys.begin() + current_key_idx);
-    c->touch();
-    ContainerManager::instance().save();
-    ui_show_container_detail(current_container_idx);
+    ContainerManager& cm = ContainerManager::instance();
+    cm.deleteKey(cm.getActiveIndex(), current_group_idx, current_key_idx);
+    invalidate_keyload_plan();
+    leave_key_edit();
 }
 
 static void build_key_edit_screen() {
-    if (scr_key_edit) lv_obj_del(scr_key_edit);
+    if (scr_key_edit) return;
     scr_key_edit = lv_obj_create(NULL);
     style_screen(scr_key_edit);
     
     create_header(scr_key_edit, "EDIT KEY", [](lv_event_t* e) {
-        (void)e; save_key(); ui_show_container_detail(current_container_idx);
+        (void)e; save_key(); leave_key_edit();
     });
     
-    const Container* c = ContainerManager::instance().getActiveContainer();
-    if (!c || current_group_idx >= (int)c->groups.size() || current_key_idx < 0 ||
-        current_key_idx >= (int)c->groups[current_group_idx].keys.size()) return;
-    
-    const KeySlot& k = c->groups[current_group_idx].keys[current_key_idx];
-    
     int y = HEADER_H + 10;
     
     // Name
     ta_key_name = create_labeled_input(scr_key_edit, "Key Name:", y);
-    lv_textarea_set_text(ta_key_name, k.name.c_str());
     y += 55;
     
     // SLN
@@ -821,8 +906,6 @@ static void build_key_edit_screen() {
     lv_textarea_set_accepted_chars(ta_key_sln, "0123456789");
     style_textarea(ta_key_sln);
     lv_obj_add_event_cb(ta_key_sln, textarea_event_cb, LV_EVENT_ALL, NULL);
-    char buf[16]; snprintf(buf, sizeof(buf), "%d", k.sln);
-    lv_textarea_set_text(ta_key_sln, buf);
     
     // Key ID
     lv_obj_t* l2 = lv_label_create(scr_key_edit);
@@ -838,8 +921,6 @@ static void build_key_edit_screen() {
     lv_textarea_set_accepted_chars(ta_key_id, "0123456789");
     style_textarea(ta_key_id);
     lv_obj_add_event_cb(ta_key_id, textarea_event_cb, LV_EVENT_ALL, NULL);
-    snprintf(buf, sizeof(buf), "%d", k.keyId);
-    lv_textarea_set_text(ta_key_id, buf);
     
     y += 60;
     
@@ -858,12 +939,6 @@ static void build_key_edit_screen() {
     lv_obj_set_style_border_color(dd_algo, COLOR_BORDER, 0);
     lv_obj_set_style_text_color(dd_algo, COLOR_TEXT, 0);
     
-    int algoIdx = 0;
-    if (k.algorithmId == P25::ALGO_DES_OFB) algoIdx = 1;
-    else if (k.algorithmId == P25::ALGO_2_KEY_3DES) algoIdx = 2;
-    else if (k.algorithmId == P25::ALGO_3_KEY_3DES) algoIdx = 3;
-    lv_dropdown_set_selected(dd_algo, algoIdx);
-    
     y += 60;
     
     // Key value
@@ -880,7 +955,6 @@ static void build_key_edit_screen() {
     lv_textarea_set_accepted_chars(ta_key_value, "0123456789ABCDEFabcdef");
     style_textarea(ta_key_value);
     lv_obj_add_event_cb(ta_key_value, textarea_event_cb, LV_EVENT_ALL, NULL);
-    lv_textarea_set_text(ta_key_value, k.keyHex.c_str());
     
     y += 95;
     
@@ -919,40 +993,137 @@ static void build_key_edit_screen() {
     create_footer(scr_key_edit);
     
     // Create keyboard (must be last so it appears on top)
-    g_keyboard = nullptr;  // Reset so it gets recreated
-    create_global_keyboard(scr_key_edit);
+    create_screen_keyboard(scr_key_edit);
+}
+
+static void refresh_key_edit_screen() {
+    const Container* c = ContainerManager::instance().getActiveContainer();
+    if (!c || current_group_idx >= (int)c->groups.size() || current_key_idx < 0 ||
+        current_key_idx >= (int)c->groups[current_group_idx].keys.size()) {
+        lv_textarea_set_text(ta_key_name, "");
+        lv_textarea_set_text(ta_key_sln, "");
+        lv_textarea_set_text(ta_key_id, "");
+        lv_textarea_set_text(ta_key_value, "");
+        return;
+    }
+    
+    const KeySlot& k = c->groups[current_group_idx].keys[current_key_idx];
+    lv_textarea_set_text(ta_key_name, k.name.c_str());
+    
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%d", k.sln);
+    lv_textarea_set_text(ta_key_sln, buf);
+    snprintf(buf, sizeof(buf), "%d", k.keyId);
+    lv_textarea_set_text(ta_key_id, buf);
+    
+    int algoIdx = 0;
+    if (k.algorithmId == P25::ALGO_DES_OFB) algoIdx = 1;
+    else if (k.algorithmId == P25::ALGO_2_KEY_3DES) algoIdx = 2;
+    else if (k.algorithmId == P25::ALGO_3_KEY_3DES) algoIdx = 3;
+    lv_dropdown_set_selected(dd_algo, algoIdx);
+    
+    std::string hex = k.keyHex();
+    lv_textarea_set_text(ta_key_value, hex.c_str());
+    Crypto::secureZero(&hex[0], hex.size());
 }
 
 // =============================================================================
 // Keyload Screen
 // =============================================================================
 static lv_obj_t* keyload_list = nullptr;
+static lv_obj_t* keyload_container_label = nullptr;
+static lv_obj_t* keyload_ports_label = nullptr;     // Per-port lines (gang-fill only)
+static uint32_t keyload_fleet_gen = 0;
+static bool keyload_fleet_running = false;
 
 static void refresh_keyload_list();
 static void do_keyload_selected();
+static void do_keyload_sync();
 static void do_keyload_single(int idx);
 
+// Row children: 0 checkbox, 1 name, 2 SLN, 3 load button
+static void create_keyload_row(lv_obj_t* item) {
+    style_panel(item);
+    
+    // Checkbox
+    lv_obj_t* cb = lv_checkbox_create(item);
+    lv_checkbox_set_text(cb, "");
+    lv_obj_align(cb, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_event_cb(cb, [](lv_event_t* e) {
+        int32_t idx = ui_vlist_row_index(keyload_list, lv_event_get_target(e));
+        if (idx < 0) return;
+        ContainerManager& cm = ContainerManager::instance();
+        if (cm.setKeySelected(cm.getActiveIndex(), 0, idx,
+                              lv_obj_has_state(lv_event_get_target(e), LV_STATE_CHECKED))) {
+            invalidate_keyload_plan();
+        }
+    }, LV_EVENT_VALUE_CHANGED, NULL);
+    
+    // Info
+    lv_obj_t* name = lv_label_create(item);
+    lv_obj_set_style_text_color(name, COLOR_TEXT, 0);
+    lv_obj_align(name, LV_ALIGN_LEFT_MID, 35, -8);
+    
+    lv_obj_t* info = lv_label_create(item);
+    lv_obj_set_style_text_color(info, COLOR_TEXT_DIM, 0);
+    lv_obj_set_style_text_font(info, &lv_font_montserrat_10, 0);
+    lv_obj_align(info, LV_ALIGN_LEFT_MID, 35, 8);
+    
+    // Single load button
+    lv_obj_t* btn = lv_btn_create(item);
+    lv_obj_set_size(btn, 50, 32);
+    lv_obj_align(btn, LV_ALIGN_RIGHT_MID, -2, 0);
+    style_btn(btn);
+    lv_obj_add_event_cb(btn, [](lv_event_t* e) {
+        int32_t idx = ui_vlist_row_index(keyload_list, lv_event_get_current_target(e));
+        if (idx >= 0) do_keyload_single(idx);
+    }, LV_EVENT_CLICKED, NULL);
+    lv_obj_t* bl = lv_label_create(btn);
+    lv_label_set_text(bl, "LOAD");
+    lv_obj_set_style_text_font(bl, &lv_font_montserrat_10, 0);
+    lv_obj_center(bl);
+}
+
+static void bind_keyload_row(lv_obj_t* item, uint32_t i) {
+    const Container* c = ContainerManager::instance().getActiveContainer();
+    if (!c || c->groups.empty() || i >= c->groups[0].keys.size()) return;
+    const KeySlot& k = c->groups[0].keys[i];
+    
+    lv_obj_t* cb = lv_obj_get_child(item, 0);
+    if (k.selected) lv_obj_add_state(cb, LV_STATE_CHECKED);
+    else lv_obj_clear_state(cb, LV_STATE_CHECKED);
+    
+    lv_label_set_text(lv_obj_get_child(item, 1), k.name.c_str());
+    char buf[32];
+    snprintf(buf, sizeof(buf), "SLN:%d", k.sln);
+    lv_label_set_text(lv_obj_get_child(item, 2), buf);
+}
+
+// The load button loads the checked keys - into every port on a gang-fill fixture
+static void set_keyload_btn_idle() {
+    uint8_t ports = FleetLoader::instance().portCount();
+    if (ports > 1) {
+        char buf[40];
+        snprintf(buf, sizeof(buf), LV_SYMBOL_UPLOAD " LOAD SELECTED (%u PORTS)", ports);
+        lv_label_set_text(keyload_btn_label, buf);
+    } else {
+        lv_label_set_text(keyload_btn_label, LV_SYMBOL_UPLOAD " LOAD SELECTED");
+    }
+}
+
 static void build_keyload_screen() {
-    if (scr_keyload) lv_obj_del(scr_keyload);
+    if (scr_keyload) return;
     scr_keyload = lv_obj_create(NULL);
     style_screen(scr_keyload);
     
     create_header(scr_keyload, "KEYLOAD", goto_main_menu);
     
-    const Container* c = ContainerManager::instance().getActiveContainer();
     int y = HEADER_H + 5;
     
     // Container info
-    lv_obj_t* lbl = lv_label_create(scr_keyload);
-    if (c) {
-        char buf[64];
-        snprintf(buf, sizeof(buf), "Container: %s", c->name.c_str());
-        lv_label_set_text(lbl, buf);
-    } else {
-        lv_label_set_text(lbl, "No container selected");
-    }
-    lv_obj_set_style_text_color(lbl, COLOR_TEXT, 0);
-    lv_obj_align(lbl, LV_ALIGN_TOP_LEFT, 10, y);
+    keyload_container_label = lv_label_create(scr_keyload);
+    lv_obj_set_style_text_color(keyload_container_label, COLOR_TEXT, 0);
+    lv_obj_align(keyload_container_label, LV_ALIGN_TOP_LEFT, 10, y);
     y += 22;
     
     // Status panel
@@ -962,8 +1133,6 @@ static void build_keyload_screen() {
     style_panel(status_panel);
     
     keyload_status_label = lv_label_create(status_panel);
-    lv_label_set_text(keyload_status_label, "Select keys and tap LOAD.\nOr tap a single key to load it.");
-    lv_obj_set_style_text_color(keyload_status_label, COLOR_TEXT, 0);
     lv_label_set_long_mode(keyload_status_label, LV_LABEL_LONG_WRAP);
     lv_obj_set_width(keyload_status_label, SCREEN_W - 40);
     lv_obj_align(keyload_status_label, LV_ALIGN_TOP_LEFT, 5, 0);
@@ -971,22 +1140,28 @@ static void build_keyload_screen() {
     keyload_progress = lv_bar_create(status_panel);
     lv_obj_set_size(keyload_progress, SCREEN_W - 40, 14);
     lv_obj_align(keyload_progress, LV_ALIGN_BOTTOM_MID, 0, -2);
-    lv_bar_set_value(keyload_progress, 0, LV_ANIM_OFF);
     lv_obj_set_style_bg_color(keyload_progress, COLOR_BG_INPUT, LV_PART_MAIN);
     lv_obj_set_style_bg_color(keyload_progress, COLOR_SUCCESS, LV_PART_INDICATOR);
     
     y += 80;
     
+    // One status line per fixture port; LOAD SELECTED fills every port at once
+    uint8_t ports = FleetLoader::instance().portCount();
+    if (ports > 1) {
+        keyload_ports_label = lv_label_create(scr_keyload);
+        lv_obj_set_width(keyload_ports_label, SCREEN_W - 20);
+        lv_label_set_long_mode(keyload_ports_label, LV_LABEL_LONG_DOT);
+        lv_obj_set_style_text_font(keyload_ports_label, &lv_font_montserrat_12, 0);
+        lv_obj_set_style_text_color(keyload_ports_label, COLOR_TEXT_DIM, 0);
+        lv_obj_align(keyload_ports_label, LV_ALIGN_TOP_LEFT, 10, y);
+        y += ports * 16 + 4;
+    }
+    
     // Keys list with load buttons
-    keyload_list = lv_obj_create(scr_keyload);
-    lv_obj_set_size(keyload_list, SCREEN_W - 10, SCREEN_H - y - FOOTER_H - BTN_H - 15);
+    keyload_list = create_list(scr_keyload, SCREEN_H - y - FOOTER_H - BTN_H - 15, 48,
+                               create_keyload_row, bind_keyload_row);
     lv_obj_align(keyload_list, LV_ALIGN_TOP_MID, 0, y);
-    lv_obj_set_style_bg_color(keyload_list, COLOR_BG_DARK, 0);
-    lv_obj_set_style_border_width(keyload_list, 0, 0);
-    lv_obj_set_style_pad_all(keyload_list, 2, 0);
-    lv_obj_set_flex_flow(keyload_list, LV_FLEX_FLOW_COLUMN);
-    
-    refresh_keyload_list();
+    ui_vlist_set_empty_text(keyload_list, "No keys available.\nCreate keys in Containers.");
     
     // Test buttons (for debugging)
     lv_obj_t* btn_test = lv_btn_create(scr_keyload);
@@ -995,11 +1170,11 @@ static void build_keyload_screen() {
     lv_obj_set_style_bg_color(btn_test, lv_color_hex(0x555555), 0);
     lv_obj_add_event_cb(btn_test, [](lv_event_t* e) { 
         (void)e; 
-        KFDProtocol& kfd = getKfdProtocol();
-        lv_label_set_text(keyload_status_label, "Testing inventory...");
-        lv_refr_now(NULL);
-        auto result = kfd.testInventory();
-        lv_label_set_text(keyload_status_label, result.message.c_str());
+        if (getKfdProtocol().submit(KFDProtocol::ASYNC_TEST_INVENTORY)) {
+            lv_label_set_text(keyload_status_label, "Testing inventory...");
+        } else {
+            lv_label_set_text(keyload_status_label, "Operation in progress");
+        }
     }, LV_EVENT_CLICKED, NULL);
     lv_obj_t* lt = lv_label_create(btn_test);
     lv_label_set_text(lt, "TEST INV");
@@ -1012,11 +1187,11 @@ static void build_keyload_screen() {
     lv_obj_set_style_bg_color(btn_test_des, lv_color_hex(0x555555), 0);
     lv_obj_add_event_cb(btn_test_des, [](lv_event_t* e) { 
         (void)e; 
-        KFDProtocol& kfd = getKfdProtocol();
-        lv_label_set_text(keyload_status_label, "Testing SLN 202...");
-        lv_refr_now(NULL);
-        auto result = kfd.testDESKey();
-        lv_label_set_text(keyload_status_label, result.message.c_str());
+        if (getKfdProtocol().submit(KFDProtocol::ASYNC_TEST_DES_KEY)) {
+            lv_label_set_text(keyload_status_label, "Testing SLN 202...");
+        } else {
+            lv_label_set_text(keyload_status_label, "Operation in progress");
+        }
     }, LV_EVENT_CLICKED, NULL);
     lv_obj_t* ltd = lv_label_create(btn_test_des);
     lv_label_set_text(ltd, "TEST 202");
@@ -1024,78 +1199,54 @@ static void build_keyload_screen() {
     
     // Load selected button
     lv_obj_t* btn_load = lv_btn_create(scr_keyload);
-    lv_obj_set_size(btn_load, SCREEN_W - 16, BTN_H);
-    lv_obj_align(btn_load, LV_ALIGN_BOTTOM_MID, 0, -FOOTER_H - 5);
+    lv_obj_set_size(btn_load, (SCREEN_W - 24) / 2, BTN_H);
+    lv_obj_align(btn_load, LV_ALIGN_BOTTOM_LEFT, 8, -FOOTER_H - 5);
     style_btn_accent(btn_load);
     lv_obj_add_event_cb(btn_load, [](lv_event_t* e) { (void)e; do_keyload_selected(); }, LV_EVENT_CLICKED, NULL);
-    lv_obj_t* ll = lv_label_create(btn_load);
-    lv_label_set_text(ll, LV_SYMBOL_UPLOAD " LOAD SELECTED KEYS");
-    lv_obj_center(ll);
+    // Doubles as the abort button while an operation runs
+    keyload_btn_label = lv_label_create(btn_load);
+    lv_obj_center(keyload_btn_label);
+    
+    // Sync button - sends only what the radio is missing
+    lv_obj_t* btn_sync = lv_btn_create(scr_keyload);
+    lv_obj_set_size(btn_sync, (SCREEN_W - 24) / 2, BTN_H);
+    lv_obj_align(btn_sync, LV_ALIGN_BOTTOM_RIGHT, -8, -FOOTER_H - 5);
+    style_btn(btn_sync);
+    lv_obj_add_event_cb(btn_sync, [](lv_event_t* e) { (void)e; do_keyload_sync(); }, LV_EVENT_CLICKED, NULL);
+    lv_obj_t* ls = lv_label_create(btn_sync);
+    lv_label_set_text(ls, LV_SYMBOL_REFRESH " SYNC");
+    lv_obj_center(ls);
     
     create_footer(scr_keyload);
 }
 
-static void refresh_keyload_list() {
-    lv_obj_clean(keyload_list);
-    
+static void refresh_keyload_screen() {
     const Container* c = ContainerManager::instance().getActiveContainer();
-    if (!c || c->groups.empty()) {
-        lv_obj_t* lbl = lv_label_create(keyload_list);
-        lv_label_set_text(lbl, "No keys available.\nCreate keys in Containers.");
-        lv_obj_set_style_text_color(lbl, COLOR_TEXT_DIM, 0);
-        return;
+    if (c) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "Container: %s", c->name.c_str());
+        lv_label_set_text(keyload_container_label, buf);
+    } else {
+        lv_label_set_text(keyload_container_label, "No container selected");
     }
     
-    const KeyGroup& g = c->groups[0];
-    for (size_t i = 0; i < g.keys.size(); i++) {
-        const KeySlot& k = g.keys[i];
-        
-        lv_obj_t* item = lv_obj_create(keyload_list);
-        lv_obj_set_size(item, SCREEN_W - 20, 48);
-        lv_obj_clear_flag(item, LV_OBJ_FLAG_SCROLLABLE);
-        style_panel(item);
-        
-        // Checkbox
-        lv_obj_t* cb = lv_checkbox_create(item);
-        lv_checkbox_set_text(cb, "");
-        lv_obj_align(cb, LV_ALIGN_LEFT_MID, 0, 0);
-        if (k.selected) lv_obj_add_state(cb, LV_STATE_CHECKED);
-        lv_obj_add_event_cb(cb, [](lv_event_t* e) {
-            int idx = (int)(uintptr_t)lv_event_get_user_data(e);
-            Container* c = ContainerManager::instance().getActiveContainerMutable();
-            if (c && !c->groups.empty() && idx < (int)c->groups[0].keys.size()) {
-                c->groups[0].keys[idx].selected = lv_obj_has_state(lv_event_get_target(e), LV_STATE_CHECKED);
-            }
-        }, LV_EVENT_VALUE_CHANGED, (void*)(uintptr_t)i);
-        
-        // Info
-        lv_obj_t* name = lv_label_create(item);
-        lv_label_set_text(name, k.name.c_str());
-        lv_obj_set_style_text_color(name, COLOR_TEXT, 0);
-        lv_obj_align(name, LV_ALIGN_LEFT_MID, 35, -8);
-        
-        char buf[32];
-        snprintf(buf, sizeof(buf), "SLN:%d", k.sln);
-        lv_obj_t* info = lv_label_create(item);
-        lv_label_set_text(info, buf);
-        lv_obj_set_style_text_color(info, COLOR_TEXT_DIM, 0);
-        lv_obj_set_style_text_font(info, &lv_font_montserrat_10, 0);
-        lv_obj_align(info, LV_ALIGN_LEFT_MID, 35, 8);
-        
-        // Single load button
-        lv_obj_t* btn = lv_btn_create(item);
-        lv_obj_set_size(btn, 50, 32);
-        lv_obj_align(btn, LV_ALIGN_RIGHT_MID, -2, 0);
-        style_btn(btn);
-        lv_obj_add_event_cb(btn, [](lv_event_t* e) {
-            int idx = (int)(uintptr_t)lv_event_get_user_data(e);
-            do_keyload_single(idx);
-        }, LV_EVENT_CLICKED, (void*)(uintptr_t)i);
-        lv_obj_t* bl = lv_label_create(btn);
-        lv_label_set_text(bl, "LOAD");
-        lv_obj_set_style_text_font(bl, &lv_font_montserrat_10, 0);
-        lv_obj_center(bl);
+    // A running operation keeps its progress; kfd_event_timer_cb updates it
+    bool busy = getKfdProtocol().isBusy() || FleetLoader::instance().isRunning();
+    if (!busy) {
+        lv_label_set_text(keyload_status_label, "Select keys and tap LOAD.\nOr tap a single key to load it.");
+        lv_obj_set_style_text_color(keyload_status_label, COLOR_TEXT, 0);
+        lv_bar_set_value(keyload_progress, 0, LV_ANIM_OFF);
     }
+    if (busy) lv_label_set_text(keyload_btn_label, LV_SYMBOL_STOP " ABORT");
+    else set_keyload_btn_idle();
+    if (keyload_ports_label) keyload_fleet_gen = FleetLoader::instance().generation() - 1;  // Redraw
+    
+    refresh_keyload_list();
+}
+
+static void refresh_keyload_list() {
+    const Container* c = ContainerManager::instance().getActiveContainer();
+    ui_vlist_set_count(keyload_list, (c && !c->groups.empty()) ? c->groups[0].keys.size() : 0);
 }
 
 static void do_keyload_single(int idx) {
@@ -1104,75 +1255,371 @@ static void do_keyload_single(int idx) {
     
     const KeySlot& k = c->groups[0].keys[idx];
     
+    if (FleetLoader::instance().isRunning()) {
+        lv_label_set_text(keyload_status_label, "Operation in progress");
+        lv_obj_set_style_text_color(keyload_status_label, COLOR_ERROR, 0);
+        return;
+    }
+    
+    P25::KeyItem item = k.toKeyItem(c->groups[0].keysetId);
+    bool queued = getKfdProtocol().submitKeyload(item);
+    if (!item.key.empty()) Crypto::secureZero(item.key.data(), item.key.size());
+    
+    if (!queued) {
+        lv_label_set_text(keyload_status_label, "Operation in progress");
+        lv_obj_set_style_text_color(keyload_status_label, COLOR_ERROR, 0);
+        return;
+    }
+    
     lv_label_set_text(keyload_status_label, "Loading key...");
     lv_obj_set_style_text_color(keyload_status_label, COLOR_WARNING, 0);
     lv_bar_set_value(keyload_progress, 50, LV_ANIM_ON);
-    lv_refr_now(NULL);
+    lv_label_set_text(keyload_btn_label, LV_SYMBOL_STOP " ABORT");
+}
+
+static void do_keyload_selected() {
+    KFDProtocol& kfd = getKfdProtocol();
+    FleetLoader& fleet = FleetLoader::instance();
+    
+    // Second tap while loading aborts
+    if (fleet.isRunning()) {
+        fleet.abort();
+        lv_label_set_text(keyload_status_label, "Aborting...");
+        lv_obj_set_style_text_color(keyload_status_label, COLOR_WARNING, 0);
+        return;
+    }
+    if (kfd.isBusy()) {
+        kfd.abort();
+        lv_label_set_text(keyload_status_label, "Aborting...");
+        lv_obj_set_style_text_color(keyload_status_label, COLOR_WARNING, 0);
+        return;
+    }
     
-    P25::KeyItem item = k.toKeyItem(c->groups[0].keysetId);
-    auto result = getKfdProtocol().keyload(item);
+    ContainerManager& cm = ContainerManager::instance();
+    const Container* c = cm.getActiveContainer();
+    if (!c) return;
     
-    if (result.success) {
-        lv_label_set_text(keyload_status_label, "Key loaded successfully!");
-        lv_obj_set_style_text_color(keyload_status_label, COLOR_SUCCESS, 0);
-        lv_bar_set_value(keyload_progress, 100, LV_ANIM_ON);
-        DeviceManager::instance().recordKeyload();
-    } else {
-        char buf[128];
-        snprintf(buf, sizeof(buf), "Failed: %s", result.message.c_str());
-        lv_label_set_text(keyload_status_label, buf);
+    if (keyload_plan.empty() || keyload_plan_idx != cm.getActiveIndex() ||
+        keyload_plan_gen != cm.getGeneration()) {
+        auto keys = c->getSelectedKeyItems();
+        if (keys.empty()) {
+            lv_label_set_text(keyload_status_label, "No keys selected!");
+            lv_obj_set_style_text_color(keyload_status_label, COLOR_ERROR, 0);
+            return;
+        }
+        
+        bool built = kfd.compilePlan(keys, keyload_plan);
+        for (auto& k : keys) {
+            if (!k.key.empty()) Crypto::secureZero(k.key.data(), k.key.size());
+        }
+        if (!built) {
+            invalidate_keyload_plan();
+            lv_label_set_text(keyload_status_label, "Failed to build keyload!");
+            lv_obj_set_style_text_color(keyload_status_label, COLOR_ERROR, 0);
+            return;
+        }
+        keyload_plan_idx = cm.getActiveIndex();
+        keyload_plan_gen = cm.getGeneration();
+    }
+    
+    bool queued = fleet.portCount() > 1 ? fleet.start(keyload_plan) : kfd.submitKeyloadPlan(keyload_plan);
+    if (!queued) {
+        lv_label_set_text(keyload_status_label, "Operation in progress");
         lv_obj_set_style_text_color(keyload_status_label, COLOR_ERROR, 0);
-        lv_bar_set_value(keyload_progress, 0, LV_ANIM_ON);
+        return;
     }
+    
+    lv_label_set_text(keyload_status_label, "Starting keyload...");
+    lv_obj_set_style_text_color(keyload_status_label, COLOR_WARNING, 0);
+    lv_bar_set_value(keyload_progress, 0, LV_ANIM_OFF);
+    lv_label_set_text(keyload_btn_label, LV_SYMBOL_STOP " ABORT");
 }
 
-static void do_keyload_selected() {
+static void do_keyload_sync() {
+    KFDProtocol& kfd = getKfdProtocol();
+    
+    if (FleetLoader::instance().isRunning()) {
+        lv_label_set_text(keyload_status_label, "Operation in progress");
+        lv_obj_set_style_text_color(keyload_status_label, COLOR_ERROR, 0);
+        return;
+    }
+    if (kfd.isBusy()) {
+        kfd.abort();
+        lv_label_set_text(keyload_status_label, "Aborting...");
+        lv_obj_set_style_text_color(keyload_status_label, COLOR_WARNING, 0);
+        return;
+    }
+    
     const Container* c = ContainerManager::instance().getActiveContainer();
     if (!c) return;
     
-    auto selected = c->getSelectedKeys();
-    if (selected.empty()) {
+    auto keys = c->getSelectedKeyItems();
+    if (keys.empty()) {
         lv_label_set_text(keyload_status_label, "No keys selected!");
         lv_obj_set_style_text_color(keyload_status_label, COLOR_ERROR, 0);
         return;
     }
     
-    std::vector<P25::KeyItem> keys;
-    uint8_t keysetId = c->groups.empty() ? 1 : c->groups[0].keysetId;
-    for (const auto& ks : selected) {
-        keys.push_back(ks.toKeyItem(keysetId));
+    bool queued = kfd.submitSync(keys);
+    for (auto& k : keys) {
+        if (!k.key.empty()) Crypto::secureZero(k.key.data(), k.key.size());
     }
     
-    lv_label_set_text(keyload_status_label, "Starting keyload...");
+    if (!queued) {
+        lv_label_set_text(keyload_status_label, "Operation in progress");
+        lv_obj_set_style_text_color(keyload_status_label, COLOR_ERROR, 0);
+        return;
+    }
+    
+    lv_label_set_text(keyload_status_label, "Starting sync...");
     lv_obj_set_style_text_color(keyload_status_label, COLOR_WARNING, 0);
     lv_bar_set_value(keyload_progress, 0, LV_ANIM_OFF);
-    lv_refr_now(NULL);
+    lv_label_set_text(keyload_btn_label, LV_SYMBOL_STOP " ABORT");
+}
+
+// =============================================================================
+// Radio Inventory Screen
+// =============================================================================
+static lv_obj_t* inventory_list = nullptr;
+static lv_obj_t* inventory_status_label = nullptr;
+static std::vector<P25::KeyStatus> inventory_keys;   // Rows received so far
+
+static void create_inventory_row(lv_obj_t* item) {
+    style_panel(item);
+    lv_obj_set_style_pad_all(item, 4, 0);
     
-    auto result = getKfdProtocol().keyloadMultiple(keys, [](int cur, int tot, const char* status) {
-        int pct = (tot > 0) ? (cur * 100 / tot) : 0;
-        lv_bar_set_value(keyload_progress, pct, LV_ANIM_ON);
-        lv_label_set_text(keyload_status_label, status);
-        lv_refr_now(NULL);
-    });
+    lv_obj_t* lbl = lv_label_create(item);
+    lv_obj_set_style_text_color(lbl, COLOR_TEXT, 0);
+    lv_obj_set_style_text_font(lbl, &lv_font_montserrat_12, 0);
+    lv_obj_align(lbl, LV_ALIGN_LEFT_MID, 0, 0);
+}
+
+static void bind_inventory_row(lv_obj_t* item, uint32_t i) {
+    if (i >= inventory_keys.size()) return;
+    const P25::KeyStatus& ks = inventory_keys[i];
+    char buf[64];
+    snprintf(buf, sizeof(buf), "KSET:%u SLN:%u KID:%u %s",
+             ks.keysetId, ks.sln, ks.keyId, P25::getAlgorithmName(ks.algorithmId));
+    lv_label_set_text(lv_obj_get_child(item, 0), buf);
+}
+
+// Fetch the rows that arrived since the last call
+static void refresh_inventory_rows() {
+    if (!inventory_list) return;
+    
+    size_t total = getKfdProtocol().getAsyncKeys(inventory_keys, inventory_keys.size());
+    if (total < inventory_keys.size()) {
+        // A new read started elsewhere - start over
+        inventory_keys.clear();
+        getKfdProtocol().getAsyncKeys(inventory_keys, 0);
+    }
+    ui_vlist_set_count(inventory_list, inventory_keys.size());
+}
+
+static void on_inventory_event(const KFDProtocol::AsyncEvent& ev) {
+    refresh_inventory_rows();
+    if (!inventory_status_label) return;
     
-    if (result.success) {
-        lv_label_set_text(keyload_status_label, "All keys loaded!");
-        lv_obj_set_style_text_color(keyload_status_label, COLOR_SUCCESS, 0);
-        lv_bar_set_value(keyload_progress, 100, LV_ANIM_ON);
-        DeviceManager::instance().recordKeyload();
+    if (ev.kind == KFDProtocol::AsyncEvent::PROGRESS) {
+        lv_label_set_text(inventory_status_label, ev.status);
+        return;
+    }
+    
+    if (ev.success) {
+        lv_label_set_text(inventory_status_label, ev.status);
+        lv_obj_set_style_text_color(inventory_status_label, COLOR_SUCCESS, 0);
     } else {
-        char buf[128];
-        snprintf(buf, sizeof(buf), "Failed: %s", result.message.c_str());
+        char buf[96];
+        snprintf(buf, sizeof(buf), "Failed: %s", ev.status);
+        lv_label_set_text(inventory_status_label, buf);
+        lv_obj_set_style_text_color(inventory_status_label, COLOR_ERROR, 0);
+    }
+}
+
+static void on_read_inventory(lv_event_t* e) {
+    (void)e;
+    KFDProtocol& kfd = getKfdProtocol();
+    if (kfd.isBusy()) {
+        kfd.abort();
+        lv_label_set_text(inventory_status_label, "Aborting...");
+        return;
+    }
+    if (!kfd.submit(KFDProtocol::ASYNC_VIEW_KEYS)) {
+        lv_label_set_text(inventory_status_label, "Operation in progress");
+        lv_obj_set_style_text_color(inventory_status_label, COLOR_ERROR, 0);
+        return;
+    }
+    
+    inventory_keys.clear();
+    ui_vlist_set_count(inventory_list, 0);
+    lv_label_set_text(inventory_status_label, "Reading key inventory...");
+    lv_obj_set_style_text_color(inventory_status_label, COLOR_WARNING, 0);
+}
+
+static void build_inventory_screen() {
+    if (scr_inventory) return;
+    scr_inventory = lv_obj_create(NULL);
+    style_screen(scr_inventory);
+    
+    create_header(scr_inventory, "RADIO KEYS", goto_main_menu);
+    
+    int y = HEADER_H + 8;
+    
+    lv_obj_t* status_panel = lv_obj_create(scr_inventory);
+    lv_obj_set_size(status_panel, SCREEN_W - 16, 40);
+    lv_obj_align(status_panel, LV_ALIGN_TOP_MID, 0, y);
+    lv_obj_clear_flag(status_panel, LV_OBJ_FLAG_SCROLLABLE);
+    style_panel(status_panel);
+    
+    inventory_status_label = lv_label_create(status_panel);
+    lv_label_set_text(inventory_status_label, "Tap READ to list keys in the radio.");
+    lv_obj_set_style_text_color(inventory_status_label, COLOR_TEXT, 0);
+    lv_obj_align(inventory_status_label, LV_ALIGN_LEFT_MID, 0, 0);
+    
+    y += 48;
+    
+    inventory_list = create_list(scr_inventory, SCREEN_H - y - FOOTER_H - BTN_H - 15, 36,
+                                 create_inventory_row, bind_inventory_row);
+    lv_obj_align(inventory_list, LV_ALIGN_TOP_MID, 0, y);
+    
+    lv_obj_t* btn = lv_btn_create(scr_inventory);
+    lv_obj_set_size(btn, SCREEN_W - 16, BTN_H);
+    lv_obj_align(btn, LV_ALIGN_BOTTOM_MID, 0, -FOOTER_H - 5);
+    style_btn_accent(btn);
+    lv_obj_add_event_cb(btn, on_read_inventory, LV_EVENT_CLICKED, NULL);
+    lv_obj_t* bl = lv_label_create(btn);
+    lv_label_set_text(bl, LV_SYMBOL_DOWNLOAD " READ INVENTORY");
+    lv_obj_center(bl);
+    
+    create_footer(scr_inventory);
+}
+
+// Redraws the per-port lines and the combined bar when any port moved
+static void poll_fleet_status() {
+    FleetLoader& fleet = FleetLoader::instance();
+    uint32_t gen = fleet.generation();
+    if (gen == keyload_fleet_gen) return;
+    keyload_fleet_gen = gen;
+    
+    bool running = fleet.isRunning();
+    bool finished = keyload_fleet_running && !running;
+    keyload_fleet_running = running;
+    
+    static const char* const STATE_TAGS[] = { "--", "..", "OK", "!!" };
+    char lines[FleetLoader::MAX_PORTS * 72];
+    size_t len = 0;
+    uint32_t current = 0, total = 0;
+    uint8_t done = 0, failed = 0;
+    
+    for (uint8_t i = 0; i < fleet.portCount(); i++) {
+        FleetLoader::PortStatus st = fleet.status(i);
+        if (st.state != FleetLoader::PORT_IDLE) {
+            current += st.current;
+            total += st.total;
+        }
+        if (st.state == FleetLoader::PORT_DONE) done++;
+        if (st.state == FleetLoader::PORT_FAILED && st.total) failed++;
+        if (finished && st.state == FleetLoader::PORT_DONE) DeviceManager::instance().recordKeyload();
+        
+        len += snprintf(lines + len, sizeof(lines) - len, "%sP%u %s %u/%u %s", i ? "\n" : "", i,
+                        STATE_TAGS[st.state], st.current, st.total, st.status);
+        if (len >= sizeof(lines)) len = sizeof(lines) - 1;
+    }
+    
+    if (!keyload_ports_label) return;
+    lv_label_set_text(keyload_ports_label, lines);
+    
+    if (running) {
+        lv_bar_set_value(keyload_progress, total ? (int)(current * 100 / total) : 0, LV_ANIM_ON);
+        lv_label_set_text(keyload_status_label, "Loading all ports...");
+        lv_obj_set_style_text_color(keyload_status_label, COLOR_WARNING, 0);
+    } else if (finished) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%u radio(s) loaded, %u failed", done, failed);
         lv_label_set_text(keyload_status_label, buf);
-        lv_obj_set_style_text_color(keyload_status_label, COLOR_ERROR, 0);
+        lv_obj_set_style_text_color(keyload_status_label, failed ? COLOR_ERROR : COLOR_SUCCESS, 0);
+        lv_bar_set_value(keyload_progress, 100, LV_ANIM_ON);
+        set_keyload_btn_idle();
+    }
+}
+
+// Drains worker events on the LVGL thread - the only place KFD results touch widgets
+static void kfd_event_timer_cb(lv_timer_t* t) {
+    (void)t;
+    poll_fleet_status();
+    
+    KFDProtocol::AsyncEvent ev;
+    while (getKfdProtocol().pollEvent(ev)) {
+        if (ev.op == KFDProtocol::ASYNC_VIEW_KEYS) {
+            on_inventory_event(ev);
+            continue;
+        }
+        
+        if (ev.kind == KFDProtocol::AsyncEvent::DONE && ev.success &&
+            (ev.op == KFDProtocol::ASYNC_KEYLOAD || ev.op == KFDProtocol::ASYNC_KEYLOAD_PLAN ||
+             ev.op == KFDProtocol::ASYNC_SYNC)) {
+            DeviceManager::instance().recordKeyload();
+        }
+        
+        // Keyload screen not built yet - nothing to update
+        if (!keyload_status_label) continue;
+        
+        if (ev.kind == KFDProtocol::AsyncEvent::PROGRESS) {
+            int pct = (ev.total > 0) ? (ev.current * 100 / ev.total) : 0;
+            lv_bar_set_value(keyload_progress, pct, LV_ANIM_ON);
+            lv_label_set_text(keyload_status_label, ev.status);
+            continue;
+        }
+        
+        set_keyload_btn_idle();
+        
+        if (ev.op == KFDProtocol::ASYNC_TEST_INVENTORY || ev.op == KFDProtocol::ASYNC_TEST_DES_KEY) {
+            lv_label_set_text(keyload_status_label, ev.status);
+            lv_obj_set_style_text_color(keyload_status_label, COLOR_TEXT, 0);
+        } else if (ev.op == KFDProtocol::ASYNC_SYNC && ev.success) {
+            // Summary says how many keys were skipped
+            lv_label_set_text(keyload_status_label, ev.status);
+            lv_obj_set_style_text_color(keyload_status_label, COLOR_SUCCESS, 0);
+            lv_bar_set_value(keyload_progress, 100, LV_ANIM_ON);
+        } else if (ev.success) {
+            lv_label_set_text(keyload_status_label, ev.op == KFDProtocol::ASYNC_KEYLOAD ?
+                              "Key loaded successfully!" : "All keys loaded!");
+            lv_obj_set_style_text_color(keyload_status_label, COLOR_SUCCESS, 0);
+            lv_bar_set_value(keyload_progress, 100, LV_ANIM_ON);
+        } else {
+            char buf[128];
+            snprintf(buf, sizeof(buf), "Failed: %s", ev.status);
+            lv_label_set_text(keyload_status_label, buf);
+            lv_obj_set_style_text_color(keyload_status_label, COLOR_ERROR, 0);
+            if (ev.op == KFDProtocol::ASYNC_KEYLOAD) lv_bar_set_value(keyload_progress, 0, LV_ANIM_ON);
+        }
     }
 }
 
 // =============================================================================
 // Diagnostics Screen
 // =============================================================================
+static lv_obj_t* diag_info_label = nullptr;
+static lv_obj_t* diag_metrics_label = nullptr;
+
+static const uint32_t DIAG_REFRESH_MS = 1000;
+
+static void refresh_diagnostics_screen();
+
+static void diag_timer_cb(lv_timer_t* t) {
+    (void)t;
+    if (lv_scr_act() == scr_diagnostics) refresh_diagnostics_screen();
+}
+
+// Compact duration for the metrics panel
+static void fmt_us(char* buf, size_t len, uint32_t us) {
+    if (us < 1000) snprintf(buf, len, "%uus", (unsigned)us);
+    else if (us < 10000000) snprintf(buf, len, "%.1fms", us / 1000.0f);
+    else snprintf(buf, len, "%us", (unsigned)(us / 1000000));
+}
+
 static void build_diagnostics_screen() {
-    if (scr_diagnostics) lv_obj_del(scr_diagnostics);
+    if (scr_diagnostics) return;
     scr_diagnostics = lv_obj_create(NULL);
     style_screen(scr_diagnostics);
     
@@ -1186,14 +1633,9 @@ static void build_diagnostics_screen() {
     lv_obj_align(info_panel, LV_ALIGN_TOP_MID, 0, y);
     style_panel(info_panel);
     
-    const DeviceInfo& info = DeviceManager::instance().getInfo();
-    char buf[256];
-    snprintf(buf, sizeof(buf), "Serial: %s\nModel: %s\nFirmware: %s\nUID: %08X\nKeyloads: %u",
-        info.serialNumber, info.modelNumber, info.firmwareVer, info.uniqueId, info.keyloadCount);
-    lv_obj_t* lbl = lv_label_create(info_panel);
-    lv_label_set_text(lbl, buf);
-    lv_obj_set_style_text_color(lbl, COLOR_TEXT, 0);
-    lv_obj_align(lbl, LV_ALIGN_TOP_LEFT, 5, 5);
+    diag_info_label = lv_label_create(info_panel);
+    lv_obj_set_style_text_color(diag_info_label, COLOR_TEXT, 0);
+    lv_obj_align(diag_info_label, LV_ALIGN_TOP_LEFT, 5, 5);
     
     y += 145;
     
@@ -1244,30 +1686,104 @@ static void build_diagnostics_screen() {
     lv_label_set_text(ld, "DISABLE INTERFACE");
     lv_obj_center(ld);
     
+    y += BTN_H + 10;
+    
+    // Link metrics (full histograms: serial "metrics")
+    lv_obj_t* metrics_panel = lv_obj_create(scr_diagnostics);
+    lv_obj_set_size(metrics_panel, SCREEN_W - 16, SCREEN_H - FOOTER_H - y - 4);
+    lv_obj_align(metrics_panel, LV_ALIGN_TOP_MID, 0, y);
+    lv_obj_clear_flag(metrics_panel, LV_OBJ_FLAG_SCROLLABLE);
+    style_panel(metrics_panel);
+    
+    diag_metrics_label = lv_label_create(metrics_panel);
+    lv_obj_set_style_text_color(diag_metrics_label, COLOR_TEXT, 0);
+    lv_obj_set_style_text_font(diag_metrics_label, &lv_font_montserrat_12, 0);
+    lv_obj_align(diag_metrics_label, LV_ALIGN_TOP_LEFT, 0, -6);
+    
+    lv_timer_create(diag_timer_cb, DIAG_REFRESH_MS, NULL);
+    
     create_footer(scr_diagnostics);
 }
 
+static void refresh_diagnostics_screen() {
+    const DeviceInfo& info = DeviceManager::instance().getInfo();
+    char buf[256];
+    snprintf(buf, sizeof(buf), "Serial: %s\nModel: %s\nFirmware: %s\nUID: %08X\nKeyloads: %u",
+        info.serialNumber, info.modelNumber, info.firmwareVer, info.uniqueId, info.keyloadCount);
+    lv_label_set_text(diag_info_label, buf);
+    
+    // p50 / p90 of the phases that explain a slow session
+    Metrics::Histogram conn = Metrics::getPhase(Metrics::PH_CONNECT);
+    Metrics::Histogram turn = Metrics::getPhase(Metrics::PH_TURNAROUND);
+    Metrics::Histogram rx = Metrics::getPhase(Metrics::PH_RX_FRAME);
+    Metrics::OpStats load = Metrics::getOp(Metrics::OP_KEYLOAD_MULTI);
+    char c50[12], c90[12], t50[12], t90[12], r50[12], l50[12];
+    fmt_us(c50, sizeof(c50), conn.percentileUs(50));
+    fmt_us(c90, sizeof(c90), conn.percentileUs(90));
+    fmt_us(t50, sizeof(t50), turn.percentileUs(50));
+    fmt_us(t90, sizeof(t90), turn.percentileUs(90));
+    fmt_us(r50, sizeof(r50), rx.percentileUs(50));
+    fmt_us(l50, sizeof(l50), load.time.percentileUs(50));
+    snprintf(buf, sizeof(buf),
+        "Connect %s / %s  retry %u fail %u\n"
+        "Turnaround %s / %s  RX %s\n"
+        "CRC %u  Parity %u  Framing %u  T/O %u\n"
+        "Keyload %s  (%u, %u failed)",
+        c50, c90, (unsigned)Metrics::getCounter(Metrics::CNT_HANDSHAKE_RETRIES),
+        (unsigned)Metrics::getCounter(Metrics::CNT_HANDSHAKE_FAILS),
+        t50, t90, r50,
+        (unsigned)Metrics::getCounter(Metrics::CNT_CRC_ERRORS),
+        (unsigned)Metrics::getCounter(Metrics::CNT_PARITY_ERRORS),
+        (unsigned)Metrics::getCounter(Metrics::CNT_FRAMING_ERRORS),
+        (unsigned)Metrics::getCounter(Metrics::CNT_RX_TIMEOUTS),
+        l50, (unsigned)load.time.count, (unsigned)load.failures);
+    lv_label_set_text(diag_metrics_label, buf);
+}
+
+// Restore, import or lock changed the store under the UI: drop the compiled
+// plan (wire-encoded keys) and every index into the old contents, and leave
+// screens that show them. Lock covers the session timeout as well as the
+// logout button, so it always ends on the login screen.
+static void on_store_event(ContainerManager::StoreEvent event) {
+    invalidate_keyload_plan();
+    current_container_idx = -1;
+    current_group_idx = 0;
+    current_key_idx = -1;
+    keys_list_container = -1;
+    if (ta_key_value) lv_textarea_set_text(ta_key_value, "");
+    
+    lv_obj_t* act = lv_scr_act();
+    if (event == ContainerManager::STORE_LOCKED) {
+        if (act != scr_login) ui_show_login();
+    } else if (act == scr_keys || act == scr_key_edit || act == scr_container_edit || act == scr_keyload) {
+        ui_show_containers();
+    } else if (act == scr_containers) {
+        refresh_containers_list();
+    }
+}
+
 // =============================================================================
 // Public API
 // =============================================================================
 void ui_init(void) {
-    build_login_screen();
+    lv_timer_create(kfd_event_timer_cb, 20, NULL);
+    ContainerManager::instance().setStoreCallback(on_store_event);
     if (!DeviceManager::instance().getSettings().requireLogin) {
         DeviceManager::instance().login(ROLE_OPERATOR, DEFAULT_OPERATOR_PIN);
-        build_main_menu();
-        lv_scr_load(scr_main_menu);
+        ui_show_main_menu();
+        storage_locked_notice();
     } else {
-        lv_scr_load(scr_login);
+        ui_show_login();
     }
 }
 
-void ui_show_login(void) { build_login_screen(); lv_scr_load(scr_login); }
-void ui_show_main_menu(void) { build_main_menu(); lv_scr_load(scr_main_menu); }
-void ui_show_containers(void) { build_containers_screen(); lv_scr_load(scr_containers); }
-void ui_show_container_detail(int idx) { current_container_idx = idx; build_container_detail_screen(); lv_scr_load(scr_keys); }
-void ui_show_key_edit(int c, int g, int k) { current_container_idx = c; current_group_idx = g; current_key_idx = k; build_key_edit_screen(); lv_scr_load(scr_key_edit); }
-void ui_show_keyload(void) { build_keyload_screen(); lv_scr_load(scr_keyload); }
-void ui_show_diagnostics(void) { build_diagnostics_screen(); lv_scr_load(scr_diagnostics); }
+void ui_show_login(void) { build_login_screen(); refresh_login_screen(); show_screen(scr_login); }
+void ui_show_main_menu(void) { build_main_menu(); refresh_main_menu(); show_screen(scr_main_menu); }
+void ui_show_containers(void) { build_containers_screen(); refresh_containers_list(); show_screen(scr_containers); }
+void ui_show_container_detail(int idx) { current_container_idx = idx; build_container_detail_screen(); refresh_container_detail_screen(); show_screen(scr_keys); }
+void ui_show_key_edit(int c, int g, int k) { current_container_idx = c; current_group_idx = g; current_key_idx = k; build_key_edit_screen(); refresh_key_edit_screen(); show_screen(scr_key_edit); }
+void ui_show_keyload(void) { build_keyload_screen(); refresh_keyload_screen(); show_screen(scr_keyload); }
+void ui_show_diagnostics(void) { build_diagnostics_screen(); refresh_diagnostics_screen(); show_screen(scr_diagnostics); }
 
 void ui_show_message(const char* title, const char* msg, int type) {
     lv_color_t c = (type == 0) ? COLOR_ACCENT : (type == 1) ? COLOR_WARNING : COLOR_ERROR;
@@ -1288,7 +1804,7 @@ bool ui_can_navigate_away(void) { return !getKfdProtocol().isOperationInProgress
 void ui_show_multiple_keyload(void) {}
 void ui_show_key_erase(void) { ui_show_message("Key Erase", "Coming soon", 0); }
 void ui_show_erase_all_keys(void) { ui_show_message("Erase All", "Coming soon", 0); }
-void ui_show_view_key_info(void) { ui_show_message("View Info", "Coming soon", 0); }
+void ui_show_view_key_info(void) { build_inventory_screen(); refresh_inventory_rows(); show_screen(scr_inventory); }
 void ui_show_view_keyset_info(void) {}
 void ui_show_rsi_config(void) {}
 void ui_show_kmf_config(void) {}
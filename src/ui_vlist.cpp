@@ -0,0 +1,176 @@
+/**
+ * @file ui_vlist.cpp
+ * @brief Virtualized list widget implementation
+ */
+
+#include "ui_vlist.h"
+#include <vector>
+
+#if !LV_USE_LARGE_COORD
+#error "ui_vlist needs LV_USE_LARGE_COORD: a 200-row list is taller than 8191 px"
+#endif
+
+static const lv_coord_t ROW_GAP = 4;
+
+struct VList {
+    lv_coord_t pitch;               // Row height + gap
+    uint32_t count;
+    ui_vlist_bind_cb_t bindCb;
+    lv_obj_t* spacer;               // Sized to all rows - defines the scroll range
+    lv_obj_t* empty;                // Empty-list text (created on demand)
+    std::vector<lv_obj_t*> rows;    // Pool
+    std::vector<int32_t> bound;     // Item shown per pooled row (-1 = none)
+};
+
+static VList* vlist_of(lv_obj_t* list) {
+    return list ? (VList*)lv_obj_get_user_data(list) : nullptr;
+}
+
+// Item i always lives in pool slot i % n, so scrolling by one row rebinds
+// exactly one row instead of all of them
+static void vlist_update(lv_obj_t* list, VList* vl, bool force) {
+    const uint32_t n = vl->rows.size();
+    lv_coord_t sy = lv_obj_get_scroll_y(list);
+    uint32_t first = sy > 0 ? (uint32_t)(sy / vl->pitch) : 0;
+
+    for (uint32_t slot = 0; slot < n; slot++) {
+        uint32_t idx = first + (slot + n - first % n) % n;
+        lv_obj_t* row = vl->rows[slot];
+
+        if (idx >= vl->count) {
+            vl->bound[slot] = -1;
+            lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+            continue;
+        }
+        if (force || vl->bound[slot] != (int32_t)idx) {
+            lv_obj_set_y(row, (lv_coord_t)(idx * vl->pitch));
+            vl->bindCb(row, idx);
+            vl->bound[slot] = (int32_t)idx;
+        }
+        lv_obj_clear_flag(row, LV_OBJ_FLAG_HIDDEN);
+    }
+
+    if (vl->empty) {
+        if (vl->count == 0) lv_obj_clear_flag(vl->empty, LV_OBJ_FLAG_HIDDEN);
+        else lv_obj_add_flag(vl->empty, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+static void vlist_event_cb(lv_event_t* e) {
+    lv_obj_t* list = lv_event_get_target(e);
+    VList* vl = vlist_of(list);
+    if (!vl) return;
+
+    if (lv_event_get_code(e) == LV_EVENT_SCROLL) {
+        vlist_update(list, vl, false);
+    } else if (lv_event_get_code(e) == LV_EVENT_DELETE) {
+        lv_obj_set_user_data(list, nullptr);
+        delete vl;
+    }
+}
+
+lv_obj_t* ui_vlist_create(lv_obj_t* parent, lv_coord_t w, lv_coord_t h, lv_coord_t row_h,
+                          ui_vlist_create_cb_t create_cb, ui_vlist_bind_cb_t bind_cb) {
+    lv_obj_t* list = lv_obj_create(parent);
+    lv_obj_set_size(list, w, h);
+    lv_obj_set_scroll_dir(list, LV_DIR_VER);
+    lv_obj_set_style_pad_all(list, 2, 0);
+
+    VList* vl = new VList();
+    vl->pitch = row_h + ROW_GAP;
+    vl->count = 0;
+    vl->bindCb = bind_cb;
+    vl->empty = nullptr;
+
+    vl->spacer = lv_obj_create(list);
+    lv_obj_remove_style_all(vl->spacer);
+    lv_obj_clear_flag(vl->spacer, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_set_size(vl->spacer, 1, 0);
+    lv_obj_set_pos(vl->spacer, 0, 0);
+
+    uint32_t n = (uint32_t)(h / vl->pitch) + 2;
+    vl->rows.reserve(n);
+    vl->bound.assign(n, -1);
+    for (uint32_t i = 0; i < n; i++) {
+        lv_obj_t* row = lv_obj_create(list);
+        lv_obj_set_size(row, lv_pct(100), row_h);
+        lv_obj_clear_flag(row, LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+        create_cb(row);
+        vl->rows.push_back(row);
+    }
+
+    lv_obj_set_user_data(list, vl);
+    lv_obj_add_event_cb(list, vlist_event_cb, LV_EVENT_SCROLL, nullptr);
+    lv_obj_add_event_cb(list, vlist_event_cb, LV_EVENT_DELETE, nullptr);
+    return list;
+}
+
+void ui_vlist_set_count(lv_obj_t* list, uint32_t count) {
+    VList* vl = vlist_of(list);
+    if (!vl) return;
+
+    vl->count = count;
+    lv_obj_set_height(vl->spacer, count ? (lv_coord_t)(count * vl->pitch - ROW_GAP) : 0);
+
+    // Keep the scroll position inside the (possibly shorter) content
+    lv_obj_update_layout(list);
+    lv_coord_t maxY = (lv_coord_t)(count * vl->pitch) - ROW_GAP - lv_obj_get_content_height(list);
+    if (maxY < 0) maxY = 0;
+    if (lv_obj_get_scroll_y(list) > maxY) lv_obj_scroll_to_y(list, maxY, LV_ANIM_OFF);
+
+    vlist_update(list, vl, true);
+}
+
+uint32_t ui_vlist_get_count(lv_obj_t* list) {
+    VList* vl = vlist_of(list);
+    return vl ? vl->count : 0;
+}
+
+void ui_vlist_rebind(lv_obj_t* list) {
+    VList* vl = vlist_of(list);
+    if (vl) vlist_update(list, vl, true);
+}
+
+void ui_vlist_scroll_to(lv_obj_t* list, uint32_t index) {
+    VList* vl = vlist_of(list);
+    if (!vl) return;
+
+    lv_obj_update_layout(list);
+    lv_coord_t y = (lv_coord_t)(index * vl->pitch);
+    lv_coord_t maxY = (lv_coord_t)(vl->count * vl->pitch) - ROW_GAP - lv_obj_get_content_height(list);
+    if (y > maxY) y = maxY;
+    if (y < 0) y = 0;
+    lv_obj_scroll_to_y(list, y, LV_ANIM_OFF);
+    vlist_update(list, vl, false);
+}
+
+void ui_vlist_set_empty_text(lv_obj_t* list, const char* text) {
+    VList* vl = vlist_of(list);
+    if (!vl) return;
+
+    if (!text) {
+        if (vl->empty) lv_obj_del(vl->empty);
+        vl->empty = nullptr;
+        return;
+    }
+    if (!vl->empty) {
+        vl->empty = lv_label_create(list);
+        lv_obj_set_pos(vl->empty, 4, 4);
+    }
+    lv_label_set_text(vl->empty, text);
+    if (vl->count == 0) lv_obj_clear_flag(vl->empty, LV_OBJ_FLAG_HIDDEN);
+    else lv_obj_add_flag(vl->empty, LV_OBJ_FLAG_HIDDEN);
+}
+
+int32_t ui_vlist_row_index(lv_obj_t* list, lv_obj_t* obj) {
+    VList* vl = vlist_of(list);
+    if (!vl) return -1;
+
+    while (obj && lv_obj_get_parent(obj) != list) obj = lv_obj_get_parent(obj);
+    if (!obj) return -1;
+    for (size_t slot = 0; slot < vl->rows.size(); slot++) {
+        if (vl->rows[slot] == obj) return vl->bound[slot];
+    }
+    return -1;
+}